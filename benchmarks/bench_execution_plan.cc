@@ -0,0 +1,52 @@
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "litchi/litchi.h"
+
+using namespace litchi;
+
+namespace {
+
+// small MLP where the per-layer bookkeeping is a large part of a call
+void build_small_mlp(sequential &net, size_t width) {
+  net << std::make_shared<fully_connected_layer>(width, width)
+      << std::make_shared<relu_layer>(width)
+      << std::make_shared<fully_connected_layer>(width, width)
+      << std::make_shared<relu_layer>(width)
+      << std::make_shared<fully_connected_layer>(width, 10);
+  for (size_t i = 0; i < net.size(); i++) net[i].set_parallelize(false);
+}
+
+// (batch, width), layer by layer through sequential::forward
+void BM_sequential_forward(benchmark::State &state) {
+  const size_t batch = state.range(0), width = state.range(1);
+  sequential net;
+  build_small_mlp(net, width);
+  const tensor_t x = tensor_t(batch, vec_t(width, float_t{1}));
+  net.forward(x);
+  for (auto _ : state) {
+    *net.input_tensor() = x;
+    benchmark::DoNotOptimize(&net.forward()[0][0]);
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+
+// (batch, width), through the compiled tape
+void BM_execution_plan(benchmark::State &state) {
+  const size_t batch = state.range(0), width = state.range(1);
+  sequential net;
+  build_small_mlp(net, width);
+  const tensor_t x    = tensor_t(batch, vec_t(width, float_t{1}));
+  execution_plan plan = compile_network(net, batch);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(&plan.run(x)[0][0]);
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+
+}  // namespace
+
+BENCHMARK(BM_sequential_forward)->Args({1, 16})->Args({1, 64})->Args({8, 64});
+BENCHMARK(BM_execution_plan)->Args({1, 16})->Args({1, 64})->Args({8, 64});
@@ -0,0 +1,105 @@
+#include <cmath>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "litchi/litchi.h"
+
+using namespace litchi;
+
+namespace {
+
+// reports the hardware counters of the timed loop next to the timings,
+// left out where perf_event_open is denied
+void set_counters(benchmark::State &state,
+                  const perf_sample &sample,
+                  uint64_t flops,
+                  uint64_t bytes) {
+  const perf_metrics m = derive_metrics(sample, flops, bytes);
+  const std::vector<std::pair<const char *, double>> values = {
+    {"GFLOPS", m.gflops},     {"IPC", m.ipc},
+    {"DRAM_GBps", m.dram_gbps}, {"L1D_MPKI", m.l1d_mpki},
+    {"LLC_MPKI", m.llc_mpki}, {"DTLB_MPKI", m.dtlb_mpki}};
+  for (const auto &v : values) {
+    if (!std::isnan(v.second)) state.counters[v.first] = v.second;
+  }
+}
+
+// (batch, in, out), single threaded
+void BM_fully_connected(benchmark::State &state) {
+  const size_t batch = state.range(0), in = state.range(1),
+               out   = state.range(2);
+  fully_connected_layer l(in, out);
+  l.set_parallelize(false);
+  tensor_t x(batch, vec_t(in)), W(1, vec_t(in * out)), b(1, vec_t(out));
+  for (auto &v : x) uniform_rand(v.begin(), v.end(), -1.0f, 1.0f);
+  uniform_rand(W[0].begin(), W[0].end(), -1.0f, 1.0f);
+  tensor_t y(batch, vec_t(out));
+  std::vector<tensor_t *> in_data = {&x, &W, &b}, out_data = {&y};
+
+  perf_counters counters;
+  counters.start();
+  for (auto _ : state) {
+    l.forward_propagation(in_data, out_data);
+    benchmark::DoNotOptimize(&y[0][0]);
+  }
+  const perf_sample sample = counters.stop();
+
+  const uint64_t iterations = state.iterations();
+  state.SetItemsProcessed(iterations * batch);
+  set_counters(state, sample, iterations * 2 * batch * in * out,
+               iterations * (batch * (in + out) + in * out + out) *
+                 sizeof(float_t));
+}
+
+#ifdef CNN_USE_HUGE_PAGES
+// (batch, in, out, huge pages), single threaded: the weights are streamed
+// from memory on every call, through 4 KB or 2 MB pages
+void BM_fully_connected_huge_pages(benchmark::State &state) {
+  const size_t batch = state.range(0), in = state.range(1),
+               out   = state.range(2);
+  set_huge_page_mode(state.range(3) ? huge_page_mode::transparent
+                                    : huge_page_mode::off);
+  fully_connected_layer l(in, out);
+  l.set_parallelize(false);
+  tensor_t x(batch, vec_t(in)), W(1, vec_t(in * out)), b(1, vec_t(out));
+  for (auto &v : x) uniform_rand(v.begin(), v.end(), -1.0f, 1.0f);
+  uniform_rand(W[0].begin(), W[0].end(), -1.0f, 1.0f);
+  tensor_t y(batch, vec_t(out));
+  std::vector<tensor_t *> in_data = {&x, &W, &b}, out_data = {&y};
+  const huge_page_report pages = huge_page_usage();
+  set_huge_page_mode(huge_page_mode::off);
+
+  perf_counters counters;
+  counters.start();
+  for (auto _ : state) {
+    l.forward_propagation(in_data, out_data);
+    benchmark::DoNotOptimize(&y[0][0]);
+  }
+  const perf_sample sample = counters.stop();
+
+  const uint64_t iterations = state.iterations();
+  state.SetItemsProcessed(iterations * batch);
+  set_counters(state, sample, iterations * 2 * batch * in * out,
+               iterations * (batch * (in + out) + in * out + out) *
+                 sizeof(float_t));
+  state.counters["huge_MB"] = double(pages.huge_bytes) / (1 << 20);
+}
+#endif
+
+}  // namespace
+
+BENCHMARK(BM_fully_connected)
+  ->Args({1, 1024, 1024})
+  ->Args({1, 4096, 4096})
+  ->Args({4, 1024, 1024})
+  ->Args({32, 1024, 1024})
+  ->Args({128, 512, 512});
+
+#ifdef CNN_USE_HUGE_PAGES
+BENCHMARK(BM_fully_connected_huge_pages)
+  ->Args({1, 4096, 4096, 0})
+  ->Args({1, 4096, 4096, 1})
+  ->Args({8, 8192, 4096, 0})
+  ->Args({8, 8192, 4096, 1});
+#endif
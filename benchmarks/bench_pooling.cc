@@ -0,0 +1,133 @@
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "litchi/litchi.h"
+
+using namespace litchi;
+
+namespace {
+
+// scalar max pooling keeping a full size_t argmax per output, as a baseline
+// for the vectorized kernel and its compact argmax
+void naive_max_pool(const tensor_t &in,
+                    tensor_t &out,
+                    std::vector<std::vector<size_t>> &argmax,
+                    const core::pooling_params &p) {
+  argmax.resize(in.size());
+  for (size_t s = 0; s < in.size(); s++) {
+    argmax[s].resize(p.out.size());
+    for (size_t c = 0; c < p.out.depth_; c++) {
+      for (size_t oy = 0; oy < p.out.height_; oy++) {
+        for (size_t ox = 0; ox < p.out.width_; ox++) {
+          size_t best = p.in.get_index(ox * p.stride_x, oy * p.stride_y, c);
+          for (size_t dy = 0; dy < p.pool_size_y; dy++) {
+            for (size_t dx = 0; dx < p.pool_size_x; dx++) {
+              const size_t i = p.in.get_index(ox * p.stride_x + dx,
+                                              oy * p.stride_y + dy, c);
+              if (in[s][i] > in[s][best]) best = i;
+            }
+          }
+          const size_t o = p.out.get_index(ox, oy, c);
+          out[s][o]      = in[s][best];
+          argmax[s][o]   = best;
+        }
+      }
+    }
+  }
+}
+
+void naive_ave_pool(const tensor_t &in,
+                    tensor_t &out,
+                    const core::pooling_params &p) {
+  const float_t scale = float_t(1) / float_t(p.window_area());
+  for (size_t s = 0; s < in.size(); s++) {
+    for (size_t c = 0; c < p.out.depth_; c++) {
+      for (size_t oy = 0; oy < p.out.height_; oy++) {
+        for (size_t ox = 0; ox < p.out.width_; ox++) {
+          float_t sum = float_t{0};
+          for (size_t dy = 0; dy < p.pool_size_y; dy++) {
+            for (size_t dx = 0; dx < p.pool_size_x; dx++) {
+              sum += in[s][p.in.get_index(ox * p.stride_x + dx,
+                                          oy * p.stride_y + dy, c)];
+            }
+          }
+          out[s][p.out.get_index(ox, oy, c)] = sum * scale;
+        }
+      }
+    }
+  }
+}
+
+// 56x56x64 feature maps, batch of 8
+constexpr size_t kWidth = 56, kChannels = 64, kBatch = 8;
+
+tensor_t make_input() {
+  tensor_t in(kBatch, vec_t(kWidth * kWidth * kChannels));
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0f, 1.0f);
+  return in;
+}
+
+// calls the kernel directly, so that the timings exclude the copies of the
+// input into the graph
+template <typename Layer>
+void run_layer(benchmark::State &state, Layer &l) {
+  tensor_t in = make_input();
+  tensor_t out(kBatch, vec_t(l.params().out.size()));
+  std::vector<tensor_t *> in_data = {&in}, out_data = {&out};
+  l.set_parallelize(false);
+  for (auto _ : state) {
+    l.forward_propagation(in_data, out_data);
+    benchmark::DoNotOptimize(&out[0][0]);
+  }
+  state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+void BM_max_pool_naive(benchmark::State &state) {
+  const size_t k = state.range(0), stride = state.range(1);
+  max_pooling_layer l(kWidth, kWidth, kChannels, k, k, stride, stride);
+  const tensor_t in = make_input();
+  tensor_t out(kBatch, vec_t(l.params().out.size()));
+  std::vector<std::vector<size_t>> argmax;
+  for (auto _ : state) {
+    naive_max_pool(in, out, argmax, l.params());
+    benchmark::DoNotOptimize(&out[0][0]);
+  }
+  state.SetItemsProcessed(state.iterations() * kBatch);
+  state.counters["argmax_bytes"] =
+    double(kBatch * l.params().out.size() * sizeof(size_t));
+}
+
+void BM_max_pool(benchmark::State &state) {
+  const size_t k = state.range(0), stride = state.range(1);
+  max_pooling_layer l(kWidth, kWidth, kChannels, k, k, stride, stride);
+  run_layer(state, l);
+  state.counters["argmax_bytes"] =
+    double(kBatch * l.params().out.size() * sizeof(uint8_t));
+}
+
+void BM_ave_pool_naive(benchmark::State &state) {
+  const size_t k = state.range(0), stride = state.range(1);
+  average_pooling_layer l(kWidth, kWidth, kChannels, k, k, stride, stride);
+  const tensor_t in = make_input();
+  tensor_t out(kBatch, vec_t(l.params().out.size()));
+  for (auto _ : state) {
+    naive_ave_pool(in, out, l.params());
+    benchmark::DoNotOptimize(&out[0][0]);
+  }
+  state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+void BM_ave_pool(benchmark::State &state) {
+  const size_t k = state.range(0), stride = state.range(1);
+  average_pooling_layer l(kWidth, kWidth, kChannels, k, k, stride, stride);
+  run_layer(state, l);
+}
+
+}  // namespace
+
+// (window, stride)
+BENCHMARK(BM_max_pool_naive)->Args({2, 2})->Args({3, 1})->Args({3, 2});
+BENCHMARK(BM_max_pool)->Args({2, 2})->Args({3, 1})->Args({3, 2});
+BENCHMARK(BM_ave_pool_naive)->Args({2, 2})->Args({3, 1})->Args({3, 2});
+BENCHMARK(BM_ave_pool)->Args({2, 2})->Args({3, 1})->Args({3, 2});
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "litchi/layers/layer.h"
+#include "litchi/util/parallel_for.h"
 #include "litchi/util/util.h"
 
 namespace litchi {
@@ -56,14 +57,24 @@ public:
 
   std::vector<shape3d> out_shape() const override { return {in_shape_}; }
 
+  uint64_t flops() const override { return in_shape_.size(); }
+
+  // elementwise: the same in every layout, but a shape of a single
+  // position or channel is channel-major whatever its layout (see
+  // same_memory_order), so it cannot carry channel-last data of another
+  // shape
+  bool supports_layout(data_layout layout) const override {
+    return layout == data_layout::nchw || !in_shape_.layout_invariant();
+  }
+
+  bool layout_agnostic() const override { return true; }
+
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     const tensor_t &x = *in_data[0];
     tensor_t &y       = *out_data[0];
-    // TODO parallel for
-    for (size_t j = 0; j < x.size(); j++) {
-      forward_activation(x[j], y[j]);
-    }
+    for_i(parallelize_, x.size(),
+          [&](size_t j) { forward_activation(x[j], y[j]); });
   }
 
   void back_propagation(const std::vector<tensor_t *> &in_data,
@@ -74,10 +85,8 @@ public:
     const tensor_t &dy = *out_grad[0];
     const tensor_t &x  = *in_data[0];
     const tensor_t &y  = *out_data[0];
-    // TODO parallel for
-    for (size_t j = 0; j < x.size(); j++) {
-      backward_activation(x[j], y[j], dx[j], dy[j]);
-    }
+    for_i(parallelize_, x.size(),
+          [&](size_t j) { backward_activation(x[j], y[j], dx[j], dy[j]); });
   }
 
   /**
@@ -103,6 +112,11 @@ public:
                                    vec_t &dx,
                                    const vec_t &dy) = 0;
 
+protected:
+  void apply_layout(data_layout layout) override {
+    in_shape_.layout_ = layout;
+  }
+
 private:
   shape3d in_shape_;
 };
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "litchi/activations/activation_layer.h"
+#include "litchi/layers/layer.h"
+
+namespace litchi {
+
+/**
+ * y = x, useful as a placeholder activation; graph optimizations remove it
+ */
+class identity_layer : public activation_layer {
+ public:
+  using activation_layer::activation_layer;
+
+  std::string layer_type() const override { return "identity-activation"; }
+
+  uint64_t flops() const override { return 0; }
+
+  void forward_activation(const vec_t &x, vec_t &y) override {
+    std::copy(x.begin(), x.end(), y.begin());
+  }
+
+  void backward_activation(const vec_t &x,
+                           const vec_t &y,
+                           vec_t &dx,
+                           const vec_t &dy) override {
+    CNN_UNREFERENCED_PARAMETER(x);
+    CNN_UNREFERENCED_PARAMETER(y);
+    std::copy(dy.begin(), dy.end(), dx.begin());
+  }
+};
+
+}  // namespace litchi
@@ -9,6 +9,8 @@ class relu_layer : public activation_layer {
 public:
   using activation_layer::activation_layer;
 
+  std::string layer_type() const override { return "relu-activation"; }
+
   void forward_activation(const vec_t &x, vec_t &y) override {
     for (size_t j = 0; j < x.size(); j++) {
       y[j] = std::max(float_t(0), x[j]);
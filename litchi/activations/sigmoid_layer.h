@@ -9,6 +9,8 @@ class sigmoid_layer : public activation_layer {
  public:
   using activation_layer::activation_layer;
 
+  std::string layer_type() const override { return "sigmoid-activation"; }
+
   void forward_activation(const vec_t &x, vec_t &y) override {
     for (size_t j = 0; j < x.size(); j++) {
       y[j] = float_t(1) / (float_t(1) + std::exp(-x[j]));
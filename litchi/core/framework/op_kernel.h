@@ -1,9 +1,12 @@
 #pragma once
 
-#include <memory>
 #include <vector>
 
+#include "litchi/core/framework/workspace.h"
 #include "litchi/core/params/params.h"
+#include "litchi/util/kernel_profiler.h"
+#include "litchi/util/parallel_for.h"
+#include "litchi/util/tracer.h"
 
 namespace litchi {
 
@@ -36,15 +39,16 @@ class OpKernelContext {
     Params *params_ptr_ = nullptr;
 
     backend_t engine = default_engine();
+
+    // whether the kernel may split its work across threads
+    bool parallelize = true;
   };
 
   OpKernelContext()
     : in_data_(nullptr),
       out_data_(nullptr),
       out_grad_(nullptr),
-      in_grad_(nullptr) {
-    op_params_ = std::unique_ptr<OpParams>(new OpParams());
-  }
+      in_grad_(nullptr) {}
 
   void set_in_out(const std::vector<tensor_t *> &in_data,
                   std::vector<tensor_t *> &out_data) {
@@ -52,13 +56,50 @@ class OpKernelContext {
     out_data_ = const_cast<std::vector<tensor_t *> *>(&out_data);
   }
 
+  void set_in_out(const std::vector<tensor_t *> &in_data,
+                  const std::vector<tensor_t *> &out_data,
+                  std::vector<tensor_t *> &out_grad,
+                  std::vector<tensor_t *> &in_grad) {
+    in_data_  = const_cast<std::vector<tensor_t *> *>(&in_data);
+    out_data_ = const_cast<std::vector<tensor_t *> *>(&out_data);
+    out_grad_ = &out_grad;
+    in_grad_  = &in_grad;
+  }
+
   tensor_t &input(const int idx) { return *(*in_data_)[idx]; }
 
+  size_t batch_size() const { return (*in_data_)[0]->size(); }
+
+  /** bytes of the tensors bound to the context */
+  uint64_t data_bytes() const {
+    uint64_t bytes = 0;
+    for (const auto *tensors : {in_data_, out_data_, out_grad_, in_grad_}) {
+      if (tensors) bytes += trace_bytes(*tensors);
+    }
+    return bytes;
+  }
+
   tensor_t &output(const int idx) { return *(*out_data_)[idx]; }
 
-  backend_t engine() const { return op_params_->engine; }
+  tensor_t &input_grad(const int idx) { return *(*in_grad_)[idx]; }
+
+  tensor_t &output_grad(const int idx) { return *(*out_grad_)[idx]; }
+
+  backend_t engine() const { return op_params_.engine; }
+
+  void setEngine(const backend_t engine) { op_params_.engine = engine; }
 
-  void setEngine(const backend_t engine) { op_params_->engine = engine; }
+  bool parallelize() const { return op_params_.parallelize; }
+
+  void setParallelize(const bool parallelize) {
+    op_params_.parallelize = parallelize;
+  }
+
+  /**
+   * scratch buffers of the kernels computed on this context, kept across
+   * computes
+   */
+  workspace &scratch() { return workspace_; }
 
  private:
   std::vector<tensor_t *> *in_data_;
@@ -66,7 +107,9 @@ class OpKernelContext {
   std::vector<tensor_t *> *out_grad_;
   std::vector<tensor_t *> *in_grad_;
 
-  std::unique_ptr<OpParams> op_params_;
+  OpParams op_params_;
+
+  workspace workspace_;
 };
 
 class OpKernel {
@@ -79,8 +122,51 @@ class OpKernel {
 
   virtual void compute(OpKernelContext &context) = 0;
 
+  /** name of the op in the traces */
+  virtual const char *name() const { return "OpKernel"; }
+
+  /** floating point operations of a compute() on the context, 0 if unknown */
+  virtual uint64_t flops(const OpKernelContext &context) const {
+    CNN_UNREFERENCED_PARAMETER(context);
+    return 0;
+  }
+
+  /**
+   * bytes of scratch one task of compute() leases from the context, as
+   * declared by the kernel at construction
+   */
+  size_t workspace_size() const { return workspace_size_; }
+
+  /**
+   * runs compute(), recorded as a "kernel" trace event when tracing and
+   * measured by the kernel_profiler when profiling; the scratch declared by
+   * the kernel is reserved for every thread beforehand
+   */
+  void run(OpKernelContext &context) {
+    if (workspace_size_ > 0) {
+      context.scratch().reserve(workspace_size_, parallel_concurrency() + 1);
+    }
+    trace_scope trace("kernel");
+    if (trace) {
+      trace.set_name(name());
+      trace.set_args(context.batch_size(), context.data_bytes());
+    }
+    kernel_profile_scope profile;
+    if (profile) profile.start(name(), flops(context), context.data_bytes());
+    compute(context);
+  }
+
  protected:
+  /**
+   * declares the scratch bytes a task of compute() leases from
+   * OpKernelContext::scratch(), for a kernel to call from its constructor
+   */
+  void set_workspace_size(size_t bytes) { workspace_size_ = bytes; }
+
   Params *params_ = nullptr;
+
+ private:
+  size_t workspace_size_ = 0;
 };
 
 }  // namespace core
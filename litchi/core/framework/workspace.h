@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "litchi/util/util.h"
+
+namespace litchi {
+
+namespace core {
+
+/**
+ * @brief Reusable scratch buffers for the temporaries of a kernel (packed
+ * GEMM panels, gathered rows...).
+ *
+ * Every concurrent task leases its own buffer and hands it back when the
+ * lease ends, so the pool grows to the peak number of tasks of a compute()
+ * and later computes of the same shapes allocate no scratch. A serial
+ * compute() then allocates nothing at all; a parallel one still allocates
+ * the bookkeeping of the threads of its loops (futures, pool tasks).
+ * Buffers are aligned to a cache line.
+ */
+class workspace {
+  struct buffer;
+
+ public:
+  static constexpr size_t alignment = 64;
+
+  /**
+   * a buffer of the pool, given back to it on destruction
+   */
+  class lease {
+   public:
+    lease() {}
+
+    lease(lease &&other) : owner_(other.owner_), buffer_(other.buffer_) {
+      other.owner_ = nullptr;
+    }
+
+    lease &operator=(lease &&other) {
+      if (this != &other) {
+        release();
+        owner_       = other.owner_;
+        buffer_      = other.buffer_;
+        other.owner_ = nullptr;
+      }
+      return *this;
+    }
+
+    ~lease() { release(); }
+
+    lease(const lease &) = delete;
+    lease &operator=(const lease &) = delete;
+
+    template <typename T = float_t>
+    T *data() const {
+      return static_cast<T *>(buffer_->data);
+    }
+
+    size_t bytes() const { return buffer_->bytes; }
+
+   private:
+    friend class workspace;
+
+    lease(workspace *owner, buffer *b) : owner_(owner), buffer_(b) {}
+
+    void release() {
+      if (owner_) owner_->release(buffer_);
+      owner_ = nullptr;
+    }
+
+    workspace *owner_ = nullptr;
+    buffer *buffer_   = nullptr;
+  };
+
+  workspace() {}
+
+  // a copied context starts with an empty pool
+  workspace(const workspace &) {}
+  workspace &operator=(const workspace &) { return *this; }
+
+  /**
+   * makes count buffers of at least bytes available, e.g. before the first
+   * compute() with the requirements declared by the kernel
+   */
+  void reserve(size_t bytes, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t ready = 0;
+    for (buffer *b : free_) {
+      if (b->bytes >= bytes) ready++;
+    }
+    for (buffer *b : free_) {
+      if (ready >= count) break;
+      if (b->bytes < bytes) {
+        grow(*b, bytes);
+        ready++;
+      }
+    }
+    while (ready < count) {
+      free_.push_back(create(bytes));
+      ready++;
+    }
+  }
+
+  /**
+   * a buffer of at least bytes, allocated only when no free buffer of the
+   * pool is large enough
+   */
+  lease acquire(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer *found = nullptr;
+    size_t index  = 0;
+    for (size_t i = 0; i < free_.size(); i++) {
+      if (free_[i]->bytes >= bytes) {
+        found = free_[i];
+        index = i;
+        break;
+      }
+    }
+    if (!found && !free_.empty()) {
+      // grows the largest free buffer rather than adding one
+      index = 0;
+      for (size_t i = 1; i < free_.size(); i++) {
+        if (free_[i]->bytes > free_[index]->bytes) index = i;
+      }
+      found = free_[index];
+      grow(*found, bytes);
+    }
+    if (found) {
+      free_[index] = free_.back();
+      free_.pop_back();
+    } else {
+      found = create(bytes);
+    }
+    return lease(this, found);
+  }
+
+  /** buffers allocated or grown so far */
+  size_t allocations() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return allocations_;
+  }
+
+  /** bytes held by the pool */
+  size_t bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t total = 0;
+    for (const auto &b : buffers_) total += b->bytes;
+    return total;
+  }
+
+ private:
+  struct buffer {
+    std::unique_ptr<char[]> storage;
+    void *data   = nullptr;
+    size_t bytes = 0;
+  };
+
+  void grow(buffer &b, size_t bytes) {
+    b.storage.reset(new char[bytes + alignment]);
+    const uintptr_t p = reinterpret_cast<uintptr_t>(b.storage.get());
+    b.data  = reinterpret_cast<void *>((p + alignment - 1) & ~(alignment - 1));
+    b.bytes = bytes;
+    allocations_++;
+  }
+
+  buffer *create(size_t bytes) {
+    buffers_.emplace_back(new buffer());
+    grow(*buffers_.back(), bytes);
+    // release() never reallocates the free list
+    free_.reserve(buffers_.size());
+    return buffers_.back().get();
+  }
+
+  void release(buffer *b) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(b);
+  }
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<buffer>> buffers_;
+  std::vector<buffer *> free_;
+  size_t allocations_ = 0;
+};
+
+}  // namespace core
+
+}  // namespace litchi
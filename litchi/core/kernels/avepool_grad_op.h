@@ -0,0 +1,38 @@
+#pragma once
+
+#include "litchi/core/framework/op_kernel.h"
+
+#include "litchi/core/kernels/pooling_op_internal.h"
+
+namespace litchi {
+
+class AvePoolGradOp : public core::OpKernel {
+ public:
+  explicit AvePoolGradOp(const core::OpKernelConstruction &context)
+    : core::OpKernel(context) {}
+
+  const char *name() const override { return "AvePoolGradOp"; }
+
+  void compute(core::OpKernelContext &context) override {
+    const auto &params = OpKernel::params_->pooling();
+
+    // incoming/outcoming data
+    tensor_t &prev_delta = context.input_grad(0);
+    tensor_t &curr_delta = context.output_grad(0);
+
+    // initialize outputs
+    fill_tensor(prev_delta, float_t{0});
+
+    // call the algorithm depending on the selected engine type
+    const core::backend_t engine = context.engine();
+
+    if (engine == core::backend_t::internal) {
+      kernels::avepool_grad_op_internal(prev_delta, curr_delta, params,
+                                        context.parallelize());
+    } else {
+      throw "Not supported engine";
+    }
+  }
+};
+
+}  // namespace litchi
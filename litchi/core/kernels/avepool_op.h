@@ -0,0 +1,38 @@
+#pragma once
+
+#include "litchi/core/framework/op_kernel.h"
+
+#include "litchi/core/kernels/pooling_op_internal.h"
+
+namespace litchi {
+
+class AvePoolOp : public core::OpKernel {
+ public:
+  explicit AvePoolOp(const core::OpKernelConstruction &context)
+    : core::OpKernel(context) {
+    set_workspace_size(
+      kernels::avepool_workspace_size(OpKernel::params_->pooling()));
+  }
+
+  const char *name() const override { return "AvePoolOp"; }
+
+  void compute(core::OpKernelContext &context) override {
+    const auto &params = OpKernel::params_->pooling();
+
+    // incoming/outcoming data
+    const tensor_t &in_data = context.input(0);
+    tensor_t &out_data      = context.output(0);
+
+    // call the algorithm depending on the selected engine type
+    const core::backend_t engine = context.engine();
+
+    if (engine == core::backend_t::internal) {
+      kernels::avepool_op_internal(in_data, out_data, params,
+                                   context.parallelize(), &context.scratch());
+    } else {
+      throw "Not supported engine";
+    }
+  }
+};
+
+}  // namespace litchi
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "litchi/core/framework/op_kernel.h"
+
+#include "litchi/core/kernels/conv2d_op_internal.h"
+
+namespace litchi {
+
+class Conv2dOp : public core::OpKernel {
+ public:
+  explicit Conv2dOp(const core::OpKernelConstruction &context)
+    : core::OpKernel(context) {
+    set_workspace_size(
+      kernels::conv2d_workspace_size(OpKernel::params_->conv()));
+  }
+
+  const char *name() const override { return "Conv2dOp"; }
+
+  uint64_t flops(const core::OpKernelContext &context) const override {
+    const auto &params = OpKernel::params_->conv();
+    return 2ull * context.batch_size() * params.out.size() *
+           params.patch_size();
+  }
+
+  void compute(core::OpKernelContext &context) override {
+    const auto &params = OpKernel::params_->conv();
+
+    // incoming/outcoming data
+    const tensor_t &in_data = context.input(0);
+    const tensor_t &W       = context.input(1);
+    const tensor_t *bias    = params.has_bias ? &context.input(2) : nullptr;
+    tensor_t &out_data      = context.output(0);
+
+    // binds to an empty vector without a bias rather than copying it
+    const vec_t no_bias;
+    const vec_t &b = params.has_bias ? (*bias)[0] : no_bias;
+
+    // call the algorithm depending on the selected engine type
+    const core::backend_t engine = context.engine();
+
+    if (engine == core::backend_t::internal) {
+      kernels::conv2d_op_internal(
+        in_data, W[0], b, out_data, params, context.parallelize(),
+        &context.scratch());
+    } else {
+      throw "Not supported engine";
+    }
+  }
+};
+
+}  // namespace litchi
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <cstddef>
+
+#include "litchi/core/kernels/gemm.h"
+#include "litchi/core/params/conv_params.h"
+#include "litchi/util/parallel_for.h"
+
+namespace litchi {
+
+namespace kernels {
+
+/**
+ * Geometry of the implicit im2col matrix of a convolution: its rows are
+ * indexed by the patch element kk = (ci * window_height + ky) *
+ * window_width + kx of a group, its columns by the output position
+ * p = oy * out_width + ox of a sample.
+ *
+ * The strides of the channels and of the positions follow the layout of
+ * the data, so the kernels below read and write channel-major and
+ * channel-last tensors in place.
+ */
+struct conv_geometry {
+  explicit conv_geometry(const core::conv_params &params)
+    : in_w(params.in.width_),
+      in_h(params.in.height_),
+      out_w(params.out.width_),
+      area(params.out.width_ * params.out.height_),
+      kw(params.weight.width_),
+      kh(params.weight.height_),
+      sw(params.w_stride),
+      sh(params.h_stride),
+      pw(params.w_padding),
+      ph(params.h_padding),
+      dw(params.w_dilation),
+      dh(params.h_dilation) {
+    if (params.in.layout_ == data_layout::nhwc) {
+      in_cs = 1;
+      in_ps = params.in.depth_;
+    } else {
+      in_cs = in_w * in_h;
+      in_ps = 1;
+    }
+    if (params.out.layout_ == data_layout::nhwc) {
+      out_cs = 1;
+      out_ps = params.out.depth_;
+    } else {
+      out_cs = area;
+      out_ps = 1;
+    }
+  }
+
+  // top-left input coordinate read by output position p
+  void origin(size_t p, std::ptrdiff_t &y0, std::ptrdiff_t &x0) const {
+    y0 = std::ptrdiff_t((p / out_w) * sh) - std::ptrdiff_t(ph);
+    x0 = std::ptrdiff_t((p % out_w) * sw) - std::ptrdiff_t(pw);
+  }
+
+  // (channel offset, dilated window offsets) of patch element kk
+  void offset(size_t kk,
+              size_t &channel,
+              std::ptrdiff_t &dy,
+              std::ptrdiff_t &dx) const {
+    channel        = kk / (kw * kh);
+    const size_t r = kk % (kw * kh);
+    dy             = std::ptrdiff_t((r / kw) * dh);
+    dx             = std::ptrdiff_t((r % kw) * dw);
+  }
+
+  // index of (channel, y, x) in the input, or -1 when it falls in padding
+  std::ptrdiff_t input_index(size_t channel,
+                             std::ptrdiff_t y,
+                             std::ptrdiff_t x) const {
+    if (y < 0 || x < 0 || y >= std::ptrdiff_t(in_h) ||
+        x >= std::ptrdiff_t(in_w)) {
+      return -1;
+    }
+    return std::ptrdiff_t(channel * in_cs +
+                          (size_t(y) * in_w + size_t(x)) * in_ps);
+  }
+
+  // index of (channel, output position p) in the output
+  size_t output_index(size_t channel, size_t p) const {
+    return channel * out_cs + p * out_ps;
+  }
+
+  size_t in_w, in_h, out_w, area;
+  size_t kw, kh, sw, sh, pw, ph, dw, dh;
+  // strides of a channel and of a position in the input and the output
+  size_t in_cs, in_ps, out_cs, out_ps;
+};
+
+/**
+ * bytes of scratch a task of the forward pass leases
+ */
+inline size_t conv2d_workspace_size(const core::conv_params &params) {
+  // the columns of the GEMM span the batch, a full block of nc columns
+  return gemm_workspace_size(gemm_config().nc, params.patch_size());
+}
+
+/**
+ * bytes of scratch a task of the backward pass leases
+ */
+inline size_t conv2d_grad_workspace_size(const core::conv_params &params) {
+  const conv_geometry geo(params);
+  return std::max(
+    gemm_workspace_size(params.patch_size(),
+                        params.out_channels_per_group()),
+    gemm_workspace_size(params.patch_size(), geo.area));
+}
+
+/**
+ * y[g] = W[g] * im2col(x[g]) for every group g, the columns of the
+ * im2col matrix spanning all the samples of the batch. The patches are
+ * gathered while packing the B panels, so only a tile of the im2col matrix
+ * exists at any time.
+ */
+inline void conv2d_op_internal(const tensor_t &in_data,
+                               const vec_t &W,
+                               const vec_t &bias,
+                               tensor_t &out_data,
+                               const core::conv_params &params,
+                               const bool layer_parallelize,
+                               core::workspace *scratch = nullptr) {
+  const conv_geometry geo(params);
+  const size_t cin_g  = params.in_channels_per_group();
+  const size_t cout_g = params.out_channels_per_group();
+  const size_t patch  = params.patch_size();
+
+  for (size_t sample = 0; sample < in_data.size(); sample++) {
+    vec_t &out = out_data[sample];
+    for (size_t o = 0; o < params.out.depth_; o++) {
+      const float_t b = params.has_bias ? bias[o] : float_t{0};
+      if (geo.out_ps == 1) {
+        vectorize::fill(&out[o * geo.area], geo.area, b);
+        continue;
+      }
+      for (size_t p = 0; p < geo.area; p++) out[geo.output_index(o, p)] = b;
+    }
+  }
+
+  for (size_t g = 0; g < params.groups; g++) {
+    const float_t *Wg = &W[g * cout_g * patch];
+
+    gemm(cout_g, in_data.size() * geo.area, patch,
+         [&](size_t i0, size_t k0, size_t mc, size_t kc, float_t *dst) {
+           gemm_pack_a_rows([&](size_t i) { return Wg + i * patch; }, i0, k0,
+                            mc, kc, dst);
+         },
+         [&](size_t k0, size_t j0, size_t kc, size_t nc, float_t *dst) {
+           for (size_t q = 0; q < nc; q += gemm_nr) {
+             const size_t nr = std::min(gemm_nr, nc - q);
+             const float_t *src[gemm_nr];
+             std::ptrdiff_t y0[gemm_nr], x0[gemm_nr];
+             for (size_t c = 0; c < nr; c++) {
+               const size_t n = j0 + q + c;
+               src[c]         = &in_data[n / geo.area][g * cin_g * geo.in_cs];
+               geo.origin(n % geo.area, y0[c], x0[c]);
+             }
+             for (size_t k = 0; k < kc; k++) {
+               size_t channel;
+               std::ptrdiff_t dy, dx;
+               geo.offset(k0 + k, channel, dy, dx);
+               float_t *d = dst + k * gemm_nr;
+               for (size_t c = 0; c < nr; c++) {
+                 const std::ptrdiff_t idx =
+                   geo.input_index(channel, y0[c] + dy, x0[c] + dx);
+                 d[c] = idx < 0 ? float_t{0} : src[c][idx];
+               }
+               for (size_t c = nr; c < gemm_nr; c++) d[c] = float_t{0};
+             }
+             dst += kc * gemm_nr;
+           }
+         },
+         [&](size_t i, size_t j, const float_t *values, size_t n) {
+           const size_t channel = g * cout_g + i;
+           if (geo.out_ps != 1) {
+             // channel-last: the positions of a channel are strided
+             for (size_t t = 0; t < n; t++, j++) {
+               out_data[j / geo.area][geo.output_index(channel,
+                                                       j % geo.area)] +=
+                 values[t];
+             }
+             return;
+           }
+           while (n > 0) {
+             const size_t sample = j / geo.area;
+             const size_t p      = j % geo.area;
+             const size_t len    = std::min(n, geo.area - p);
+             vectorize::reduce(values, len,
+                               &out_data[sample][channel * geo.area + p]);
+             values += len;
+             j += len;
+             n -= len;
+           }
+         },
+         layer_parallelize, gemm_config(), scratch);
+  }
+}
+
+/**
+ * per sample s and group g:
+ * - dx[g] += col2im(W[g]^T * dy[g]), scattered while storing the tiles
+ * - dW[s][g] += dy[g] * im2col(x[g])^T, gathered while packing
+ * - db[s] += sum of dy over the output positions
+ */
+inline void conv2d_op_internal(const tensor_t &prev_out,
+                               const vec_t &W,
+                               tensor_t &dW,
+                               tensor_t &db,
+                               tensor_t &curr_delta,
+                               tensor_t &prev_delta,
+                               const core::conv_params &params,
+                               const bool layer_parallelize,
+                               core::workspace *scratch = nullptr) {
+  const conv_geometry geo(params);
+  const size_t cin_g  = params.in_channels_per_group();
+  const size_t cout_g = params.out_channels_per_group();
+  const size_t patch  = params.patch_size();
+
+  // overlapping windows scatter into the same input elements, so the
+  // samples are processed in parallel and each GEMM runs serially
+  for_i(layer_parallelize, prev_out.size(), [&](size_t sample) {
+    const vec_t &x  = prev_out[sample];
+    const vec_t &dy = curr_delta[sample];
+    vec_t &dx       = prev_delta[sample];
+
+    for (size_t g = 0; g < params.groups; g++) {
+      const float_t *Wg  = &W[g * cout_g * patch];
+      const float_t *dyg = &dy[g * cout_g * geo.out_cs];
+      const float_t *xg  = &x[g * cin_g * geo.in_cs];
+      float_t *dxg       = &dx[g * cin_g * geo.in_cs];
+      float_t *dWg       = &dW[sample][g * cout_g * patch];
+
+      // dcol[area x patch] = dy[g]^T * W[g]
+      gemm(geo.area, patch, cout_g,
+           [&](size_t i0, size_t k0, size_t mc, size_t kc, float_t *dst) {
+             for (size_t p = 0; p < mc; p += gemm_mr) {
+               const size_t mr = std::min(gemm_mr, mc - p);
+               for (size_t k = 0; k < kc; k++) {
+                 const float_t *src = dyg + geo.output_index(k0 + k, i0 + p);
+                 float_t *d         = dst + k * gemm_mr;
+                 for (size_t r = 0; r < mr; r++) d[r] = src[r * geo.out_ps];
+                 for (size_t r = mr; r < gemm_mr; r++) d[r] = float_t{0};
+               }
+               dst += kc * gemm_mr;
+             }
+           },
+           [&](size_t k0, size_t j0, size_t kc, size_t nc, float_t *dst) {
+             gemm_pack_b_rows([&](size_t k) { return Wg + k * patch; }, k0,
+                              j0, kc, nc, dst);
+           },
+           [&](size_t i, size_t j, const float_t *values, size_t n) {
+             std::ptrdiff_t y0, x0;
+             geo.origin(i, y0, x0);
+             for (size_t t = 0; t < n; t++) {
+               size_t channel;
+               std::ptrdiff_t oy, ox;
+               geo.offset(j + t, channel, oy, ox);
+               const std::ptrdiff_t idx =
+                 geo.input_index(channel, y0 + oy, x0 + ox);
+               if (idx >= 0) dxg[idx] += values[t];
+             }
+           },
+           false, gemm_config(), scratch);
+
+      // dW[g][cout_g x patch] += dy[g] * im2col(x[g])^T
+      gemm(cout_g, patch, geo.area,
+           [&](size_t i0, size_t k0, size_t mc, size_t kc, float_t *dst) {
+             if (geo.out_ps == 1) {
+               gemm_pack_a_rows([&](size_t i) { return dyg + i * geo.area; },
+                                i0, k0, mc, kc, dst);
+             } else {
+               // channel-last: the channels of a position are contiguous
+               gemm_pack_a_cols([&](size_t k) { return dyg + k * geo.out_ps; },
+                                i0, k0, mc, kc, dst);
+             }
+           },
+           [&](size_t k0, size_t j0, size_t kc, size_t nc, float_t *dst) {
+             for (size_t q = 0; q < nc; q += gemm_nr) {
+               const size_t nr = std::min(gemm_nr, nc - q);
+               size_t channel[gemm_nr];
+               std::ptrdiff_t oy[gemm_nr], ox[gemm_nr];
+               for (size_t c = 0; c < nr; c++) {
+                 geo.offset(j0 + q + c, channel[c], oy[c], ox[c]);
+               }
+               for (size_t k = 0; k < kc; k++) {
+                 std::ptrdiff_t y0, x0;
+                 geo.origin(k0 + k, y0, x0);
+                 float_t *d = dst + k * gemm_nr;
+                 for (size_t c = 0; c < nr; c++) {
+                   const std::ptrdiff_t idx =
+                     geo.input_index(channel[c], y0 + oy[c], x0 + ox[c]);
+                   d[c] = idx < 0 ? float_t{0} : xg[idx];
+                 }
+                 for (size_t c = nr; c < gemm_nr; c++) d[c] = float_t{0};
+               }
+               dst += kc * gemm_nr;
+             }
+           },
+           [&](size_t i, size_t j, const float_t *values, size_t n) {
+             vectorize::reduce(values, n, dWg + i * patch + j);
+           },
+           false, gemm_config(), scratch);
+    }
+
+    if (params.has_bias) {
+      for (size_t o = 0; o < params.out.depth_; o++) {
+        float_t sum{0};
+        for (size_t p = 0; p < geo.area; p++) {
+          sum += dy[geo.output_index(o, p)];
+        }
+        db[sample][o] += sum;
+      }
+    }
+  }, 1);
+}
+
+}  // namespace kernels
+
+}  // namespace litchi
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "litchi/core/framework/op_kernel.h"
+
+#include "litchi/core/kernels/fully_connected_op_internal.h"
+
+namespace litchi {
+
+class FullyConnectedGradOp : public core::OpKernel {
+ public:
+  explicit FullyConnectedGradOp(const core::OpKernelConstruction &context)
+    : core::OpKernel(context) {
+    set_workspace_size(kernels::fully_connected_grad_workspace_size(
+      OpKernel::params_->fully()));
+  }
+
+  const char *name() const override { return "FullyConnectedGradOp"; }
+
+  // the input delta and the weight gradient, one GEMM each
+  uint64_t flops(const core::OpKernelContext &context) const override {
+    const auto &params = OpKernel::params_->fully();
+    return 4ull * context.batch_size() * params.in_size_ * params.out_size_;
+  }
+
+  void compute(core::OpKernelContext &context) override {
+    const auto &params = OpKernel::params_->fully();
+
+    // incoming/outcoming data
+    const tensor_t &prev_out = context.input(0);
+    const tensor_t &W        = context.input(1);
+    tensor_t &dW             = context.input_grad(1);
+    tensor_t *db         = params.has_bias_ ? &context.input_grad(2) : nullptr;
+    tensor_t &prev_delta = context.input_grad(0);
+    tensor_t &curr_delta = context.output_grad(0);
+    tensor_t dummy;  // need lvalue for non-const reference
+
+    // initialize outputs
+    fill_tensor(prev_delta, float_t{0});
+
+    // call the algorithm depending on the selected engine type
+    const core::backend_t engine = context.engine();
+
+    if (engine == core::backend_t::internal) {
+      kernels::fully_connected_op_internal(
+        prev_out, W[0], dW, params.has_bias_ ? *db : dummy, curr_delta,
+        prev_delta, params, context.parallelize(), &context.scratch());
+    } else {
+      throw "Not supported engine";
+    }
+  }
+};
+
+}  // namespace litchi
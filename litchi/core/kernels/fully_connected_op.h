@@ -9,10 +9,20 @@ namespace litchi {
 class FullyConnectedOp : public core::OpKernel {
  public:
   explicit FullyConnectedOp(const core::OpKernelConstruction &context)
-    : core::OpKernel(context) {}
+    : core::OpKernel(context) {
+    set_workspace_size(
+      kernels::fully_connected_workspace_size(OpKernel::params_->fully()));
+  }
+
+  const char *name() const override { return "FullyConnectedOp"; }
+
+  uint64_t flops(const core::OpKernelContext &context) const override {
+    const auto &params = OpKernel::params_->fully();
+    return 2ull * context.batch_size() * params.in_size_ * params.out_size_;
+  }
 
   void compute(core::OpKernelContext &context) override {
-    auto params = OpKernel::params_->fully();
+    const auto &params = OpKernel::params_->fully();
 
     // incoming/outcoming data
     const tensor_t &in_data = context.input(0);
@@ -20,16 +30,24 @@ class FullyConnectedOp : public core::OpKernel {
     const tensor_t *bias    = params.has_bias_ ? &context.input(2) : nullptr;
     tensor_t &out_data      = context.output(0);
 
+    // binds to an empty vector without a bias rather than copying it
+    const vec_t no_bias;
+    const vec_t &b = params.has_bias_ ? (*bias)[0] : no_bias;
+
     // initialize outputs
     fill_tensor(out_data, float_t{0});
 
     // call the algorithm depending on the selected engine type
     const core::backend_t engine = context.engine();
 
-    if (engine == core::backend_t::internal) {
+    if (engine == core::backend_t::internal && params.replicas_ &&
+        context.parallelize()) {
+      kernels::fully_connected_op_internal(
+        in_data, *params.replicas_, b, out_data, params, &context.scratch());
+    } else if (engine == core::backend_t::internal) {
       kernels::fully_connected_op_internal(
-        in_data, W[0], params.has_bias_ ? (*bias)[0] : vec_t(), out_data,
-        params);
+        in_data, W[0], b, out_data, params, context.parallelize(),
+        &context.scratch());
     } else {
       throw "Not supported engine";
     }
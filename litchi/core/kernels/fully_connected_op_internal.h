@@ -1,34 +1,171 @@
 #pragma once
 
+#include "litchi/core/kernels/gemm_tuner.h"
+#include "litchi/core/kernels/gemv.h"
 #include "litchi/core/params/fully_params.h"
+#include "litchi/util/parallel_for.h"
 
 namespace litchi {
 
 namespace kernels {
 
+// minimum number of samples per task so that a task amortizes its dispatch
+inline size_t fully_connected_grainsize(const core::fully_params &params) {
+  const size_t work = params.in_size_ * params.out_size_;
+  return std::max<size_t>(1, (size_t(1) << 16) / std::max<size_t>(work, 1));
+}
+
+/**
+ * samples up to which the forward pass multiplies the batch by W with
+ * gemv(), in one pass over W, rather than packing it for gemm(): below a
+ * few rows the packed panels are mostly padding and the product is bound
+ * by reading W
+ */
+constexpr size_t fully_connected_gemv_batch = gemv_max_vectors;
+
+/**
+ * bytes of scratch a task of the forward pass leases
+ */
+inline size_t fully_connected_workspace_size(
+  const core::fully_params &params) {
+  return gemm_workspace_size(params.out_size_, params.in_size_);
+}
+
+/**
+ * bytes of scratch a task of the backward pass leases
+ */
+inline size_t fully_connected_grad_workspace_size(
+  const core::fully_params &params) {
+  return gemm_workspace_size(params.in_size_, params.out_size_);
+}
+
+/**
+ * forward pass of the samples [begin, end)
+ */
 inline void fully_connected_op_internal(const tensor_t &in_data,
                                         const vec_t &W,
                                         const vec_t &bias,
                                         tensor_t &out_data,
-                                        const core::fully_params &params) {
-  // TODO parallel for
-  for (size_t sample = 0; sample < in_data.size(); ++sample) {
-    const vec_t &in = in_data[sample];
-    vec_t &out      = out_data[sample];
-
-    for (size_t i = 0; i < params.out_size_; i++) {
-      out[i] = float_t{0};
-      for (size_t c = 0; c < params.in_size_; c++) {
-        out[i] += W[c * params.out_size_ + i] * in[c];
-      }
-
-      if (params.has_bias_) {
-        out[i] += bias[i];
-      }
+                                        const core::fully_params &params,
+                                        const bool layer_parallelize,
+                                        size_t begin,
+                                        size_t end,
+                                        core::workspace *scratch = nullptr) {
+  const size_t out_size = params.out_size_;
+
+  for (size_t sample = begin; sample < end; sample++) {
+    vec_t &out = out_data[sample];
+    if (params.has_bias_) {
+      std::copy(bias.begin(), bias.begin() + out_size, out.begin());
+    } else {
+      vectorize::fill(&out[0], out_size, float_t{0});
     }
   }
+
+  // decided on the whole batch, so that splitting it (see numa_for) gives
+  // the same results
+  if (in_data.size() <= fully_connected_gemv_batch) {
+    const float_t *x[fully_connected_gemv_batch];
+    float_t *y[fully_connected_gemv_batch];
+    for (size_t sample = begin; sample < end; sample++) {
+      x[sample - begin] = in_data[sample].data();
+      y[sample - begin] = out_data[sample].data();
+    }
+    gemv(x, end - begin, W.data(), out_size, params.in_size_, out_size, y,
+         layer_parallelize);
+    return;
+  }
+
+  // out[sample x out_size] += in[sample x in_size] * W[in_size x out_size]
+  tuned_gemm(
+    "fully_connected.forward", end - begin, out_size, params.in_size_,
+    [&](size_t i0, size_t k0, size_t mc, size_t kc, float_t *dst) {
+      gemm_pack_a_rows([&](size_t i) { return &in_data[begin + i][0]; }, i0,
+                       k0, mc, kc, dst);
+    },
+    [&](size_t k0, size_t j0, size_t kc, size_t nc, float_t *dst) {
+      gemm_pack_b_rows([&](size_t k) { return &W[k * out_size]; }, k0, j0, kc,
+                       nc, dst);
+    },
+    [&](size_t i, size_t j, const float_t *values, size_t n) {
+      vectorize::reduce(values, n, &out_data[begin + i][j]);
+    },
+    layer_parallelize, scratch);
+}
+
+inline void fully_connected_op_internal(const tensor_t &in_data,
+                                        const vec_t &W,
+                                        const vec_t &bias,
+                                        tensor_t &out_data,
+                                        const core::fully_params &params,
+                                        const bool layer_parallelize,
+                                        core::workspace *scratch = nullptr) {
+  fully_connected_op_internal(in_data, W, bias, out_data, params,
+                              layer_parallelize, 0, in_data.size(), scratch);
+}
+
+/**
+ * Forward pass with W replicated per NUMA node: the batch is split across
+ * the nodes and each node multiplies its samples by its local copy.
+ */
+inline void fully_connected_op_internal(const tensor_t &in_data,
+                                        const numa_replicas &W,
+                                        const vec_t &bias,
+                                        tensor_t &out_data,
+                                        const core::fully_params &params,
+                                        core::workspace *scratch = nullptr) {
+  numa_for(W.topology(), in_data.size(),
+           [&](size_t node, size_t begin, size_t end) {
+             fully_connected_op_internal(in_data, W.local(node), bias,
+                                         out_data, params, true, begin, end,
+                                         scratch);
+           });
+}
+
+inline void fully_connected_op_internal(const tensor_t &prev_out,
+                                        const vec_t &W,
+                                        tensor_t &dW,
+                                        tensor_t &db,
+                                        tensor_t &curr_delta,
+                                        tensor_t &prev_delta,
+                                        const core::fully_params &params,
+                                        const bool layer_parallelize,
+                                        core::workspace *scratch = nullptr) {
+  const size_t out_size = params.out_size_;
+
+  // propagate delta to previous layer
+  // prev_delta[sample x in_size] += curr_delta[sample x out_size] * W^T
+  tuned_gemm(
+    "fully_connected.backward", prev_out.size(), params.in_size_, out_size,
+    [&](size_t i0, size_t k0, size_t mc, size_t kc, float_t *dst) {
+      gemm_pack_a_rows([&](size_t i) { return &curr_delta[i][0]; }, i0, k0,
+                       mc, kc, dst);
+    },
+    [&](size_t k0, size_t j0, size_t kc, size_t nc, float_t *dst) {
+      gemm_pack_b_cols([&](size_t j) { return &W[j * out_size]; }, k0, j0, kc,
+                       nc, dst);
+    },
+    [&](size_t i, size_t j, const float_t *values, size_t n) {
+      vectorize::reduce(values, n, &prev_delta[i][j]);
+    },
+    layer_parallelize, scratch);
+
+  // every sample owns its dW/db slot, so samples are independent
+  for_i(layer_parallelize, prev_out.size(), [&](size_t sample) {
+    // accumulate weight-step using delta
+    // dW[c * out_size + i] += current_delta[i] * prev_out[c]
+    for (size_t c = 0; c < params.in_size_; c++) {
+      vectorize::muladd(&curr_delta[sample][0], prev_out[sample][c],
+                        params.out_size_, &dW[sample][c * params.out_size_]);
+    }
+
+    if (params.has_bias_) {
+      vectorize::reduce(&curr_delta[sample][0], params.out_size_,
+                        &db[sample][0]);
+    }
+  }, fully_connected_grainsize(params));
 }
 
 }  // namespace kernels
 
-}  // namespace litchi
\ No newline at end of file
+}  // namespace litchi
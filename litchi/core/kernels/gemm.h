@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "litchi/core/framework/workspace.h"
+#include "litchi/util/parallel_for.h"
+#include "litchi/util/util.h"
+
+namespace litchi {
+
+namespace kernels {
+
+/**
+ * rows (mr) and columns (nr) of the register tile of the micro-kernel
+ */
+constexpr size_t gemm_mr = 4;
+#if defined(CNN_USE_AVX2)
+constexpr size_t gemm_nr = 16;
+#else
+constexpr size_t gemm_nr = 8;
+#endif
+
+/**
+ * order of the micro-kernel calls over a block of C
+ */
+enum class gemm_loop_order {
+  columns_outer,  // a panel of B stays in L1 while the rows of A stream
+  rows_outer,     // a panel of A stays in L1 while the columns of B stream
+};
+
+/**
+ * cache blocking, thread split and loop order of the GEMM
+ */
+struct gemm_config {
+  size_t mc      = 96;    // rows of A packed per block, sized for L2
+  size_t kc      = 256;   // depth of the packed panels, sized for L1
+  size_t nc      = 2048;  // columns of B packed per block, sized for L3
+  size_t threads = 0;     // upper bound on the threads, 0 for all of them
+  gemm_loop_order order = gemm_loop_order::columns_outer;
+
+  bool operator==(const gemm_config &rhs) const {
+    return mc == rhs.mc && kc == rhs.kc && nc == rhs.nc &&
+           threads == rhs.threads && order == rhs.order;
+  }
+};
+
+/**
+ * bytes of the largest packed panel of a GEMM with N columns and a depth of
+ * K, the scratch a task of gemm() leases from its workspace
+ */
+inline size_t gemm_workspace_size(size_t N,
+                                  size_t K,
+                                  const gemm_config &config = gemm_config()) {
+  const size_t mc     = std::max(gemm_mr, config.mc / gemm_mr * gemm_mr);
+  const size_t nc     = std::max(gemm_nr, config.nc / gemm_nr * gemm_nr);
+  const size_t kc     = std::min(std::max<size_t>(1, config.kc), K);
+  const size_t nc_max = std::min(nc, (N + gemm_nr - 1) / gemm_nr * gemm_nr);
+  return std::max(nc_max, mc) * kc * sizeof(float_t);
+}
+
+/**
+ * Packs rows [i0, i0 + mc) x depth [k0, k0 + kc) of A into panels of gemm_mr
+ * rows: dst[(p * kc + k) * gemm_mr + r] = A(i0 + p * gemm_mr + r, k0 + k),
+ * the rows beyond mc being zero.
+ *
+ * @param row function returning a pointer to the i-th row of A
+ */
+template <typename RowPtr>
+void gemm_pack_a_rows(const RowPtr &row,
+                      size_t i0,
+                      size_t k0,
+                      size_t mc,
+                      size_t kc,
+                      float_t *dst) {
+  for (size_t p = 0; p < mc; p += gemm_mr) {
+    const size_t mr = std::min(gemm_mr, mc - p);
+    for (size_t r = 0; r < gemm_mr; r++) {
+      if (r < mr) {
+        const float_t *src = row(i0 + p + r) + k0;
+        for (size_t k = 0; k < kc; k++) dst[k * gemm_mr + r] = src[k];
+      } else {
+        for (size_t k = 0; k < kc; k++) dst[k * gemm_mr + r] = float_t{0};
+      }
+    }
+    dst += kc * gemm_mr;
+  }
+}
+
+/**
+ * Same as gemm_pack_a_rows for an A stored transposed, i.e. given by its
+ * columns: A(i, k) = col(k)[i].
+ */
+template <typename ColPtr>
+void gemm_pack_a_cols(const ColPtr &col,
+                      size_t i0,
+                      size_t k0,
+                      size_t mc,
+                      size_t kc,
+                      float_t *dst) {
+  for (size_t p = 0; p < mc; p += gemm_mr) {
+    const size_t mr = std::min(gemm_mr, mc - p);
+    for (size_t k = 0; k < kc; k++) {
+      const float_t *src = col(k0 + k) + i0 + p;
+      float_t *d         = dst + k * gemm_mr;
+      for (size_t r = 0; r < mr; r++) d[r] = src[r];
+      for (size_t r = mr; r < gemm_mr; r++) d[r] = float_t{0};
+    }
+    dst += kc * gemm_mr;
+  }
+}
+
+/**
+ * Packs depth [k0, k0 + kc) x columns [j0, j0 + nc) of B into panels of
+ * gemm_nr columns: dst[(q * kc + k) * gemm_nr + c] = B(k0 + k, j0 + q *
+ * gemm_nr + c), the columns beyond nc being zero.
+ *
+ * @param row function returning a pointer to the k-th row of B
+ */
+template <typename RowPtr>
+void gemm_pack_b_rows(const RowPtr &row,
+                      size_t k0,
+                      size_t j0,
+                      size_t kc,
+                      size_t nc,
+                      float_t *dst) {
+  for (size_t q = 0; q < nc; q += gemm_nr) {
+    const size_t nr = std::min(gemm_nr, nc - q);
+    for (size_t k = 0; k < kc; k++) {
+      const float_t *src = row(k0 + k) + j0 + q;
+      float_t *d         = dst + k * gemm_nr;
+      for (size_t c = 0; c < nr; c++) d[c] = src[c];
+      for (size_t c = nr; c < gemm_nr; c++) d[c] = float_t{0};
+    }
+    dst += kc * gemm_nr;
+  }
+}
+
+/**
+ * Same as gemm_pack_b_rows for a B stored transposed, i.e. given by its
+ * columns: B(k, j) = col(j)[k].
+ */
+template <typename ColPtr>
+void gemm_pack_b_cols(const ColPtr &col,
+                      size_t k0,
+                      size_t j0,
+                      size_t kc,
+                      size_t nc,
+                      float_t *dst) {
+  for (size_t q = 0; q < nc; q += gemm_nr) {
+    const size_t nr = std::min(gemm_nr, nc - q);
+    for (size_t c = 0; c < gemm_nr; c++) {
+      if (c < nr) {
+        const float_t *src = col(j0 + q + c) + k0;
+        for (size_t k = 0; k < kc; k++) dst[k * gemm_nr + c] = src[k];
+      } else {
+        for (size_t k = 0; k < kc; k++) dst[k * gemm_nr + c] = float_t{0};
+      }
+    }
+    dst += kc * gemm_nr;
+  }
+}
+
+/**
+ * c[gemm_mr x gemm_nr] = a-panel * b-panel over a depth of kc
+ */
+inline void gemm_micro_kernel(size_t kc,
+                              const float_t *a,
+                              const float_t *b,
+                              float_t *c) {
+  float_t acc[gemm_mr][gemm_nr] = {};
+  for (size_t k = 0; k < kc; k++) {
+    for (size_t r = 0; r < gemm_mr; r++) {
+      const float_t ar = a[k * gemm_mr + r];
+      for (size_t j = 0; j < gemm_nr; j++) acc[r][j] += ar * b[j];
+    }
+    b += gemm_nr;
+  }
+  for (size_t r = 0; r < gemm_mr; r++) {
+    for (size_t j = 0; j < gemm_nr; j++) c[r * gemm_nr + j] = acc[r][j];
+  }
+}
+
+/**
+ * @brief Blocked GEMM, C[M x N] += A[M x K] * B[K x N].
+ *
+ * The operands are never accessed directly: blocks of A and B are copied
+ * into contiguous panels by the packing functions, and the result tiles
+ * are handed to the store function. Layers can therefore describe their
+ * operands implicitly (e.g. gather convolution patches while packing)
+ * while sharing the same blocking and micro-kernel.
+ *
+ * @param pack_a  void(i0, k0, mc, kc, float_t *dst), packs a block of A in
+ *                the layout of gemm_pack_a_rows
+ * @param pack_b  void(k0, j0, kc, nc, float_t *dst), packs a block of B in
+ *                the layout of gemm_pack_b_rows
+ * @param store_c void(i, j, const float_t *values, size_t n), accumulates
+ *                values into C(i, j .. j + n)
+ * @param parallelize split the blocks of C over threads; store_c must then
+ *                    be safe to call concurrently for distinct (i, j)
+ * @param config  blocking, see gemm_tuner to pick it per shape
+ * @param scratch pool of the packed panels, kept by the caller across calls
+ *                so that they are not reallocated; temporary if null
+ */
+template <typename PackA, typename PackB, typename StoreC>
+void gemm(size_t M,
+          size_t N,
+          size_t K,
+          const PackA &pack_a,
+          const PackB &pack_b,
+          const StoreC &store_c,
+          bool parallelize,
+          const gemm_config &config = gemm_config(),
+          core::workspace *scratch  = nullptr) {
+  if (M == 0 || N == 0 || K == 0) return;
+
+  const size_t mc = std::max(gemm_mr, config.mc / gemm_mr * gemm_mr);
+  const size_t nc = std::max(gemm_nr, config.nc / gemm_nr * gemm_nr);
+  const size_t kc = std::min(std::max<size_t>(1, config.kc), K);
+
+  size_t threads = parallelize ? parallel_concurrency() : 1;
+  if (config.threads > 0) threads = std::min(threads, config.threads);
+  concurrency_limit limit(threads);
+
+  const size_t nc_max = std::min(nc, (N + gemm_nr - 1) / gemm_nr * gemm_nr);
+  const size_t mc_max = std::min(mc, (M + gemm_mr - 1) / gemm_mr * gemm_mr);
+  core::workspace temporary;
+  core::workspace &ws = scratch ? *scratch : temporary;
+  const core::workspace::lease packed_b =
+    ws.acquire(nc_max * kc * sizeof(float_t));
+
+  for (size_t j0 = 0; j0 < N; j0 += nc) {
+    const size_t nb = std::min(nc, N - j0);
+    for (size_t k0 = 0; k0 < K; k0 += kc) {
+      const size_t kb = std::min(kc, K - k0);
+      pack_b(k0, j0, kb, nb, packed_b.data());
+
+      // tasks are (row block, column chunk) pairs so that small M (e.g. a
+      // few samples) still spreads over the threads
+      const size_t row_blocks = (M + mc - 1) / mc;
+      const size_t panels     = (nb + gemm_nr - 1) / gemm_nr;
+      const size_t col_chunks =
+        row_blocks >= threads ? 1 : std::min(panels, threads / row_blocks);
+      const size_t panels_per_chunk = (panels + col_chunks - 1) / col_chunks;
+
+      for_i(parallelize, row_blocks * col_chunks, [&](size_t task) {
+        const size_t i0 = (task / col_chunks) * mc;
+        const size_t mb = std::min(mc, M - i0);
+        const size_t q0 = (task % col_chunks) * panels_per_chunk;
+        const size_t q1 = std::min(panels, q0 + panels_per_chunk);
+        if (q0 >= q1) return;
+
+        const core::workspace::lease packed_a =
+          ws.acquire(mc_max * kc * sizeof(float_t));
+        float_t tile[gemm_mr * gemm_nr];
+        pack_a(i0, k0, mb, kb, packed_a.data());
+
+        auto tile_at = [&](size_t q, size_t ir) {
+          const size_t jr = q * gemm_nr;
+          const size_t nr = std::min(gemm_nr, nb - jr);
+          const size_t mr = std::min(gemm_mr, mb - ir);
+          gemm_micro_kernel(kb, packed_a.data() + ir * kb,
+                            packed_b.data() + jr * kb, tile);
+          for (size_t r = 0; r < mr; r++) {
+            store_c(i0 + ir + r, j0 + jr, &tile[r * gemm_nr], nr);
+          }
+        };
+        if (config.order == gemm_loop_order::columns_outer) {
+          for (size_t q = q0; q < q1; q++) {
+            for (size_t ir = 0; ir < mb; ir += gemm_mr) tile_at(q, ir);
+          }
+        } else {
+          for (size_t ir = 0; ir < mb; ir += gemm_mr) {
+            for (size_t q = q0; q < q1; q++) tile_at(q, ir);
+          }
+        }
+      }, 1);
+    }
+  }
+}
+
+}  // namespace kernels
+
+}  // namespace litchi
@@ -0,0 +1,428 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "litchi/core/kernels/gemm.h"
+
+namespace litchi {
+
+namespace kernels {
+
+/**
+ * shape of a GEMM of a kernel, the key of the tuned configurations
+ */
+struct gemm_shape {
+  const char *kernel;  // name of the calling kernel, a string literal
+  size_t M;
+  size_t N;
+  size_t K;
+  size_t threads;  // threads available to the GEMM
+};
+
+/**
+ * @brief Per-shape autotuning of the GEMM configuration.
+ *
+ * Disabled by default. Once enabled, the first GEMM of a kernel with a
+ * given shape (M, N, K and the threads available) benchmarks the
+ * candidates() on its actual operands and keeps the fastest. With a cache
+ * file the choices are appended to it, keyed by shape and cpu_signature(),
+ * and loaded by the next processes, so that a machine type is tuned once:
+ *
+ *     gemm_tuner::enable("/var/cache/litchi/gemm.tsv");
+ *
+ * Setting the LITCHI_GEMM_TUNING_CACHE environment variable to a path
+ * enables the tuner with that file at startup. Several processes may share
+ * a file: every line is written at once and the last entry of a key wins.
+ */
+class gemm_tuner {
+ public:
+  /**
+   * @param cache_path file holding the tuned configurations, loaded if it
+   *                   exists; empty to keep them in memory only
+   */
+  static void enable(const std::string &cache_path = "") {
+    state &s = get_state();
+    if (!cache_path.empty()) load(cache_path);
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.path = cache_path;
+    }
+    s.enabled = true;
+  }
+
+  static void disable() { get_state().enabled = false; }
+
+  static bool enabled() {
+    return get_state().enabled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * CPU model, logical CPUs and SIMD width of the build, e.g.
+   * "Intel(R) Xeon(R) Gold 6248 CPU @ 2.50GHz/80/avx2"
+   */
+  static const std::string &cpu_signature() {
+    static const std::string signature = read_cpu_signature();
+    return signature;
+  }
+
+  /**
+   * configurations benchmarked for a GEMM running on up to threads threads
+   */
+  static std::vector<gemm_config> candidates(size_t threads) {
+    // (mc, kc, nc) around the L1/L2/L3 sizes of current cores
+    const size_t blocking[][3] = {{96, 256, 2048},
+                                  {48, 256, 2048},
+                                  {192, 128, 2048},
+                                  {96, 512, 1024},
+                                  {64, 384, 4096}};
+    std::vector<gemm_config> out;
+    for (const auto &b : blocking) {
+      for (gemm_loop_order order :
+           {gemm_loop_order::columns_outer, gemm_loop_order::rows_outer}) {
+        gemm_config c;
+        c.mc    = b[0];
+        c.kc    = b[1];
+        c.nc    = b[2];
+        c.order = order;
+        out.push_back(c);
+      }
+    }
+    // fewer threads win when the blocks are too small to amortize them
+    for (size_t t = threads / 2; t >= 1 && threads > 1; t /= 2) {
+      gemm_config c;
+      c.threads = t;
+      out.push_back(c);
+      if (t == 1) break;
+    }
+    return out;
+  }
+
+  /**
+   * key of a GEMM of a kernel, e.g. "fully_connected.forward 32 1024 1024 8"
+   */
+  static std::string key(const std::string &kernel,
+                         size_t M,
+                         size_t N,
+                         size_t K,
+                         size_t threads) {
+    std::ostringstream os;
+    os << kernel << ' ' << M << ' ' << N << ' ' << K << ' ' << threads;
+    return os.str();
+  }
+
+  static std::string key(const gemm_shape &shape) {
+    return key(shape.kernel, shape.M, shape.N, shape.K, shape.threads);
+  }
+
+  /**
+   * tuned configuration of key on this CPU, false if not tuned yet
+   */
+  static bool find(const std::string &key, gemm_config &config) {
+    state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.entries.find(cpu_signature() + '\t' + key);
+    if (it == s.entries.end()) return false;
+    config = it->second;
+    return true;
+  }
+
+  /**
+   * records the configuration of key on this CPU, appended to the cache
+   * file if any
+   */
+  static void set(const std::string &key, const gemm_config &config) {
+    state &s                = get_state();
+    const std::string entry = cpu_signature() + '\t' + key;
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.entries[entry] = config;
+    s.generation++;
+    if (s.path.empty()) return;
+    std::ofstream os(s.path, std::ios::app);
+    if (os) os << format(entry, config);
+  }
+
+  /**
+   * Configuration of key, benchmarking the candidates the first time.
+   *
+   * @param run void(const gemm_config &), runs the GEMM once
+   */
+  template <typename Run>
+  static gemm_config tune(const std::string &key,
+                          size_t threads,
+                          const Run &run) {
+    gemm_config best;
+    if (find(key, best)) return best;
+
+    double best_time = 0;
+    for (const gemm_config &c : candidates(threads)) {
+      const double t = measure(c, run);
+      if (best_time == 0 || t < best_time) {
+        best_time = t;
+        best      = c;
+      }
+    }
+    get_state().tunings++;
+    set(key, best);
+    return best;
+  }
+
+  /**
+   * @brief Configuration of shape, benchmarking the candidates the first
+   * time.
+   *
+   * Every thread remembers the configurations of the last shapes it ran in
+   * a small table compared field by field: the string key and the shared
+   * entries, behind their lock, are only consulted on a miss. Any change to
+   * the entries (set(), load(), clear()) invalidates the tables.
+   *
+   * @param run void(const gemm_config &), runs the GEMM once
+   */
+  template <typename Run>
+  static gemm_config tune(const gemm_shape &shape, const Run &run) {
+    shape_cache &cache      = thread_cache();
+    const size_t generation = get_state().generation.load();
+    if (cache.generation != generation) {
+      for (cached_shape &c : cache.slots) c.valid = false;
+      cache.generation = generation;
+    }
+    cached_shape &slot = cache.slots[slot_of(shape)];
+    if (slot.valid && same_shape(slot.shape, shape)) return slot.config;
+
+    const gemm_config config = tune(key(shape), shape.threads, run);
+    // tuning may have changed the entries: the slot is kept for the
+    // generation read before, flushed on the next call
+    slot.shape  = shape;
+    slot.config = config;
+    slot.valid  = true;
+    return config;
+  }
+
+  /**
+   * adds the entries of a cache file, replacing those of the same keys
+   */
+  static void load(const std::string &path) {
+    std::map<std::string, gemm_config> entries;
+    read_entries(path, entries);
+    state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (const auto &e : entries) s.entries[e.first] = e.second;
+    s.generation++;
+  }
+
+  /**
+   * writes every entry, of all CPUs, to path
+   */
+  static void save(const std::string &path) {
+    state &s = get_state();
+    std::ofstream os(path);
+    if (!os) throw "Failed to open tuning cache";
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (const auto &e : s.entries) os << format(e.first, e.second);
+  }
+
+  /** drops the entries held in memory, the cache file is kept */
+  static void clear() {
+    state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.entries.clear();
+    s.generation++;
+  }
+
+  /** number of entries held in memory, of all CPUs */
+  static size_t size() {
+    state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.entries.size();
+  }
+
+  /** number of shapes benchmarked by this process */
+  static size_t tunings() { return get_state().tunings; }
+
+ private:
+  struct state {
+    state() {
+      if (const char *cache = std::getenv("LITCHI_GEMM_TUNING_CACHE")) {
+        path = cache;
+        read_entries(path, entries);
+        enabled = true;
+      }
+    }
+
+    std::atomic<bool> enabled{false};
+    std::mutex mutex;
+    std::string path;
+    // "<cpu signature>\t<key>" -> configuration
+    std::map<std::string, gemm_config> entries;
+    std::atomic<size_t> tunings{0};
+    // bumped whenever entries change, invalidating the per-thread caches
+    std::atomic<size_t> generation{0};
+  };
+
+  static state &get_state() {
+    static state s;
+    return s;
+  }
+
+  struct cached_shape {
+    bool valid = false;
+    gemm_shape shape;
+    gemm_config config;
+  };
+
+  // direct-mapped: a kernel runs a handful of shapes, colliding ones
+  // evict each other
+  struct shape_cache {
+    size_t generation = 0;
+    cached_shape slots[16];
+  };
+
+  static shape_cache &thread_cache() {
+    thread_local shape_cache cache;
+    return cache;
+  }
+
+  static size_t slot_of(const gemm_shape &shape) {
+    const size_t h = shape.M * 31 + shape.N * 17 + shape.K * 7 +
+                     shape.threads;
+    return h % (sizeof(shape_cache::slots) / sizeof(cached_shape));
+  }
+
+  // the kernel names are literals, mostly compared by address
+  static bool same_shape(const gemm_shape &a, const gemm_shape &b) {
+    return a.M == b.M && a.N == b.N && a.K == b.K && a.threads == b.threads &&
+           (a.kernel == b.kernel || std::strcmp(a.kernel, b.kernel) == 0);
+  }
+
+  static void read_entries(const std::string &path,
+                           std::map<std::string, gemm_config> &entries) {
+    std::ifstream is(path);
+    std::string line;
+    while (std::getline(is, line)) {
+      std::string entry;
+      gemm_config config;
+      if (parse(line, entry, config)) entries[entry] = config;
+    }
+  }
+
+  // seconds of a run after a warm-up run, the best of three for fast
+  // shapes
+  template <typename Run>
+  static double measure(const gemm_config &config, const Run &run) {
+    typedef std::chrono::steady_clock clock;
+    auto timed = [&]() {
+      const clock::time_point start = clock::now();
+      run(config);
+      return std::chrono::duration<double>(clock::now() - start).count();
+    };
+    const double warm_up = timed();
+    if (warm_up >= 0.1) return warm_up;
+    double best = timed();
+    for (int i = 0; i < 2; i++) best = std::min(best, timed());
+    return best;
+  }
+
+  static std::string format(const std::string &entry,
+                            const gemm_config &config) {
+    std::ostringstream os;
+    os << entry << '\t' << config.mc << ' ' << config.kc << ' ' << config.nc
+       << ' ' << config.threads << ' '
+       << (config.order == gemm_loop_order::rows_outer ? "rows" : "columns")
+       << '\n';
+    return os.str();
+  }
+
+  // "<cpu signature>\t<key>\t<mc> <kc> <nc> <threads> <order>"
+  static bool parse(const std::string &line,
+                    std::string &entry,
+                    gemm_config &config) {
+    const size_t tab = line.rfind('\t');
+    if (tab == std::string::npos || line.find('\t') == tab) return false;
+    entry = line.substr(0, tab);
+    std::istringstream is(line.substr(tab + 1));
+    std::string order;
+    if (!(is >> config.mc >> config.kc >> config.nc >> config.threads >>
+          order)) {
+      return false;
+    }
+    if (order != "rows" && order != "columns") return false;
+    config.order = order == "rows" ? gemm_loop_order::rows_outer
+                                   : gemm_loop_order::columns_outer;
+    return config.mc > 0 && config.kc > 0 && config.nc > 0;
+  }
+
+  static std::string read_cpu_signature() {
+    std::string model = "unknown";
+    std::ifstream is("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(is, line)) {
+      if (line.compare(0, 10, "model name") != 0) continue;
+      const size_t colon = line.find(':');
+      if (colon != std::string::npos) {
+        model = line.substr(line.find_first_not_of(" \t", colon + 1));
+      }
+      break;
+    }
+    for (char &c : model) {
+      if (c == '\t' || c == '\n') c = ' ';
+    }
+#if defined(CNN_USE_AVX2)
+    const char *simd = "avx2";
+#else
+    const char *simd = "generic";
+#endif
+    return model + '/' + std::to_string(std::thread::hardware_concurrency()) +
+           '/' + simd;
+  }
+};
+
+/**
+ * @brief gemm() with the configuration tuned for its shape when the
+ * gemm_tuner is enabled, the default one otherwise.
+ *
+ * The candidates are benchmarked on the actual operands, their results
+ * going to a temporary matrix, so tuning does not alter C.
+ *
+ * @param kernel name of the calling kernel, part of the tuning key
+ * @param scratch pool of the packed panels, see gemm()
+ */
+template <typename PackA, typename PackB, typename StoreC>
+void tuned_gemm(const char *kernel,
+                size_t M,
+                size_t N,
+                size_t K,
+                const PackA &pack_a,
+                const PackB &pack_b,
+                const StoreC &store_c,
+                bool parallelize,
+                core::workspace *scratch = nullptr) {
+  gemm_config config;
+  if (gemm_tuner::enabled() && M > 0 && N > 0 && K > 0) {
+    const size_t threads = parallelize ? parallel_concurrency() : 1;
+    std::vector<float_t> result;
+    config = gemm_tuner::tune(
+      gemm_shape{kernel, M, N, K, threads}, [&](const gemm_config &c) {
+        result.assign(M * N, float_t{0});
+        gemm(M, N, K, pack_a, pack_b,
+             [&](size_t i, size_t j, const float_t *values, size_t n) {
+               float_t *dst = &result[i * N + j];
+               for (size_t x = 0; x < n; x++) dst[x] += values[x];
+             },
+             parallelize, c, scratch);
+      });
+  }
+  gemm(M, N, K, pack_a, pack_b, store_c, parallelize, config, scratch);
+}
+
+}  // namespace kernels
+
+}  // namespace litchi
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+
+#include "litchi/util/parallel_for.h"
+#include "litchi/util/util.h"
+
+namespace litchi {
+
+namespace kernels {
+
+/**
+ * columns of y updated per pass over the rows of B, so that the slice of y
+ * stays in L1 while B streams
+ */
+constexpr size_t gemv_nc = 2048;
+
+/**
+ * rows of B prefetched ahead of the ones being multiplied
+ */
+constexpr size_t gemv_prefetch_rows = 8;
+
+/**
+ * elements of B below which gemv() stays on the calling thread
+ */
+constexpr size_t gemv_parallel_threshold = size_t(1) << 18;
+
+/**
+ * largest number of vectors gemv() multiplies in one pass over B
+ */
+constexpr size_t gemv_max_vectors = 4;
+
+/**
+ * y_v[j0 .. j1) += x_v[K] * B[K x N] for the m vectors v, B being
+ * row-major with rows ldb apart.
+ *
+ * The rows of B are read once, contiguously and four at a time, each group
+ * of rows serving every vector before the next one is loaded; each row
+ * gemv_prefetch_rows ahead is prefetched without temporal locality: the
+ * weights are touched once per call and should not evict y or x.
+ */
+inline void gemv_columns(const float_t *const *x,
+                         size_t m,
+                         const float_t *B,
+                         size_t ldb,
+                         size_t K,
+                         size_t j0,
+                         size_t j1,
+                         float_t *const *y) {
+  const size_t n = j1 - j0;
+  // a cache line holds 64 bytes
+  const size_t line = 64 / sizeof(float_t);
+  auto prefetch     = [&](size_t k) {
+    if (k >= K) return;
+    const float_t *row = B + k * ldb + j0;
+    for (size_t j = 0; j < n; j += line) __builtin_prefetch(row + j, 0, 0);
+  };
+
+  size_t k = 0;
+  for (; k + 4 <= K; k += 4) {
+    for (size_t p = 0; p < 4; p++) prefetch(k + gemv_prefetch_rows + p);
+    const float_t *b0 = B + k * ldb + j0;
+    const float_t *b1 = b0 + ldb;
+    const float_t *b2 = b1 + ldb;
+    const float_t *b3 = b2 + ldb;
+    for (size_t v = 0; v < m; v++) {
+      const float_t *xv = x[v] + k;
+      const float_t x0 = xv[0], x1 = xv[1], x2 = xv[2], x3 = xv[3];
+      float_t *yv = y[v] + j0;
+      for (size_t j = 0; j < n; j++) {
+        yv[j] += x0 * b0[j] + x1 * b1[j] + x2 * b2[j] + x3 * b3[j];
+      }
+    }
+  }
+  for (; k < K; k++) {
+    const float_t *b0 = B + k * ldb + j0;
+    for (size_t v = 0; v < m; v++) {
+      const float_t x0 = x[v][k];
+      float_t *yv      = y[v] + j0;
+      for (size_t j = 0; j < n; j++) yv[j] += x0 * b0[j];
+    }
+  }
+}
+
+/**
+ * @brief Matrix-vector products y_v[N] += x_v[K] * B[K x N] of up to
+ * gemv_max_vectors vectors, B row-major with rows ldb apart.
+ *
+ * A few input vectors make the product bound by the bandwidth of B:
+ * unlike gemm() nothing is packed, every element of B is read once and in
+ * order, whatever the number of vectors. Large products split the columns
+ * of y over the threads, each streaming its own slice of every row.
+ *
+ * @param x           [in] the m input vectors
+ * @param m           [in] number of vectors, at most gemv_max_vectors
+ * @param y           [in] the m output vectors
+ * @param parallelize split the columns over threads when B is large
+ */
+inline void gemv(const float_t *const *x,
+                 size_t m,
+                 const float_t *B,
+                 size_t ldb,
+                 size_t K,
+                 size_t N,
+                 float_t *const *y,
+                 bool parallelize) {
+  if (K == 0 || N == 0 || m == 0) return;
+
+  const size_t line    = 64 / sizeof(float_t);
+  const size_t threads = parallelize && K * N >= gemv_parallel_threshold
+                           ? parallel_concurrency()
+                           : 1;
+  // slices of whole cache lines, one per thread at least, the slices of
+  // all the vectors fitting in L1 together
+  const size_t slice = (N + threads - 1) / threads;
+  const size_t nb    = std::min(std::max(line, gemv_nc / m / line * line),
+                                (slice + line - 1) / line * line);
+  const size_t tasks = (N + nb - 1) / nb;
+
+  for_i(threads > 1, tasks, [&](size_t task) {
+    const size_t j0 = task * nb;
+    gemv_columns(x, m, B, ldb, K, j0, std::min(N, j0 + nb), y);
+  }, 1);
+}
+
+/**
+ * y[N] += x[K] * B[K x N] for a single vector
+ */
+inline void gemv(const float_t *x,
+                 const float_t *B,
+                 size_t ldb,
+                 size_t K,
+                 size_t N,
+                 float_t *y,
+                 bool parallelize) {
+  gemv(&x, 1, B, ldb, K, N, &y, parallelize);
+}
+
+}  // namespace kernels
+
+}  // namespace litchi
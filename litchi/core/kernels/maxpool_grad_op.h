@@ -0,0 +1,45 @@
+#pragma once
+
+#include "litchi/core/framework/op_kernel.h"
+
+#include "litchi/core/kernels/pooling_op_internal.h"
+
+namespace litchi {
+
+class MaxPoolGradOp : public core::OpKernel {
+ public:
+  explicit MaxPoolGradOp(const core::OpKernelConstruction &context)
+    : core::OpKernel(context) {}
+
+  const char *name() const override { return "MaxPoolGradOp"; }
+
+  void compute(core::OpKernelContext &context) override {
+    auto &params = OpKernel::params_->pooling();
+
+    // incoming/outcoming data
+    tensor_t &prev_delta = context.input_grad(0);
+    tensor_t &curr_delta = context.output_grad(0);
+
+    // initialize outputs
+    fill_tensor(prev_delta, float_t{0});
+
+    // call the algorithm depending on the selected engine type
+    const core::backend_t engine = context.engine();
+
+    if (engine == core::backend_t::internal) {
+      if (params.compact_argmax()) {
+        kernels::maxpool_grad_op_internal(prev_delta, curr_delta,
+                                          params.argmax8, params,
+                                          context.parallelize());
+      } else {
+        kernels::maxpool_grad_op_internal(prev_delta, curr_delta,
+                                          params.argmax16, params,
+                                          context.parallelize());
+      }
+    } else {
+      throw "Not supported engine";
+    }
+  }
+};
+
+}  // namespace litchi
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "litchi/core/framework/op_kernel.h"
+
+#include "litchi/core/kernels/pooling_op_internal.h"
+
+namespace litchi {
+
+class MaxPoolOp : public core::OpKernel {
+ public:
+  explicit MaxPoolOp(const core::OpKernelConstruction &context)
+    : core::OpKernel(context) {
+    set_workspace_size(
+      kernels::maxpool_workspace_size(OpKernel::params_->pooling()));
+  }
+
+  const char *name() const override { return "MaxPoolOp"; }
+
+  void compute(core::OpKernelContext &context) override {
+    // the argmax is written back to the params
+    auto &params = OpKernel::params_->pooling();
+
+    // incoming/outcoming data
+    const tensor_t &in_data = context.input(0);
+    tensor_t &out_data      = context.output(0);
+
+    // call the algorithm depending on the selected engine type
+    const core::backend_t engine = context.engine();
+
+    if (engine == core::backend_t::internal) {
+      if (params.compact_argmax()) {
+        kernels::maxpool_op_internal(in_data, out_data, params.argmax8,
+                                     params, context.parallelize(),
+                                     &context.scratch());
+      } else {
+        kernels::maxpool_op_internal(in_data, out_data, params.argmax16,
+                                     params, context.parallelize(),
+                                     &context.scratch());
+      }
+    } else {
+      throw "Not supported engine";
+    }
+  }
+};
+
+}  // namespace litchi
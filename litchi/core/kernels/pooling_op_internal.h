@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "litchi/core/framework/workspace.h"
+#include "litchi/core/params/pooling_params.h"
+#include "litchi/util/parallel_for.h"
+#include "litchi/util/product.h"
+
+namespace litchi {
+
+namespace kernels {
+
+/**
+ * Returns the n inputs read at window column dx by consecutive outputs of a
+ * row, i.e. row[dx + i * stride]. Strided rows are gathered into buf so
+ * that the reductions below always run on contiguous memory.
+ */
+inline const float_t *pooling_row(const float_t *row,
+                                  size_t dx,
+                                  size_t stride,
+                                  size_t n,
+                                  float_t *buf) {
+  if (stride == 1) return row + dx;
+  for (size_t i = 0; i < n; i++) buf[i] = row[dx + i * stride];
+  return buf;
+}
+
+inline size_t pooling_grainsize(const core::pooling_params &params) {
+  const size_t work =
+    std::max<size_t>(params.out.size() * params.window_area(), 1);
+  return std::max<size_t>(1, (size_t(1) << 14) / work);
+}
+
+inline bool pooling_channels_last(const core::pooling_params &params) {
+  return params.in.layout_ == data_layout::nhwc;
+}
+
+/**
+ * bytes of scratch a task of max pooling leases: a gathered row and the
+ * argmax of an output row, or the argmax of the channels of an output in
+ * the channel-last layout
+ */
+inline size_t maxpool_workspace_size(const core::pooling_params &params) {
+  return std::max(params.out.width_ * (sizeof(float_t) + sizeof(int32_t)),
+                  params.out.depth_ * sizeof(int32_t));
+}
+
+/**
+ * bytes of scratch a task of average pooling leases: the sum of the rows of
+ * a window and a gathered row
+ */
+inline size_t avepool_workspace_size(const core::pooling_params &params) {
+  return (params.in.width_ + params.out.width_) * sizeof(float_t);
+}
+
+/**
+ * Max pooling, vectorized across the output width: every window offset
+ * updates a whole output row and its argmax at once. In the channel-last
+ * layout, it updates the channels of an output instead. The argmax is
+ * stored as the offset within the window, which fits in Index.
+ */
+template <typename Index>
+void maxpool_op_internal(const tensor_t &in_data,
+                         tensor_t &out_data,
+                         std::vector<std::vector<Index>> &argmax,
+                         const core::pooling_params &params,
+                         const bool layer_parallelize,
+                         core::workspace *scratch = nullptr) {
+  const size_t out_w = params.out.width_;
+  argmax.resize(in_data.size());
+  core::workspace temporary;
+  core::workspace &ws = scratch ? *scratch : temporary;
+
+  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
+    const vec_t &in         = in_data[sample];
+    vec_t &out              = out_data[sample];
+    std::vector<Index> &arg = argmax[sample];
+    arg.resize(params.out.size());
+
+    const core::workspace::lease lease =
+      ws.acquire(maxpool_workspace_size(params));
+    if (pooling_channels_last(params)) {
+      const size_t channels = params.out.depth_;
+      int32_t *index        = reinterpret_cast<int32_t *>(lease.data());
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        for (size_t ox = 0; ox < out_w; ox++) {
+          const size_t o = params.out.get_index(ox, oy, 0);
+          float_t *best  = &out[o];
+          vectorize::fill(best, channels,
+                          -std::numeric_limits<float_t>::max());
+          std::fill(index, index + channels, 0);
+          for (size_t dy = 0; dy < params.pool_size_y; dy++) {
+            for (size_t dx = 0; dx < params.pool_size_x; dx++) {
+              vectorize::max_index(
+                &in[params.in.get_index(ox * params.stride_x + dx,
+                                        oy * params.stride_y + dy, 0)],
+                channels, int32_t(dy * params.pool_size_x + dx), best,
+                index);
+            }
+          }
+          for (size_t c = 0; c < channels; c++) arg[o + c] = Index(index[c]);
+        }
+      }
+      return;
+    }
+
+    float_t *buf   = lease.data();
+    int32_t *index = reinterpret_cast<int32_t *>(buf + out_w);
+
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        const size_t o = params.out.get_index(0, oy, c);
+        float_t *best  = &out[o];
+        vectorize::fill(best, out_w, -std::numeric_limits<float_t>::max());
+        std::fill(index, index + out_w, 0);
+
+        for (size_t dy = 0; dy < params.pool_size_y; dy++) {
+          const float_t *row =
+            &in[params.in.get_index(0, oy * params.stride_y + dy, c)];
+          for (size_t dx = 0; dx < params.pool_size_x; dx++) {
+            vectorize::max_index(
+              pooling_row(row, dx, params.stride_x, out_w, buf), out_w,
+              int32_t(dy * params.pool_size_x + dx), best, index);
+          }
+        }
+        for (size_t ox = 0; ox < out_w; ox++) arg[o + ox] = Index(index[ox]);
+      }
+    }
+  }, pooling_grainsize(params));
+}
+
+/**
+ * dx[argmax] += dy, prev_delta being zero-initialized by the caller; the
+ * indices follow the layout of the shapes
+ */
+template <typename Index>
+void maxpool_grad_op_internal(tensor_t &prev_delta,
+                              const tensor_t &curr_delta,
+                              const std::vector<std::vector<Index>> &argmax,
+                              const core::pooling_params &params,
+                              const bool layer_parallelize) {
+  for_i(layer_parallelize, prev_delta.size(), [&](size_t sample) {
+    vec_t &dx                     = prev_delta[sample];
+    const vec_t &dy               = curr_delta[sample];
+    const std::vector<Index> &arg = argmax[sample];
+
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        for (size_t ox = 0; ox < params.out.width_; ox++) {
+          const size_t o = params.out.get_index(ox, oy, c);
+          const size_t k = arg[o];
+          dx[params.in.get_index(
+            ox * params.stride_x + k % params.pool_size_x,
+            oy * params.stride_y + k / params.pool_size_x, c)] += dy[o];
+        }
+      }
+    }
+  }, pooling_grainsize(params));
+}
+
+/**
+ * Average pooling, vectorized across the width: the rows of the window are
+ * first summed over the full input width, then the columns of that sum are
+ * accumulated into the output row. In the channel-last layout, the window
+ * is accumulated into the channels of each output instead.
+ */
+inline void avepool_op_internal(const tensor_t &in_data,
+                                tensor_t &out_data,
+                                const core::pooling_params &params,
+                                const bool layer_parallelize,
+                                core::workspace *scratch = nullptr) {
+  const size_t in_w   = params.in.width_;
+  const size_t out_w  = params.out.width_;
+  const float_t scale = float_t(1) / float_t(params.window_area());
+  core::workspace temporary;
+  core::workspace &ws = scratch ? *scratch : temporary;
+
+  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
+    const vec_t &in = in_data[sample];
+    vec_t &out      = out_data[sample];
+
+    if (pooling_channels_last(params)) {
+      const size_t channels = params.out.depth_;
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        for (size_t ox = 0; ox < out_w; ox++) {
+          float_t *dst = &out[params.out.get_index(ox, oy, 0)];
+          vectorize::fill(dst, channels, float_t{0});
+          for (size_t dy = 0; dy < params.pool_size_y; dy++) {
+            for (size_t dx = 0; dx < params.pool_size_x; dx++) {
+              vectorize::muladd(
+                &in[params.in.get_index(ox * params.stride_x + dx,
+                                        oy * params.stride_y + dy, 0)],
+                scale, channels, dst);
+            }
+          }
+        }
+      }
+      return;
+    }
+
+    const core::workspace::lease lease =
+      ws.acquire(avepool_workspace_size(params));
+    float_t *row_sum = lease.data();
+    float_t *buf     = row_sum + in_w;
+
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        vectorize::fill(row_sum, in_w, float_t{0});
+        for (size_t dy = 0; dy < params.pool_size_y; dy++) {
+          vectorize::reduce(
+            &in[params.in.get_index(0, oy * params.stride_y + dy, c)], in_w,
+            row_sum);
+        }
+
+        float_t *dst = &out[params.out.get_index(0, oy, c)];
+        vectorize::fill(dst, out_w, float_t{0});
+        for (size_t dx = 0; dx < params.pool_size_x; dx++) {
+          vectorize::muladd(
+            pooling_row(row_sum, dx, params.stride_x, out_w, buf),
+            scale, out_w, dst);
+        }
+      }
+    }
+  }, pooling_grainsize(params));
+}
+
+/**
+ * dx[window] += dy / window_area, prev_delta being zero-initialized by the
+ * caller
+ */
+inline void avepool_grad_op_internal(tensor_t &prev_delta,
+                                     const tensor_t &curr_delta,
+                                     const core::pooling_params &params,
+                                     const bool layer_parallelize) {
+  const size_t out_w  = params.out.width_;
+  const float_t scale = float_t(1) / float_t(params.window_area());
+
+  for_i(layer_parallelize, prev_delta.size(), [&](size_t sample) {
+    vec_t &dx       = prev_delta[sample];
+    const vec_t &dy = curr_delta[sample];
+
+    if (pooling_channels_last(params)) {
+      const size_t channels = params.out.depth_;
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        for (size_t ox = 0; ox < out_w; ox++) {
+          const float_t *src = &dy[params.out.get_index(ox, oy, 0)];
+          for (size_t wy = 0; wy < params.pool_size_y; wy++) {
+            for (size_t wx = 0; wx < params.pool_size_x; wx++) {
+              vectorize::muladd(
+                src, scale, channels,
+                &dx[params.in.get_index(ox * params.stride_x + wx,
+                                        oy * params.stride_y + wy, 0)]);
+            }
+          }
+        }
+      }
+      return;
+    }
+
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        const float_t *src = &dy[params.out.get_index(0, oy, c)];
+        for (size_t wy = 0; wy < params.pool_size_y; wy++) {
+          float_t *row =
+            &dx[params.in.get_index(0, oy * params.stride_y + wy, c)];
+          for (size_t wx = 0; wx < params.pool_size_x; wx++) {
+            if (params.stride_x == 1) {
+              vectorize::muladd(src, scale, out_w, row + wx);
+              continue;
+            }
+            for (size_t ox = 0; ox < out_w; ox++) {
+              row[wx + ox * params.stride_x] += src[ox] * scale;
+            }
+          }
+        }
+      }
+    }
+  }, pooling_grainsize(params));
+}
+
+}  // namespace kernels
+
+}  // namespace litchi
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+
+#include "litchi/util/util.h"
+
+namespace litchi {
+
+namespace kernels {
+
+/**
+ * side of the tiles of transpose(): a tile of the source and one of the
+ * destination stay in L1 together
+ */
+constexpr size_t transpose_tile = 16;
+
+/**
+ * dst[c * rows + r] = src[r * cols + c], i.e. the rows x cols row-major
+ * matrix src transposed into dst.
+ *
+ * Converts between the layouts of a shape: a channel-major tensor is a
+ * depth x area matrix and a channel-last one an area x depth matrix. The
+ * copy runs tile by tile, so that both sides are read and written in
+ * whole cache lines.
+ */
+inline void transpose(const float_t *src,
+                      size_t rows,
+                      size_t cols,
+                      float_t *dst) {
+  for (size_t r0 = 0; r0 < rows; r0 += transpose_tile) {
+    const size_t r1 = std::min(rows, r0 + transpose_tile);
+    for (size_t c0 = 0; c0 < cols; c0 += transpose_tile) {
+      const size_t c1 = std::min(cols, c0 + transpose_tile);
+      for (size_t c = c0; c < c1; c++) {
+        for (size_t r = r0; r < r1; r++) dst[c * rows + r] = src[r * cols + c];
+      }
+    }
+  }
+}
+
+/**
+ * copies a tensor of the given shape into the same shape in another layout
+ */
+inline void convert_layout(const float_t *src,
+                           const shape3d &shape,
+                           data_layout to,
+                           float_t *dst) {
+  if (shape.layout_ == to || shape.layout_invariant()) {
+    std::copy(src, src + shape.size(), dst);
+  } else if (to == data_layout::nhwc) {
+    transpose(src, shape.depth_, shape.area(), dst);
+  } else {
+    transpose(src, shape.area(), shape.depth_, dst);
+  }
+}
+
+}  // namespace kernels
+
+}  // namespace litchi
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "litchi/core/params/params.h"
+#include "litchi/util/util.h"
+
+namespace litchi {
+
+namespace core {
+
+class conv_params : public Params {
+public:
+  shape3d in;      // input:  width x height x in_channels
+  shape3d out;     // output: width x height x out_channels
+  shape3d weight;  // window_width x window_height x (in/groups * out)
+  size_t w_stride;
+  size_t h_stride;
+  size_t w_padding;
+  size_t h_padding;
+  size_t w_dilation;
+  size_t h_dilation;
+  size_t groups;
+  bool has_bias;
+
+  size_t in_channels_per_group() const { return in.depth_ / groups; }
+
+  size_t out_channels_per_group() const { return out.depth_ / groups; }
+
+  // depth of the implicit GEMM: in_channels/groups * window area
+  size_t patch_size() const {
+    return in_channels_per_group() * weight.width_ * weight.height_;
+  }
+};
+
+inline conv_params &Params::conv() {
+  return *(static_cast<conv_params *>(this));
+}
+
+}  // namespace core
+
+}  // namespace litchi
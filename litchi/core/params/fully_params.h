@@ -1,6 +1,7 @@
 #pragma once
 
 #include "litchi/core/params/params.h"
+#include "litchi/util/numa.h"
 
 namespace litchi {
 
@@ -11,6 +12,8 @@ public:
   size_t in_size_;
   size_t out_size_;
   bool has_bias_;
+  /** per-node copies of W read by the forward pass, or nullptr */
+  const numa_replicas *replicas_ = nullptr;
 };
 
 // TODO: can we do better here?
@@ -5,6 +5,8 @@ namespace litchi {
 namespace core {
 
 class fully_params;
+class conv_params;
+class pooling_params;
 
 /* Base class to model operation parameters */
 class Params {
@@ -12,6 +14,10 @@ public:
   Params() {}
 
   fully_params &fully();
+
+  conv_params &conv();
+
+  pooling_params &pooling();
 };
 
 }  // namespace core
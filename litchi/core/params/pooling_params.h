@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "litchi/core/params/params.h"
+#include "litchi/util/util.h"
+
+namespace litchi {
+
+namespace core {
+
+class pooling_params : public Params {
+public:
+  shape3d in;   // input:  width x height x channels
+  shape3d out;  // output: out_width x out_height x channels
+  size_t pool_size_x;
+  size_t pool_size_y;
+  size_t stride_x;
+  size_t stride_y;
+
+  /**
+   * max pooling: offset dy * pool_size_x + dx of the maximum within the
+   * window of every output, per sample. Windows of up to 256 elements use
+   * one byte per output, larger ones two.
+   */
+  std::vector<std::vector<uint8_t>> argmax8;
+  std::vector<std::vector<uint16_t>> argmax16;
+
+  size_t window_area() const { return pool_size_x * pool_size_y; }
+
+  bool compact_argmax() const { return window_area() <= 256; }
+};
+
+inline pooling_params &Params::pooling() {
+  return *(static_cast<pooling_params *>(this));
+}
+
+}  // namespace core
+
+}  // namespace litchi
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "litchi/io/dataset.h"
+#include "litchi/util/util.h"
+
+namespace litchi {
+
+/**
+ * Pseudo-random permutation of [0, count) evaluated on the fly.
+ *
+ * A keyed Feistel network permutes the smallest power-of-4 domain holding
+ * count, and values falling outside [0, count) are walked through the
+ * network again until they land inside. Each epoch gets a new key, so the
+ * shuffled order costs O(1) memory instead of an index array per sample.
+ */
+class index_stream {
+ public:
+  index_stream(size_t count, bool shuffle, uint64_t seed)
+    : count_(count), shuffle_(shuffle), seed_(seed), key_(0), half_bits_(1) {
+    while ((uint64_t(1) << (2 * half_bits_)) < count_) half_bits_++;
+    half_mask_ = (uint64_t(1) << half_bits_) - 1;
+    reset(0);
+  }
+
+  /**
+   * start a new epoch with its own permutation
+   */
+  void reset(uint64_t epoch) { key_ = mix(seed_ ^ mix(epoch + 1)); }
+
+  size_t size() const { return count_; }
+
+  /**
+   * @param i [in] position in the epoch, in [0, size())
+   * @return index of the sample to visit at position i
+   */
+  size_t operator[](size_t i) const {
+    if (!shuffle_) return i;
+    uint64_t v = i;
+    do {
+      v = permute(v);
+    } while (v >= count_);
+    return static_cast<size_t>(v);
+  }
+
+ private:
+  static uint64_t mix(uint64_t x) {
+    // splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  uint64_t permute(uint64_t v) const {
+    uint64_t left  = v >> half_bits_;
+    uint64_t right = v & half_mask_;
+    for (uint64_t round = 0; round < 4; round++) {
+      uint64_t next = left ^ (mix(key_ ^ (round << 56) ^ right) & half_mask_);
+      left          = right;
+      right         = next;
+    }
+    return (left << half_bits_) | right;
+  }
+
+  size_t count_;
+  bool shuffle_;
+  uint64_t seed_;
+  uint64_t key_;
+  uint64_t half_bits_;
+  uint64_t half_mask_;
+};
+
+/**
+ * Minibatch loader streaming a mmap_dataset through a background thread.
+ *
+ * The worker assembles batches into a ring of prefetch_depth slots while
+ * the caller computes on the previous ones. next() hands a batch over by
+ * swapping tensors, the caller's old tensor is recycled as a free slot, so
+ * in steady state neither side allocates nor copies and the memory in use
+ * is bounded by (prefetch_depth + 1) batches whatever the dataset size.
+ *
+ * Batches use the layout of layer inputs (one vec_t per sample), so they
+ * can be swapped straight into a layer with:
+ *
+ *     loader.next(*layer.input_tensor(0), labels);
+ *     layer.forward();
+ */
+class data_loader {
+ public:
+  /**
+   * @param dataset        [in] dataset to stream, must outlive the loader
+   * @param batch_size     [in] number of samples per batch
+   * @param shuffle        [in] visit samples in a new random order per epoch
+   * @param prefetch_depth [in] number of batches assembled ahead (2 for
+   *                            double buffering, 3 for triple buffering)
+   * @param seed           [in] seed of the shuffled order
+   */
+  data_loader(const mmap_dataset &dataset,
+              size_t batch_size,
+              bool shuffle          = true,
+              size_t prefetch_depth = 2,
+              uint64_t seed         = 1)
+    : dataset_(dataset),
+      batch_size_(batch_size),
+      indices_(dataset.size(), shuffle, seed),
+      slots_(std::max<size_t>(prefetch_depth, 1)),
+      head_(0),
+      tail_(0),
+      ready_(0),
+      epoch_(0),
+      stop_(false) {
+    if (batch_size_ == 0) throw "Batch size must be positive";
+    dataset_.advise(shuffle);
+    worker_ = std::thread([this]() { run(); });
+  }
+
+  ~data_loader() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    worker_.join();
+  }
+
+  data_loader(const data_loader &) = delete;
+  data_loader &operator=(const data_loader &) = delete;
+
+  size_t batches_per_epoch() const {
+    return (dataset_.size() + batch_size_ - 1) / batch_size_;
+  }
+
+  /**
+   * Waits for the next prefetched batch and swaps it into data/labels.
+   *
+   * @param data   [out] batch of samples, one vec_t per sample
+   * @param labels [out] batch of labels, one vec_t per sample
+   * @return false once at the end of every epoch, in which case data and
+   *         labels are left untouched; the following call starts the next
+   *         epoch.
+   */
+  bool next(tensor_t &data, tensor_t &labels) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return ready_ > 0; });
+    slot &s = slots_[head_];
+    if (s.error) std::rethrow_exception(s.error);
+
+    const bool has_batch = !s.end_of_epoch;
+    if (has_batch) {
+      data.swap(s.data);
+      labels.swap(s.labels);
+    }
+    head_ = (head_ + 1) % slots_.size();
+    ready_--;
+    lock.unlock();
+    cond_.notify_all();
+    return has_batch;
+  }
+
+  bool next(tensor_t &data) { return next(data, label_sink_); }
+
+ private:
+  struct slot {
+    tensor_t data;
+    tensor_t labels;
+    bool end_of_epoch = false;
+    std::exception_ptr error;
+  };
+
+  void run() {
+    size_t pos = 0;
+    for (;;) {
+      size_t index;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock,
+                   [this]() { return stop_ || ready_ < slots_.size(); });
+        if (stop_) return;
+        index = tail_;
+      }
+
+      // the slot is owned by the worker until it is published below
+      slot &s = slots_[index];
+      try {
+        if (pos >= dataset_.size()) {
+          s.end_of_epoch = true;
+          pos            = 0;
+          indices_.reset(++epoch_);
+        } else {
+          const size_t count = std::min(batch_size_, dataset_.size() - pos);
+          assemble(s, pos, count);
+          s.end_of_epoch = false;
+          pos += count;
+        }
+      } catch (...) {
+        s.error = std::current_exception();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tail_ = (tail_ + 1) % slots_.size();
+        ready_++;
+      }
+      cond_.notify_all();
+      if (s.error) return;
+    }
+  }
+
+  void assemble(slot &s, size_t first, size_t count) {
+    const size_t sample_size = dataset_.sample_size();
+    const size_t label_size  = dataset_.label_size();
+    s.data.resize(count);
+    s.labels.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      const size_t idx = indices_[first + i];
+      const float *src = dataset_.sample(idx);
+      s.data[i].assign(src, src + sample_size);
+      const float *lbl = dataset_.label(idx);
+      s.labels[i].assign(lbl, lbl + label_size);
+    }
+  }
+
+  const mmap_dataset &dataset_;
+  size_t batch_size_;
+  index_stream indices_;
+
+  std::vector<slot> slots_;
+  size_t head_;   // next slot handed to the caller
+  size_t tail_;   // next slot filled by the worker
+  size_t ready_;  // number of published slots
+  uint64_t epoch_;
+  bool stop_;
+
+  tensor_t label_sink_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::thread worker_;
+};
+
+}  // namespace litchi
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "litchi/util/util.h"
+
+namespace litchi {
+
+/**
+ * On-disk layout of a binary dataset:
+ *
+ *     | header (32 bytes) | record 0 | record 1 | ... | record N-1 |
+ *
+ * where every record holds sample_size float32 values of data followed by
+ * label_size float32 values of label. All the values are little-endian,
+ * records have a fixed size so sample i lives at a computable offset.
+ */
+struct dataset_header {
+  char magic[4];          // "LTDS"
+  uint32_t version;       // format version, currently 1
+  uint64_t sample_count;  // number of records
+  uint64_t sample_size;   // number of data values per record
+  uint64_t label_size;    // number of label values per record
+};
+
+static_assert(sizeof(dataset_header) == 32, "unexpected dataset header size");
+
+constexpr char dataset_magic[4]   = {'L', 'T', 'D', 'S'};
+constexpr uint32_t dataset_version = 1;
+
+/**
+ * Writes samples to a binary dataset file one record at a time, so that a
+ * dataset never needs to be held in memory to be created.
+ */
+class dataset_writer {
+ public:
+  dataset_writer(const std::string &path, size_t sample_size, size_t label_size)
+    : file_(std::fopen(path.c_str(), "wb")),
+      sample_size_(sample_size),
+      label_size_(label_size),
+      sample_count_(0),
+      record_(sample_size + label_size) {
+    if (!file_) throw "Cannot create dataset file";
+    write_header();
+  }
+
+  ~dataset_writer() { close(); }
+
+  dataset_writer(const dataset_writer &) = delete;
+  dataset_writer &operator=(const dataset_writer &) = delete;
+
+  /**
+   * append one record
+   *
+   * @param sample [in] data values, must hold sample_size elements
+   * @param label  [in] label values, must hold label_size elements
+   */
+  void write(const vec_t &sample, const vec_t &label = vec_t()) {
+    if (sample.size() != sample_size_ || label.size() != label_size_) {
+      throw "Record size mismatch while writing dataset";
+    }
+    std::copy(sample.begin(), sample.end(), record_.begin());
+    std::copy(label.begin(), label.end(), record_.begin() + sample_size_);
+    if (std::fwrite(record_.data(), sizeof(float), record_.size(), file_) !=
+        record_.size()) {
+      throw "Cannot write dataset record";
+    }
+    sample_count_++;
+  }
+
+  /**
+   * patch the final record count into the header and close the file
+   */
+  void close() {
+    if (!file_) return;
+    std::rewind(file_);
+    write_header();
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+
+ private:
+  void write_header() {
+    dataset_header header;
+    std::memcpy(header.magic, dataset_magic, sizeof(header.magic));
+    header.version      = dataset_version;
+    header.sample_count = sample_count_;
+    header.sample_size  = sample_size_;
+    header.label_size   = label_size_;
+    if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+      throw "Cannot write dataset header";
+    }
+  }
+
+  std::FILE *file_;
+  size_t sample_size_;
+  size_t label_size_;
+  size_t sample_count_;
+  std::vector<float> record_;
+};
+
+/**
+ * Read-only view over a binary dataset file mapped in memory.
+ *
+ * Records are paged in by the kernel on first access and can be evicted at
+ * any time, so the resident footprint does not depend on the file size.
+ */
+class mmap_dataset {
+ public:
+  explicit mmap_dataset(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw "Cannot open dataset file";
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(dataset_header)) {
+      ::close(fd);
+      throw "Invalid dataset file";
+    }
+    mapped_size_ = static_cast<size_t>(st.st_size);
+
+    void *addr = ::mmap(nullptr, mapped_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (addr == MAP_FAILED) throw "Cannot map dataset file";
+    base_ = static_cast<const uint8_t *>(addr);
+
+    std::memcpy(&header_, base_, sizeof(header_));
+    const size_t expected =
+      sizeof(dataset_header) + header_.sample_count * record_bytes();
+    if (std::memcmp(header_.magic, dataset_magic, sizeof(dataset_magic)) !=
+          0 ||
+        header_.version != dataset_version || mapped_size_ < expected) {
+      ::munmap(const_cast<uint8_t *>(base_), mapped_size_);
+      throw "Invalid dataset file";
+    }
+  }
+
+  ~mmap_dataset() {
+    if (base_) ::munmap(const_cast<uint8_t *>(base_), mapped_size_);
+  }
+
+  mmap_dataset(const mmap_dataset &) = delete;
+  mmap_dataset &operator=(const mmap_dataset &) = delete;
+
+  size_t size() const { return header_.sample_count; }
+
+  size_t sample_size() const { return header_.sample_size; }
+
+  size_t label_size() const { return header_.label_size; }
+
+  const float *sample(size_t i) const {
+    assert(i < size());
+    return reinterpret_cast<const float *>(base_ + sizeof(dataset_header) +
+                                           i * record_bytes());
+  }
+
+  const float *label(size_t i) const { return sample(i) + sample_size(); }
+
+  /**
+   * hint the kernel about the access pattern of the upcoming reads
+   *
+   * @param random [in] true for shuffled reads, false for sequential reads
+   */
+  void advise(bool random) const {
+    ::madvise(const_cast<uint8_t *>(base_), mapped_size_,
+              random ? MADV_RANDOM : MADV_SEQUENTIAL);
+  }
+
+ private:
+  size_t record_bytes() const {
+    return (header_.sample_size + header_.label_size) * sizeof(float);
+  }
+
+  dataset_header header_;
+  const uint8_t *base_ = nullptr;
+  size_t mapped_size_  = 0;
+};
+
+}  // namespace litchi
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+#include "litchi/util/parallel_for.h"
+
+namespace litchi {
+
+/**
+ * Batch Normalization
+ *
+ * Normalizes each channel with the statistics of the batch (training) or
+ * with their running averages (inference), then scales and shifts it:
+ * y = gamma * (x - mean) / sqrt(variance + epsilon) + beta.
+ *
+ * inputs:  (0) data of in_channels x in_spatial_size, channel-major,
+ *          (1) gamma and (2) beta, one per channel
+ * output:  (0) normalized data, same shape as the input
+ *
+ * The statistics are computed in a single pass with Welford's algorithm:
+ * every element of a sample is a lane updated across the batch (contiguous,
+ * so the update vectorizes), then the lanes of a channel are merged with
+ * Chan's formula. The work is split over blocks of channels.
+ *
+ * At inference the layer is an affine map per channel, and
+ * optimize_graph() folds it into the preceding fully-connected or
+ * convolutional layer.
+ */
+class batch_normalization_layer : public layer {
+ public:
+  /**
+   * @param in_spatial_size [in] spatial size (width x height) of the input,
+   *                             1 after a fully-connected layer
+   * @param in_channels     [in] number of channels (features) normalized
+   *                             independently
+   * @param epsilon         [in] small value added to the variance
+   * @param momentum        [in] weight of the previous value in the running
+   *                             averages of the statistics
+   * @param phase           [in] initial phase (see set_context)
+   */
+  batch_normalization_layer(size_t in_spatial_size,
+                            size_t in_channels,
+                            float_t epsilon  = float_t(1e-5),
+                            float_t momentum = float_t(0.999),
+                            net_phase phase  = net_phase::train)
+    : layer({vector_type::data, vector_type::weight, vector_type::bias},
+            {vector_type::data}),
+      in_spatial_size_(in_spatial_size),
+      channels_(in_channels),
+      eps_(epsilon),
+      momentum_(momentum),
+      phase_(phase),
+      update_running_stats_(false),
+      mean_(in_channels),
+      variance_(in_channels),
+      mean_running_(in_channels, float_t{0}),
+      variance_running_(in_channels, float_t{1}) {
+    weight_init(weight_init::constant(1.0));
+    bias_init(weight_init::constant(0.0));
+  }
+
+  std::vector<index3d<size_t>> in_shape() const override {
+    return {index3d<size_t>(in_spatial_size_, 1, channels_),
+            index3d<size_t>(channels_, 1, 1),
+            index3d<size_t>(channels_, 1, 1)};
+  }
+
+  std::vector<index3d<size_t>> out_shape() const override {
+    return {index3d<size_t>(in_spatial_size_, 1, channels_)};
+  }
+
+  std::string layer_type() const override { return "batch-norm"; }
+
+  uint64_t flops() const override {
+    return 2 * uint64_t(in_spatial_size_) * channels_;
+  }
+
+  size_t fan_in_size() const override { return 1; }
+
+  size_t fan_out_size() const override { return 1; }
+
+  void set_context(net_phase ctx) override { phase_ = ctx; }
+
+  net_phase phase() const { return phase_; }
+
+  size_t in_spatial_size() const { return in_spatial_size_; }
+
+  size_t channels() const { return channels_; }
+
+  float_t epsilon() const { return eps_; }
+
+  float_t momentum() const { return momentum_; }
+
+  const vec_t &running_mean() const { return mean_running_; }
+
+  const vec_t &running_variance() const { return variance_running_; }
+
+  void set_running_statistics(const vec_t &mean, const vec_t &variance) {
+    assert(mean.size() == channels_ && variance.size() == channels_);
+    mean_running_     = mean;
+    variance_running_ = variance;
+  }
+
+  /**
+   * gamma * inv_std and beta - mean * gamma * inv_std of every channel for
+   * the running statistics, i.e. the affine map applied at inference
+   */
+  void inference_affine(vec_t &scale, vec_t &shift) const {
+    const vec_t &gamma = *weights()[0];
+    const vec_t &beta  = *weights()[1];
+    scale.resize(channels_);
+    shift.resize(channels_);
+    for (size_t c = 0; c < channels_; c++) {
+      scale[c] = gamma[c] / std::sqrt(variance_running_[c] + eps_);
+      shift[c] = beta[c] - mean_running_[c] * scale[c];
+    }
+  }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &x  = *in_data[0];
+    const vec_t &gamma = (*in_data[1])[0];
+    const vec_t &beta  = (*in_data[2])[0];
+    tensor_t &y        = *out_data[0];
+
+    const vec_t *mean     = &mean_running_;
+    const vec_t *variance = &variance_running_;
+    if (phase_ == net_phase::train) {
+      compute_statistics(x);
+      update_running_statistics(x.size());
+      mean     = &mean_;
+      variance = &variance_;
+    }
+
+    // y = x * scale + shift, per channel
+    inv_std_.resize(channels_);
+    scale_.resize(channels_);
+    shift_.resize(channels_);
+    for (size_t c = 0; c < channels_; c++) {
+      inv_std_[c] = float_t(1) / std::sqrt((*variance)[c] + eps_);
+      scale_[c]   = gamma[c] * inv_std_[c];
+      shift_[c]   = beta[c] - (*mean)[c] * scale_[c];
+    }
+
+    for_i(parallelize_, x.size(), [&](size_t sample) {
+      const float_t *src = &x[sample][0];
+      float_t *dst       = &y[sample][0];
+      if (in_spatial_size_ == 1) {
+        for (size_t c = 0; c < channels_; c++) {
+          dst[c] = src[c] * scale_[c] + shift_[c];
+        }
+        return;
+      }
+      for (size_t c = 0; c < channels_; c++) {
+        const float_t a = scale_[c], b = shift_[c];
+        const size_t o  = c * in_spatial_size_;
+        for (size_t j = 0; j < in_spatial_size_; j++) {
+          dst[o + j] = src[o + j] * a + b;
+        }
+      }
+    }, grainsize());
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    const tensor_t &x  = *in_data[0];
+    const vec_t &gamma = (*in_data[1])[0];
+    const tensor_t &dy = *out_grad[0];
+    tensor_t &dx       = *in_grad[0];
+    tensor_t &dgamma   = *in_grad[1];
+    tensor_t &dbeta    = *in_grad[2];
+
+    const vec_t &mean  = phase_ == net_phase::train ? mean_ : mean_running_;
+    const size_t batch = x.size();
+
+    // per-sample sums of dy and dy * xhat over the spatial positions
+    sum_dy_.assign(batch, vec_t(channels_));
+    sum_dy_xhat_.assign(batch, vec_t(channels_));
+    for_i(parallelize_, batch, [&](size_t sample) {
+      for (size_t c = 0; c < channels_; c++) {
+        const size_t o  = c * in_spatial_size_;
+        const float_t m = mean[c];
+        const float_t s = inv_std_[c];
+        float_t g       = float_t{0};
+        float_t gx      = float_t{0};
+        for (size_t j = 0; j < in_spatial_size_; j++) {
+          const float_t d = dy[sample][o + j];
+          g += d;
+          gx += d * (x[sample][o + j] - m) * s;
+        }
+        sum_dy_[sample][c]      = g;
+        sum_dy_xhat_[sample][c] = gx;
+        dgamma[sample][c] += gx;
+        dbeta[sample][c] += g;
+      }
+    }, grainsize());
+
+    if (phase_ == net_phase::test) {
+      // the statistics are constants: dx = dy * gamma * inv_std
+      for_i(parallelize_, batch, [&](size_t sample) {
+        for (size_t c = 0; c < channels_; c++) {
+          const size_t o = c * in_spatial_size_;
+          for (size_t j = 0; j < in_spatial_size_; j++) {
+            dx[sample][o + j] = dy[sample][o + j] * scale_[c];
+          }
+        }
+      }, grainsize());
+      return;
+    }
+
+    // dx = gamma * inv_std * (dy - mean(dy) - xhat * mean(dy * xhat))
+    vec_t mean_dy(channels_, float_t{0});
+    vec_t mean_dy_xhat(channels_, float_t{0});
+    for (size_t sample = 0; sample < batch; sample++) {
+      for (size_t c = 0; c < channels_; c++) {
+        mean_dy[c] += sum_dy_[sample][c];
+        mean_dy_xhat[c] += sum_dy_xhat_[sample][c];
+      }
+    }
+    const float_t inv_n = float_t(1) / float_t(batch * in_spatial_size_);
+    for (size_t c = 0; c < channels_; c++) {
+      mean_dy[c] *= inv_n;
+      mean_dy_xhat[c] *= inv_n;
+    }
+
+    for_i(parallelize_, batch, [&](size_t sample) {
+      for (size_t c = 0; c < channels_; c++) {
+        const size_t o  = c * in_spatial_size_;
+        const float_t m = mean[c];
+        const float_t s = inv_std_[c];
+        const float_t a = gamma[c] * s;
+        for (size_t j = 0; j < in_spatial_size_; j++) {
+          const float_t xhat = (x[sample][o + j] - m) * s;
+          dx[sample][o + j] =
+            a * (dy[sample][o + j] - mean_dy[c] - xhat * mean_dy_xhat[c]);
+        }
+      }
+    }, grainsize());
+  }
+
+ private:
+  size_t grainsize() const {
+    const size_t work = std::max<size_t>(in_spatial_size_ * channels_, 1);
+    return std::max<size_t>(1, (size_t(1) << 14) / work);
+  }
+
+  /**
+   * batch mean and (biased) variance of every channel in one pass over x
+   */
+  void compute_statistics(const tensor_t &x) {
+    const size_t batch = x.size();
+    const size_t lanes = in_spatial_size_ * channels_;
+    lane_mean_.assign(lanes, float_t{0});
+    lane_m2_.assign(lanes, float_t{0});
+
+    // blocks of channels, each at least a few cache lines wide
+    const size_t block = std::max<size_t>(
+      1, std::min(channels_, 1024 / std::max<size_t>(in_spatial_size_, 1)));
+    const size_t blocks = (channels_ + block - 1) / block;
+
+    for_i(parallelize_, blocks, [&](size_t b) {
+      const size_t c0 = b * block;
+      const size_t c1 = std::min(channels_, c0 + block);
+      const size_t l0 = c0 * in_spatial_size_;
+      const size_t n  = (c1 - c0) * in_spatial_size_;
+      float_t *mean   = &lane_mean_[l0];
+      float_t *m2     = &lane_m2_[l0];
+
+      // Welford update of every lane with the sample, all lanes sharing
+      // the same count
+      for (size_t sample = 0; sample < batch; sample++) {
+        const float_t *v  = &x[sample][l0];
+        const float_t inv = float_t(1) / float_t(sample + 1);
+        for (size_t i = 0; i < n; i++) {
+          const float_t d = v[i] - mean[i];
+          mean[i] += d * inv;
+          m2[i] += d * (v[i] - mean[i]);
+        }
+      }
+
+      // merge the spatial lanes of each channel (Chan et al.)
+      for (size_t c = c0; c < c1; c++) {
+        const float_t *lm  = &lane_mean_[c * in_spatial_size_];
+        const float_t *lm2 = &lane_m2_[c * in_spatial_size_];
+        float_t m          = float_t{0};
+        for (size_t j = 0; j < in_spatial_size_; j++) m += lm[j];
+        m /= float_t(in_spatial_size_);
+        float_t s = float_t{0};
+        for (size_t j = 0; j < in_spatial_size_; j++) {
+          const float_t d = lm[j] - m;
+          s += lm2[j] + float_t(batch) * d * d;
+        }
+        mean_[c]     = m;
+        variance_[c] = s / float_t(batch * in_spatial_size_);
+      }
+    }, 1);
+  }
+
+  void update_running_statistics(size_t batch) {
+    const size_t n = batch * in_spatial_size_;
+    // unbiased estimate of the variance for inference
+    const float_t correction = n > 1 ? float_t(n) / float_t(n - 1) : 1;
+    for (size_t c = 0; c < channels_; c++) {
+      if (update_running_stats_) {
+        mean_running_[c] =
+          momentum_ * mean_running_[c] + (1 - momentum_) * mean_[c];
+        variance_running_[c] = momentum_ * variance_running_[c] +
+                               (1 - momentum_) * variance_[c] * correction;
+      } else {
+        mean_running_[c]     = mean_[c];
+        variance_running_[c] = variance_[c] * correction;
+      }
+    }
+    update_running_stats_ = true;
+  }
+
+  size_t in_spatial_size_;
+  size_t channels_;
+  float_t eps_;
+  float_t momentum_;
+  net_phase phase_;
+  /** false until the running statistics are seeded by a first batch */
+  bool update_running_stats_;
+
+  /** statistics of the last training batch */
+  vec_t mean_;
+  vec_t variance_;
+  /** running averages used at inference */
+  vec_t mean_running_;
+  vec_t variance_running_;
+
+  /** per-channel terms of the last forward pass */
+  vec_t inv_std_;
+  vec_t scale_;
+  vec_t shift_;
+
+  /** scratch of compute_statistics and back_propagation */
+  vec_t lane_mean_;
+  vec_t lane_m2_;
+  tensor_t sum_dy_;
+  tensor_t sum_dy_xhat_;
+};
+
+}  // namespace litchi
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+#include "litchi/util/parallel_for.h"
+
+namespace litchi {
+
+/**
+ * concatenates its inputs, flattened, into a single output: the output of
+ * a sample is in[0] followed by in[1], ...
+ */
+class concat_layer : public layer {
+ public:
+  /**
+   * @param in_shapes [in] shapes of the inputs, in output order
+   */
+  explicit concat_layer(const std::vector<shape3d> &in_shapes)
+    : layer(std::vector<vector_type>(in_shapes.size(), vector_type::data),
+            {vector_type::data}),
+      in_shapes_(in_shapes) {
+    if (in_shapes.empty()) throw "concat needs at least one input";
+    for (const shape3d &shape : in_shapes) out_size_ += shape.size();
+  }
+
+  /**
+   * @param in_sizes [in] number of elements of each flat input
+   */
+  explicit concat_layer(const std::vector<size_t> &in_sizes)
+    : concat_layer(flat_shapes(in_sizes)) {}
+
+  std::vector<shape3d> in_shape() const override { return in_shapes_; }
+
+  std::vector<shape3d> out_shape() const override {
+    return {shape3d(out_size_, 1, 1)};
+  }
+
+  std::string layer_type() const override { return "concat"; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    tensor_t &out = *out_data[0];
+    for_i(parallelize_, out.size(), [&](size_t sample) {
+      float_t *dst = &out[sample][0];
+      for (size_t i = 0; i < in_shapes_.size(); i++) {
+        const vec_t &src = (*in_data[i])[sample];
+        dst              = std::copy(src.begin(), src.end(), dst);
+      }
+    }, grainsize());
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    const tensor_t &dy = *out_grad[0];
+    for_i(parallelize_, dy.size(), [&](size_t sample) {
+      const float_t *src = &dy[sample][0];
+      for (size_t i = 0; i < in_shapes_.size(); i++) {
+        vec_t &dst = (*in_grad[i])[sample];
+        std::copy(src, src + dst.size(), dst.begin());
+        src += dst.size();
+      }
+    }, grainsize());
+  }
+
+ private:
+  static std::vector<shape3d> flat_shapes(const std::vector<size_t> &sizes) {
+    std::vector<shape3d> shapes;
+    for (size_t size : sizes) shapes.emplace_back(size, 1, 1);
+    return shapes;
+  }
+
+  size_t grainsize() const {
+    return std::max<size_t>(1, (size_t(1) << 14) / std::max<size_t>(
+                                                     out_size_, 1));
+  }
+
+  std::vector<shape3d> in_shapes_;
+  size_t out_size_ = 0;
+};
+
+}  // namespace litchi
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+
+#include "litchi/core/kernels/conv2d_grad_op.h"
+#include "litchi/core/kernels/conv2d_op.h"
+
+namespace litchi {
+
+/**
+ * 2D convolution layer
+ *
+ * Takes a width x height x in_channels input and outputs
+ * out_width x out_height x out_channels, with
+ * out = (in + 2 * padding - dilation * (window - 1) - 1) / stride + 1.
+ * The channels are split into groups convolved independently; the weights
+ * are stored as out_channels x (in_channels / groups) x window_height x
+ * window_width.
+ *
+ * The convolution runs as an implicit GEMM on the shared blocked engine:
+ * the patches are gathered while packing, so no im2col buffer is allocated.
+ */
+class convolutional_layer : public layer {
+ public:
+  /**
+   * @param in_width      [in] input image width
+   * @param in_height     [in] input image height
+   * @param window_width  [in] window(kernel) width of convolution
+   * @param window_height [in] window(kernel) height of convolution
+   * @param in_channels   [in] input image channels (grayscale=1, rgb=3)
+   * @param out_channels  [in] output image channels
+   * @param w_stride      [in] horizontal interval at which to apply the
+   *                           filters to the input
+   * @param h_stride      [in] vertical interval at which to apply the
+   *                           filters to the input
+   * @param w_padding     [in] zeros added to the left and right of the input
+   * @param h_padding     [in] zeros added to the top and bottom of the input
+   * @param w_dilation    [in] horizontal spacing between the window taps
+   * @param h_dilation    [in] vertical spacing between the window taps
+   * @param groups        [in] number of channel groups, dividing both
+   *                           in_channels and out_channels
+   * @param has_bias      [in] whether to add a bias to each output channel
+   */
+  convolutional_layer(size_t in_width,
+                      size_t in_height,
+                      size_t window_width,
+                      size_t window_height,
+                      size_t in_channels,
+                      size_t out_channels,
+                      size_t w_stride              = 1,
+                      size_t h_stride              = 1,
+                      size_t w_padding             = 0,
+                      size_t h_padding             = 0,
+                      size_t w_dilation            = 1,
+                      size_t h_dilation            = 1,
+                      size_t groups                = 1,
+                      bool has_bias                = true,
+                      core::backend_t backend_type = core::default_engine())
+    : layer(std_input_order(has_bias), {vector_type::data}) {
+    set_params(shape3d(in_width, in_height, in_channels), window_width,
+               window_height, out_channels, w_stride, h_stride, w_padding,
+               h_padding, w_dilation, h_dilation, groups, has_bias);
+    init_backend(backend_type);
+    layer::set_backend_type(backend_type);
+  }
+
+  std::vector<index3d<size_t>> in_shape() const override {
+    if (params_.has_bias) {
+      return {params_.in, params_.weight,
+              index3d<size_t>(1, 1, params_.out.depth_)};
+    } else {
+      return {params_.in, params_.weight};
+    }
+  }
+
+  std::vector<index3d<size_t>> out_shape() const override {
+    return {params_.out};
+  }
+
+  std::string layer_type() const override { return "conv"; }
+
+  uint64_t flops() const override {
+    const uint64_t outputs = params_.out.size();
+    return 2 * outputs * params_.patch_size() +
+           (params_.has_bias ? outputs : 0);
+  }
+
+  size_t fan_in_size() const override { return params_.patch_size(); }
+
+  size_t fan_out_size() const override {
+    return params_.weight.width_ * params_.weight.height_ *
+           params_.out_channels_per_group();
+  }
+
+  const core::conv_params &params() const { return params_; }
+
+  // channel-last data is read and written in place by the same GEMMs
+  bool supports_layout(data_layout) const override { return true; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    // forward convolutional op context
+    fwd_ctx_.set_in_out(in_data, out_data);
+    fwd_ctx_.setEngine(layer::engine());
+    fwd_ctx_.setParallelize(layer::parallelize());
+
+    // launch convolutional kernel
+    kernel_fwd_->run(fwd_ctx_);
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    // backward convolutional op context
+    bwd_ctx_.set_in_out(in_data, out_data, out_grad, in_grad);
+    bwd_ctx_.setEngine(layer::engine());
+    bwd_ctx_.setParallelize(layer::parallelize());
+
+    // launch convolutional kernel
+    kernel_back_->run(bwd_ctx_);
+  }
+
+ protected:
+  void apply_layout(data_layout layout) override {
+    params_.in.layout_  = layout;
+    params_.out.layout_ = layout;
+  }
+
+  void set_params(const shape3d &in,
+                  size_t window_width,
+                  size_t window_height,
+                  size_t out_channels,
+                  size_t w_stride,
+                  size_t h_stride,
+                  size_t w_padding,
+                  size_t h_padding,
+                  size_t w_dilation,
+                  size_t h_dilation,
+                  size_t groups,
+                  bool has_bias) {
+    if (groups == 0 || in.depth_ % groups != 0 ||
+        out_channels % groups != 0) {
+      throw "groups must divide in_channels and out_channels";
+    }
+    if (w_stride == 0 || h_stride == 0 || w_dilation == 0 ||
+        h_dilation == 0) {
+      throw "stride and dilation must be positive";
+    }
+    const size_t span_w = w_dilation * (window_width - 1) + 1;
+    const size_t span_h = h_dilation * (window_height - 1) + 1;
+    if (window_width == 0 || window_height == 0 ||
+        in.width_ + 2 * w_padding < span_w ||
+        in.height_ + 2 * h_padding < span_h) {
+      throw "window larger than the padded input";
+    }
+
+    params_.in = in;
+    params_.out =
+      shape3d((in.width_ + 2 * w_padding - span_w) / w_stride + 1,
+              (in.height_ + 2 * h_padding - span_h) / h_stride + 1,
+              out_channels);
+    params_.weight =
+      shape3d(window_width, window_height, in.depth_ / groups * out_channels);
+    params_.w_stride   = w_stride;
+    params_.h_stride   = h_stride;
+    params_.w_padding  = w_padding;
+    params_.h_padding  = h_padding;
+    params_.w_dilation = w_dilation;
+    params_.h_dilation = h_dilation;
+    params_.groups     = groups;
+    params_.has_bias   = has_bias;
+  }
+
+  void init_backend(core::backend_t backend_type) {
+    core::OpKernelConstruction ctx = core::OpKernelConstruction(&params_);
+
+    if (backend_type == core::backend_t::internal) {
+      kernel_fwd_.reset(new Conv2dOp(ctx));
+      kernel_back_.reset(new Conv2dGradOp(ctx));
+    } else {
+      throw "Not supported engine: ";
+    }
+  }
+
+ private:
+  /* The layer parameters */
+  core::conv_params params_;
+
+  /* forward op context */
+  core::OpKernelContext fwd_ctx_;
+
+  /* backward op context */
+  core::OpKernelContext bwd_ctx_;
+
+  /* Forward and backward ops */
+  std::shared_ptr<core::OpKernel> kernel_fwd_;
+  std::shared_ptr<core::OpKernel> kernel_back_;
+};
+
+}  // namespace litchi
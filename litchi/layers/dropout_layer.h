@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+#include "litchi/util/parallel_for.h"
+#include "litchi/util/philox.h"
+#include "litchi/util/product.h"
+#include "litchi/util/random.h"
+
+namespace litchi {
+
+/**
+ * @brief Dropout: in training, every element is zeroed with probability
+ * dropout_rate and the others are scaled by 1 / (1 - dropout_rate); at
+ * inference the layer passes its input through.
+ *
+ * The mask of a sample is a packed bitmask drawn from a philox4x32 stream
+ * (see bernoulli_mask()), the counters of every forward pass following
+ * those of the previous one: the masks depend on the seed of the layer
+ * and on the number of passes, not on the threads. A pass recomputing the
+ * previous one (see set_recomputing()) draws the same masks again. The
+ * rate is rounded to a multiple of 2^-16. The same mask scales the
+ * gradient in the backward pass, both passes applying it with
+ * vectorize::mask_scale().
+ */
+class dropout_layer : public layer {
+ public:
+  /**
+   * @param in_dim       [in] number of elements of a sample
+   * @param dropout_rate [in] probability of dropping an element, in [0, 1)
+   * @param phase        [in] initial phase (see set_context)
+   */
+  dropout_layer(size_t in_dim,
+                float_t dropout_rate,
+                net_phase phase = net_phase::train)
+    : layer({vector_type::data}, {vector_type::data}),
+      in_size_(in_dim),
+      dropout_rate_(dropout_rate),
+      phase_(phase),
+      layout_(data_layout::nchw),
+      generator_(seed()),
+      counter_(0),
+      last_counter_(0),
+      recomputing_(false) {
+    if (in_dim == 0) throw "Dropout layer dimension must be positive";
+    if (!(dropout_rate >= 0 && dropout_rate < 1)) {
+      throw "Dropout rate must be in [0, 1)";
+    }
+    threshold_ = uint32_t(
+      std::lround((float_t(1) - dropout_rate) * float_t(1 << 16)));
+    scale_ = float_t(1) / (float_t(1) - dropout_rate);
+  }
+
+  std::vector<index3d<size_t>> in_shape() const override {
+    return {index3d<size_t>(in_size_, 1, 1, layout_)};
+  }
+
+  std::vector<index3d<size_t>> out_shape() const override {
+    return {index3d<size_t>(in_size_, 1, 1, layout_)};
+  }
+
+  std::string layer_type() const override { return "dropout"; }
+
+  uint64_t flops() const override { return in_size_; }
+
+  void set_context(net_phase ctx) override { phase_ = ctx; }
+
+  void set_recomputing(bool recomputing) override {
+    recomputing_ = recomputing;
+  }
+
+  // elementwise, but flat: its data is channel-major whatever its layout
+  // (see same_memory_order), so it cannot carry channel-last data
+  bool supports_layout(data_layout layout) const override {
+    return layout == data_layout::nchw;
+  }
+
+  bool layout_agnostic() const override { return true; }
+
+  net_phase phase() const { return phase_; }
+
+  float_t dropout_rate() const { return dropout_rate_; }
+
+  /**
+   * bits of the mask of a sample of the last training pass, bit i keeping
+   * element i
+   */
+  const uint64_t *mask(size_t sample) const {
+    return &mask_[sample * words()];
+  }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &x = *in_data[0];
+    tensor_t &y       = *out_data[0];
+
+    if (!dropping()) {
+      for_i(parallelize_, x.size(), [&](size_t s) {
+        std::copy(x[s].begin(), x[s].begin() + in_size_, y[s].begin());
+      }, grainsize());
+      return;
+    }
+
+    const size_t words  = this->words();
+    const size_t blocks = words * bernoulli_mask_blocks;
+    if (!recomputing_) {
+      last_counter_ = counter_;
+      counter_ += x.size() * blocks;
+    }
+    const uint64_t base = last_counter_;
+    mask_.resize(x.size() * words);
+    for_i(parallelize_, x.size(), [&](size_t s) {
+      uint64_t *bits = &mask_[s * words];
+      bernoulli_mask(generator_, base + s * blocks, in_size_, threshold_,
+                     bits);
+      vectorize::mask_scale(&x[s][0], bits, in_size_, scale_, &y[s][0]);
+    }, grainsize());
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    const tensor_t &dy = *out_grad[0];
+    tensor_t &dx       = *in_grad[0];
+
+    for_i(parallelize_, dy.size(), [&](size_t s) {
+      if (dropping()) {
+        vectorize::mask_scale(&dy[s][0], mask(s), in_size_, scale_,
+                              &dx[s][0]);
+      } else {
+        std::copy(dy[s].begin(), dy[s].begin() + in_size_, dx[s].begin());
+      }
+    }, grainsize());
+  }
+
+ protected:
+  void apply_layout(data_layout layout) override { layout_ = layout; }
+
+ private:
+  // a key for the generator drawn from the global one, so that
+  // set_random_seed() makes the masks reproducible
+  static uint64_t seed() {
+    std::mt19937 &gen = random_generator::get_instance()();
+    const uint64_t hi = gen();
+    return hi << 32 | gen();
+  }
+
+  bool dropping() const {
+    return phase_ == net_phase::train && dropout_rate_ > 0;
+  }
+
+  size_t words() const { return (in_size_ + 63) / 64; }
+
+  // minimum number of samples per task
+  size_t grainsize() const {
+    return std::max<size_t>(1, (size_t(1) << 14) / in_size_);
+  }
+
+  size_t in_size_;
+  float_t dropout_rate_;
+  net_phase phase_;
+  data_layout layout_;
+
+  philox4x32 generator_;
+  /* first counter of the next training pass, and of the last one */
+  uint64_t counter_;
+  uint64_t last_counter_;
+  bool recomputing_;
+  /* probability of keeping an element, times 2^16, and the scale of the
+   * kept ones */
+  uint32_t threshold_;
+  float_t scale_;
+  /* masks of the samples of the last training pass */
+  std::vector<uint64_t> mask_;
+};
+
+}  // namespace litchi
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+#include "litchi/util/parallel_for.h"
+#include "litchi/util/product.h"
+
+namespace litchi {
+
+/**
+ * how the rows looked up by a bag of indices are combined
+ */
+enum class embedding_pooling { sum, mean };
+
+/**
+ * @brief Gradient of an embedding table restricted to the rows a batch
+ * looked up.
+ */
+struct embedding_gradient {
+  /** distinct rows touched by the batch, in ascending order */
+  std::vector<uint32_t> rows;
+  /** gradient of every row in rows, rows.size() x dim */
+  vec_t values;
+};
+
+/**
+ * @brief Embedding lookup: every sample is a bag of bag_size row indices
+ * into a num_embeddings x dim table, the output being the sum or the mean
+ * of the rows looked up.
+ *
+ * inputs:  (0) indices, (1) table
+ * output:  (0) pooled rows
+ *
+ * Indices are stored bit for bit in the float_t slots of the input, so that
+ * every row of a table of up to 2^32 - 1 rows is addressed exactly: fill
+ * the input with index() and pad the shorter bags with index(no_index).
+ * The mean divides by the number of indices actually present.
+ *
+ * A batch touches few rows of a large table, so the gradient of the table
+ * is never materialized: back_propagation() leaves its edge empty and
+ * records the gradient of the touched rows instead (sparse_gradient()),
+ * which update() applies by SGD. In Hogwild mode the backward pass skips
+ * merging the rows looked up more than once and update() applies every
+ * lookup concurrently without locking; such rows may then lose part of
+ * their update, which Hogwild accepts in exchange for not sorting.
+ */
+class embedding_layer : public layer {
+ public:
+  /** padding index of the bags shorter than bag_size */
+  static constexpr uint32_t no_index = 0xffffffffu;
+
+  /**
+   * @param num_embeddings [in] number of rows of the table
+   * @param dim            [in] number of features of a row
+   * @param bag_size       [in] number of indices per sample
+   * @param pooling        [in] combination of the rows of a bag
+   */
+  embedding_layer(size_t num_embeddings,
+                  size_t dim,
+                  size_t bag_size           = 1,
+                  embedding_pooling pooling = embedding_pooling::sum)
+    : layer({vector_type::data, vector_type::weight}, {vector_type::data}),
+      num_embeddings_(num_embeddings),
+      dim_(dim),
+      bag_size_(bag_size),
+      pooling_(pooling),
+      hogwild_(false) {
+    if (num_embeddings == 0 || dim == 0 || bag_size == 0) {
+      throw "Embedding dimensions must be positive";
+    }
+    if (num_embeddings > no_index) {
+      throw "Embedding table has too many rows";
+    }
+  }
+
+  /**
+   * the float_t holding index i of an input bag
+   */
+  static float_t index(uint32_t i) {
+    static_assert(sizeof(float_t) == sizeof(uint32_t),
+                  "Embedding indices are stored in 32-bit float_t");
+    float_t value;
+    std::memcpy(&value, &i, sizeof(value));
+    return value;
+  }
+
+  /**
+   * the index held by an element of an input bag
+   */
+  static uint32_t row_of(float_t value) {
+    uint32_t i;
+    std::memcpy(&i, &value, sizeof(i));
+    return i;
+  }
+
+  std::vector<index3d<size_t>> in_shape() const override {
+    return {index3d<size_t>(bag_size_, 1, 1),
+            index3d<size_t>(dim_, num_embeddings_, 1)};
+  }
+
+  std::vector<index3d<size_t>> out_shape() const override {
+    return {index3d<size_t>(dim_, 1, 1)};
+  }
+
+  std::string layer_type() const override { return "embedding"; }
+
+  uint64_t flops() const override { return uint64_t(bag_size_) * dim_; }
+
+  // a row feeds each of its outputs alone
+  size_t fan_in_size(size_t) const override { return 1; }
+
+  size_t fan_out_size(size_t) const override { return dim_; }
+
+  size_t in_grad_samples(size_t index, size_t batch_size) const override {
+    return index == 1 ? 0 : batch_size;
+  }
+
+  /**
+   * the data edges grow with the batch; the table gradient, which is never
+   * written, is released
+   */
+  void set_sample_count(size_t sample_count) override {
+    auto resize = [sample_count](tensor_t *tensor) {
+      tensor->resize(sample_count, (*tensor)[0]);
+    };
+    resize(prev()[0]->get_data());
+    resize(prev()[0]->get_gradient());
+    tensor_t().swap(*prev()[1]->get_gradient());
+    resize(next()[0]->get_data());
+    resize(next()[0]->get_gradient());
+  }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &x = *in_data[0];
+    const vec_t &W    = (*in_data[1])[0];
+    tensor_t &y       = *out_data[0];
+    const size_t n    = x.size();
+
+    // decode and check the bags once, for this pass and the backward one
+    rows_.resize(n * bag_size_);
+    scale_.resize(n);
+    for (size_t s = 0; s < n; s++) {
+      size_t count = 0;
+      for (size_t k = 0; k < bag_size_; k++) {
+        const uint32_t r = row_of(x[s][k]);
+        if (r != no_index && r >= num_embeddings_) {
+          throw "Embedding index out of range";
+        }
+        rows_[s * bag_size_ + k] = r;
+        count += r != no_index;
+      }
+      scale_[s] = pooling_ == embedding_pooling::mean && count > 0
+                    ? float_t(1) / float_t(count)
+                    : float_t(1);
+    }
+
+    // rows are scattered over the table: the next one of the bag is
+    // prefetched while the current one is added
+    const size_t line = 64 / sizeof(float_t);
+    for_i(parallelize_, n, [&](size_t s) {
+      const uint32_t *bag = &rows_[s * bag_size_];
+      float_t *out        = &y[s][0];
+      vectorize::fill(out, dim_, float_t{0});
+      for (size_t k = 0; k < bag_size_; k++) {
+        if (k + 1 < bag_size_ && bag[k + 1] != no_index) {
+          const float_t *next = &W[size_t(bag[k + 1]) * dim_];
+          for (size_t j = 0; j < dim_; j += line) {
+            __builtin_prefetch(next + j, 0, 0);
+          }
+        }
+        if (bag[k] == no_index) continue;
+        vectorize::reduce(&W[size_t(bag[k]) * dim_], dim_, out);
+      }
+      if (scale_[s] != float_t(1)) {
+        for (size_t j = 0; j < dim_; j++) out[j] *= scale_[s];
+      }
+    }, grainsize());
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    const tensor_t &dy = *out_grad[0];
+    const size_t n     = dy.size();
+
+    // indices are not differentiable
+    fill_tensor(*in_grad[0], float_t{0});
+
+    // the gradient reaching every row of a bag
+    dpooled_.resize(n * dim_);
+    for_i(parallelize_, n, [&](size_t s) {
+      for (size_t j = 0; j < dim_; j++) {
+        dpooled_[s * dim_ + j] = dy[s][j] * scale_[s];
+      }
+    }, grainsize());
+
+    lookups_.clear();
+    for (size_t s = 0; s < n; s++) {
+      for (size_t k = 0; k < bag_size_; k++) {
+        const uint32_t r = rows_[s * bag_size_ + k];
+        if (r != no_index) lookups_.emplace_back(r, uint32_t(s));
+      }
+    }
+    gradient_.rows.clear();
+    gradient_.values.clear();
+    if (hogwild_) return;
+
+    // group the lookups by row, then sum the gradients of every row; each
+    // task owns its rows, so that no update races
+    std::sort(lookups_.begin(), lookups_.end());
+    starts_.clear();
+    for (size_t l = 0; l < lookups_.size(); l++) {
+      if (l == 0 || lookups_[l].first != lookups_[l - 1].first) {
+        gradient_.rows.push_back(lookups_[l].first);
+        starts_.push_back(l);
+      }
+    }
+    starts_.push_back(lookups_.size());
+
+    const size_t rows = gradient_.rows.size();
+    gradient_.values.assign(rows * dim_, float_t{0});
+    for_i(parallelize_, rows, [&](size_t u) {
+      for (size_t l = starts_[u]; l < starts_[u + 1]; l++) {
+        vectorize::reduce(&dpooled_[lookups_[l].second * dim_], dim_,
+                          &gradient_.values[u * dim_]);
+      }
+    }, grainsize());
+  }
+
+  /**
+   * @brief SGD step on the rows touched by the last backward pass,
+   * table[r] -= learning_rate * gradient[r].
+   *
+   * Only those rows are read or written. In Hogwild mode, the lookups are
+   * applied concurrently and without locking, straight from the gradient
+   * of each sample.
+   */
+  void update(float_t learning_rate) {
+    vec_t &W         = *weights()[0];
+    const float_t lr = -learning_rate;
+    if (hogwild_) {
+      for_i(parallelize_, lookups_.size(), [&](size_t l) {
+        vectorize::muladd(&dpooled_[lookups_[l].second * dim_], lr, dim_,
+                          &W[size_t(lookups_[l].first) * dim_]);
+      }, grainsize());
+      return;
+    }
+    for_i(parallelize_, gradient_.rows.size(), [&](size_t u) {
+      vectorize::muladd(&gradient_.values[u * dim_], lr, dim_,
+                        &W[size_t(gradient_.rows[u]) * dim_]);
+    }, grainsize());
+  }
+
+  /**
+   * gradient of the rows touched by the last backward pass; empty in
+   * Hogwild mode
+   */
+  const embedding_gradient &sparse_gradient() const { return gradient_; }
+
+  /**
+   * apply the lookups of a batch without merging the repeated rows
+   */
+  embedding_layer &set_hogwild(bool hogwild) {
+    hogwild_ = hogwild;
+    return *this;
+  }
+
+  bool hogwild() const { return hogwild_; }
+
+  size_t num_embeddings() const { return num_embeddings_; }
+
+  size_t dim() const { return dim_; }
+
+  size_t bag_size() const { return bag_size_; }
+
+ private:
+  // minimum number of rows per task
+  size_t grainsize() const {
+    return std::max<size_t>(1, (size_t(1) << 12) / dim_);
+  }
+
+  size_t num_embeddings_;
+  size_t dim_;
+  size_t bag_size_;
+  embedding_pooling pooling_;
+  bool hogwild_;
+
+  /* rows of the bags and scale of the pooling of the last forward pass */
+  std::vector<uint32_t> rows_;
+  vec_t scale_;
+
+  /* gradient reaching the rows of each sample, and the (row, sample) of
+   * every lookup of the last backward pass */
+  vec_t dpooled_;
+  std::vector<std::pair<uint32_t, uint32_t>> lookups_;
+  std::vector<size_t> starts_;
+  embedding_gradient gradient_;
+};
+
+}  // namespace litchi
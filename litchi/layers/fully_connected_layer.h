@@ -5,8 +5,9 @@
 
 #include "litchi/layers/layer.h"
 
-// #include "litchi/core/kernels/fully_connected_grad_op.h"
+#include "litchi/core/kernels/fully_connected_grad_op.h"
 #include "litchi/core/kernels/fully_connected_op.h"
+#include "litchi/util/numa.h"
 
 namespace litchi {
 
@@ -45,20 +46,80 @@ class fully_connected_layer : public layer {
     return {index3d<size_t>(params_.out_size_, 1, 1)};
   }
 
+  std::string layer_type() const override { return "fully-connected"; }
+
+  uint64_t flops() const override {
+    return 2 * uint64_t(params_.in_size_) * params_.out_size_ +
+           (params_.has_bias_ ? params_.out_size_ : 0);
+  }
+
+  size_t in_size() const { return params_.in_size_; }
+
+  size_t out_size() const { return params_.out_size_; }
+
+  bool has_bias() const { return params_.has_bias_; }
+
+  /**
+   * @brief Placement of W on NUMA machines, applied by the next forward
+   * pass.
+   *
+   * With numa_policy::replicate every node of topology keeps a copy of W,
+   * and the forward pass splits the batch across the nodes so that each
+   * reads its local copy. The copies are snapshots, taken again by the
+   * first forward pass after a backward one, i.e. after a training step
+   * updated the weights. Weights changed in any other way (loaded, set by
+   * hand) are only seen once refresh_numa_placement() was called.
+   * numa_policy::interleave spreads the pages of W over the nodes instead.
+   * Both are no-ops on a single node.
+   */
+  void set_numa_policy(
+    numa_policy policy,
+    const numa_topology &topology = system_numa_topology()) {
+    numa_policy_       = policy;
+    numa_replicas_     = numa_replicas(topology);
+    params_.replicas_  = nullptr;
+    numa_placement_ok_ = false;
+  }
+
+  numa_policy get_numa_policy() const { return numa_policy_; }
+
+  /**
+   * re-applies the NUMA placement to the current weights at the next
+   * forward pass; needed after changing them outside of training
+   */
+  void refresh_numa_placement() { numa_placement_ok_ = false; }
+
+  /** bytes held by the per-node copies of W */
+  uint64_t numa_replica_bytes() const { return numa_replicas_.bytes(); }
+
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
+    if (!numa_placement_ok_) place_weights((*in_data[1])[0]);
+
     // forward fully connected op context
     fwd_ctx_.set_in_out(in_data, out_data);
     fwd_ctx_.setEngine(layer::engine());
+    fwd_ctx_.setParallelize(layer::parallelize());
 
     // launch fully connected kernel
-    kernel_fwd_->compute(fwd_ctx_);
+    kernel_fwd_->run(fwd_ctx_);
   }
 
   void back_propagation(const std::vector<tensor_t *> &in_data,
                         const std::vector<tensor_t *> &out_data,
                         std::vector<tensor_t *> &out_grad,
-                        std::vector<tensor_t *> &in_grad) override {}
+                        std::vector<tensor_t *> &in_grad) override {
+    // backward fully connected op context
+    bwd_ctx_.set_in_out(in_data, out_data, out_grad, in_grad);
+    bwd_ctx_.setEngine(layer::engine());
+    bwd_ctx_.setParallelize(layer::parallelize());
+
+    // launch fully connected kernel
+    kernel_back_->run(bwd_ctx_);
+
+    // the weights are about to be updated from these gradients
+    if (numa_policy_ != numa_policy::none) numa_placement_ok_ = false;
+  }
 
  protected:
   void set_params(const size_t in_size, const size_t out_size, bool has_bias) {
@@ -72,6 +133,7 @@ class fully_connected_layer : public layer {
 
     if (backend_type == core::backend_t::internal) {
       kernel_fwd_.reset(new FullyConnectedOp(ctx));
+      kernel_back_.reset(new FullyConnectedGradOp(ctx));
     } else {
       // TODO error throw
       throw "Not supported engine: ";
@@ -79,6 +141,18 @@ class fully_connected_layer : public layer {
   }
 
  private:
+  void place_weights(vec_t &W) {
+    const numa_topology &topology = numa_replicas_.topology();
+    params_.replicas_             = nullptr;
+    if (numa_policy_ == numa_policy::replicate && topology.is_numa()) {
+      numa_replicas_.update(W);
+      params_.replicas_ = &numa_replicas_;
+    } else if (numa_policy_ == numa_policy::interleave) {
+      interleave_pages(&W[0], W.size() * sizeof(float_t), topology);
+    }
+    numa_placement_ok_ = true;
+  }
+
   /* The layer parameters */
   core::fully_params params_;
 
@@ -86,11 +160,16 @@ class fully_connected_layer : public layer {
   core::OpKernelContext fwd_ctx_;
 
   /* backward op context */
-  // core::OpKernelContext bwd_ctx_;
+  core::OpKernelContext bwd_ctx_;
 
   /* Forward and backward ops */
   std::shared_ptr<core::OpKernel> kernel_fwd_;
-  // std::shared_ptr<core::OpKernel> kernel_back_;
+  std::shared_ptr<core::OpKernel> kernel_back_;
+
+  /* NUMA placement of the weights */
+  numa_policy numa_policy_ = numa_policy::none;
+  numa_replicas numa_replicas_;
+  bool numa_placement_ok_ = true;
 };
 
 }  // namespace litchi
\ No newline at end of file
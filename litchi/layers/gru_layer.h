@@ -0,0 +1,138 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "litchi/layers/recurrent_layer.h"
+
+namespace litchi {
+
+/**
+ * @brief Gated recurrent unit layer.
+ *
+ *     r = sigmoid(x_t W_xr + h_{t-1} W_hr + b_r)
+ *     z = sigmoid(x_t W_xz + h_{t-1} W_hz + b_z)
+ *     n = tanh(x_t W_xn + b_n + r * (h_{t-1} W_hn))
+ *     h_t = (1 - z) * n + z * h_{t-1}
+ *
+ * The gates are concatenated in the order r, z, n along the columns of W_x,
+ * W_h and the bias. The reset gate applies after the product by W_hn (as in
+ * cuDNN), so that h_{t-1} W_h is a single GEMM per step; its result is kept
+ * separate from the input projection for the candidate n. See
+ * recurrent_layer for the layout of the sequences.
+ */
+class gru_layer : public recurrent_layer {
+ public:
+  /**
+   * @param in_size     [in] number of features of a step
+   * @param hidden_size [in] number of features of the hidden state
+   * @param seq_len     [in] number of steps of a sequence
+   */
+  gru_layer(size_t in_size, size_t hidden_size, size_t seq_len)
+    : recurrent_layer(in_size, hidden_size, seq_len, 3) {}
+
+  std::string layer_type() const override { return "gru"; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &x = *in_data[0];
+    const vec_t &Wx   = (*in_data[1])[0];
+    const vec_t &Wh   = (*in_data[2])[0];
+    const vec_t &b    = (*in_data[3])[0];
+    tensor_t &y       = *out_data[0];
+    const size_t H    = hidden_size();
+    const size_t T    = seq_len();
+
+    // the input projections, then the values of the gates
+    project_inputs(x, Wx, b, gates_);
+    hidden_.assign(x.size() * T * gate_size(), float_t{0});
+
+    for (size_t t = 0; t < T; t++) {
+      if (t > 0) project_hidden(y, Wh, t, hidden_);
+      for_i(parallelize_, x.size(), [&](size_t sample) {
+        float_t *g            = gate_row(gates_, sample, t);
+        const float_t *p      = gate_row(hidden_, sample, t);
+        const float_t *h_prev = t > 0 ? &y[sample][(t - 1) * H] : nullptr;
+        float_t *h            = &y[sample][t * H];
+        // r and z are adjacent: one call covers both
+        vectorize::reduce(p, 2 * H, g);
+        vectorize::sigmoid(g, 2 * H, g);
+        const float_t *r = g, *z = g + H;
+        float_t *n       = g + 2 * H;
+        for (size_t j = 0; j < H; j++) n[j] += r[j] * p[2 * H + j];
+        vectorize::tanh(n, H, n);
+        for (size_t j = 0; j < H; j++) {
+          h[j] = (float_t(1) - z[j]) * n[j] +
+                 (h_prev ? z[j] * h_prev[j] : float_t{0});
+        }
+      }, grainsize());
+    }
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    const tensor_t &x  = *in_data[0];
+    const vec_t &Wx    = (*in_data[1])[0];
+    const vec_t &Wh    = (*in_data[2])[0];
+    const tensor_t &y  = *out_data[0];
+    const tensor_t &dy = *out_grad[0];
+    tensor_t &dx       = *in_grad[0];
+    const size_t H     = hidden_size();
+    const size_t T     = seq_len();
+    const size_t batch = x.size();
+
+    // gradients of the input and hidden projections, and the one flowing
+    // to h_{t-1}
+    dgates_.resize(batch * T * gate_size());
+    dhidden_.resize(batch * T * gate_size());
+    dh_.assign(batch * H, float_t{0});
+
+    for (size_t t = T; t-- > 0;) {
+      for_i(parallelize_, batch, [&](size_t sample) {
+        const float_t *g      = gate_row(gates_, sample, t);
+        const float_t *p      = gate_row(hidden_, sample, t);
+        const float_t *h_prev = t > 0 ? &y[sample][(t - 1) * H] : nullptr;
+        const float_t *dys    = &dy[sample][t * H];
+        float_t *dgx          = gate_row(dgates_, sample, t);
+        float_t *dgh          = gate_row(dhidden_, sample, t);
+        float_t *dh           = &dh_[sample * H];
+        for (size_t j = 0; j < H; j++) {
+          const float_t r   = g[j];
+          const float_t z   = g[H + j];
+          const float_t n   = g[2 * H + j];
+          const float_t hp  = h_prev ? h_prev[j] : float_t{0};
+          const float_t dhj = dys[j] + dh[j];
+          const float_t dn  = dhj * (float_t(1) - z) * (float_t(1) - n * n);
+          const float_t dz  = dhj * (hp - n) * z * (float_t(1) - z);
+          const float_t dr  = dn * p[2 * H + j] * r * (float_t(1) - r);
+          dgx[j]            = dr;
+          dgx[H + j]        = dz;
+          dgx[2 * H + j]    = dn;
+          dgh[j]            = dr;
+          dgh[H + j]        = dz;
+          dgh[2 * H + j]    = dn * r;
+          dh[j]             = dhj * z;
+        }
+      }, grainsize());
+      if (t > 0) backpropagate_hidden(Wh, dhidden_, batch, t, dh_);
+    }
+
+    fill_tensor(dx, float_t{0});
+    input_gradients(x, Wx, dgates_, dx, (*in_grad[1])[0], (*in_grad[3])[0]);
+    recurrent_weight_gradient(y, dhidden_, (*in_grad[2])[0]);
+  }
+
+ private:
+  /* gates and h_{t-1} W_h of every step of the last forward pass */
+  vec_t gates_;
+  vec_t hidden_;
+
+  /* buffers of the backward pass, reused across steps */
+  vec_t dgates_;
+  vec_t dhidden_;
+  vec_t dh_;
+};
+
+}  // namespace litchi
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
 
 #include "litchi/core/backend.h"
 #include "litchi/node.h"
 
+#include "litchi/util/tracer.h"
 #include "litchi/util/util.h"
 #include "litchi/util/weight_init.h"
 
@@ -32,6 +35,7 @@ class layer : public node {
         const std::vector<vector_type> &out_type)
     : node(in_type.size(), out_type.size()),
       initialized_(false),
+      parallelize_(true),
       in_channels_(in_type.size()),
       out_channels_(out_type.size()),
       in_type_(in_type),
@@ -49,6 +53,72 @@ class layer : public node {
     backend_type_ = backend_type;
   }
 
+  void set_parallelize(bool parallelize) { parallelize_ = parallelize; }
+
+  /**
+   * Switches between training and inference behaviour, for layers that
+   * differ between the two (e.g. batch normalization). Does nothing by
+   * default.
+   */
+  virtual void set_context(net_phase ctx) { CNN_UNREFERENCED_PARAMETER(ctx); }
+
+  /**
+   * Marks the following forward passes as recomputations of the last one
+   * (activation checkpointing, see sequential::set_checkpoint), which must
+   * reproduce its outputs: layers drawing random numbers (e.g. dropout)
+   * replay the same draws. Does nothing by default.
+   */
+  virtual void set_recomputing(bool recomputing) {
+    CNN_UNREFERENCED_PARAMETER(recomputing);
+  }
+
+  /**
+   * Whether the layer can read and write its data in the given layout.
+   * Layers support the channel-major layout only by default.
+   */
+  virtual bool supports_layout(data_layout layout) const {
+    return layout == data_layout::nchw;
+  }
+
+  /**
+   * Whether the layer computes the same thing in every layout, such as
+   * elementwise layers: it then takes the layout of its neighbours.
+   */
+  virtual bool layout_agnostic() const { return false; }
+
+  /**
+   * Switches the layout of the data of the layer, retagging the output
+   * edges already allocated (and the fed inputs); the predecessors must
+   * follow for the graph to stay connected.
+   */
+  void set_layout(data_layout layout) {
+    if (!supports_layout(layout)) throw "Layout not supported by the layer";
+    apply_layout(layout);
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (in_type_[i] == vector_type::data && prev_[i] &&
+          !prev_[i]->prev()) {
+        prev_[i]->set_layout(layout);
+      }
+    }
+    for (size_t i = 0; i < out_channels_; i++) {
+      if (out_type_[i] == vector_type::data && next_[i]) {
+        next_[i]->set_layout(layout);
+      }
+    }
+  }
+
+  /**
+   * layout of the data the layer reads
+   */
+  data_layout layout() const { return in_shape()[0].layout_; }
+
+  /**
+   * Freezes (false) or unfreezes (true) the weights of the layer. Frozen
+   * weights are not reset by init_weight() and may be rewritten by offline
+   * graph transformations.
+   */
+  void set_trainable(bool trainable) { trainable_ = trainable; }
+
   ///////////////////////////////////////////////////////////
   // getter
 
@@ -56,14 +126,38 @@ class layer : public node {
 
   core::backend_t engine() const { return backend_type_; }
 
+  bool parallelize() const { return parallelize_; }
+
+  bool trainable() const { return trainable_; }
+
+  /**
+   * name of layer, should be unique for each concrete class
+   */
+  virtual std::string layer_type() const = 0;
+
+  /**
+   * number of floating point operations of forward_propagation per sample,
+   * a multiply-add counts as two operations
+   */
+  virtual uint64_t flops() const { return 0; }
+
   ///< number of incoming edges in this layer
   size_t in_channels() const { return in_channels_; }
 
+  ///< number of outgoing edges in this layer
+  size_t out_channels() const { return out_channels_; }
+
+  ///< type of each incoming edge (data, weight, bias...)
+  const std::vector<vector_type> &in_types() const { return in_type_; }
+
+  ///< type of each outgoing edge
+  const std::vector<vector_type> &out_types() const { return out_type_; }
+
   void set_in_data(const std::vector<const vec_t *> *data, size_t cnt) {
     CNN_UNREFERENCED_PARAMETER(cnt);
     size_t n = 0;
     for (size_t i = 0; i < in_channels_; i++) {
-      if (in_type_[i] != vector_type::data) continue;
+      if (!is_fed_input(in_type_[i])) continue;
       tensor_t &dst_data = *ith_in_node(i)->get_data();
       size_t in_size     = ith_in_node(i)->shape().size();
       assert(n < cnt);
@@ -82,6 +176,41 @@ class layer : public node {
     }
   }
 
+  /**
+   * @brief Mutable access to the data of the i-th input edge.
+   *
+   * Lets a caller assemble or swap a batch straight into the layer input
+   * (e.g. from a data_loader) instead of going through set_in_data(), which
+   * copies every sample. The layer must be set up beforehand.
+   */
+  tensor_t *input_tensor(size_t i) {
+    assert(is_fed_input(in_type_[i]));
+    return ith_in_node(i)->get_data();
+  }
+
+  /**
+   * pointers to the values of the trainable input edges (weights, biases)
+   */
+  std::vector<vec_t *> weights() {
+    std::vector<vec_t *> v;
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (is_trainable_weight(in_type_[i])) {
+        v.push_back(get_weight_data(i));
+      }
+    }
+    return v;
+  }
+
+  std::vector<const vec_t *> weights() const {
+    std::vector<const vec_t *> v;
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (is_trainable_weight(in_type_[i])) {
+        v.push_back(get_weight_data(i));
+      }
+    }
+    return v;
+  }
+
   void output(std::vector<const tensor_t *> &out) const {
     out.clear();
     for (size_t i = 0; i < out_channels_; i++) {
@@ -236,9 +365,56 @@ class layer : public node {
     }
 
     // call the forward computation kernel/routine
+    trace_scope trace("layer");
+    if (trace) {
+      trace.set_name(layer_type(), ".forward");
+      trace.set_args(fwd_in_data_[0]->size(),
+                     trace_bytes(fwd_in_data_) + trace_bytes(fwd_out_data_));
+    }
     forward_propagation(fwd_in_data_, fwd_out_data_);
   }
 
+  /**
+   * @brief Runs back_propagation on the data and gradients held by the
+   * edges: reads the gradient of the outputs, writes the gradient of the
+   * inputs (data, weights and biases).
+   */
+  void backward() {
+    bwd_in_data_.resize(in_channels_);
+    bwd_in_grad_.resize(in_channels_);
+    bwd_out_data_.resize(out_channels_);
+    bwd_out_grad_.resize(out_channels_);
+
+    for (size_t i = 0; i < in_channels_; i++) {
+      const auto &nd  = ith_in_node(i);
+      bwd_in_data_[i] = nd->get_data();
+      bwd_in_grad_[i] = nd->get_gradient();
+    }
+    for (size_t i = 0; i < out_channels_; i++) {
+      const auto &nd   = ith_out_node(i);
+      bwd_out_data_[i] = nd->get_data();
+      bwd_out_grad_[i] = nd->get_gradient();
+    }
+    trace_scope trace("layer");
+    if (trace) {
+      trace.set_name(layer_type(), ".backward");
+      trace.set_args(bwd_in_data_[0]->size(),
+                     trace_bytes(bwd_in_data_) + trace_bytes(bwd_in_grad_) +
+                       trace_bytes(bwd_out_data_) +
+                       trace_bytes(bwd_out_grad_));
+    }
+    back_propagation(bwd_in_data_, bwd_out_data_, bwd_out_grad_,
+                     bwd_in_grad_);
+  }
+
+  /**
+   * zeroes the gradients of the inputs, weight gradients being accumulated
+   * by back_propagation
+   */
+  void clear_grads() {
+    for (size_t i = 0; i < in_channels_; i++) ith_in_node(i)->clear_grads();
+  }
+
   /**
    * @brief Allocates data in the computational graph and reset weights if
    * it's needed or the data is not already initialized.
@@ -319,6 +495,16 @@ class layer : public node {
     initialized_ = true;
   }
 
+  /**
+   * samples of gradient the index-th input edge holds once set_sample_count()
+   * saw a batch of batch_size samples; predict_memory() sizes the edges
+   * with it
+   */
+  virtual size_t in_grad_samples(size_t index, size_t batch_size) const {
+    CNN_UNREFERENCED_PARAMETER(index);
+    return batch_size;
+  }
+
   virtual void set_sample_count(size_t sample_count) {
     // increase the size if necessary - but do not decrease
     auto resize = [sample_count](tensor_t *tensor) {
@@ -341,8 +527,18 @@ class layer : public node {
   }
 
  protected:
+  /**
+   * Rewrites the shapes of the layer for set_layout(), the layout being
+   * supported. Layers supporting channel-last data override it.
+   */
+  virtual void apply_layout(data_layout layout) {
+    CNN_UNREFERENCED_PARAMETER(layout);
+  }
+
   /** Flag indication whether the layer/node is initialized */
   bool initialized_;
+  /** Flag indicating whether to use parallel operations */
+  bool parallelize_;
   /** The number of input vectors/edges */
   size_t in_channels_;
   /** The number of output vectors/edges */
@@ -356,7 +552,17 @@ class layer : public node {
   /** The backend instance (deprecated) */
   // std::shared_ptr<core::backend> backend_;
 
+  friend void connect(layer *head,
+                      layer *tail,
+                      size_t head_index,
+                      size_t tail_index);
+
  private:
+  /** inputs provided by the caller: data and labels */
+  static bool is_fed_input(vector_type vtype) {
+    return vtype == vector_type::data || vtype == vector_type::label;
+  }
+
   /** Flag indicating whether the layer/node parameters are trainable */
   bool trainable_;
   /** Pointer to the function for weights initialization */
@@ -366,6 +572,10 @@ class layer : public node {
 
   std::vector<tensor_t *> fwd_in_data_;
   std::vector<tensor_t *> fwd_out_data_;
+  std::vector<tensor_t *> bwd_in_data_;
+  std::vector<tensor_t *> bwd_in_grad_;
+  std::vector<tensor_t *> bwd_out_data_;
+  std::vector<tensor_t *> bwd_out_grad_;
 
   /**
    * @brief Allocates the necessary edge memory in a specific
@@ -458,4 +668,36 @@ class layer : public node {
   }
 };
 
+/**
+ * @brief Connects the head_index-th output of head to the tail_index-th
+ * input of tail, the two layers then share the same edge.
+ *
+ * Graphical explanation:
+ *
+ *     |head| -- next(head_index) == prev(tail_index) -- |tail|
+ */
+inline void connect(layer *head,
+                    layer *tail,
+                    size_t head_index = 0,
+                    size_t tail_index = 0) {
+  const shape3d out_shape = head->out_shape()[head_index];
+  const shape3d in_shape  = tail->in_shape()[tail_index];
+
+  if (out_shape.size() != in_shape.size()) {
+    throw "Connection mismatch between layers";
+  }
+  if (!same_memory_order(out_shape, in_shape)) {
+    throw "Layout mismatch between layers";
+  }
+
+  // make sure the output edge of the head exists
+  head->setup(false);
+
+  if (tail->prev_[tail_index]) {
+    tail->prev_[tail_index]->remove_next_node(tail);
+  }
+  tail->prev_[tail_index] = head->next_[head_index];
+  tail->prev_[tail_index]->add_next_node(tail);
+}
+
 }  // namespace litchi
\ No newline at end of file
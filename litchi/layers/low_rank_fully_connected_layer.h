@@ -0,0 +1,195 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+
+#include "litchi/core/kernels/fully_connected_grad_op.h"
+#include "litchi/core/kernels/fully_connected_op.h"
+
+namespace litchi {
+
+/**
+ * @brief Fully-connected layer with a factorized weight matrix W = U * V,
+ * U being in_dim x rank and V rank x out_dim.
+ *
+ * A sample costs 2 * rank * (in_dim + out_dim) FLOPs instead of
+ * 2 * in_dim * out_dim. Both products run on the fully-connected kernels:
+ * the forward pass keeps the rank-sized intermediate x * U of the batch for
+ * the backward pass. See compress_low_rank() to factorize a trained
+ * fully_connected_layer.
+ */
+class low_rank_fully_connected_layer : public layer {
+ public:
+  /**
+   * @param in_dim [in] number of elements of the input
+   * @param out_dim [in] number of elements of the output
+   * @param rank [in] inner dimension of the factorization
+   * @param has_bias [in] whether to include additional bias to the layer
+   */
+  low_rank_fully_connected_layer(
+    size_t in_dim,
+    size_t out_dim,
+    size_t rank,
+    bool has_bias                = true,
+    core::backend_t backend_type = core::default_engine())
+    : layer(input_order(has_bias), {vector_type::data}) {
+    if (rank == 0) throw "Rank must be positive";
+    set_params(in_dim, out_dim, rank, has_bias);
+    init_backend(backend_type);
+    layer::set_backend_type(backend_type);
+  }
+
+  std::vector<index3d<size_t>> in_shape() const override {
+    std::vector<index3d<size_t>> shapes = {
+      index3d<size_t>(in_size(), 1, 1),
+      index3d<size_t>(in_size(), rank(), 1),
+      index3d<size_t>(rank(), out_size(), 1)};
+    if (has_bias()) shapes.push_back(index3d<size_t>(out_size(), 1, 1));
+    return shapes;
+  }
+
+  std::vector<index3d<size_t>> out_shape() const override {
+    return {index3d<size_t>(out_size(), 1, 1)};
+  }
+
+  std::string layer_type() const override {
+    return "low-rank-fully-connected";
+  }
+
+  uint64_t flops() const override {
+    return 2 * uint64_t(rank()) * (in_size() + out_size()) +
+           (has_bias() ? out_size() : 0);
+  }
+
+  // U is initialized as a layer in_dim -> rank, V as rank -> out_dim
+  size_t fan_in_size(size_t i) const override {
+    return i == 2 ? rank() : in_size();
+  }
+
+  size_t fan_out_size(size_t i) const override {
+    return i == 1 ? rank() : out_size();
+  }
+
+  size_t in_size() const { return params_u_.in_size_; }
+
+  size_t out_size() const { return params_v_.out_size_; }
+
+  size_t rank() const { return params_u_.out_size_; }
+
+  bool has_bias() const { return params_v_.has_bias_; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    hidden_.resize(in_data[0]->size(), vec_t(rank()));
+
+    // hidden = x * U
+    u_in_  = {in_data[0], in_data[1]};
+    u_out_ = {&hidden_};
+    fwd_ctx_u_.set_in_out(u_in_, u_out_);
+    fwd_ctx_u_.setEngine(layer::engine());
+    fwd_ctx_u_.setParallelize(layer::parallelize());
+    kernel_fwd_u_->run(fwd_ctx_u_);
+
+    // y = hidden * V + b
+    v_in_ = {&hidden_, in_data[2]};
+    if (has_bias()) v_in_.push_back(in_data[3]);
+    fwd_ctx_v_.set_in_out(v_in_, out_data);
+    fwd_ctx_v_.setEngine(layer::engine());
+    fwd_ctx_v_.setParallelize(layer::parallelize());
+    kernel_fwd_v_->run(fwd_ctx_v_);
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    hidden_grad_.resize(in_data[0]->size(), vec_t(rank()));
+
+    // dV, db and d(hidden) from dy
+    v_in_ = {&hidden_, in_data[2]};
+    if (has_bias()) v_in_.push_back(in_data[3]);
+    v_grad_ = {&hidden_grad_, in_grad[2]};
+    if (has_bias()) v_grad_.push_back(in_grad[3]);
+    bwd_ctx_v_.set_in_out(v_in_, out_data, out_grad, v_grad_);
+    bwd_ctx_v_.setEngine(layer::engine());
+    bwd_ctx_v_.setParallelize(layer::parallelize());
+    kernel_back_v_->run(bwd_ctx_v_);
+
+    // dU and dx from d(hidden)
+    u_in_         = {in_data[0], in_data[1]};
+    u_out_        = {&hidden_};
+    hidden_grads_ = {&hidden_grad_};
+    u_grad_       = {in_grad[0], in_grad[1]};
+    bwd_ctx_u_.set_in_out(u_in_, u_out_, hidden_grads_, u_grad_);
+    bwd_ctx_u_.setEngine(layer::engine());
+    bwd_ctx_u_.setParallelize(layer::parallelize());
+    kernel_back_u_->run(bwd_ctx_u_);
+  }
+
+ protected:
+  static std::vector<vector_type> input_order(bool has_bias) {
+    std::vector<vector_type> order = {vector_type::data, vector_type::weight,
+                                      vector_type::weight};
+    if (has_bias) order.push_back(vector_type::bias);
+    return order;
+  }
+
+  void set_params(size_t in_size,
+                  size_t out_size,
+                  size_t rank,
+                  bool has_bias) {
+    params_u_.in_size_  = in_size;
+    params_u_.out_size_ = rank;
+    params_u_.has_bias_ = false;
+    params_v_.in_size_  = rank;
+    params_v_.out_size_ = out_size;
+    params_v_.has_bias_ = has_bias;
+  }
+
+  void init_backend(core::backend_t backend_type) {
+    core::OpKernelConstruction ctx_u = core::OpKernelConstruction(&params_u_);
+    core::OpKernelConstruction ctx_v = core::OpKernelConstruction(&params_v_);
+
+    if (backend_type == core::backend_t::internal) {
+      kernel_fwd_u_.reset(new FullyConnectedOp(ctx_u));
+      kernel_fwd_v_.reset(new FullyConnectedOp(ctx_v));
+      kernel_back_u_.reset(new FullyConnectedGradOp(ctx_u));
+      kernel_back_v_.reset(new FullyConnectedGradOp(ctx_v));
+    } else {
+      throw "Not supported engine: ";
+    }
+  }
+
+ private:
+  /* The parameters of the two products */
+  core::fully_params params_u_;  // in -> rank, no bias
+  core::fully_params params_v_;  // rank -> out
+
+  /* op contexts */
+  core::OpKernelContext fwd_ctx_u_;
+  core::OpKernelContext fwd_ctx_v_;
+  core::OpKernelContext bwd_ctx_u_;
+  core::OpKernelContext bwd_ctx_v_;
+
+  /* Forward and backward ops */
+  std::shared_ptr<core::OpKernel> kernel_fwd_u_;
+  std::shared_ptr<core::OpKernel> kernel_fwd_v_;
+  std::shared_ptr<core::OpKernel> kernel_back_u_;
+  std::shared_ptr<core::OpKernel> kernel_back_v_;
+
+  /* x * U of the last forward pass and its gradient */
+  tensor_t hidden_;
+  tensor_t hidden_grad_;
+
+  /* edges bound to the contexts */
+  std::vector<tensor_t *> u_in_;
+  std::vector<tensor_t *> u_out_;
+  std::vector<tensor_t *> u_grad_;
+  std::vector<tensor_t *> v_in_;
+  std::vector<tensor_t *> v_grad_;
+  std::vector<tensor_t *> hidden_grads_;
+};
+
+}  // namespace litchi
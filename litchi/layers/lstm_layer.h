@@ -0,0 +1,140 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "litchi/layers/recurrent_layer.h"
+
+namespace litchi {
+
+/**
+ * @brief Long short-term memory layer.
+ *
+ *     i = sigmoid(x_t W_xi + h_{t-1} W_hi + b_i)
+ *     f = sigmoid(x_t W_xf + h_{t-1} W_hf + b_f)
+ *     g = tanh(x_t W_xg + h_{t-1} W_hg + b_g)
+ *     o = sigmoid(x_t W_xo + h_{t-1} W_ho + b_o)
+ *     c_t = f * c_{t-1} + i * g
+ *     h_t = o * tanh(c_t)
+ *
+ * The gates are concatenated in the order i, f, g, o along the columns of
+ * W_x, W_h and the bias. After the GEMM of a step, the nonlinearities run
+ * vectorized over whole gate blocks of H units, then a pass over the hidden
+ * units updates the cell. See
+ * recurrent_layer for the layout of the sequences.
+ */
+class lstm_layer : public recurrent_layer {
+ public:
+  /**
+   * @param in_size     [in] number of features of a step
+   * @param hidden_size [in] number of features of the hidden state
+   * @param seq_len     [in] number of steps of a sequence
+   */
+  lstm_layer(size_t in_size, size_t hidden_size, size_t seq_len)
+    : recurrent_layer(in_size, hidden_size, seq_len, 4) {}
+
+  std::string layer_type() const override { return "lstm"; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &x = *in_data[0];
+    const vec_t &Wx   = (*in_data[1])[0];
+    const vec_t &Wh   = (*in_data[2])[0];
+    const vec_t &b    = (*in_data[3])[0];
+    tensor_t &y       = *out_data[0];
+    const size_t H    = hidden_size();
+    const size_t T    = seq_len();
+
+    // the pre-activations of the gates, then their values
+    project_inputs(x, Wx, b, gates_);
+    cell_.resize(x.size() * T * H);
+
+    for (size_t t = 0; t < T; t++) {
+      if (t > 0) project_hidden(y, Wh, t, gates_);
+      for_i(parallelize_, x.size(), [&](size_t sample) {
+        float_t *g            = gate_row(gates_, sample, t);
+        float_t *c            = &cell_[(sample * T + t) * H];
+        const float_t *c_prev = t > 0 ? c - H : nullptr;
+        float_t *h            = &y[sample][t * H];
+        // i and f are adjacent: one call covers both
+        vectorize::sigmoid(g, 2 * H, g);
+        vectorize::tanh(g + 2 * H, H, g + 2 * H);
+        vectorize::sigmoid(g + 3 * H, H, g + 3 * H);
+        const float_t *i = g, *f = g + H, *u = g + 2 * H, *o = g + 3 * H;
+        for (size_t j = 0; j < H; j++) {
+          c[j] = i[j] * u[j] + (c_prev ? f[j] * c_prev[j] : float_t{0});
+        }
+        vectorize::tanh(c, H, h);
+        for (size_t j = 0; j < H; j++) h[j] *= o[j];
+      }, grainsize());
+    }
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    const tensor_t &x  = *in_data[0];
+    const vec_t &Wx    = (*in_data[1])[0];
+    const vec_t &Wh    = (*in_data[2])[0];
+    const tensor_t &y  = *out_data[0];
+    const tensor_t &dy = *out_grad[0];
+    tensor_t &dx       = *in_grad[0];
+    const size_t H     = hidden_size();
+    const size_t T     = seq_len();
+    const size_t batch = x.size();
+
+    // gradients of the pre-activations, and those flowing to h_{t-1} and
+    // c_{t-1}
+    dgates_.resize(batch * T * gate_size());
+    dh_.assign(batch * H, float_t{0});
+    dc_.assign(batch * H, float_t{0});
+
+    for (size_t t = T; t-- > 0;) {
+      for_i(parallelize_, batch, [&](size_t sample) {
+        const float_t *g      = gate_row(gates_, sample, t);
+        const float_t *c      = &cell_[(sample * T + t) * H];
+        const float_t *c_prev = t > 0 ? c - H : nullptr;
+        const float_t *dys    = &dy[sample][t * H];
+        float_t *dg           = gate_row(dgates_, sample, t);
+        float_t *dh           = &dh_[sample * H];
+        float_t *dc           = &dc_[sample * H];
+        // tanh(c_t) goes to the slot of do, read before being overwritten
+        vectorize::tanh(c, H, dg + 3 * H);
+        for (size_t j = 0; j < H; j++) {
+          const float_t i   = g[j];
+          const float_t f   = g[H + j];
+          const float_t u   = g[2 * H + j];
+          const float_t o   = g[3 * H + j];
+          const float_t tc  = dg[3 * H + j];
+          const float_t dhj = dys[j] + dh[j];
+          const float_t dcj = dc[j] + dhj * o * (float_t(1) - tc * tc);
+          const float_t cp  = c_prev ? c_prev[j] : float_t{0};
+          dg[j]             = dcj * u * i * (float_t(1) - i);
+          dg[H + j]         = dcj * cp * f * (float_t(1) - f);
+          dg[2 * H + j]     = dcj * i * (float_t(1) - u * u);
+          dg[3 * H + j]     = dhj * tc * o * (float_t(1) - o);
+          dc[j]             = dcj * f;
+          dh[j]             = float_t{0};
+        }
+      }, grainsize());
+      if (t > 0) backpropagate_hidden(Wh, dgates_, batch, t, dh_);
+    }
+
+    fill_tensor(dx, float_t{0});
+    input_gradients(x, Wx, dgates_, dx, (*in_grad[1])[0], (*in_grad[3])[0]);
+    recurrent_weight_gradient(y, dgates_, (*in_grad[2])[0]);
+  }
+
+ private:
+  /* gates and cell states of every step of the last forward pass */
+  vec_t gates_;
+  vec_t cell_;
+
+  /* buffers of the backward pass, reused across steps */
+  vec_t dgates_;
+  vec_t dh_;
+  vec_t dc_;
+};
+
+}  // namespace litchi
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+
+#include "litchi/core/kernels/maxpool_grad_op.h"
+#include "litchi/core/kernels/maxpool_op.h"
+
+namespace litchi {
+
+/**
+ * applies max-pooling operation to the spatial data
+ *
+ * The position of each maximum is kept as its offset within the pooling
+ * window, one byte per output for windows of up to 256 elements and two
+ * bytes otherwise, for the backward pass.
+ */
+class max_pooling_layer : public layer {
+ public:
+  /**
+   * @param in_width       [in] width of input image
+   * @param in_height      [in] height of input image
+   * @param in_channels    [in] the number of input image channels(depth)
+   * @param pooling_size   [in] factor by which to downscale, used as both
+   *                            the window size and the stride
+   */
+  max_pooling_layer(size_t in_width,
+                    size_t in_height,
+                    size_t in_channels,
+                    size_t pooling_size,
+                    core::backend_t backend_type = core::default_engine())
+    : max_pooling_layer(in_width,
+                        in_height,
+                        in_channels,
+                        pooling_size,
+                        pooling_size,
+                        pooling_size,
+                        pooling_size,
+                        backend_type) {}
+
+  /**
+   * @param in_width       [in] width of input image
+   * @param in_height      [in] height of input image
+   * @param in_channels    [in] the number of input image channels(depth)
+   * @param pooling_size_x [in] width of the pooling window
+   * @param pooling_size_y [in] height of the pooling window
+   * @param stride_x       [in] horizontal interval between the windows
+   * @param stride_y       [in] vertical interval between the windows
+   */
+  max_pooling_layer(size_t in_width,
+                    size_t in_height,
+                    size_t in_channels,
+                    size_t pooling_size_x,
+                    size_t pooling_size_y,
+                    size_t stride_x,
+                    size_t stride_y,
+                    core::backend_t backend_type = core::default_engine())
+    : layer({vector_type::data}, {vector_type::data}) {
+    set_params(shape3d(in_width, in_height, in_channels), pooling_size_x,
+               pooling_size_y, stride_x, stride_y);
+    init_backend(backend_type);
+    layer::set_backend_type(backend_type);
+  }
+
+  std::vector<index3d<size_t>> in_shape() const override {
+    return {params_.in};
+  }
+
+  std::vector<index3d<size_t>> out_shape() const override {
+    return {params_.out};
+  }
+
+  std::string layer_type() const override { return "max-pool"; }
+
+  uint64_t flops() const override {
+    return uint64_t(params_.out.size()) * params_.window_area();
+  }
+
+  const core::pooling_params &params() const { return params_; }
+
+  // channel-last pooling vectorizes across the channels of an output
+  bool supports_layout(data_layout) const override { return true; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    // forward max pooling op context
+    fwd_ctx_.set_in_out(in_data, out_data);
+    fwd_ctx_.setEngine(layer::engine());
+    fwd_ctx_.setParallelize(layer::parallelize());
+
+    // launch max pooling kernel
+    kernel_fwd_->run(fwd_ctx_);
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    // backward max pooling op context
+    bwd_ctx_.set_in_out(in_data, out_data, out_grad, in_grad);
+    bwd_ctx_.setEngine(layer::engine());
+    bwd_ctx_.setParallelize(layer::parallelize());
+
+    // launch max pooling kernel
+    kernel_back_->run(bwd_ctx_);
+  }
+
+ protected:
+  void apply_layout(data_layout layout) override {
+    params_.in.layout_  = layout;
+    params_.out.layout_ = layout;
+  }
+
+  void set_params(const shape3d &in,
+                  size_t pooling_size_x,
+                  size_t pooling_size_y,
+                  size_t stride_x,
+                  size_t stride_y) {
+    if (pooling_size_x == 0 || pooling_size_y == 0 || stride_x == 0 ||
+        stride_y == 0) {
+      throw "pooling size and stride must be positive";
+    }
+    if (in.width_ < pooling_size_x || in.height_ < pooling_size_y) {
+      throw "pooling window larger than the input";
+    }
+    if (pooling_size_x * pooling_size_y > 65536) {
+      throw "pooling window too large";
+    }
+
+    params_.in          = in;
+    params_.out         = shape3d((in.width_ - pooling_size_x) / stride_x + 1,
+                                  (in.height_ - pooling_size_y) / stride_y + 1,
+                                  in.depth_);
+    params_.pool_size_x = pooling_size_x;
+    params_.pool_size_y = pooling_size_y;
+    params_.stride_x    = stride_x;
+    params_.stride_y    = stride_y;
+  }
+
+  void init_backend(core::backend_t backend_type) {
+    core::OpKernelConstruction ctx = core::OpKernelConstruction(&params_);
+
+    if (backend_type == core::backend_t::internal) {
+      kernel_fwd_.reset(new MaxPoolOp(ctx));
+      kernel_back_.reset(new MaxPoolGradOp(ctx));
+    } else {
+      throw "Not supported engine: ";
+    }
+  }
+
+ private:
+  /* The layer parameters */
+  core::pooling_params params_;
+
+  /* forward op context */
+  core::OpKernelContext fwd_ctx_;
+
+  /* backward op context */
+  core::OpKernelContext bwd_ctx_;
+
+  /* Forward and backward ops */
+  std::shared_ptr<core::OpKernel> kernel_fwd_;
+  std::shared_ptr<core::OpKernel> kernel_back_;
+};
+
+}  // namespace litchi
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "litchi/core/framework/workspace.h"
+#include "litchi/core/kernels/gemm.h"
+#include "litchi/layers/layer.h"
+#include "litchi/util/parallel_for.h"
+
+namespace litchi {
+
+/**
+ * @brief Base of lstm_layer and gru_layer: shapes, weights and the GEMMs of
+ * a recurrent layer.
+ *
+ * A sample is a sequence of seq_len steps of in_size features, stored step
+ * after step (x_t = x[t * in_size...]). The output is the hidden state of
+ * every step, h_t = y[t * hidden_size...], the initial state being zero.
+ *
+ * inputs:  (0) data, (1) W_x of in_size x gates * hidden_size,
+ *          (2) W_h of hidden_size x gates * hidden_size, (3) bias
+ * output:  (0) hidden states
+ *
+ * The projections of the gates are concatenated along the columns of W_x
+ * and W_h, so that one GEMM computes all the gates. The input projection of
+ * every step of every sample is a single GEMM of batch * seq_len rows run
+ * before the recurrence, leaving only h_{t-1} * W_h per step. Likewise,
+ * backpropagation through time only runs the product by W_h^T per step:
+ * the gradients of W_x, W_h, the bias and the input are computed for the
+ * whole sequence at once afterwards. The weight gradients of the batch are
+ * accumulated in the first sample of their gradient tensors.
+ */
+class recurrent_layer : public layer {
+ public:
+  /**
+   * @param in_size     [in] number of features of a step
+   * @param hidden_size [in] number of features of the hidden state
+   * @param seq_len     [in] number of steps of a sequence
+   * @param gates       [in] number of gate projections of the cell
+   */
+  recurrent_layer(size_t in_size,
+                  size_t hidden_size,
+                  size_t seq_len,
+                  size_t gates)
+    : layer({vector_type::data, vector_type::weight, vector_type::weight,
+             vector_type::bias},
+            {vector_type::data}),
+      in_size_(in_size),
+      hidden_size_(hidden_size),
+      seq_len_(seq_len),
+      gate_count_(gates) {
+    if (in_size == 0 || hidden_size == 0 || seq_len == 0) {
+      throw "Recurrent layer dimensions must be positive";
+    }
+  }
+
+  std::vector<index3d<size_t>> in_shape() const override {
+    return {index3d<size_t>(in_size_, seq_len_, 1),
+            index3d<size_t>(in_size_, gate_size(), 1),
+            index3d<size_t>(hidden_size_, gate_size(), 1),
+            index3d<size_t>(gate_size(), 1, 1)};
+  }
+
+  std::vector<index3d<size_t>> out_shape() const override {
+    return {index3d<size_t>(hidden_size_, seq_len_, 1)};
+  }
+
+  uint64_t flops() const override {
+    return uint64_t(seq_len_) * gate_size() *
+           (2 * (in_size_ + hidden_size_) + 1);
+  }
+
+  // W_x is initialized as a layer in_size -> gates, W_h as hidden -> gates
+  size_t fan_in_size(size_t i) const override {
+    return i == 2 ? hidden_size_ : in_size_;
+  }
+
+  size_t fan_out_size(size_t) const override { return gate_size(); }
+
+  size_t in_size() const { return in_size_; }
+
+  size_t hidden_size() const { return hidden_size_; }
+
+  size_t seq_len() const { return seq_len_; }
+
+ protected:
+  /** columns of the concatenated gate projections */
+  size_t gate_size() const { return gate_count_ * hidden_size_; }
+
+  // minimum number of samples per task of the elementwise passes
+  size_t grainsize() const {
+    return std::max<size_t>(1, (size_t(1) << 14) / gate_size());
+  }
+
+  /** gates of step t of a sample in a batch * seq_len x gate_size buffer */
+  float_t *gate_row(vec_t &buffer, size_t sample, size_t t) const {
+    return &buffer[(sample * seq_len_ + t) * gate_size()];
+  }
+
+  /**
+   * C[M x N] += A[M x K] * B[K x N], the operands being given by pointers to
+   * the rows of their storage: a(i), or a(k) when A is stored transposed,
+   * b(k), or b(j) when B is stored transposed, and c(i)
+   */
+  template <typename ARow, typename BRow, typename CRow>
+  void matmul(size_t M,
+              size_t N,
+              size_t K,
+              const ARow &a,
+              bool a_transposed,
+              const BRow &b,
+              bool b_transposed,
+              const CRow &c) {
+    kernels::gemm(
+      M, N, K,
+      [&](size_t i0, size_t k0, size_t mc, size_t kc, float_t *dst) {
+        if (a_transposed) {
+          kernels::gemm_pack_a_cols(a, i0, k0, mc, kc, dst);
+        } else {
+          kernels::gemm_pack_a_rows(a, i0, k0, mc, kc, dst);
+        }
+      },
+      [&](size_t k0, size_t j0, size_t kc, size_t nc, float_t *dst) {
+        if (b_transposed) {
+          kernels::gemm_pack_b_cols(b, k0, j0, kc, nc, dst);
+        } else {
+          kernels::gemm_pack_b_rows(b, k0, j0, kc, nc, dst);
+        }
+      },
+      [&](size_t i, size_t j, const float_t *values, size_t n) {
+        vectorize::reduce(values, n, c(i) + j);
+      },
+      parallelize_, kernels::gemm_config(), &scratch_);
+  }
+
+  /**
+   * pre = bias + x_t * W_x for every step of every sample, in one GEMM
+   */
+  void project_inputs(const tensor_t &x,
+                      const vec_t &Wx,
+                      const vec_t &bias,
+                      vec_t &pre) {
+    const size_t rows = x.size() * seq_len_;
+    const size_t G    = gate_size();
+    pre.resize(rows * G);
+    for (size_t i = 0; i < rows; i++) {
+      std::copy(bias.begin(), bias.begin() + G, pre.begin() + i * G);
+    }
+    matmul(
+      rows, G, in_size_,
+      [&](size_t i) { return &x[i / seq_len_][(i % seq_len_) * in_size_]; },
+      false, [&](size_t k) { return &Wx[k * G]; }, false,
+      [&](size_t i) { return &pre[i * G]; });
+  }
+
+  /**
+   * out(t) += h_{t-1} * W_h for every sample, h being the output
+   */
+  void project_hidden(const tensor_t &y,
+                      const vec_t &Wh,
+                      size_t t,
+                      vec_t &out) {
+    const size_t G = gate_size();
+    matmul(
+      y.size(), G, hidden_size_,
+      [&](size_t s) { return &y[s][(t - 1) * hidden_size_]; }, false,
+      [&](size_t k) { return &Wh[k * G]; }, false,
+      [&](size_t s) { return gate_row(out, s, t); });
+  }
+
+  /**
+   * dh += dgates(t) * W_h^T for every sample, dh being batch x hidden_size
+   */
+  void backpropagate_hidden(const vec_t &Wh,
+                            vec_t &dgates,
+                            size_t batch,
+                            size_t t,
+                            vec_t &dh) {
+    const size_t G = gate_size();
+    matmul(
+      batch, hidden_size_, G,
+      [&](size_t s) { return gate_row(dgates, s, t); }, false,
+      [&](size_t j) { return &Wh[j * G]; }, true,
+      [&](size_t s) { return &dh[s * hidden_size_]; });
+  }
+
+  /**
+   * dx += dgates * W_x^T, dW_x += x^T * dgates and db += dgates over every
+   * step of every sample
+   */
+  void input_gradients(const tensor_t &x,
+                       const vec_t &Wx,
+                       const vec_t &dgates,
+                       tensor_t &dx,
+                       vec_t &dWx,
+                       vec_t &db) {
+    const size_t rows = x.size() * seq_len_;
+    const size_t G    = gate_size();
+    auto x_row        = [&](size_t i) {
+      return &x[i / seq_len_][(i % seq_len_) * in_size_];
+    };
+    auto dgates_row = [&](size_t i) { return &dgates[i * G]; };
+
+    matmul(
+      rows, in_size_, G, dgates_row, false,
+      [&](size_t j) { return &Wx[j * G]; }, true,
+      [&](size_t i) { return &dx[i / seq_len_][(i % seq_len_) * in_size_]; });
+    matmul(in_size_, G, rows, x_row, true, dgates_row, false,
+           [&](size_t i) { return &dWx[i * G]; });
+    for (size_t i = 0; i < rows; i++) {
+      vectorize::reduce(dgates_row(i), G, &db[0]);
+    }
+  }
+
+  /**
+   * dW_h += h_{t-1}^T * dgates(t) summed over the steps t >= 1 of every
+   * sample, in one GEMM
+   */
+  void recurrent_weight_gradient(const tensor_t &y,
+                                 const vec_t &dgates,
+                                 vec_t &dWh) {
+    if (seq_len_ < 2) return;
+    const size_t steps = seq_len_ - 1;
+    const size_t G     = gate_size();
+    matmul(
+      hidden_size_, G, y.size() * steps,
+      [&](size_t k) { return &y[k / steps][(k % steps) * hidden_size_]; },
+      true,
+      [&](size_t k) {
+        return &dgates[((k / steps) * seq_len_ + k % steps + 1) * G];
+      },
+      false, [&](size_t i) { return &dWh[i * G]; });
+  }
+
+ private:
+  size_t in_size_;
+  size_t hidden_size_;
+  size_t seq_len_;
+  size_t gate_count_;
+
+  /* packed panels of the GEMMs, kept across steps and passes */
+  core::workspace scratch_;
+};
+
+}  // namespace litchi
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+#include "litchi/util/parallel_for.h"
+
+namespace litchi {
+
+/**
+ * Fused softmax + cross-entropy loss for classification heads.
+ *
+ * inputs:  (0) logits x of size classes, (1) label holding the index of the
+ *          target class
+ * output:  (0) loss of each sample, -log(softmax(x)[label])
+ *
+ * The forward pass computes loss = logsumexp(x) - x[label] with a SIMD max
+ * reduction and a vectorized exp-sum, and only keeps logsumexp(x) per
+ * sample. The backward pass writes dx = dy * (softmax(x) - onehot(label))
+ * in one vectorized pass, so the probabilities are never materialized.
+ */
+class softmax_cross_entropy_layer : public layer {
+ public:
+  /**
+   * @param classes [in] number of classes (size of the logits)
+   */
+  explicit softmax_cross_entropy_layer(size_t classes)
+    : layer({vector_type::data, vector_type::label}, {vector_type::data}),
+      classes_(classes) {
+    if (classes == 0) throw "Number of classes must be positive";
+  }
+
+  std::vector<shape3d> in_shape() const override {
+    return {shape3d(classes_, 1, 1), shape3d(1, 1, 1)};
+  }
+
+  std::vector<shape3d> out_shape() const override {
+    return {shape3d(1, 1, 1)};
+  }
+
+  std::string layer_type() const override { return "softmax-cross-entropy"; }
+
+  uint64_t flops() const override { return 4 * uint64_t(classes_); }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &x     = *in_data[0];
+    const tensor_t &label = *in_data[1];
+    tensor_t &loss        = *out_data[0];
+
+    if (log_sum_exp_.size() < x.size()) log_sum_exp_.resize(x.size());
+    decode_targets(label);
+
+    for_i(parallelize_, x.size(), [&](size_t sample) {
+      const float_t *logits = &x[sample][0];
+      const float_t m       = vectorize::max_value(logits, classes_);
+      const float_t lse =
+        m + std::log(vectorize::exp_sum(logits, classes_, m));
+      log_sum_exp_[sample] = lse;
+      loss[sample][0]      = lse - logits[targets_[sample]];
+    }, grainsize());
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    const tensor_t &x     = *in_data[0];
+    const tensor_t &label = *in_data[1];
+    const tensor_t &dy    = *out_grad[0];
+    tensor_t &dx          = *in_grad[0];
+    decode_targets(label);
+
+    for_i(parallelize_, x.size(), [&](size_t sample) {
+      const float_t scale = dy[sample][0];
+      // dx = dy * exp(x - logsumexp(x)) - dy * onehot(label)
+      vectorize::exp_scale(&x[sample][0], classes_, log_sum_exp_[sample],
+                           scale, &dx[sample][0]);
+      dx[sample][targets_[sample]] -= scale;
+    }, grainsize());
+
+    // labels are not differentiable
+    fill_tensor(*in_grad[1], float_t{0});
+  }
+
+  size_t classes() const { return classes_; }
+
+ private:
+  // checks the labels before the parallel loops index the logits with them
+  void decode_targets(const tensor_t &label) {
+    targets_.resize(label.size());
+    for (size_t sample = 0; sample < label.size(); sample++) {
+      const float_t t = label[sample][0];
+      // written to reject NaN as well
+      if (!(t >= 0 && t < float_t(classes_))) throw "Label out of range";
+      targets_[sample] = static_cast<size_t>(t);
+    }
+  }
+
+  size_t grainsize() const {
+    const size_t work = std::max<size_t>(classes_, 1);
+    return std::max<size_t>(1, (size_t(1) << 14) / work);
+  }
+
+  size_t classes_;
+  /** logsumexp(x) of every sample of the last forward pass */
+  std::vector<float_t> log_sum_exp_;
+  /** class index of every sample, decoded from the labels */
+  std::vector<size_t> targets_;
+};
+
+}  // namespace litchi
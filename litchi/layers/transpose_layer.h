@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "litchi/core/kernels/transpose.h"
+#include "litchi/layers/layer.h"
+#include "litchi/util/parallel_for.h"
+
+namespace litchi {
+
+/**
+ * @brief Converts spatial data between the channel-major and the
+ * channel-last layouts; the gradient is converted back.
+ *
+ * Inserted by optimize_layouts() wherever neighbouring layers disagree on
+ * the layout of the data they exchange.
+ */
+class transpose_layer : public layer {
+ public:
+  /**
+   * @param in [in] shape and layout of the input
+   * @param to [in] layout of the output
+   */
+  transpose_layer(const shape3d &in, data_layout to)
+    : layer({vector_type::data}, {vector_type::data}),
+      in_(in),
+      out_(in.with_layout(to)) {}
+
+  std::vector<index3d<size_t>> in_shape() const override { return {in_}; }
+
+  std::vector<index3d<size_t>> out_shape() const override { return {out_}; }
+
+  std::string layer_type() const override { return "transpose"; }
+
+  uint64_t flops() const override { return 0; }
+
+  bool supports_layout(data_layout layout) const override {
+    return layout == in_.layout_;
+  }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &x = *in_data[0];
+    tensor_t &y       = *out_data[0];
+    for_i(parallelize_, x.size(), [&](size_t s) {
+      kernels::convert_layout(&x[s][0], in_, out_.layout_, &y[s][0]);
+    });
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    const tensor_t &dy = *out_grad[0];
+    tensor_t &dx       = *in_grad[0];
+    for_i(parallelize_, dy.size(), [&](size_t s) {
+      kernels::convert_layout(&dy[s][0], out_, in_.layout_, &dx[s][0]);
+    });
+  }
+
+ private:
+  shape3d in_;
+  shape3d out_;
+};
+
+}  // namespace litchi
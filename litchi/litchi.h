@@ -1,16 +1,52 @@
 #pragma once
 
+#include "litchi/activations/identity_layer.h"
 #include "litchi/activations/relu_layer.h"
+#include "litchi/activations/sigmoid_layer.h"
+#include "litchi/layers/average_pooling_layer.h"
+#include "litchi/layers/batch_normalization_layer.h"
+#include "litchi/layers/concat_layer.h"
+#include "litchi/layers/convolutional_layer.h"
+#include "litchi/layers/dropout_layer.h"
+#include "litchi/layers/embedding_layer.h"
 #include "litchi/layers/fully_connected_layer.h"
+#include "litchi/layers/gru_layer.h"
+#include "litchi/layers/low_rank_fully_connected_layer.h"
+#include "litchi/layers/lstm_layer.h"
+#include "litchi/layers/max_pooling_layer.h"
+#include "litchi/layers/softmax_cross_entropy_layer.h"
+#include "litchi/layers/transpose_layer.h"
 
+#include "litchi/io/data_loader.h"
+#include "litchi/io/dataset.h"
+
+#include "litchi/network/async_network.h"
+#include "litchi/network/checkpoint.h"
+#include "litchi/network/execution_plan.h"
+#include "litchi/network/graph_executor.h"
+#include "litchi/network/graph_optimizer.h"
+#include "litchi/network/layout_optimizer.h"
+#include "litchi/network/low_rank_compression.h"
+#include "litchi/network/memory_report.h"
+#include "litchi/network/sequential.h"
+#include "litchi/network/streaming.h"
+
+#include "litchi/util/kernel_profiler.h"
+#include "litchi/util/numa.h"
+#include "litchi/util/perf_counters.h"
 #include "litchi/util/product.h"
+#include "litchi/util/svd.h"
+#include "litchi/util/thread_pool.h"
+#include "litchi/util/tracer.h"
 
 // shortcut version of layer names
 namespace litchi {
 
 namespace activation {
 
-using relu = litchi::relu_layer;
+using identity = litchi::identity_layer;
+using relu     = litchi::relu_layer;
+using sigmoid  = litchi::sigmoid_layer;
 
 } // namespace activation
 
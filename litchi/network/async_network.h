@@ -0,0 +1,283 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <coroutine>
+#define CNN_HAS_COROUTINES
+#endif
+
+#include "litchi/network/sequential.h"
+#include "litchi/util/thread_pool.h"
+
+namespace litchi {
+
+enum class inference_status { queued, running, done, failed, cancelled };
+
+/**
+ * called once an inference finished: output is the result, or nullptr
+ * when the inference failed (error is set) or was cancelled (error is
+ * null)
+ */
+typedef std::function<void(const tensor_t *output, std::exception_ptr error)>
+  inference_callback;
+
+namespace detail {
+
+struct inference_request {
+  tensor_t input;
+  inference_callback callback;
+  std::promise<tensor_t> promise;
+  std::atomic<inference_status> status{inference_status::queued};
+
+  /** continuations of the coroutines awaiting the result */
+  std::mutex mutex;
+  bool finished = false;
+  std::vector<std::function<void()>> waiters;
+
+  // runs the callback, then publishes the outcome and resumes the waiters
+  void finish(inference_status outcome,
+              const tensor_t *output,
+              std::exception_ptr error) {
+    if (callback) callback(output, error);
+    status = outcome;
+    if (output) {
+      promise.set_value(*output);
+    } else {
+      promise.set_exception(error ? error : std::make_exception_ptr(
+                                              "Inference cancelled"));
+    }
+
+    std::vector<std::function<void()>> resume;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      finished = true;
+      resume.swap(waiters);
+    }
+    for (auto &w : resume) w();
+  }
+};
+
+}  // namespace detail
+
+/**
+ * @brief Inference submitted to an async_network.
+ *
+ * get() blocks for the output and rethrows the error of the inference. A
+ * cancelled inference throws "Inference cancelled".
+ */
+class inference_handle {
+ public:
+  inference_handle() {}
+
+  explicit inference_handle(std::shared_ptr<detail::inference_request> r)
+    : request_(std::move(r)), future_(request_->promise.get_future()) {}
+
+  bool valid() const { return request_ != nullptr; }
+
+  inference_status status() const { return request_->status; }
+
+  /**
+   * Cancels the inference if it has not started yet, in which case its
+   * callback runs on the calling thread. Returns false once it is running
+   * or finished.
+   */
+  bool cancel() {
+    inference_status expected = inference_status::queued;
+    if (!request_->status.compare_exchange_strong(
+          expected, inference_status::cancelled)) {
+      return false;
+    }
+    request_->finish(inference_status::cancelled, nullptr, nullptr);
+    return true;
+  }
+
+  void wait() const { future_.wait(); }
+
+  const tensor_t &get() const { return future_.get(); }
+
+  std::shared_future<tensor_t> future() const { return future_; }
+
+#ifdef CNN_HAS_COROUTINES
+  /**
+   * co_await handle resumes the coroutine on the thread finishing the
+   * inference (a worker of the pool, or the cancelling thread) and yields
+   * its output, or rethrows its error
+   */
+  auto operator co_await() const {
+    struct awaiter {
+      const inference_handle &handle;
+
+      bool await_ready() const {
+        return handle.future_.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready;
+      }
+
+      bool await_suspend(std::coroutine_handle<> coroutine) const {
+        detail::inference_request &r = *handle.request_;
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (r.finished) return false;
+        r.waiters.push_back([coroutine]() { coroutine.resume(); });
+        return true;
+      }
+
+      const tensor_t &await_resume() const { return handle.get(); }
+    };
+    return awaiter{*this};
+  }
+#endif
+
+ private:
+  std::shared_ptr<detail::inference_request> request_;
+  std::shared_future<tensor_t> future_;
+};
+
+/**
+ * @brief Runs the inferences of a network on the workers of a
+ * work_stealing_pool.
+ *
+ * submit() queues a batch and returns at once, so the caller can prepare
+ * the next request while the network computes. Inferences run one at a
+ * time in submission order, each a task of the pool whose kernels spread
+ * their parallel loops over the workers of that pool. The network must
+ * not be used directly while the async_network is alive.
+ */
+class async_network {
+ public:
+  /**
+   * @param threads [in] workers of the pool owned by the network
+   */
+  explicit async_network(sequential &net,
+                         size_t threads = parallel_concurrency())
+    : net_(net),
+      own_pool_(new work_stealing_pool(threads)),
+      pool_(*own_pool_) {}
+
+  /**
+   * runs the inferences on pool, shared with other work; the
+   * async_network must be destroyed before the pool, and not from one of
+   * its tasks
+   */
+  async_network(sequential &net, work_stealing_pool &pool)
+    : net_(net), pool_(pool) {}
+
+  /**
+   * cancels the queued inferences, waits for the running one
+   */
+  ~async_network() {
+    cancel_all();
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return !running_; });
+  }
+
+  async_network(const async_network &) = delete;
+  async_network &operator=(const async_network &) = delete;
+
+  /**
+   * @param input    [in] batch of samples fed to the first layer
+   * @param callback [in] called on a worker of the pool when the
+   *                      inference finishes, or on the cancelling thread,
+   *                      before the future becomes ready; it must not
+   *                      throw
+   */
+  inference_handle submit(tensor_t input,
+                          inference_callback callback = nullptr) {
+    auto request      = std::make_shared<detail::inference_request>();
+    request->input    = std::move(input);
+    request->callback = std::move(callback);
+    inference_handle handle(request);
+    bool start = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(request));
+      start    = !running_;
+      running_ = true;
+    }
+    if (start) pool_.submit([this]() { step(); });
+    return handle;
+  }
+
+  /**
+   * cancels every queued inference, returns how many were cancelled
+   */
+  size_t cancel_all() {
+    std::deque<std::shared_ptr<detail::inference_request>> queued;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queued.swap(queue_);
+    }
+    size_t cancelled = 0;
+    for (auto &request : queued) {
+      inference_status expected = inference_status::queued;
+      if (request->status.compare_exchange_strong(
+            expected, inference_status::cancelled)) {
+        request->finish(inference_status::cancelled, nullptr, nullptr);
+        cancelled++;
+      }
+    }
+    return cancelled;
+  }
+
+  /** number of inferences waiting for their turn */
+  size_t queued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
+ private:
+  // runs the oldest queued inference, then hands the next one to the pool:
+  // a worker is only held for one inference at a time
+  void step() {
+    std::shared_ptr<detail::inference_request> request;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (queue_.empty()) {
+        running_ = false;
+        // under the lock: the destructor may return as soon as it is
+        // released
+        idle_.notify_all();
+        return;
+      }
+      request = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    // skips the requests cancelled through their handle
+    inference_status expected = inference_status::queued;
+    if (request->status.compare_exchange_strong(expected,
+                                                inference_status::running)) {
+      const tensor_t *output = nullptr;
+      std::exception_ptr error;
+      try {
+        output = &net_.forward(request->input);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      request->finish(
+        error ? inference_status::failed : inference_status::done, output,
+        error);
+    }
+    pool_.submit([this]() { step(); });
+  }
+
+  sequential &net_;
+  std::unique_ptr<work_stealing_pool> own_pool_;
+  work_stealing_pool &pool_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable idle_;
+  std::deque<std::shared_ptr<detail::inference_request>> queue_;
+  // a step() is queued or running on the pool
+  bool running_ = false;
+};
+
+}  // namespace litchi
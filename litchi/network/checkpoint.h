@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+
+namespace litchi {
+
+/**
+ * memory and compute of a checkpointing plan for one training step
+ */
+struct checkpoint_report {
+  size_t layers      = 0;
+  size_t checkpoints = 0;  // layers whose output is kept, the last excluded
+  /** most layers recomputed at once, i.e. the longest segment */
+  size_t longest_segment = 0;
+  /** bytes of the layer outputs kept without checkpointing */
+  uint64_t activation_bytes = 0;
+  /**
+   * estimated high-water mark of the layer outputs with checkpointing: the
+   * kept outputs plus the longest segment being rematerialized
+   */
+  uint64_t activation_bytes_peak = 0;
+  /** FLOPs of the forward pass, and extra FLOPs spent recomputing */
+  uint64_t forward_flops   = 0;
+  uint64_t recompute_flops = 0;
+};
+
+/**
+ * Checkpoints every ceil(sqrt(n))-th layer of a chain of n layers, which
+ * keeps O(sqrt(n)) outputs resident for at most one extra forward pass.
+ */
+inline std::vector<bool> sqrt_checkpoints(size_t layers) {
+  std::vector<bool> checkpoints(layers, false);
+  if (layers < 3) return checkpoints;
+  const size_t segment =
+    static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(layers))));
+  for (size_t i = segment - 1; i + 1 < layers; i += segment) {
+    checkpoints[i] = true;
+  }
+  return checkpoints;
+}
+
+/**
+ * @brief Cost of a checkpointing plan on a chain of layers.
+ *
+ * @param checkpoints whether the output of each layer is kept; the output
+ *                    of the last layer always is
+ * @param batch_size  samples per step
+ */
+inline checkpoint_report plan_checkpoints(
+  const std::vector<std::shared_ptr<layer>> &layers,
+  const std::vector<bool> &checkpoints,
+  size_t batch_size) {
+  checkpoint_report report;
+  report.layers = layers.size();
+
+  uint64_t kept = 0, segment = 0, largest_segment = 0;
+  size_t segment_layers = 0;
+  for (size_t i = 0; i < layers.size(); i++) {
+    uint64_t bytes = 0;
+    for (const shape3d &shape : layers[i]->out_shape()) {
+      bytes += uint64_t(batch_size) * shape.size() * sizeof(float_t);
+    }
+    const uint64_t flops = uint64_t(batch_size) * layers[i]->flops();
+    report.activation_bytes += bytes;
+    report.forward_flops += flops;
+
+    if (i + 1 == layers.size() || checkpoints[i]) {
+      if (i + 1 < layers.size()) report.checkpoints++;
+      kept += bytes;
+      segment = segment_layers = 0;
+    } else {
+      report.recompute_flops += flops;
+      segment += bytes;
+      segment_layers++;
+      largest_segment        = std::max(largest_segment, segment);
+      report.longest_segment = std::max(report.longest_segment,
+                                        segment_layers);
+    }
+  }
+  // a dropped output only coexists with outputs of its own segment, during
+  // the forward pass as well as during its rematerialization
+  report.activation_bytes_peak = kept + largest_segment;
+  return report;
+}
+
+}  // namespace litchi
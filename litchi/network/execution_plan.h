@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "litchi/network/sequential.h"
+
+namespace litchi {
+
+/**
+ * @brief Forward pass of a sequential resolved once into a flat tape of
+ * instructions.
+ *
+ * layer::forward() looks up the edges of a layer, resizes them to the
+ * batch, clears the gradients and traces the call before it reaches
+ * forward_propagation(), every time. compile_network() does this once for
+ * a fixed batch size and records, for every layer, the tensors it reads
+ * and writes: the tape is the list of the layers with their resolved
+ * buffers. run() then walks it, calling forward_propagation() of every
+ * layer: no edge lookup, no resize and no shape check. A serial network
+ * allocates nothing during run(); parallel loops still allocate the
+ * bookkeeping of their threads.
+ *
+ * The plan borrows the buffers of the network: it must be compiled again
+ * once the network changed (layers, layouts, phase affecting the shapes)
+ * or after the network itself ran on another batch size, which run()
+ * detects from the size of the input and output buffers. Running the
+ * network and the plan in turn on the compiled batch size is fine.
+ */
+class execution_plan {
+ public:
+  struct instruction {
+    layer *target;
+    std::vector<tensor_t *> in_data;
+    std::vector<tensor_t *> out_data;
+  };
+
+  size_t batch_size() const { return batch_size_; }
+
+  const std::vector<instruction> &instructions() const { return tape_; }
+
+  /**
+   * the input buffer of the first layer: batch_size() samples, filled in
+   * place before run()
+   */
+  tensor_t &input() { return *input_; }
+
+  const tensor_t &output() const { return *output_; }
+
+  /**
+   * runs the tape on the samples already in input()
+   */
+  const tensor_t &run() {
+    check_buffers();
+    for (instruction &i : tape_) {
+      i.target->forward_propagation(i.in_data, i.out_data);
+    }
+    return *output_;
+  }
+
+  /**
+   * copies input into input() and runs the tape
+   *
+   * @param input [in] batch_size() samples of the size of the network
+   *                   input
+   */
+  const tensor_t &run(const tensor_t &input) {
+    if (input.size() != batch_size_) {
+      throw "Batch size differs from the compiled one";
+    }
+    check_buffers();
+    for (size_t s = 0; s < input.size(); s++) {
+      if (input[s].size() != (*input_)[s].size()) {
+        throw "Sample size does not match the network input";
+      }
+      std::copy(input[s].begin(), input[s].end(), (*input_)[s].begin());
+    }
+    return run();
+  }
+
+ private:
+  // the network resizes the borrowed buffers when it runs on another batch
+  void check_buffers() const {
+    if (input_->size() != batch_size_ || output_->size() != batch_size_) {
+      throw "Network ran on another batch size, compile it again";
+    }
+  }
+
+  friend execution_plan compile_network(sequential &net, size_t batch_size);
+
+  size_t batch_size_ = 0;
+  std::vector<instruction> tape_;
+  tensor_t *input_  = nullptr;
+  tensor_t *output_ = nullptr;
+};
+
+/**
+ * @brief Resolves the forward pass of net on batch_size samples into an
+ * execution_plan.
+ *
+ * The network runs once on a zero batch to allocate its edges and the
+ * workspaces of its kernels; its output is overwritten.
+ */
+inline execution_plan compile_network(sequential &net, size_t batch_size) {
+  if (net.empty()) throw "Cannot compile an empty network";
+  if (batch_size == 0) throw "Batch size must be positive";
+  if (net.checkpointing()) {
+    throw "Cannot compile a network with activation checkpoints";
+  }
+
+  const size_t in_size = net[0].in_shape()[0].size();
+  net.forward(tensor_t(batch_size, vec_t(in_size)));
+
+  execution_plan plan;
+  plan.batch_size_ = batch_size;
+  for (const auto &l : net.layers()) {
+    execution_plan::instruction i;
+    i.target = l.get();
+    for (const edgeptr_t &e : l->prev()) i.in_data.push_back(e->get_data());
+    for (const edgeptr_t &e : l->next()) i.out_data.push_back(e->get_data());
+    plan.tape_.push_back(std::move(i));
+  }
+  plan.input_  = plan.tape_.front().in_data[0];
+  plan.output_ = plan.tape_.back().out_data[0];
+  return plan;
+}
+
+}  // namespace litchi
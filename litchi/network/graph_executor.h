@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+#include "litchi/util/parallel_for.h"
+#include "litchi/util/thread_pool.h"
+
+namespace litchi {
+
+/**
+ * @brief Runs the forward pass of a DAG of connected layers, independent
+ * branches (e.g. the towers feeding a concat_layer) running concurrently.
+ *
+ * A layer is submitted to a work_stealing_pool as soon as every layer
+ * producing one of its inputs has run. Branches and the parallel loops of
+ * the kernels share the workers of that pool: the blocks of a loop are
+ * tasks of the pool too, so a wide part of the graph runs its branches
+ * side by side, a narrow one spreads the loops of its layers over the idle
+ * workers, and no more than threads threads ever run.
+ *
+ * The layers must be connected beforehand (see connect()). The inputs of
+ * the graph are the data inputs of the source layers, i.e. the layers no
+ * other layer of the graph feeds.
+ */
+class graph_executor {
+ public:
+  /**
+   * @param layers  [in] layers of the graph, in any order
+   * @param threads [in] threads shared by the branches and the kernels
+   */
+  explicit graph_executor(std::vector<std::shared_ptr<layer>> layers,
+                          size_t threads = parallel_concurrency())
+    : pool_(std::max<size_t>(threads, 1)) {
+    build(std::move(layers));
+  }
+
+  /** layers in a topological order */
+  const std::vector<std::shared_ptr<layer>> &layers() const {
+    return layers_;
+  }
+
+  /** layers fed by no other layer of the graph */
+  std::vector<layer *> sources() const { return select(in_degree_, 0); }
+
+  /** layers feeding no other layer of the graph */
+  std::vector<layer *> sinks() const {
+    std::vector<layer *> sinks;
+    for (size_t i = 0; i < layers_.size(); i++) {
+      if (successors_[i].empty()) sinks.push_back(layers_[i].get());
+    }
+    return sinks;
+  }
+
+  /** number of layers that can run concurrently at most */
+  size_t width() const { return width_; }
+
+  /**
+   * runs every layer once, the inputs being already in the input edges of
+   * the source layers. Rethrows the first exception thrown by a layer, the
+   * layers depending on it being skipped.
+   */
+  void forward() {
+    if (layers_.empty()) return;
+    for (size_t i = 0; i < layers_.size(); i++) {
+      dependencies_[i] = in_degree_[i];
+    }
+    remaining_ = layers_.size();
+    failed_    = false;
+    error_     = nullptr;
+
+    for (size_t i = 0; i < layers_.size(); i++) {
+      if (in_degree_[i] == 0) submit(i);
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return remaining_ == 0; });
+    if (error_) std::rethrow_exception(error_);
+  }
+
+  /**
+   * @param inputs [in] batch fed to the first input of every source layer,
+   *                    in the order of sources()
+   * @return outputs of the sink layers, in the order of sinks()
+   */
+  std::vector<const tensor_t *> forward(const std::vector<tensor_t> &inputs) {
+    const std::vector<layer *> in = sources();
+    if (inputs.size() != in.size()) throw "Input count mismatch";
+    for (size_t i = 0; i < in.size(); i++) *in[i]->input_tensor(0) = inputs[i];
+    forward();
+
+    std::vector<const tensor_t *> out;
+    for (layer *l : sinks()) out.push_back(l->next()[0]->get_data());
+    return out;
+  }
+
+ private:
+  void build(std::vector<std::shared_ptr<layer>> layers) {
+    const size_t n = layers.size();
+    std::vector<std::vector<size_t>> successors(n);
+    std::vector<size_t> in_degree(n, 0);
+    auto index_of = [&](const node *nd) {
+      for (size_t i = 0; i < n; i++) {
+        if (layers[i].get() == nd) return i;
+      }
+      return n;
+    };
+    for (size_t i = 0; i < n; i++) {
+      for (const edgeptr_t &e : layers[i]->next()) {
+        if (!e) continue;
+        for (const node *consumer : e->next()) {
+          const size_t j = index_of(consumer);
+          if (j == n || j == i) continue;
+          if (std::find(successors[i].begin(), successors[i].end(), j) ==
+              successors[i].end()) {
+            successors[i].push_back(j);
+            in_degree[j]++;
+          }
+        }
+      }
+    }
+
+    // Kahn's algorithm, level by level to measure the width
+    std::vector<size_t> order, level, degree = in_degree;
+    for (size_t i = 0; i < n; i++) {
+      if (degree[i] == 0) level.push_back(i);
+    }
+    while (!level.empty()) {
+      width_ = std::max(width_, level.size());
+      std::vector<size_t> next;
+      for (size_t i : level) {
+        order.push_back(i);
+        for (size_t j : successors[i]) {
+          if (--degree[j] == 0) next.push_back(j);
+        }
+      }
+      level.swap(next);
+    }
+    if (order.size() != n) throw "Graph has a cycle";
+
+    // renumber in topological order
+    std::vector<size_t> rank(n);
+    for (size_t r = 0; r < n; r++) rank[order[r]] = r;
+    layers_.resize(n);
+    successors_.resize(n);
+    in_degree_.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      layers_[rank[i]]    = std::move(layers[i]);
+      in_degree_[rank[i]] = in_degree[i];
+      for (size_t j : successors[i]) successors_[rank[i]].push_back(rank[j]);
+    }
+    dependencies_.reset(new std::atomic<size_t>[n]);
+  }
+
+  std::vector<layer *> select(const std::vector<size_t> &degree,
+                              size_t value) const {
+    std::vector<layer *> selected;
+    for (size_t i = 0; i < layers_.size(); i++) {
+      if (degree[i] == value) selected.push_back(layers_[i].get());
+    }
+    return selected;
+  }
+
+  void submit(size_t index) {
+    pool_.submit([this, index]() { run(index); });
+  }
+
+  void run(size_t index) {
+    if (!failed_) {
+      try {
+        layers_[index]->forward();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) error_ = std::current_exception();
+        failed_ = true;
+      }
+    }
+
+    for (size_t j : successors_[index]) {
+      if (--dependencies_[j] == 0) submit(j);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--remaining_ == 0) done_.notify_all();
+  }
+
+  std::vector<std::shared_ptr<layer>> layers_;
+  std::vector<std::vector<size_t>> successors_;
+  std::vector<size_t> in_degree_;
+  size_t width_ = 0;
+
+  work_stealing_pool pool_;
+
+  /* state of the running forward pass */
+  std::unique_ptr<std::atomic<size_t>[]> dependencies_;
+  std::atomic<bool> failed_{false};
+  size_t remaining_ = 0;  // guarded by mutex_
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable done_;
+};
+
+}  // namespace litchi
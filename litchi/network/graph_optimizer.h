@@ -0,0 +1,325 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "litchi/activations/identity_layer.h"
+#include "litchi/layers/batch_normalization_layer.h"
+#include "litchi/layers/convolutional_layer.h"
+#include "litchi/layers/fully_connected_layer.h"
+#include "litchi/network/sequential.h"
+
+namespace litchi {
+
+struct graph_optimizer_options {
+  /** remove layers computing y = x */
+  bool drop_identity = true;
+  /** merge adjacent fully-connected layers when it reduces FLOPs */
+  bool fold_linear = true;
+  /**
+   * fold batch normalizations (with their running statistics) into the
+   * preceding fully-connected or convolutional layer
+   */
+  bool fold_batch_norm = true;
+  /** only merge layers whose weights are frozen (see set_trainable) */
+  bool frozen_only = false;
+  /**
+   * optional batch on which the outputs before and after the optimization
+   * are compared; the graph is left untouched if they differ by more than
+   * tolerance
+   */
+  const tensor_t *validation = nullptr;
+  float_t tolerance          = float_t(1e-4);
+};
+
+struct graph_optimization_report {
+  size_t layers_before = 0;
+  size_t layers_after  = 0;
+  size_t dropped       = 0;  // identity layers removed
+  size_t folded        = 0;  // layers merged into their predecessor
+  size_t folded_norms  = 0;  // of which batch normalizations
+  /** per-sample forward FLOPs */
+  uint64_t flops_before = 0;
+  uint64_t flops_after  = 0;
+  /** bytes of weights and biases */
+  uint64_t weight_bytes_before = 0;
+  uint64_t weight_bytes_after  = 0;
+  /** per-sample bytes of the layer outputs */
+  uint64_t activation_bytes_before = 0;
+  uint64_t activation_bytes_after  = 0;
+  /** largest output difference on the validation batch */
+  float_t max_abs_error = float_t{0};
+  /** false if the validation failed and the graph was restored */
+  bool applied = true;
+};
+
+namespace detail {
+
+inline void measure_graph(const std::vector<std::shared_ptr<layer>> &layers,
+                          uint64_t &flops,
+                          uint64_t &weight_bytes,
+                          uint64_t &activation_bytes) {
+  flops = weight_bytes = activation_bytes = 0;
+  for (const auto &l : layers) {
+    flops += l->flops();
+    for (const vec_t *w : l->weights()) {
+      weight_bytes += w->size() * sizeof(float_t);
+    }
+    for (const shape3d &shape : l->out_shape()) {
+      activation_bytes += shape.size() * sizeof(float_t);
+    }
+  }
+}
+
+inline bool is_identity(layer &l) {
+  if (dynamic_cast<identity_layer *>(&l)) return true;
+
+  auto *fc = dynamic_cast<fully_connected_layer *>(&l);
+  if (!fc || fc->in_size() != fc->out_size()) return false;
+  std::vector<vec_t *> w = fc->weights();
+  const size_t n         = fc->in_size();
+  for (size_t c = 0; c < n; c++) {
+    for (size_t i = 0; i < n; i++) {
+      if ((*w[0])[c * n + i] != (c == i ? float_t{1} : float_t{0})) {
+        return false;
+      }
+    }
+  }
+  return !fc->has_bias() ||
+         std::all_of(w[1]->begin(), w[1]->end(),
+                     [](float_t b) { return b == float_t{0}; });
+}
+
+/**
+ * y = (x * W1 + b1) * W2 + b2 = x * (W1 * W2) + (b1 * W2 + b2)
+ *
+ * @return the merged layer, or nullptr if merging would not pay off
+ */
+inline std::shared_ptr<layer> fold_linear(layer &head,
+                                          layer &tail,
+                                          bool frozen_only) {
+  auto *a = dynamic_cast<fully_connected_layer *>(&head);
+  auto *b = dynamic_cast<fully_connected_layer *>(&tail);
+  if (!a || !b) return nullptr;
+  if (frozen_only && (a->trainable() || b->trainable())) return nullptr;
+
+  const size_t in  = a->in_size();
+  const size_t mid = a->out_size();
+  const size_t out = b->out_size();
+  const bool bias  = a->has_bias() || b->has_bias();
+  auto merged =
+    std::make_shared<fully_connected_layer>(in, out, bias, a->engine());
+  if (merged->flops() >= a->flops() + b->flops()) return nullptr;
+
+  merged->set_trainable(a->trainable() && b->trainable());
+  merged->set_parallelize(a->parallelize());
+  merged->setup(false);
+
+  std::vector<vec_t *> wa = a->weights();
+  std::vector<vec_t *> wb = b->weights();
+  std::vector<vec_t *> wm = merged->weights();
+  const vec_t &W1         = *wa[0];
+  const vec_t &W2         = *wb[0];
+  vec_t &W                = *wm[0];
+
+  // accumulate in double, the folded weights are computed once
+  std::vector<double> row(out);
+  for (size_t c = 0; c < in; c++) {
+    std::fill(row.begin(), row.end(), 0.0);
+    for (size_t k = 0; k < mid; k++) {
+      const double w1 = W1[c * mid + k];
+      for (size_t i = 0; i < out; i++) row[i] += w1 * W2[k * out + i];
+    }
+    for (size_t i = 0; i < out; i++) W[c * out + i] = float_t(row[i]);
+  }
+
+  if (bias) {
+    std::fill(row.begin(), row.end(), 0.0);
+    if (a->has_bias()) {
+      const vec_t &b1 = *wa[1];
+      for (size_t k = 0; k < mid; k++) {
+        const double b1k = b1[k];
+        for (size_t i = 0; i < out; i++) row[i] += b1k * W2[k * out + i];
+      }
+    }
+    if (b->has_bias()) {
+      const vec_t &b2 = *wb[1];
+      for (size_t i = 0; i < out; i++) row[i] += b2[i];
+    }
+    vec_t &bm = *wm[1];
+    for (size_t i = 0; i < out; i++) bm[i] = float_t(row[i]);
+  }
+  return merged;
+}
+
+/**
+ * W'[., i] = W[., i] * scale[i], b'[i] = b[i] * scale[i] + shift[i] for the
+ * inference affine map (scale, shift) of the normalization
+ *
+ * @return the layer computing linear followed by the normalization, or
+ * nullptr if they cannot be merged
+ */
+inline std::shared_ptr<layer> fold_batch_norm(layer &linear,
+                                              layer &norm,
+                                              bool frozen_only) {
+  auto *bn = dynamic_cast<batch_normalization_layer *>(&norm);
+  if (!bn) return nullptr;
+  if (frozen_only && (linear.trainable() || bn->trainable())) return nullptr;
+
+  vec_t scale, shift;
+  bn->inference_affine(scale, shift);
+
+  std::shared_ptr<layer> merged;
+  // rows of W scaled per output channel: W[row * row_stride + i * col_stride]
+  size_t rows = 0, row_stride = 0, col_stride = 0;
+  if (auto *fc = dynamic_cast<fully_connected_layer *>(&linear)) {
+    if (bn->in_spatial_size() != 1 || bn->channels() != fc->out_size()) {
+      return nullptr;
+    }
+    merged = std::make_shared<fully_connected_layer>(
+      fc->in_size(), fc->out_size(), true, fc->engine());
+    // W is in_size x out_size, the outputs being contiguous
+    rows       = fc->in_size();
+    row_stride = fc->out_size();
+    col_stride = 1;
+  } else if (auto *conv = dynamic_cast<convolutional_layer *>(&linear)) {
+    const core::conv_params &p = conv->params();
+    if (bn->in_spatial_size() != p.out.area() ||
+        bn->channels() != p.out.depth_) {
+      return nullptr;
+    }
+    merged = std::make_shared<convolutional_layer>(
+      p.in.width_, p.in.height_, p.weight.width_, p.weight.height_,
+      p.in.depth_, p.out.depth_, p.w_stride, p.h_stride, p.w_padding,
+      p.h_padding, p.w_dilation, p.h_dilation, p.groups, true,
+      conv->engine());
+    // W is out_channels x patch_size
+    rows       = p.patch_size();
+    row_stride = 1;
+    col_stride = p.patch_size();
+  } else {
+    return nullptr;
+  }
+
+  merged->set_trainable(linear.trainable() && bn->trainable());
+  merged->set_parallelize(linear.parallelize());
+  merged->setup(false);
+
+  std::vector<vec_t *> wl = linear.weights();
+  std::vector<vec_t *> wm = merged->weights();
+  const vec_t &W          = *wl[0];
+  vec_t &Wm               = *wm[0];
+  vec_t &bm               = *wm[1];
+  for (size_t i = 0; i < scale.size(); i++) {
+    for (size_t r = 0; r < rows; r++) {
+      const size_t idx = r * row_stride + i * col_stride;
+      Wm[idx]          = W[idx] * scale[i];
+    }
+    const float_t b = wl.size() > 1 ? (*wl[1])[i] : float_t{0};
+    bm[i]           = b * scale[i] + shift[i];
+  }
+  return merged;
+}
+
+inline float_t max_abs_difference(const tensor_t &x, const tensor_t &y) {
+  float_t err = float_t{0};
+  for (size_t s = 0; s < x.size(); s++) {
+    for (size_t i = 0; i < x[s].size(); i++) {
+      err = std::max(err, std::abs(x[s][i] - y[s][i]));
+    }
+  }
+  return err;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Offline optimization of an inference graph.
+ *
+ * - identity layers (identity activations, or square fully-connected
+ *   layers with unit weights and no bias) are removed,
+ * - chains of fully-connected layers without non-linearity in between are
+ *   merged into a single weight matrix, their biases being folded through
+ *   the following weights, whenever it lowers the FLOPs (a bottleneck such
+ *   as 1024 -> 64 -> 1024 is kept as is),
+ * - batch normalizations following a fully-connected or convolutional layer
+ *   are folded into its weights and bias using their running statistics,
+ *   so the graph should be meant for inference (net_phase::test).
+ *
+ * @param net graph to optimize in place
+ * @param options passes to run and optional validation batch
+ * @return savings of the transformation
+ */
+inline graph_optimization_report optimize_graph(
+  sequential &net,
+  const graph_optimizer_options &options = graph_optimizer_options()) {
+  graph_optimization_report report;
+  const std::vector<std::shared_ptr<layer>> original = net.layers();
+  report.layers_before                               = original.size();
+  detail::measure_graph(original, report.flops_before,
+                        report.weight_bytes_before,
+                        report.activation_bytes_before);
+
+  tensor_t expected;
+  if (options.validation) expected = net.forward(*options.validation);
+
+  std::vector<std::shared_ptr<layer>> optimized;
+  for (size_t i = 0; i < original.size(); i++) {
+    const std::shared_ptr<layer> &l = original[i];
+    l->setup(false);
+
+    // keep at least one layer so that the graph still has an output
+    const bool last = i + 1 == original.size() && optimized.empty();
+    if (options.drop_identity && !last && detail::is_identity(*l)) {
+      report.dropped++;
+      continue;
+    }
+
+    if (options.fold_batch_norm && !optimized.empty()) {
+      std::shared_ptr<layer> merged = detail::fold_batch_norm(
+        *optimized.back(), *l, options.frozen_only);
+      if (merged) {
+        optimized.back() = merged;
+        report.folded++;
+        report.folded_norms++;
+        continue;
+      }
+    }
+
+    if (options.fold_linear && !optimized.empty()) {
+      std::shared_ptr<layer> merged =
+        detail::fold_linear(*optimized.back(), *l, options.frozen_only);
+      if (merged) {
+        optimized.back() = merged;
+        report.folded++;
+        continue;
+      }
+    }
+    optimized.push_back(l);
+  }
+
+  if (optimized.size() != original.size() ||
+      !std::equal(optimized.begin(), optimized.end(), original.begin())) {
+    net.set_layers(optimized);
+  }
+
+  if (options.validation) {
+    report.max_abs_error =
+      detail::max_abs_difference(expected, net.forward(*options.validation));
+    if (report.max_abs_error > options.tolerance) {
+      net.set_layers(original);
+      report.applied = false;
+    }
+  }
+
+  report.layers_after = net.size();
+  detail::measure_graph(net.layers(), report.flops_after,
+                        report.weight_bytes_after,
+                        report.activation_bytes_after);
+  return report;
+}
+
+}  // namespace litchi
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "litchi/layers/transpose_layer.h"
+#include "litchi/network/sequential.h"
+
+namespace litchi {
+
+struct layout_report {
+  /** layers running in the preferred layout */
+  size_t converted = 0;
+  /** transpose layers in the graph after the pass */
+  size_t transposes = 0;
+  /** per-sample elements the transposes copy */
+  uint64_t transposed_elements = 0;
+};
+
+namespace detail {
+
+// cost of a layout no assignment reaches
+constexpr uint64_t unreachable = std::numeric_limits<uint64_t>::max();
+
+/**
+ * shape of the data a transpose must reorder to hand data written in shape
+ * out to a layer reading shape in. Data of a single position or channel is
+ * channel-major whatever its layout, so it is read as such under the shape
+ * of the reader.
+ */
+inline shape3d transpose_source(const shape3d &out, const shape3d &in) {
+  return out.layout_invariant() ? in.with_layout(data_layout::nchw) : out;
+}
+
+/**
+ * elements transposed to hand data written in shape out to a layer reading
+ * shape in, 0 if none
+ */
+inline uint64_t transpose_cost(const shape3d &out, const shape3d &in) {
+  if (same_memory_order(out, in)) return 0;
+  return transpose_source(out, in).size();
+}
+
+/**
+ * whether l reads and writes a single data tensor, i.e. is a link of a
+ * chain
+ */
+inline bool chain_link(const layer &l) {
+  size_t inputs = 0, outputs = 0;
+  for (vector_type t : l.in_types()) inputs += t == vector_type::data;
+  for (vector_type t : l.out_types()) outputs += t == vector_type::data;
+  return inputs == 1 && outputs == 1;
+}
+
+/**
+ * layouts layer l may run in when the spatial layers prefer one
+ */
+inline std::vector<data_layout> layout_candidates(const layer &l,
+                                                  data_layout preferred) {
+  if (l.layout_agnostic()) {
+    std::vector<data_layout> any;
+    for (data_layout d : {data_layout::nchw, data_layout::nhwc}) {
+      if (l.supports_layout(d)) any.push_back(d);
+    }
+    return any;
+  }
+  if (l.supports_layout(preferred)) return {preferred};
+  return {data_layout::nchw};
+}
+
+}  // namespace detail
+
+/**
+ * @brief Runs the spatial layers of a graph in the preferred layout with
+ * as few transposes as possible.
+ *
+ * Every layer supporting the preferred layout (convolutions, poolings)
+ * switches to it, other layers keep the channel-major one, and layout
+ * agnostic layers (activations, dropout) take whichever layout spares a
+ * transpose. The assignment minimizing the transposed elements is found by
+ * dynamic programming along the chain, then a transpose_layer is inserted
+ * wherever two neighbours still disagree. The input and the output of the
+ * chain stay channel-major. Transposes already in the chain are dropped
+ * first, so the pass may run again after the chain changed.
+ *
+ * Only chains are handled: a layer with several data inputs or outputs
+ * (e.g. a concat_layer) is rejected, and the DAGs run by a graph_executor
+ * keep the layouts of their layers.
+ *
+ * @param net       chain to rewrite in place
+ * @param preferred layout of the spatial layers
+ */
+inline layout_report optimize_layouts(
+  sequential &net, data_layout preferred = data_layout::nhwc) {
+  std::vector<std::shared_ptr<layer>> layers;
+  for (const auto &l : net.layers()) {
+    if (!detail::chain_link(*l)) {
+      throw "Layout optimization only handles chains of layers";
+    }
+    if (!dynamic_cast<transpose_layer *>(l.get())) layers.push_back(l);
+  }
+  layout_report report;
+  if (layers.empty()) return report;
+
+  const size_t n               = layers.size();
+  const data_layout layouts[2] = {data_layout::nchw, data_layout::nhwc};
+  auto state = [](data_layout d) { return d == data_layout::nhwc ? 1 : 0; };
+
+  // cost[i][s]: fewest elements transposed up to layer i running in
+  // layout s, from[i][s] the layout of layer i - 1 achieving it
+  std::vector<std::vector<uint64_t>> cost(
+    n + 1, std::vector<uint64_t>(2, detail::unreachable));
+  std::vector<std::vector<int>> from(n + 1, std::vector<int>(2, 0));
+  auto relax = [&](size_t i, int s, uint64_t previous, uint64_t step,
+                   int origin) {
+    if (previous == detail::unreachable) return;
+    if (previous + step < cost[i][s]) {
+      cost[i][s] = previous + step;
+      from[i][s] = origin;
+    }
+  };
+
+  const shape3d input =
+    layers[0]->in_shape()[0].with_layout(data_layout::nchw);
+  for (data_layout d : detail::layout_candidates(*layers[0], preferred)) {
+    relax(0, state(d), 0,
+          detail::transpose_cost(input,
+                                 layers[0]->in_shape()[0].with_layout(d)),
+          0);
+  }
+  // step n is the caller reading the output channel-major
+  for (size_t i = 1; i <= n; i++) {
+    const std::vector<data_layout> next =
+      i < n ? detail::layout_candidates(*layers[i], preferred)
+            : std::vector<data_layout>{data_layout::nchw};
+    for (data_layout d : next) {
+      const shape3d in =
+        i < n ? layers[i]->in_shape()[0].with_layout(d)
+              : layers[n - 1]->out_shape()[0].with_layout(d);
+      // on a tie the previous layer keeps the preferred layout, so that
+      // activations stay next to the convolutions they follow
+      for (int p : {state(preferred), 1 - state(preferred)}) {
+        const shape3d out =
+          layers[i - 1]->out_shape()[0].with_layout(layouts[p]);
+        relax(i, state(d), cost[i - 1][p], detail::transpose_cost(out, in),
+              p);
+      }
+    }
+  }
+  if (cost[n][0] == detail::unreachable) {
+    throw "No layout assignment connects the graph";
+  }
+
+  std::vector<data_layout> chosen(n);
+  for (size_t i = n, s = 0; i-- > 0;) {
+    s         = size_t(from[i + 1][s]);
+    chosen[i] = layouts[s];
+  }
+
+  // rebuild the chain, transposing between the layers that disagree
+  std::vector<std::shared_ptr<layer>> rewritten;
+  auto bridge = [&](const shape3d &out, const shape3d &in) {
+    if (detail::transpose_cost(out, in) == 0) return;
+    const shape3d source = detail::transpose_source(out, in);
+    rewritten.push_back(
+      std::make_shared<transpose_layer>(source, in.layout_));
+    report.transposes++;
+    report.transposed_elements += source.size();
+  };
+  for (size_t i = 0; i < n; i++) {
+    layers[i]->set_layout(chosen[i]);
+    if (chosen[i] == preferred && !layers[i]->layout_agnostic()) {
+      report.converted++;
+    }
+    bridge(i == 0 ? input : layers[i - 1]->out_shape()[0],
+           layers[i]->in_shape()[0]);
+    rewritten.push_back(layers[i]);
+  }
+  bridge(layers[n - 1]->out_shape()[0],
+         layers[n - 1]->out_shape()[0].with_layout(data_layout::nchw));
+
+  net.set_layers(rewritten);
+  return report;
+}
+
+}  // namespace litchi
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "litchi/layers/fully_connected_layer.h"
+#include "litchi/layers/low_rank_fully_connected_layer.h"
+#include "litchi/network/graph_optimizer.h"
+#include "litchi/network/sequential.h"
+#include "litchi/util/svd.h"
+
+namespace litchi {
+
+struct low_rank_options {
+  /**
+   * fraction of the squared Frobenius norm of W (the sum of its squared
+   * singular values) the kept singular values must retain
+   */
+  double energy = 0.99;
+  /**
+   * when positive, the rank is instead the smallest one whose relative
+   * error ||W - U * V|| / ||W|| (Frobenius) is at most this value
+   */
+  double max_relative_error = 0;
+  /** upper bound on the rank, 0 for none */
+  size_t max_rank = 0;
+  /** indices of the layers to compress, empty for every fully-connected */
+  std::vector<size_t> layers;
+  /**
+   * optional batch on which the outputs before and after the compression
+   * are compared; the graph is left untouched if they differ by more than
+   * tolerance
+   */
+  const tensor_t *validation = nullptr;
+  float_t tolerance          = std::numeric_limits<float_t>::max();
+};
+
+struct low_rank_layer_report {
+  size_t index    = 0;  // position in the network
+  size_t in_size  = 0;
+  size_t out_size = 0;
+  size_t rank     = 0;  // selected rank, 0 if the layer was kept
+  /** fraction of the squared singular values retained */
+  double energy = 1;
+  /** ||W - U * V|| / ||W||, Frobenius */
+  double relative_error = 0;
+  /** false if the factorization would not save FLOPs */
+  bool factorized = false;
+};
+
+struct low_rank_report {
+  std::vector<low_rank_layer_report> layers;
+  /** per-sample forward FLOPs */
+  uint64_t flops_before = 0;
+  uint64_t flops_after  = 0;
+  /** number of weights and biases */
+  uint64_t params_before = 0;
+  uint64_t params_after  = 0;
+  /** largest output difference on the validation batch */
+  float_t max_abs_error = float_t{0};
+  /** false if the validation failed and the graph was restored */
+  bool applied = true;
+};
+
+namespace detail {
+
+inline uint64_t count_params(const std::vector<std::shared_ptr<layer>> &l) {
+  uint64_t params = 0;
+  for (const auto &x : l) {
+    for (const vec_t *w : x->weights()) params += w->size();
+  }
+  return params;
+}
+
+}  // namespace detail
+
+/**
+ * smallest rank meeting the energy or error threshold of the options,
+ * given singular values in descending order
+ */
+inline size_t select_rank(const std::vector<double> &s,
+                          const low_rank_options &options) {
+  double total = 0;
+  for (double x : s) total += x * x;
+  if (total == 0) return 1;
+
+  const double energy =
+    options.max_relative_error > 0
+      ? 1 - options.max_relative_error * options.max_relative_error
+      : options.energy;
+  size_t limit = s.size();
+  if (options.max_rank > 0) limit = std::min(limit, options.max_rank);
+
+  double kept = 0;
+  for (size_t r = 1; r <= limit; r++) {
+    kept += s[r - 1] * s[r - 1];
+    if (kept >= energy * total) return r;
+  }
+  return limit;
+}
+
+/**
+ * @brief Factorized copy of a fully-connected layer from the SVD of its
+ * weights, keeping the rank largest singular values.
+ *
+ * The singular values are split evenly between the factors,
+ * U = U_r * sqrt(S_r) and V = sqrt(S_r) * V_r, so that both have the same
+ * scale when fine-tuned afterwards.
+ */
+inline std::shared_ptr<low_rank_fully_connected_layer> factorize(
+  fully_connected_layer &fc, const svd_result &svd, size_t rank) {
+  const size_t in  = fc.in_size();
+  const size_t out = fc.out_size();
+  const size_t k   = svd.s.size();
+  auto low_rank    = std::make_shared<low_rank_fully_connected_layer>(
+    in, out, rank, fc.has_bias(), fc.engine());
+  low_rank->set_trainable(fc.trainable());
+  low_rank->set_parallelize(fc.parallelize());
+  low_rank->setup(false);
+
+  std::vector<vec_t *> w  = fc.weights();
+  std::vector<vec_t *> lw = low_rank->weights();
+  vec_t &U                = *lw[0];
+  vec_t &V                = *lw[1];
+  for (size_t r = 0; r < rank; r++) {
+    const double scale = std::sqrt(svd.s[r]);
+    for (size_t c = 0; c < in; c++) {
+      U[c * rank + r] = float_t(svd.u[c * k + r] * scale);
+    }
+    for (size_t i = 0; i < out; i++) {
+      V[r * out + i] = float_t(svd.v[r * out + i] * scale);
+    }
+  }
+  if (fc.has_bias()) *lw[2] = *w[1];
+  return low_rank;
+}
+
+/**
+ * @brief Replaces fully-connected layers of a trained network by low-rank
+ * factorizations W ~ U * V.
+ *
+ * The rank of each layer is the smallest one retaining options.energy of
+ * the squared singular values of W (or meeting max_relative_error); a
+ * layer is only replaced when rank * (in + out) < in * out, i.e. when it
+ * saves FLOPs and weights. The truncated singular values bound the error
+ * of each layer, the validation batch measures the resulting error of the
+ * network output.
+ *
+ * @param net network to compress in place
+ * @param options rank selection, layers to consider and validation batch
+ * @return per-layer ranks and the savings of the transformation
+ */
+inline low_rank_report compress_low_rank(
+  sequential &net, const low_rank_options &options = low_rank_options()) {
+  low_rank_report report;
+  const std::vector<std::shared_ptr<layer>> original = net.layers();
+  for (const auto &l : original) {
+    l->setup(false);
+    report.flops_before += l->flops();
+  }
+  report.params_before = detail::count_params(original);
+
+  tensor_t expected;
+  if (options.validation) expected = net.forward(*options.validation);
+
+  std::vector<size_t> indices = options.layers;
+  if (indices.empty()) {
+    for (size_t i = 0; i < original.size(); i++) indices.push_back(i);
+  }
+
+  std::vector<std::shared_ptr<layer>> compressed = original;
+  for (size_t index : indices) {
+    if (index >= original.size()) throw "Layer index out of range";
+    auto *fc = dynamic_cast<fully_connected_layer *>(original[index].get());
+    if (!fc) continue;
+
+    low_rank_layer_report r;
+    r.index    = index;
+    r.in_size  = fc->in_size();
+    r.out_size = fc->out_size();
+
+    const svd_result svd = litchi::svd(&(*fc->weights()[0])[0],
+                                       fc->in_size(), fc->out_size());
+    const size_t rank = select_rank(svd.s, options);
+    double total = 0, kept = 0;
+    for (size_t k = 0; k < svd.s.size(); k++) {
+      total += svd.s[k] * svd.s[k];
+      if (k < rank) kept += svd.s[k] * svd.s[k];
+    }
+    if (total > 0) {
+      r.energy         = kept / total;
+      r.relative_error = std::sqrt(std::max(0.0, 1 - r.energy));
+    }
+
+    if (rank * (r.in_size + r.out_size) < r.in_size * r.out_size) {
+      compressed[index] = factorize(*fc, svd, rank);
+      r.rank            = rank;
+      r.factorized      = true;
+    }
+    report.layers.push_back(r);
+  }
+
+  if (compressed != original) net.set_layers(compressed);
+
+  if (options.validation) {
+    report.max_abs_error =
+      detail::max_abs_difference(expected, net.forward(*options.validation));
+    if (report.max_abs_error > options.tolerance) {
+      net.set_layers(original);
+      report.applied = false;
+    }
+  }
+
+  for (const auto &l : net.layers()) report.flops_after += l->flops();
+  report.params_after = detail::count_params(net.layers());
+  return report;
+}
+
+}  // namespace litchi
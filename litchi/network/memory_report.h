@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+
+namespace litchi {
+
+/**
+ * estimated bookkeeping of the heap allocator for every block (chunk header
+ * and alignment slack of a typical malloc)
+ */
+constexpr uint64_t allocator_block_overhead = 2 * sizeof(void *);
+
+/**
+ * bytes held by a part of the graph, by category
+ */
+struct memory_usage {
+  uint64_t data             = 0;  // inputs and activations
+  uint64_t gradients        = 0;  // gradients of inputs and activations
+  uint64_t weights          = 0;  // weights and biases
+  uint64_t weight_gradients = 0;  // per-sample gradients of the weights
+  /** vector headers, unused capacity and allocator bookkeeping */
+  uint64_t overhead = 0;
+
+  uint64_t total() const {
+    return data + gradients + weights + weight_gradients + overhead;
+  }
+
+  memory_usage &operator+=(const memory_usage &rhs) {
+    data += rhs.data;
+    gradients += rhs.gradients;
+    weights += rhs.weights;
+    weight_gradients += rhs.weight_gradients;
+    overhead += rhs.overhead;
+    return *this;
+  }
+};
+
+struct edge_memory_report {
+  vector_type vtype;
+  shape3d shape;
+  /** number of samples held by the data and gradient tensors */
+  size_t data_samples = 0;
+  size_t grad_samples = 0;
+  memory_usage usage;
+};
+
+struct layer_memory_report {
+  std::string layer_type;
+  /** edges owned by the layer: its outputs and its unconnected inputs */
+  std::vector<edge_memory_report> edges;
+  memory_usage usage;
+};
+
+struct memory_report {
+  std::vector<layer_memory_report> layers;
+  memory_usage total;
+};
+
+namespace detail {
+
+// bytes of payload and overhead of a tensor, allocated (capacity) or
+// predicted for a number of samples
+inline void tensor_memory(const tensor_t &t,
+                          uint64_t &payload,
+                          uint64_t &overhead) {
+  payload  = 0;
+  overhead = t.capacity() * sizeof(vec_t) +
+             (t.capacity() ? allocator_block_overhead : 0);
+  for (const vec_t &v : t) {
+    payload += v.size() * sizeof(float_t);
+    overhead += (v.capacity() - v.size()) * sizeof(float_t) +
+                (v.capacity() ? allocator_block_overhead : 0);
+  }
+  // samples beyond size() are destroyed, their buffers released
+}
+
+inline void tensor_memory(size_t samples,
+                          size_t sample_size,
+                          uint64_t &payload,
+                          uint64_t &overhead) {
+  payload  = uint64_t(samples) * sample_size * sizeof(float_t);
+  overhead = samples * (sizeof(vec_t) + allocator_block_overhead) +
+             (samples ? allocator_block_overhead : 0);
+}
+
+inline memory_usage edge_usage(vector_type vtype,
+                               uint64_t data,
+                               uint64_t grad,
+                               uint64_t overhead) {
+  memory_usage usage;
+  if (is_trainable_weight(vtype)) {
+    usage.weights          = data;
+    usage.weight_gradients = grad;
+  } else {
+    usage.data      = data;
+    usage.gradients = grad;
+  }
+  usage.overhead = overhead;
+  return usage;
+}
+
+inline edge_memory_report measure_edge(const edge &e) {
+  edge_memory_report report;
+  report.vtype        = e.vtype();
+  report.shape        = e.shape();
+  report.data_samples = e.get_data()->size();
+  report.grad_samples = e.get_gradient()->size();
+
+  uint64_t data, grad, data_overhead, grad_overhead;
+  tensor_memory(*e.get_data(), data, data_overhead);
+  tensor_memory(*e.get_gradient(), grad, grad_overhead);
+  report.usage =
+    edge_usage(e.vtype(), data, grad, data_overhead + grad_overhead);
+  return report;
+}
+
+/**
+ * what an edge holds once a batch went through it: weights keep a single
+ * sample of data, the gradients grad_samples samples, batch_size unless the
+ * layer keeps fewer (see layer::in_grad_samples)
+ */
+inline edge_memory_report predict_edge(vector_type vtype,
+                                       const shape3d &shape,
+                                       size_t batch_size,
+                                       size_t grad_samples) {
+  edge_memory_report report;
+  report.vtype        = vtype;
+  report.shape        = shape;
+  report.data_samples = is_trainable_weight(vtype) ? 1 : batch_size;
+  report.grad_samples = grad_samples;
+
+  uint64_t data, grad, data_overhead, grad_overhead;
+  tensor_memory(report.data_samples, shape.size(), data, data_overhead);
+  tensor_memory(report.grad_samples, shape.size(), grad, grad_overhead);
+  report.usage = edge_usage(vtype, data, grad, data_overhead + grad_overhead);
+  return report;
+}
+
+// bytes allocated by the data and gradient tensors of an edge
+inline uint64_t edge_bytes(const edge &e) {
+  uint64_t data, grad, data_overhead, grad_overhead;
+  tensor_memory(*e.get_data(), data, data_overhead);
+  tensor_memory(*e.get_gradient(), grad, grad_overhead);
+  return data + grad + data_overhead + grad_overhead;
+}
+
+inline bool owned_by(const edge &e,
+                     const layer *l,
+                     const std::vector<std::shared_ptr<layer>> &layers) {
+  if (e.prev() == l) return true;
+  // inputs produced outside of the graph belong to their consumer
+  return std::none_of(layers.begin(), layers.end(),
+                      [&](const std::shared_ptr<layer> &other) {
+                        return e.prev() == other.get();
+                      });
+}
+
+}  // namespace detail
+
+/**
+ * @brief Bytes currently allocated by the edges of a graph.
+ *
+ * Every edge is counted once, by the layer producing it (or consuming it
+ * if it is fed from outside the graph). Edges not created yet count as
+ * empty.
+ */
+inline memory_report measure_memory(
+  const std::vector<std::shared_ptr<layer>> &layers) {
+  memory_report report;
+  for (const auto &l : layers) {
+    layer_memory_report lr;
+    lr.layer_type = l->layer_type();
+    for (const auto *edges : {&l->prev(), &l->next()}) {
+      for (const edgeptr_t &e : *edges) {
+        if (!e || !detail::owned_by(*e, l.get(), layers)) continue;
+        lr.edges.push_back(detail::measure_edge(*e));
+        lr.usage += lr.edges.back().usage;
+      }
+    }
+    report.total += lr.usage;
+    report.layers.push_back(std::move(lr));
+  }
+  return report;
+}
+
+/**
+ * total of measure_memory(layers), without building the report
+ */
+inline uint64_t memory_in_use(
+  const std::vector<std::shared_ptr<layer>> &layers) {
+  uint64_t bytes = 0;
+  for (const auto &l : layers) {
+    for (const auto *edges : {&l->prev(), &l->next()}) {
+      for (const edgeptr_t &e : *edges) {
+        if (!e || !detail::owned_by(*e, l.get(), layers)) continue;
+        bytes += detail::edge_bytes(*e);
+      }
+    }
+  }
+  return bytes;
+}
+
+/**
+ * @brief Bytes the edges of a linear chain will hold after a forward and
+ * backward pass on batch_size samples, computed from the shapes only.
+ *
+ * The i-th layer's first input is assumed to be the output of layer i - 1,
+ * as built by sequential. Nothing is allocated.
+ */
+inline memory_report predict_memory(
+  const std::vector<std::shared_ptr<layer>> &layers, size_t batch_size) {
+  memory_report report;
+  for (size_t li = 0; li < layers.size(); li++) {
+    const layer &l = *layers[li];
+    layer_memory_report lr;
+    lr.layer_type = l.layer_type();
+
+    const std::vector<shape3d> in_shape = l.in_shape();
+    for (size_t i = 0; i < in_shape.size(); i++) {
+      if (li > 0 && i == 0) continue;  // output of the previous layer
+      lr.edges.push_back(detail::predict_edge(
+        l.in_types()[i], in_shape[i], batch_size,
+        l.in_grad_samples(i, batch_size)));
+      lr.usage += lr.edges.back().usage;
+    }
+    const std::vector<shape3d> out_shape = l.out_shape();
+    for (size_t i = 0; i < out_shape.size(); i++) {
+      lr.edges.push_back(detail::predict_edge(
+        l.out_types()[i], out_shape[i], batch_size, batch_size));
+      lr.usage += lr.edges.back().usage;
+    }
+    report.total += lr.usage;
+    report.layers.push_back(std::move(lr));
+  }
+  return report;
+}
+
+/**
+ * @brief High-water mark of the memory held by a graph.
+ *
+ * A network calls record() after each layer of its forward and backward
+ * passes, so the peak also covers memory released in between (e.g.
+ * activations dropped by checkpointing).
+ */
+class memory_tracker {
+ public:
+  void record(uint64_t bytes) {
+    current_ = bytes;
+    peak_    = std::max(peak_, bytes);
+    records_++;
+  }
+
+  void reset() { current_ = peak_ = records_ = 0; }
+
+  /** bytes at the last record */
+  uint64_t current() const { return current_; }
+
+  /** largest recorded value since the last reset */
+  uint64_t peak() const { return peak_; }
+
+  size_t records() const { return records_; }
+
+ private:
+  uint64_t current_ = 0;
+  uint64_t peak_    = 0;
+  size_t records_   = 0;
+};
+
+}  // namespace litchi
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "litchi/layers/layer.h"
+#include "litchi/network/checkpoint.h"
+#include "litchi/network/memory_report.h"
+
+namespace litchi {
+
+/**
+ * linear chain of layers, the output edge of every layer is the input edge
+ * of the next one so data flows through the chain without copies
+ */
+class sequential {
+ public:
+  sequential() {}
+
+  explicit sequential(std::vector<std::shared_ptr<layer>> layers) {
+    set_layers(std::move(layers));
+  }
+
+  /**
+   * appends a layer at the end of the chain
+   */
+  void add(std::shared_ptr<layer> l) {
+    if (!layers_.empty()) connect(layers_.back().get(), l.get());
+    layers_.push_back(std::move(l));
+    checkpoints_.push_back(false);
+    resident_.push_back(true);
+  }
+
+  sequential &operator<<(std::shared_ptr<layer> l) {
+    add(std::move(l));
+    return *this;
+  }
+
+  /**
+   * replaces the whole chain and reconnects its layers in order
+   */
+  void set_layers(std::vector<std::shared_ptr<layer>> layers) {
+    layers_.clear();
+    checkpoints_.clear();
+    resident_.clear();
+    checkpointing_ = false;
+    for (auto &l : layers) add(std::move(l));
+  }
+
+  const std::vector<std::shared_ptr<layer>> &layers() const { return layers_; }
+
+  size_t size() const { return layers_.size(); }
+
+  bool empty() const { return layers_.empty(); }
+
+  layer &operator[](size_t index) { return *layers_[index]; }
+
+  const layer &operator[](size_t index) const { return *layers_[index]; }
+
+  /**
+   * allocates the edges of every layer, initializing weights if needed
+   */
+  void setup(bool reset_weight = false) {
+    for (auto &l : layers_) l->setup(reset_weight);
+  }
+
+  /**
+   * switches every layer to training or inference behaviour
+   */
+  void set_context(net_phase phase) {
+    for (auto &l : layers_) l->set_context(phase);
+  }
+
+  /**
+   * runs the chain on a batch of samples
+   *
+   * @param input batch of samples fed to the first layer
+   * @return output of the last layer, valid until the next call
+   */
+  const tensor_t &forward(const tensor_t &input) {
+    assert(!layers_.empty());
+    setup(false);
+    *layers_.front()->input_tensor(0) = input;
+    return forward();
+  }
+
+  /**
+   * runs the chain on the data already present in the input of the first
+   * layer (see input_tensor())
+   */
+  const tensor_t &forward() {
+    count_memory();
+    for (size_t i = 0; i < layers_.size(); i++) {
+      restore(i);
+      layers_[i]->forward();
+      // the input of this layer is rematerialized by backward() if needed
+      if (i > 0 && !keeps_output(i - 1)) release(i - 1);
+      track_memory(i);
+    }
+    return output();
+  }
+
+  /**
+   * back-propagates the gradient of the output of the last forward pass
+   * through the chain; the weight gradients are accumulated (see
+   * clear_grads())
+   *
+   * @param output_grad gradient of the loss with respect to output()
+   */
+  void backward(const tensor_t &output_grad) {
+    assert(!layers_.empty());
+    *layers_.back()->next()[0]->get_gradient() = output_grad;
+    backward();
+  }
+
+  /**
+   * back-propagates the gradient already present in the output edge of the
+   * last layer
+   */
+  void backward() {
+    count_memory();
+    for (size_t i = layers_.size(); i-- > 0;) {
+      if (i > 0 && !resident_[i - 1]) rematerialize(i - 1);
+      layers_[i]->backward();
+      // the output of layer i was last needed by layers i + 1 and i
+      if (i + 1 < layers_.size() && !keeps_output(i)) release(i);
+      track_memory(i);
+    }
+  }
+
+  /**
+   * @brief Activation checkpointing: keep (true) or drop the output of the
+   * index-th layer between the forward and backward passes.
+   *
+   * Once a checkpoint is set, the outputs of the other layers are released
+   * as soon as the forward pass no longer needs them, and backward()
+   * recomputes each segment between two checkpoints by running its layers
+   * forward again. The output of the last layer is always kept. Layers
+   * with side effects in forward_propagation (e.g. running statistics of
+   * batch normalization) see the recomputed segments a second time.
+   */
+  void set_checkpoint(size_t index, bool keep = true) {
+    checkpoints_[index] = keep;
+    checkpointing_      = true;
+  }
+
+  /**
+   * checkpoints every ceil(sqrt(n))-th layer (see sqrt_checkpoints())
+   */
+  void set_sqrt_checkpoints() {
+    checkpoints_   = sqrt_checkpoints(layers_.size());
+    checkpointing_ = true;
+  }
+
+  /**
+   * disables checkpointing, every output is kept again
+   */
+  void clear_checkpoints() {
+    std::fill(checkpoints_.begin(), checkpoints_.end(), false);
+    checkpointing_ = false;
+  }
+
+  bool checkpointing() const { return checkpointing_; }
+
+  bool is_checkpoint(size_t index) const { return checkpoints_[index]; }
+
+  /**
+   * memory saved and FLOPs spent by the current checkpoints for a training
+   * step on batch_size samples
+   */
+  checkpoint_report checkpoint_cost(size_t batch_size) const {
+    return plan_checkpoints(
+      layers_,
+      checkpointing_ ? checkpoints_ : std::vector<bool>(layers_.size(), true),
+      batch_size);
+  }
+
+  /**
+   * zeroes the weight gradients of every layer
+   */
+  void clear_grads() {
+    for (auto &l : layers_) l->clear_grads();
+  }
+
+  /**
+   * records the memory held by the graph after every layer of the forward
+   * and backward passes; nullptr disables the tracking
+   */
+  void set_memory_tracker(memory_tracker *tracker) { tracker_ = tracker; }
+
+  /**
+   * bytes currently held by the edges of the chain
+   */
+  memory_report memory() const { return measure_memory(layers_); }
+
+  /**
+   * bytes the edges will hold after a forward and backward pass on
+   * batch_size samples, without allocating anything
+   */
+  memory_report predict_memory(size_t batch_size) const {
+    return litchi::predict_memory(layers_, batch_size);
+  }
+
+  tensor_t *input_tensor() { return layers_.front()->input_tensor(0); }
+
+  tensor_t *output_grad() { return layers_.back()->next()[0]->get_gradient(); }
+
+  const tensor_t &output() const {
+    std::vector<const tensor_t *> out;
+    layers_.back()->output(out);
+    return *out[0];
+  }
+
+ private:
+  bool keeps_output(size_t index) const {
+    return !checkpointing_ || checkpoints_[index] ||
+           index + 1 == layers_.size();
+  }
+
+  // frees the buffers of the data output of a layer, keeping the samples
+  void release(size_t index) {
+    for (const edgeptr_t &e : layers_[index]->next()) {
+      if (!e) continue;
+      for (vec_t &v : *e->get_data()) vec_t().swap(v);
+    }
+    resident_[index] = false;
+  }
+
+  // reallocates the output of a layer released by release()
+  void restore(size_t index) {
+    if (resident_[index]) return;
+    for (const edgeptr_t &e : layers_[index]->next()) {
+      if (!e) continue;
+      for (vec_t &v : *e->get_data()) v.resize(e->shape().size());
+    }
+    resident_[index] = true;
+  }
+
+  // recomputes the outputs of the layers following the last resident one,
+  // up to the index-th
+  void rematerialize(size_t index) {
+    size_t first = index;
+    while (first > 0 && !resident_[first - 1]) first--;
+    for (size_t i = first; i <= index; i++) {
+      restore(i);
+      layers_[i]->set_recomputing(true);
+      layers_[i]->forward();
+      layers_[i]->set_recomputing(false);
+      track_memory(i);
+    }
+  }
+
+  // bytes held by the edges the index-th layer owns, as measure_memory()
+  // counts them: its outputs and the inputs no layer of the chain produces
+  uint64_t owned_bytes(size_t index) const {
+    const layer *producer = index > 0 ? layers_[index - 1].get() : nullptr;
+    uint64_t bytes        = 0;
+    for (const edgeptr_t &e : layers_[index]->prev()) {
+      if (e && (!producer || e->prev() != producer)) {
+        bytes += detail::edge_bytes(*e);
+      }
+    }
+    for (const edgeptr_t &e : layers_[index]->next()) {
+      if (e) bytes += detail::edge_bytes(*e);
+    }
+    return bytes;
+  }
+
+  // measures every layer before a pass, the edges may have changed since
+  void count_memory() {
+    if (!tracker_) return;
+    owned_.resize(layers_.size());
+    in_use_ = 0;
+    for (size_t i = 0; i < layers_.size(); i++) {
+      owned_[i] = owned_bytes(i);
+      in_use_ += owned_[i];
+    }
+  }
+
+  // records the memory in use once the index-th layer ran: it only
+  // touches its own edges and the outputs of the previous layer
+  void track_memory(size_t index) {
+    if (!tracker_) return;
+    for (size_t i = index > 0 ? index - 1 : 0; i <= index; i++) {
+      const uint64_t bytes = owned_bytes(i);
+      in_use_              = in_use_ - owned_[i] + bytes;
+      owned_[i]            = bytes;
+    }
+    tracker_->record(in_use_);
+  }
+
+  std::vector<std::shared_ptr<layer>> layers_;
+  memory_tracker *tracker_ = nullptr;
+  /** bytes owned by every layer and their total, while tracking */
+  std::vector<uint64_t> owned_;
+  uint64_t in_use_ = 0;
+
+  /** activation checkpointing */
+  bool checkpointing_ = false;
+  std::vector<bool> checkpoints_;
+  /** false while the output of a layer is released */
+  std::vector<bool> resident_;
+};
+
+}  // namespace litchi
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "litchi/network/sequential.h"
+
+namespace litchi {
+
+/**
+ * @brief Source of a stream of samples.
+ *
+ * Called with a chunk of max_samples samples, whose buffers may hold the
+ * samples of an earlier chunk: it overwrites the first n samples and
+ * returns n, or 0 once the stream is exhausted. Resizing the samples is
+ * allowed but defeats the reuse of their buffers.
+ */
+typedef std::function<size_t(tensor_t &chunk, size_t max_samples)>
+  sample_source;
+
+/**
+ * receives the outputs of the samples [first, first + outputs.size()) of
+ * the stream, in order; outputs is only valid during the call
+ */
+typedef std::function<void(size_t first, const tensor_t &outputs)>
+  sample_sink;
+
+struct streaming_options {
+  /** samples per chunk, 0 to derive it from cache_bytes */
+  size_t chunk_size = 0;
+  /** bytes of activations one layer may touch per chunk, about an L2 */
+  size_t cache_bytes = size_t(1) << 20;
+  /**
+   * reads the next chunk and delivers the previous one on two threads
+   * while the network computes; otherwise the three steps take turns on
+   * the calling thread
+   */
+  bool pipelined = true;
+};
+
+struct streaming_report {
+  size_t samples    = 0;
+  size_t chunks     = 0;
+  size_t chunk_size = 0;
+  /** largest memory held by the edges of the graph after a chunk */
+  uint64_t peak_graph_bytes = 0;
+  /** memory of the chunks in flight between the stages */
+  uint64_t buffer_bytes = 0;
+};
+
+/**
+ * @brief Samples per chunk keeping the working set of every layer within
+ * cache_bytes.
+ *
+ * A layer reads its input and writes its output: a chunk of n samples
+ * touches n * (in + out) values in the layer with the largest ones. At
+ * least one sample is returned, however large.
+ */
+inline size_t streaming_chunk_size(
+  const std::vector<std::shared_ptr<layer>> &layers, size_t cache_bytes) {
+  size_t widest = 1;
+  for (const auto &l : layers) {
+    widest = std::max(
+      widest, l->in_shape()[0].size() + l->out_shape()[0].size());
+  }
+  return std::max<size_t>(1, cache_bytes / (widest * sizeof(float_t)));
+}
+
+namespace detail {
+
+// chunks handed from one stage of a stream to the next; the number of
+// chunks in circulation bounds its length
+class chunk_queue {
+ public:
+  void push(tensor_t chunk) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      chunks_.push_back(std::move(chunk));
+    }
+    cond_.notify_one();
+  }
+
+  // blocks for the next chunk; false once the queue is closed and empty
+  bool pop(tensor_t &chunk) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return closed_ || !chunks_.empty(); });
+    if (chunks_.empty()) return false;
+    chunk = std::move(chunks_.front());
+    chunks_.pop_front();
+    return true;
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    cond_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<tensor_t> chunks_;
+  bool closed_ = false;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Runs the network over a stream of samples too large to be held
+ * at once, in chunks.
+ *
+ * The edges of the graph are sized for one chunk and reused by every
+ * chunk, so memory depends on the chunk size, not on the length of the
+ * stream. A chunk goes through three stages: the source fills it, the
+ * network computes its outputs, the sink receives them. The chunks move
+ * between the stages by swapping buffers: the network reads a chunk
+ * straight from the buffer the source filled, and hands its outputs over
+ * in exchange for the buffer the sink is done with. When pipelined, the
+ * source and the sink run on their own threads, reading the next chunk
+ * and delivering the previous one while the network computes: two chunks
+ * of inputs and two of outputs are in flight besides those of the graph.
+ *
+ * Exceptions thrown by the source, the sink or the network stop the
+ * stream and are rethrown once the stages are stopped; the samples
+ * delivered so far stay delivered.
+ *
+ * @param net     network to run, in its current phase
+ * @param source  [in] samples to score (see sample_source)
+ * @param sink    [in] their outputs (see sample_sink); called on the sink
+ *                     thread when pipelined
+ * @param options [in] chunking and pipelining
+ */
+inline streaming_report stream_forward(
+  sequential &net,
+  const sample_source &source,
+  const sample_sink &sink,
+  const streaming_options &options = streaming_options()) {
+  if (net.empty()) throw "Cannot stream through an empty network";
+  streaming_report report;
+  report.chunk_size =
+    options.chunk_size
+      ? options.chunk_size
+      : streaming_chunk_size(net.layers(), options.cache_bytes);
+  const size_t chunk    = report.chunk_size;
+  const size_t in_size  = net[0].in_shape()[0].size();
+  const size_t out_size = net[net.size() - 1].out_shape()[0].size();
+  net.setup(false);
+
+  // buffers circulating between the stages
+  detail::chunk_queue free_inputs, inputs, outputs, free_outputs;
+  const size_t in_flight = options.pipelined ? 2 : 1;
+  for (size_t i = 0; i < in_flight; i++) {
+    free_inputs.push(tensor_t(chunk, vec_t(in_size)));
+    free_outputs.push(tensor_t(chunk, vec_t(out_size)));
+  }
+  report.buffer_bytes = in_flight * chunk * (in_size + out_size) *
+                        sizeof(float_t);
+
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  std::atomic<bool> stopped{false};
+  auto fail = [&](std::exception_ptr e) {
+    {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) error = e;
+    }
+    stopped = true;
+    for (auto *q : {&free_inputs, &inputs, &outputs, &free_outputs}) {
+      q->close();
+    }
+  };
+
+  // each stage handles one chunk, false once it has nothing left to do
+  auto load = [&]() {
+    tensor_t buffer;
+    if (stopped || !free_inputs.pop(buffer)) return false;
+    buffer.resize(chunk, vec_t(in_size));
+    const size_t n = source(buffer, chunk);
+    if (n == 0) {
+      inputs.close();
+      return false;
+    }
+    if (n > chunk) throw "Source returned more samples than requested";
+    buffer.resize(n);
+    for (const vec_t &sample : buffer) {
+      if (sample.size() != in_size) {
+        throw "Sample size does not match the network input";
+      }
+    }
+    inputs.push(std::move(buffer));
+    return true;
+  };
+  auto compute = [&]() {
+    tensor_t buffer;
+    if (stopped || !inputs.pop(buffer)) {
+      outputs.close();
+      return false;
+    }
+    std::swap(*net.input_tensor(), buffer);
+    free_inputs.push(std::move(buffer));
+    net.forward();
+
+    tensor_t &out  = *net[net.size() - 1].next()[0]->get_data();
+    const size_t n = out.size();
+    if (!free_outputs.pop(buffer)) return false;
+    // the last chunk may be shorter than the recycled buffer
+    buffer.resize(n, vec_t(out_size));
+    std::swap(out, buffer);
+    outputs.push(std::move(buffer));
+
+    report.samples += n;
+    report.chunks++;
+    report.peak_graph_bytes =
+      std::max(report.peak_graph_bytes, net.memory().total.total());
+    return true;
+  };
+  size_t delivered = 0;
+  auto deliver     = [&]() {
+    tensor_t buffer;
+    if (stopped || !outputs.pop(buffer)) return false;
+    sink(delivered, buffer);
+    delivered += buffer.size();
+    free_outputs.push(std::move(buffer));
+    return true;
+  };
+
+  if (!options.pipelined) {
+    try {
+      while (load() && compute() && deliver()) {
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+    if (error) std::rethrow_exception(error);
+    return report;
+  }
+
+  auto stage = [&](const std::function<bool()> &step) {
+    return std::thread([&, step]() {
+      try {
+        while (step()) {
+        }
+      } catch (...) {
+        fail(std::current_exception());
+      }
+    });
+  };
+  std::thread loader = stage(load);
+  std::thread sender = stage(deliver);
+  try {
+    while (compute()) {
+    }
+  } catch (...) {
+    fail(std::current_exception());
+  }
+  outputs.close();
+  loader.join();
+  sender.join();
+  if (error) std::rethrow_exception(error);
+  return report;
+}
+
+/**
+ * stream_forward() over the samples [first, last) of a range, read
+ * chunk by chunk
+ */
+template <typename InputIterator>
+streaming_report stream_forward(
+  sequential &net,
+  InputIterator first,
+  InputIterator last,
+  const sample_sink &sink,
+  const streaming_options &options = streaming_options()) {
+  sample_source source = [&](tensor_t &chunk, size_t max_samples) {
+    size_t n = 0;
+    for (; n < max_samples && first != last; ++first, ++n) {
+      const vec_t &sample = *first;
+      chunk[n].assign(sample.begin(), sample.end());
+    }
+    return n;
+  };
+  return stream_forward(net, source, sink, options);
+}
+
+}  // namespace litchi
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <memory>
 #include <vector>
@@ -62,6 +63,23 @@ class edge {
 
   const shape3d &shape() const { return shape_; }
 
+  /** retags the order of the elements, which are not moved */
+  void set_layout(data_layout layout) { shape_.layout_ = layout; }
+
+  vector_type vtype() const { return vtype_; }
+
+  node *prev() { return prev_; }
+
+  const node *prev() const { return prev_; }
+
+  const std::vector<node *> &next() const { return next_; }
+
+  void add_next_node(node *next) { next_.push_back(next); }
+
+  void remove_next_node(node *next) {
+    next_.erase(std::remove(next_.begin(), next_.end(), next), next_.end());
+  }
+
  private:
   shape3d shape_;
   vector_type vtype_;
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 #include "litchi/layers/layer.h"
+#include "litchi/util/parallel_for.h"
 
 namespace litchi {
 
@@ -13,7 +18,7 @@ namespace litchi {
  * @param input vector of tensors.
  * @return vector of tensor pointers.
  */
-std::vector<tensor_t *> tensor2ptr(std::vector<tensor_t> &input) {
+inline std::vector<tensor_t *> tensor2ptr(std::vector<tensor_t> &input) {
   std::vector<tensor_t *> ret(input.size());
   for (size_t i = 0; i < input.size(); i++) {
     ret[i] = &input[i];
@@ -39,13 +44,13 @@ std::vector<tensor_t *> tensor2ptr(std::vector<tensor_t> &input) {
  *                perturbation.
  * @return The numeric gradient for the desired position and matrix.
  */
-float_t numeric_gradient(layer &layer,
-                         std::vector<tensor_t> in_data,
-                         const size_t in_edge,
-                         const size_t in_pos,
-                         std::vector<tensor_t> out_data,
-                         const size_t out_edge,
-                         const size_t out_pos) {
+inline float_t numeric_gradient(layer &layer,
+                                std::vector<tensor_t> in_data,
+                                const size_t in_edge,
+                                const size_t in_pos,
+                                std::vector<tensor_t> out_data,
+                                const size_t out_edge,
+                                const size_t out_pos) {
   // sqrt(machine epsilon) is assumed to be safe
   float_t h = std::sqrt(std::numeric_limits<float_t>::epsilon());
   // initialize input/output
@@ -67,14 +72,14 @@ float_t numeric_gradient(layer &layer,
   return (out_2 - out_1) / (2 * h);
 }
 
-float_t analytical_gradient(layer &layer,
-                            std::vector<tensor_t> in_data,
-                            const size_t in_edge,
-                            const size_t in_pos,
-                            std::vector<tensor_t> out_data,
-                            std::vector<tensor_t> out_grads,
-                            const size_t out_edge,
-                            const size_t out_pos) {
+inline float_t analytical_gradient(layer &layer,
+                                   std::vector<tensor_t> in_data,
+                                   const size_t in_edge,
+                                   const size_t in_pos,
+                                   std::vector<tensor_t> out_data,
+                                   std::vector<tensor_t> out_grads,
+                                   const size_t out_edge,
+                                   const size_t out_pos) {
   // initialize input/output
   std::vector<tensor_t *> in_data_  = tensor2ptr(in_data);
   std::vector<tensor_t> in_grads    = in_data; // copy constructor
@@ -94,4 +99,348 @@ float_t analytical_gradient(layer &layer,
   return in_grads[in_edge][0][in_pos];
 }
 
+/**
+ * Error between an analytical and a numeric derivative, relative to their
+ * magnitude. Derivatives below unit magnitude are compared in absolute terms
+ * so that vanishing gradients do not blow up the ratio.
+ */
+inline float_t gradient_relative_error(float_t analytical, float_t numeric) {
+  const float_t scale =
+    std::max({std::abs(analytical), std::abs(numeric), float_t{1}});
+  return std::abs(analytical - numeric) / scale;
+}
+
+/**
+ * Result of checking every probed position of one input edge.
+ */
+struct gradient_check_report {
+  size_t edge                 = 0;
+  vector_type type            = vector_type::data;
+  size_t probes               = 0;
+  float_t max_relative_error  = float_t{0};
+  float_t mean_relative_error = float_t{0};
+  size_t worst_position       = 0;
+};
+
+/**
+ * Batched gradient checker.
+ *
+ * The outputs of the layer are contracted with a fixed random projection r,
+ * and the gradient of the scalar L = sum(r * out) is checked:
+ * - the analytical gradient of every input edge comes from a single
+ *   back_propagation with out_grad = r,
+ * - data edges are probed by one batched forward_propagation per chunk where
+ *   each sample carries one -h or +h perturbation, so the probes are spread
+ *   over the threads of the layer kernel,
+ * - weights are shared by all samples of a batch, therefore each of their
+ *   probes costs one single-sample forward_propagation; the probes are
+ *   spread over copies of the layer, one per thread, each with its own
+ *   copy of the inputs. Copies are only made when the checker is built
+ *   from a copyable layer type, otherwise the layer probes sequentially.
+ *
+ * All buffers are allocated at construction and reused by every probe.
+ */
+class gradient_checker {
+ public:
+  /**
+   * @param layer layer to check, its weights are taken from in_data.
+   * @param in_data one tensor per input edge (data, weights, biases...);
+   *                only the first sample of each tensor is used.
+   * @param batch_size number of samples of the batched forward pass, i.e.
+   *                   twice the number of data probes evaluated at once.
+   * @param step finite difference step, defaults to cbrt(machine epsilon)
+   *             which balances truncation and rounding errors of central
+   *             differences.
+   */
+  gradient_checker(
+    layer &layer,
+    const std::vector<tensor_t> &in_data,
+    size_t batch_size = 128,
+    float_t step      = std::cbrt(std::numeric_limits<float_t>::epsilon()))
+    : layer_(layer),
+      step_(step),
+      batch_size_(std::max<size_t>(2, batch_size & ~size_t(1))),
+      in_types_(layer.in_types()),
+      out_types_(layer.out_types()) {
+    const std::vector<shape3d> out_shapes = layer.out_shape();
+    assert(in_data.size() == in_types_.size());
+
+    const size_t in_channels = in_types_.size();
+    single_in_.resize(in_channels);
+    batch_in_.resize(in_channels);
+    in_grad_.resize(in_channels);
+    for (size_t i = 0; i < in_channels; i++) {
+      single_in_[i] = tensor_t(1, in_data[i][0]);
+      in_grad_[i]   = tensor_t(1, vec_t(in_data[i][0].size()));
+      if (!is_trainable_weight(in_types_[i])) {
+        batch_in_[i] = tensor_t(batch_size_, in_data[i][0]);
+      }
+    }
+
+    const size_t out_channels = out_types_.size();
+    single_out_.resize(out_channels);
+    batch_out_.resize(out_channels);
+    out_grad_.resize(out_channels);
+    projection_.resize(out_channels);
+    for (size_t i = 0; i < out_channels; i++) {
+      const size_t size = out_shapes[i].size();
+      single_out_[i]    = tensor_t(1, vec_t(size));
+      batch_out_[i]     = tensor_t(batch_size_, vec_t(size));
+      projection_[i]    = vec_t(size, float_t{0});
+      if (out_types_[i] == vector_type::data) {
+        uniform_rand(projection_[i].begin(), projection_[i].end(), float_t{-1},
+                     float_t{1});
+      }
+      out_grad_[i] = tensor_t(1, projection_[i]);
+    }
+    losses_.resize(batch_size_);
+
+    single_in_ptr_  = tensor2ptr(single_in_);
+    single_out_ptr_ = tensor2ptr(single_out_);
+    in_grad_ptr_    = tensor2ptr(in_grad_);
+    out_grad_ptr_   = tensor2ptr(out_grad_);
+    batch_out_ptr_  = tensor2ptr(batch_out_);
+    batch_in_ptr_.resize(in_channels);
+    for (size_t i = 0; i < in_channels; i++) {
+      batch_in_ptr_[i] = is_trainable_weight(in_types_[i]) ? &single_in_[i]
+                                                           : &batch_in_[i];
+    }
+
+    // analytical gradient of L for all the input edges at once
+    layer_.forward_propagation(single_in_ptr_, single_out_ptr_);
+    layer_.back_propagation(single_in_ptr_, single_out_ptr_, out_grad_ptr_,
+                            in_grad_ptr_);
+  }
+
+  /**
+   * Same as above, the weight probes running in parallel on copies of
+   * layer when Layer is copyable.
+   */
+  template <typename Layer>
+  gradient_checker(
+    Layer &layer,
+    const std::vector<tensor_t> &in_data,
+    size_t batch_size = 128,
+    float_t step      = std::cbrt(std::numeric_limits<float_t>::epsilon()))
+    : gradient_checker(static_cast<litchi::layer &>(layer), in_data,
+                       batch_size, step) {
+    add_copies(layer, std::is_copy_constructible<Layer>());
+  }
+
+  /**
+   * Checks the input edges holding data, weights or biases.
+   *
+   * @param max_probes maximum number of positions to probe per edge;
+   *                   0 probes every position.
+   */
+  std::vector<gradient_check_report> check(size_t max_probes = 0) {
+    std::vector<gradient_check_report> reports;
+    for (size_t i = 0; i < in_types_.size(); i++) {
+      if (in_types_[i] == vector_type::data ||
+          is_trainable_weight(in_types_[i])) {
+        reports.push_back(check_edge(i, max_probes));
+      }
+    }
+    return reports;
+  }
+
+  /**
+   * Compares analytical and numeric gradient of L on one input edge.
+   *
+   * @param in_edge input edge index to perturb.
+   * @param max_probes maximum number of positions to probe, randomly chosen;
+   *                   0 probes every position.
+   */
+  gradient_check_report check_edge(size_t in_edge, size_t max_probes = 0) {
+    const size_t size = single_in_[in_edge][0].size();
+    positions_.clear();
+    if (max_probes == 0 || max_probes >= size) {
+      for (size_t pos = 0; pos < size; pos++) positions_.push_back(pos);
+    } else {
+      for (size_t k = 0; k < max_probes; k++) {
+        positions_.push_back(uniform_rand(size_t{0}, size - 1));
+      }
+    }
+
+    numeric_.resize(positions_.size());
+    if (is_trainable_weight(in_types_[in_edge])) {
+      probe_shared(in_edge);
+    } else {
+      probe_batched(in_edge);
+    }
+
+    gradient_check_report report;
+    report.edge   = in_edge;
+    report.type   = in_types_[in_edge];
+    report.probes = positions_.size();
+    double sum    = 0.0;
+    for (size_t k = 0; k < positions_.size(); k++) {
+      const float_t analytical = in_grad_[in_edge][0][positions_[k]];
+      const float_t err = gradient_relative_error(analytical, numeric_[k]);
+      sum += err;
+      if (err > report.max_relative_error || k == 0) {
+        report.max_relative_error = err;
+        report.worst_position     = positions_[k];
+      }
+    }
+    if (!positions_.empty()) {
+      report.mean_relative_error =
+        static_cast<float_t>(sum / positions_.size());
+    }
+    return report;
+  }
+
+  /**
+   * analytical gradient of L with respect to the given input edge
+   */
+  const vec_t &analytical_gradient(size_t in_edge) const {
+    return in_grad_[in_edge][0];
+  }
+
+ private:
+  // value of L = sum(r * out) for a given output sample
+  double projected_output(const std::vector<tensor_t> &out,
+                          size_t sample) const {
+    double sum = 0.0;
+    for (size_t i = 0; i < out.size(); i++) {
+      if (out_types_[i] != vector_type::data) continue;
+      const vec_t &o = out[i][sample];
+      const vec_t &r = projection_[i];
+      for (size_t j = 0; j < o.size(); j++) {
+        sum += static_cast<double>(o[j]) * r[j];
+      }
+    }
+    return sum;
+  }
+
+  // each sample of the batch carries one perturbation of a data edge
+  void probe_batched(size_t in_edge) {
+    tensor_t &batch      = batch_in_[in_edge];
+    const vec_t &base    = single_in_[in_edge][0];
+    const size_t per_run = batch_size_ / 2;
+
+    for (size_t first = 0; first < positions_.size(); first += per_run) {
+      const size_t count = std::min(per_run, positions_.size() - first);
+      for (size_t k = 0; k < count; k++) {
+        const size_t pos      = positions_[first + k];
+        batch[2 * k][pos]     = base[pos] - step_;
+        batch[2 * k + 1][pos] = base[pos] + step_;
+      }
+
+      layer_.forward_propagation(batch_in_ptr_, batch_out_ptr_);
+
+      for_i(layer_.parallelize(), 2 * count, [&](size_t sample) {
+        losses_[sample] = projected_output(batch_out_, sample);
+      });
+
+      for (size_t k = 0; k < count; k++) {
+        const size_t pos      = positions_[first + k];
+        const double diff     = losses_[2 * k + 1] - losses_[2 * k];
+        numeric_[first + k]   = static_cast<float_t>(diff / (2 * step_));
+        batch[2 * k][pos]     = base[pos];
+        batch[2 * k + 1][pos] = base[pos];
+      }
+    }
+  }
+
+  // a copy of the layer probing weights with its own inputs and outputs
+  struct probe_copy {
+    std::shared_ptr<layer> target;
+    std::vector<tensor_t> in;
+    std::vector<tensor_t> out;
+    std::vector<tensor_t *> in_ptr;
+    std::vector<tensor_t *> out_ptr;
+  };
+
+  template <typename Layer>
+  void add_copies(const Layer &layer, std::true_type) {
+    const size_t copies = parallel_concurrency();
+    if (copies < 2) return;
+    copies_.resize(copies);
+    for (probe_copy &c : copies_) {
+      c.target = std::make_shared<Layer>(layer);
+      // the probes are the parallel work, not the kernels
+      c.target->set_parallelize(false);
+      c.in      = single_in_;
+      c.out     = single_out_;
+      c.in_ptr  = tensor2ptr(c.in);
+      c.out_ptr = tensor2ptr(c.out);
+    }
+  }
+
+  template <typename Layer>
+  void add_copies(const Layer &, std::false_type) {}
+
+  // central difference of L on weight position pos of in_edge
+  float_t probe_weight(layer &target,
+                       std::vector<tensor_t> &in,
+                       std::vector<tensor_t *> &in_ptr,
+                       std::vector<tensor_t> &out,
+                       std::vector<tensor_t *> &out_ptr,
+                       size_t in_edge,
+                       size_t pos) const {
+    vec_t &w            = in[in_edge][0];
+    const float_t saved = w[pos];
+
+    w[pos] = saved - step_;
+    target.forward_propagation(in_ptr, out_ptr);
+    const double minus = projected_output(out, 0);
+
+    w[pos] = saved + step_;
+    target.forward_propagation(in_ptr, out_ptr);
+    const double plus = projected_output(out, 0);
+
+    w[pos] = saved;
+    return static_cast<float_t>((plus - minus) / (2 * step_));
+  }
+
+  // weights are shared by the whole batch: one single-sample forward pass
+  // per probe, the probes being dealt round-robin to the copies
+  void probe_shared(size_t in_edge) {
+    if (copies_.empty()) {
+      for (size_t k = 0; k < positions_.size(); k++) {
+        numeric_[k] = probe_weight(layer_, single_in_, single_in_ptr_,
+                                   single_out_, single_out_ptr_, in_edge,
+                                   positions_[k]);
+      }
+      return;
+    }
+    const size_t workers = copies_.size();
+    for_i(true, workers, [&](size_t worker) {
+      probe_copy &c = copies_[worker];
+      for (size_t k = worker; k < positions_.size(); k += workers) {
+        numeric_[k] = probe_weight(*c.target, c.in, c.in_ptr, c.out,
+                                   c.out_ptr, in_edge, positions_[k]);
+      }
+    }, 1);
+  }
+
+  layer &layer_;
+  float_t step_;
+  size_t batch_size_;
+  std::vector<vector_type> in_types_;
+  std::vector<vector_type> out_types_;
+
+  std::vector<tensor_t> single_in_;
+  std::vector<tensor_t> batch_in_;
+  std::vector<tensor_t> single_out_;
+  std::vector<tensor_t> batch_out_;
+  std::vector<tensor_t> in_grad_;
+  std::vector<tensor_t> out_grad_;
+  std::vector<vec_t> projection_;
+
+  std::vector<tensor_t *> single_in_ptr_;
+  std::vector<tensor_t *> batch_in_ptr_;
+  std::vector<tensor_t *> single_out_ptr_;
+  std::vector<tensor_t *> batch_out_ptr_;
+  std::vector<tensor_t *> in_grad_ptr_;
+  std::vector<tensor_t *> out_grad_ptr_;
+
+  std::vector<probe_copy> copies_;
+
+  std::vector<size_t> positions_;
+  std::vector<float_t> numeric_;
+  std::vector<double> losses_;
+};
+
 } // namespace litchi
\ No newline at end of file
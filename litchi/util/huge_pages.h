@@ -0,0 +1,313 @@
+#pragma once
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "litchi/util/macro.h"
+
+namespace litchi {
+
+/**
+ * size of the pages backing huge allocations (the PMD pages of x86-64 and
+ * arm64 with 4 KB base pages)
+ */
+constexpr size_t huge_page_size = size_t(2) << 20;
+
+/**
+ * where the buffers of vec_t above the huge page threshold come from
+ */
+enum class huge_page_mode {
+  off,          // the heap, like smaller buffers
+  transparent,  // huge-page aligned mappings advised with MADV_HUGEPAGE
+  hugetlbfs     // pages reserved in hugetlbfs (vm.nr_hugepages), falling
+                // back to transparent ones once the reserve is exhausted
+};
+
+/**
+ * buffers currently mapped for huge pages
+ */
+struct huge_page_report {
+  size_t blocks           = 0;  // live buffers
+  size_t hugetlbfs_blocks = 0;  // of which taken from hugetlbfs
+  uint64_t mapped_bytes   = 0;  // bytes mapped for them
+  uint64_t huge_bytes     = 0;  // of which backed by huge pages
+};
+
+namespace detail {
+
+struct huge_block {
+  size_t bytes;
+  bool hugetlbfs;
+};
+
+struct huge_page_state {
+  std::atomic<huge_page_mode> mode{huge_page_mode::off};
+  std::atomic<size_t> threshold{huge_page_size};
+  /** number of entries of blocks, read without the lock */
+  std::atomic<size_t> live{0};
+  /** mappings still to refuse, for the tests to exercise the fallback */
+  std::atomic<size_t> refused{0};
+  std::mutex mutex;
+  std::map<uintptr_t, huge_block> blocks;
+};
+
+// never destroyed, so that vectors outliving static destruction still find
+// the blocks they release
+inline huge_page_state &huge_pages() {
+  static huge_page_state *state = new huge_page_state();
+  return *state;
+}
+
+inline size_t round_to_huge_pages(size_t bytes) {
+  return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+}
+
+// maps size bytes (a multiple of huge_page_size) starting on a huge page
+// boundary, nullptr on failure
+inline void *map_huge_block(size_t size, bool hugetlbfs, bool &from_pool) {
+#ifdef __linux__
+  const int prot  = PROT_READ | PROT_WRITE;
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  from_pool       = false;
+#ifdef MAP_HUGETLB
+  if (hugetlbfs) {
+    void *p = mmap(nullptr, size, prot, flags | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      from_pool = true;
+      return p;
+    }
+  }
+#endif
+  // over-map by a huge page, then trim both ends to align the start: the
+  // kernel only backs aligned 2 MB extents with huge pages
+  void *raw = mmap(nullptr, size + huge_page_size, prot, flags, -1, 0);
+  if (raw == MAP_FAILED) return nullptr;
+  const uintptr_t begin   = reinterpret_cast<uintptr_t>(raw);
+  const uintptr_t aligned = (begin + huge_page_size - 1) &
+                            ~uintptr_t(huge_page_size - 1);
+  const uintptr_t end = begin + size + huge_page_size;
+  if (aligned > begin) munmap(raw, aligned - begin);
+  if (end > aligned + size) {
+    munmap(reinterpret_cast<void *>(aligned + size), end - aligned - size);
+  }
+#ifdef MADV_HUGEPAGE
+  // refused where THP is disabled: the block keeps normal pages
+  madvise(reinterpret_cast<void *>(aligned), size, MADV_HUGEPAGE);
+#endif
+  return reinterpret_cast<void *>(aligned);
+#else
+  CNN_UNREFERENCED_PARAMETER(size);
+  CNN_UNREFERENCED_PARAMETER(hugetlbfs);
+  from_pool = false;
+  return nullptr;
+#endif
+}
+
+// a huge block of bytes when the mode asks for one, nullptr otherwise
+inline void *allocate_huge(size_t bytes) {
+  huge_page_state &state    = huge_pages();
+  const huge_page_mode mode = state.mode.load(std::memory_order_relaxed);
+  if (mode == huge_page_mode::off ||
+      bytes < state.threshold.load(std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  size_t refused = state.refused.load(std::memory_order_relaxed);
+  while (refused > 0) {
+    if (state.refused.compare_exchange_weak(refused, refused - 1)) {
+      return nullptr;
+    }
+  }
+  const size_t size = round_to_huge_pages(bytes);
+  bool from_pool    = false;
+  void *p = map_huge_block(size, mode == huge_page_mode::hugetlbfs, from_pool);
+  if (!p) return nullptr;
+
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.blocks[reinterpret_cast<uintptr_t>(p)] = huge_block{size, from_pool};
+  state.live++;
+  return p;
+}
+
+// unmaps p if allocate_huge() returned it
+inline bool release_huge(void *p) noexcept {
+  // blocks start on a huge page: most heap buffers are ruled out unlocked
+  if (reinterpret_cast<uintptr_t>(p) & (huge_page_size - 1)) return false;
+  huge_page_state &state = huge_pages();
+  if (state.live.load(std::memory_order_relaxed) == 0) return false;
+  size_t size = 0;
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto it = state.blocks.find(reinterpret_cast<uintptr_t>(p));
+    if (it == state.blocks.end()) return false;
+    size = it->second.bytes;
+    state.blocks.erase(it);
+    state.live--;
+  }
+#ifdef __linux__
+  munmap(p, size);
+#endif
+  return true;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Sends the buffers of at least threshold bytes allocated from now
+ * on to huge pages.
+ *
+ * Each such buffer gets its own mapping, rounded up to whole huge pages,
+ * so that a large weight matrix or activation tensor is read through a
+ * few TLB entries instead of one per 4 KB. Buffers allocated before keep
+ * their memory (see reallocate_huge()). Where a mapping cannot be made the
+ * buffer falls back to the heap; huge_page_usage() tells how much memory
+ * huge pages actually back.
+ *
+ * vec_t only uses the allocator when the library is built with
+ * CNN_USE_HUGE_PAGES (the USE_HUGE_PAGES option of CMake).
+ *
+ * @param mode      [in] source of the pages, off to go back to the heap
+ * @param threshold [in] smallest buffer in bytes sent to huge pages
+ */
+inline void set_huge_page_mode(huge_page_mode mode,
+                               size_t threshold = huge_page_size) {
+  detail::huge_pages().threshold = threshold;
+  detail::huge_pages().mode      = mode;
+}
+
+inline huge_page_mode get_huge_page_mode() {
+  return detail::huge_pages().mode;
+}
+
+/**
+ * whether p is the start of a buffer mapped for huge pages
+ */
+inline bool is_huge_block(const void *p) {
+  detail::huge_page_state &state = detail::huge_pages();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  return state.blocks.count(reinterpret_cast<uintptr_t>(p)) > 0;
+}
+
+/**
+ * @brief Bytes of the live huge-page buffers, and how many of them the
+ * kernel backs with huge pages.
+ *
+ * Transparent huge pages are granted at fault time and may be refused
+ * (THP disabled, memory fragmented): their coverage is read from the
+ * AnonHugePages fields of smaps. Blocks from hugetlbfs are huge by
+ * construction. Without a readable smaps only those are counted.
+ *
+ * @param smaps [in] path of the memory map of the process
+ */
+inline huge_page_report huge_page_usage(
+  const std::string &smaps = "/proc/self/smaps") {
+  std::map<uintptr_t, detail::huge_block> blocks;
+  {
+    detail::huge_page_state &state = detail::huge_pages();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    blocks = state.blocks;
+  }
+
+  huge_page_report report;
+  for (const auto &b : blocks) {
+    report.blocks++;
+    report.mapped_bytes += b.second.bytes;
+    if (b.second.hugetlbfs) {
+      report.hugetlbfs_blocks++;
+      report.huge_bytes += b.second.bytes;
+    }
+  }
+  if (report.blocks == report.hugetlbfs_blocks) return report;
+
+  // bytes of the transparent blocks inside [begin, end)
+  auto overlap = [&](uintptr_t begin, uintptr_t end) {
+    uint64_t bytes = 0;
+    for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+      if (it->second.hugetlbfs) continue;
+      const uintptr_t first = std::max(begin, it->first);
+      const uintptr_t last  = std::min(end, it->first + it->second.bytes);
+      if (first < last) bytes += last - first;
+    }
+    return bytes;
+  };
+
+  // a mapping may merge several blocks, or a block and a neighbour: its
+  // huge pages are credited up to the bytes of blocks it holds
+  std::ifstream file(smaps);
+  std::string line;
+  uint64_t in_blocks = 0;
+  while (std::getline(file, line)) {
+    unsigned long long begin = 0, end = 0, kb = 0;
+    if (std::sscanf(line.c_str(), "%llx-%llx ", &begin, &end) == 2) {
+      in_blocks = overlap(uintptr_t(begin), uintptr_t(end));
+    } else if (in_blocks > 0 &&
+               std::sscanf(line.c_str(), "AnonHugePages: %llu kB", &kb) ==
+                 1) {
+      report.huge_bytes += std::min<uint64_t>(kb * 1024, in_blocks);
+      in_blocks = 0;
+    }
+  }
+  return report;
+}
+
+/**
+ * @brief Allocator of vec_t: the heap for small buffers, a huge-page
+ * mapping for large ones once set_huge_page_mode() enabled them.
+ */
+template <typename T>
+class huge_page_allocator {
+ public:
+  typedef T value_type;
+
+  huge_page_allocator() noexcept {}
+
+  template <typename U>
+  huge_page_allocator(const huge_page_allocator<U> &) noexcept {}
+
+  T *allocate(size_t n) {
+    if (void *p = detail::allocate_huge(n * sizeof(T))) {
+      return static_cast<T *>(p);
+    }
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, size_t) noexcept {
+    if (!detail::release_huge(p)) ::operator delete(p);
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const huge_page_allocator<T> &,
+                const huge_page_allocator<U> &) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const huge_page_allocator<T> &,
+                const huge_page_allocator<U> &) {
+  return false;
+}
+
+/**
+ * moves the elements of v to a buffer allocated under the current mode,
+ * e.g. weights created before set_huge_page_mode(); returns whether the
+ * buffer is now a huge-page one
+ */
+template <typename Vector>
+bool reallocate_huge(Vector &v) {
+  Vector(v.begin(), v.end()).swap(v);
+  return !v.empty() && is_huge_block(v.data());
+}
+
+}  // namespace litchi
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "litchi/util/perf_counters.h"
+
+namespace litchi {
+
+/**
+ * measurements of one op kernel, summed over its invocations
+ */
+struct kernel_profile {
+  std::string name;
+  uint64_t calls = 0;
+  uint64_t flops = 0;  // as reported by the kernel
+  uint64_t bytes = 0;  // of the tensors bound to the kernel
+  perf_sample counters;
+
+  perf_metrics metrics() const {
+    return derive_metrics(counters, flops, bytes);
+  }
+};
+
+/**
+ * @brief Hardware counters per op kernel (see OpKernel::run()).
+ *
+ * Disabled by default. Every thread counts its own kernels with its own
+ * perf_counters; when they are unavailable the profiles still hold the
+ * calls, FLOPs, bytes and wall time.
+ */
+class kernel_profiler {
+ public:
+  static void enable() { get_state().enabled = true; }
+
+  static void disable() { get_state().enabled = false; }
+
+  static bool enabled() {
+    return get_state().enabled.load(std::memory_order_relaxed);
+  }
+
+  /** whether the calling thread can read hardware counters */
+  static bool counters_available() { return thread_counters().available(); }
+
+  static void reset() {
+    state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.profiles.clear();
+  }
+
+  /**
+   * profiles of the kernels run since the last reset, the most time
+   * consuming first
+   */
+  static std::vector<kernel_profile> report() {
+    state &s = get_state();
+    std::vector<kernel_profile> out;
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      for (const auto &p : s.profiles) out.push_back(p.second);
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const kernel_profile &a, const kernel_profile &b) {
+                       return a.counters.ns > b.counters.ns;
+                     });
+    return out;
+  }
+
+  static void record(const char *name,
+                     const perf_sample &sample,
+                     uint64_t flops,
+                     uint64_t bytes) {
+    state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    kernel_profile &p = s.profiles[name];
+    p.name            = name;
+    p.calls++;
+    p.flops += flops;
+    p.bytes += bytes;
+    p.counters += sample;
+  }
+
+  static perf_counters &thread_counters() {
+    thread_local perf_counters counters;
+    return counters;
+  }
+
+ private:
+  struct state {
+    std::atomic<bool> enabled{false};
+    std::mutex mutex;
+    std::map<std::string, kernel_profile> profiles;
+  };
+
+  static state &get_state() {
+    static state s;
+    return s;
+  }
+};
+
+/**
+ * @brief Measures a kernel invocation when the profiler is enabled at
+ * construction:
+ *
+ *     kernel_profile_scope profile;
+ *     if (profile) profile.start(name(), flops, bytes);
+ *
+ * Only the outermost scope of a thread measures, nested kernels being
+ * counted in their caller.
+ */
+class kernel_profile_scope {
+ public:
+  kernel_profile_scope() : active_(kernel_profiler::enabled() && !depth()) {
+    if (active_) depth() = true;
+  }
+
+  ~kernel_profile_scope() {
+    if (!active_) return;
+    if (name_) {
+      kernel_profiler::record(name_, kernel_profiler::thread_counters().stop(),
+                              flops_, bytes_);
+    }
+    depth() = false;
+  }
+
+  kernel_profile_scope(const kernel_profile_scope &) = delete;
+  kernel_profile_scope &operator=(const kernel_profile_scope &) = delete;
+
+  explicit operator bool() const { return active_; }
+
+  void start(const char *name, uint64_t flops, uint64_t bytes) {
+    name_  = name;
+    flops_ = flops;
+    bytes_ = bytes;
+    kernel_profiler::thread_counters().start();
+  }
+
+ private:
+  static bool &depth() {
+    thread_local bool measuring = false;
+    return measuring;
+  }
+
+  bool active_;
+  const char *name_ = nullptr;
+  uint64_t flops_   = 0;
+  uint64_t bytes_   = 0;
+};
+
+}  // namespace litchi
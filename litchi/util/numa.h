@@ -0,0 +1,343 @@
+#pragma once
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "litchi/util/macro.h"
+#include "litchi/util/parallel_for.h"
+#include "litchi/util/thread_pool.h"
+#include "litchi/util/util.h"
+
+namespace litchi {
+
+struct numa_node {
+  size_t id = 0;             // node number given by the kernel
+  std::vector<size_t> cpus;  // logical cpus of the node
+};
+
+/**
+ * NUMA nodes with cpus of a machine
+ */
+struct numa_topology {
+  std::vector<numa_node> nodes;
+
+  size_t size() const { return nodes.size(); }
+
+  bool is_numa() const { return nodes.size() > 1; }
+
+  size_t cpus() const {
+    size_t n = 0;
+    for (const numa_node &node : nodes) n += node.cpus.size();
+    return n;
+  }
+};
+
+/**
+ * placement of a weight matrix on a NUMA machine
+ */
+enum class numa_policy {
+  none,        // pages stay on the node of the thread that touched them
+  interleave,  // pages spread round-robin over the nodes
+  replicate    // one copy per node, read by the threads of that node
+};
+
+namespace detail {
+
+// parses a kernel list of ids such as "0-3,8-11"
+inline std::vector<size_t> parse_id_list(const std::string &list) {
+  std::vector<size_t> ids;
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) end = list.size();
+    const std::string range = list.substr(pos, end - pos);
+    pos                     = end + 1;
+    if (range.find_first_of("0123456789") == std::string::npos) continue;
+
+    const size_t dash  = range.find('-');
+    const size_t first = std::stoul(range.substr(0, dash));
+    const size_t last =
+      dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+    for (size_t id = first; id <= last; id++) ids.push_back(id);
+  }
+  return ids;
+}
+
+inline bool read_line(const std::string &path, std::string &line) {
+  std::ifstream file(path);
+  return file && std::getline(file, line);
+}
+
+}  // namespace detail
+
+/**
+ * a single node holding every cpu, what a machine without NUMA looks like
+ */
+inline numa_topology uniform_topology() {
+  numa_node node;
+  node.cpus.resize(parallel_concurrency());
+  for (size_t cpu = 0; cpu < node.cpus.size(); cpu++) node.cpus[cpu] = cpu;
+  numa_topology topology;
+  topology.nodes.push_back(std::move(node));
+  return topology;
+}
+
+/**
+ * @brief NUMA nodes and their cpus as listed by sysfs.
+ *
+ * Reads <sysfs_root>/online, then <sysfs_root>/node<N>/cpulist for every
+ * online node. Nodes without cpus (memory only) are left out. Falls back to
+ * uniform_topology() when the files are missing.
+ */
+inline numa_topology detect_numa_topology(
+  const std::string &sysfs_root = "/sys/devices/system/node") {
+  numa_topology topology;
+  std::string line;
+  if (detail::read_line(sysfs_root + "/online", line)) {
+    for (size_t id : detail::parse_id_list(line)) {
+      const std::string path =
+        sysfs_root + "/node" + std::to_string(id) + "/cpulist";
+      if (!detail::read_line(path, line)) continue;
+      numa_node node;
+      node.id   = id;
+      node.cpus = detail::parse_id_list(line);
+      if (!node.cpus.empty()) topology.nodes.push_back(std::move(node));
+    }
+  }
+  return topology.nodes.empty() ? uniform_topology() : topology;
+}
+
+/**
+ * topology of this machine, detected once
+ */
+inline const numa_topology &system_numa_topology() {
+  static const numa_topology topology = detect_numa_topology();
+  return topology;
+}
+
+/**
+ * binds the calling thread, and the threads it starts afterwards, to cpus.
+ * Returns false where not supported or refused (e.g. by a cgroup).
+ */
+inline bool pin_thread(const std::vector<size_t> &cpus) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (size_t cpu : cpus) {
+    if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+  }
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  CNN_UNREFERENCED_PARAMETER(cpus);
+  return false;
+#endif
+}
+
+namespace detail {
+
+// whether the calling thread is a worker of numa_node_pool()
+inline bool &on_numa_worker() {
+  thread_local bool on = false;
+  return on;
+}
+
+// workers pinned to the cpus of a node, started by its first use and kept
+// until the process exits
+inline work_stealing_pool &numa_node_pool(const numa_node &node) {
+  typedef std::pair<size_t, std::vector<size_t>> key;
+  struct registry {
+    std::mutex mutex;
+    std::map<key, std::unique_ptr<work_stealing_pool>> pools;
+  };
+  // never destroyed: its workers may still wait for tasks at exit
+  static registry *pools = new registry();
+
+  std::lock_guard<std::mutex> lock(pools->mutex);
+  std::unique_ptr<work_stealing_pool> &pool =
+    pools->pools[key(node.id, node.cpus)];
+  if (!pool) {
+    const std::vector<size_t> cpus = node.cpus;
+    pool.reset(new work_stealing_pool(
+      std::max<size_t>(cpus.size(), 1), [cpus](size_t) {
+        pin_thread(cpus);
+        on_numa_worker() = true;
+      }));
+  }
+  return *pool;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Spreads the pages of [data, data + bytes) round-robin over the
+ * nodes of topology, moving the pages already touched.
+ *
+ * Returns false on a single node or where mbind is not available.
+ */
+inline bool interleave_pages(void *data,
+                             size_t bytes,
+                             const numa_topology &topology) {
+#if defined(__linux__) && defined(SYS_mbind)
+  if (!topology.is_numa() || bytes == 0) return false;
+  constexpr int mpol_interleave   = 3;
+  constexpr unsigned mpol_mf_move = 1 << 1;
+  constexpr size_t word           = 8 * sizeof(unsigned long);
+
+  unsigned long mask[1024 / word] = {};
+  for (const numa_node &node : topology.nodes) {
+    if (node.id < 1024) mask[node.id / word] |= 1UL << (node.id % word);
+  }
+  const uintptr_t page  = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(page - 1);
+  const uintptr_t end   = reinterpret_cast<uintptr_t>(data) + bytes;
+  return syscall(SYS_mbind, begin, end - begin, mpol_interleave, mask,
+                 sizeof(mask) * 8, mpol_mf_move) == 0;
+#else
+  CNN_UNREFERENCED_PARAMETER(data);
+  CNN_UNREFERENCED_PARAMETER(bytes);
+  CNN_UNREFERENCED_PARAMETER(topology);
+  return false;
+#endif
+}
+
+/**
+ * @brief Runs f(node) once per node, on a worker pinned to the cpus of that
+ * node.
+ *
+ * Every node has a pool of as many workers as cpus, pinned once when the
+ * node is first used and kept for the following calls; the parallel loops
+ * of f run on the workers of its node. Called from one of these workers,
+ * the nodes run in turn on the calling thread. Rethrows the first
+ * exception thrown by f.
+ */
+template <typename Func>
+void for_each_numa_node(const numa_topology &topology, const Func &f) {
+  if (detail::on_numa_worker()) {
+    for (size_t node = 0; node < topology.size(); node++) f(node);
+    return;
+  }
+  struct join {
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t remaining = 0;
+    std::exception_ptr error;
+  } state;
+  state.remaining = topology.size();
+  for (size_t node = 0; node < topology.size(); node++) {
+    detail::numa_node_pool(topology.nodes[node]).submit([&state, &f, node]() {
+      std::exception_ptr error;
+      try {
+        f(node);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(state.mutex);
+      if (error && !state.error) state.error = error;
+      if (--state.remaining == 0) state.done.notify_all();
+    });
+  }
+  std::unique_lock<std::mutex> lock(state.mutex);
+  state.done.wait(lock, [&state]() { return state.remaining == 0; });
+  if (state.error) std::rethrow_exception(state.error);
+}
+
+/**
+ * splits [0, n) into one contiguous range per node, proportional to its
+ * number of cpus: node i gets [bounds[i], bounds[i + 1])
+ */
+inline std::vector<size_t> numa_partition(const numa_topology &topology,
+                                          size_t n) {
+  std::vector<size_t> bounds(1, 0);
+  const size_t total = std::max<size_t>(topology.cpus(), 1);
+  size_t cpus        = 0;
+  for (size_t node = 0; node < topology.size(); node++) {
+    cpus += topology.nodes[node].cpus.size();
+    bounds.push_back(node + 1 == topology.size() ? n : n * cpus / total);
+  }
+  return bounds;
+}
+
+/**
+ * @brief Runs f(node, begin, end) on the range of numa_partition() of every
+ * node, on the cpus of that node (see for_each_numa_node()).
+ *
+ * On a single node f(0, 0, n) runs on the calling thread, unpinned.
+ */
+template <typename Func>
+void numa_for(const numa_topology &topology, size_t n, const Func &f) {
+  if (!topology.is_numa()) {
+    f(size_t(0), size_t(0), n);
+    return;
+  }
+  const std::vector<size_t> bounds = numa_partition(topology, n);
+  for_each_numa_node(topology, [&](size_t node) {
+    if (bounds[node] < bounds[node + 1]) {
+      f(node, bounds[node], bounds[node + 1]);
+    }
+  });
+}
+
+/**
+ * @brief Per-node copies of a vector.
+ *
+ * Every copy is allocated and written by a worker pinned to its node, so
+ * that first-touch places its pages on that node. The copies are
+ * snapshots: update() must be called again once the source changed. On a
+ * single node no copy is made and local() returns the source.
+ */
+class numa_replicas {
+ public:
+  numa_replicas() : topology_(uniform_topology()) {}
+
+  explicit numa_replicas(const numa_topology &topology)
+    : topology_(topology) {}
+
+  void update(const vec_t &source) {
+    source_ = &source;
+    if (!topology_.is_numa()) {
+      copies_.clear();
+      return;
+    }
+    copies_.resize(topology_.size());
+    for_each_numa_node(topology_, [&](size_t node) {
+      vec_t copy(source);
+      copies_[node].swap(copy);
+    });
+  }
+
+  /** the copy of the node-th node of the topology */
+  const vec_t &local(size_t node) const {
+    return copies_.empty() ? *source_ : copies_[node];
+  }
+
+  const numa_topology &topology() const { return topology_; }
+
+  /** bytes held by the copies */
+  uint64_t bytes() const {
+    uint64_t n = 0;
+    for (const vec_t &copy : copies_) n += copy.size() * sizeof(float_t);
+    return n;
+  }
+
+ private:
+  numa_topology topology_;
+  const vec_t *source_ = nullptr;
+  std::vector<vec_t> copies_;
+};
+
+}  // namespace litchi
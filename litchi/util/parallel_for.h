@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "litchi/util/tracer.h"
+
+namespace litchi {
+
+/**
+ * half-open range [begin, end) handed to the body of a parallel loop
+ */
+struct blocked_range {
+  typedef size_t const_iterator;
+
+  blocked_range(size_t begin, size_t end) : begin_(begin), end_(end) {}
+  blocked_range(int begin, int end)
+    : begin_(static_cast<size_t>(begin)), end_(static_cast<size_t>(end)) {}
+
+  const_iterator begin() const { return begin_; }
+  const_iterator end() const { return end_; }
+
+ private:
+  size_t begin_;
+  size_t end_;
+};
+
+/**
+ * @brief Threads running the blocks of the parallel loops started on them,
+ * e.g. the workers of a pool whose kernels must not start threads of their
+ * own.
+ *
+ * Once installed on a thread (see run_loops_on()), the parallel loops it
+ * starts split into at most concurrency() blocks handed to run_blocks()
+ * instead of std::async threads.
+ */
+class loop_scheduler {
+ public:
+  virtual ~loop_scheduler() {}
+
+  /** threads the blocks of a loop may run on, the calling one included */
+  virtual size_t concurrency() const = 0;
+
+  /**
+   * runs body(0) ... body(n - 1) and returns once all of them returned,
+   * the calling thread taking part; rethrows the first exception thrown by
+   * a block
+   */
+  virtual void run_blocks(size_t n,
+                          const std::function<void(size_t)> &body) = 0;
+};
+
+namespace detail {
+
+// scheduler of the parallel loops started by the calling thread, nullptr
+// for std::async threads
+inline loop_scheduler *&thread_loop_scheduler() {
+  thread_local loop_scheduler *scheduler = nullptr;
+  return scheduler;
+}
+
+// cap on the threads of the parallel loops started by the calling thread,
+// 0 when unlimited (see concurrency_limit)
+inline size_t &thread_concurrency_limit() {
+  thread_local size_t limit = 0;
+  return limit;
+}
+
+}  // namespace detail
+
+/**
+ * runs the parallel loops started by the calling thread on scheduler from
+ * now on, nullptr going back to std::async threads
+ */
+inline void run_loops_on(loop_scheduler *scheduler) {
+  detail::thread_loop_scheduler() = scheduler;
+}
+
+/**
+ * number of worker threads used by the parallel loops
+ */
+inline size_t parallel_concurrency() {
+  const loop_scheduler *scheduler = detail::thread_loop_scheduler();
+  size_t n = scheduler ? scheduler->concurrency()
+                       : std::thread::hardware_concurrency();
+  const size_t limit = detail::thread_concurrency_limit();
+  if (limit != 0 && (n == 0 || limit < n)) n = limit;
+  return n == 0 ? 1 : n;
+}
+
+/**
+ * Limits the parallel loops started by the current thread to n threads
+ * while in scope, e.g. to the cores of the NUMA node it is pinned to.
+ */
+class concurrency_limit {
+ public:
+  explicit concurrency_limit(size_t n)
+    : previous_(detail::thread_concurrency_limit()) {
+    detail::thread_concurrency_limit() = n;
+  }
+
+  ~concurrency_limit() { detail::thread_concurrency_limit() = previous_; }
+
+  concurrency_limit(const concurrency_limit &) = delete;
+  concurrency_limit &operator=(const concurrency_limit &) = delete;
+
+ private:
+  size_t previous_;
+};
+
+template <typename Func>
+void xparallel_for(size_t begin, size_t end, const Func &f) {
+  blocked_range r(begin, end);
+  f(r);
+}
+
+// one block of a parallel loop, traced to show the balance of the threads
+template <typename Func>
+void parallel_block(size_t begin, size_t end, const Func &f) {
+  trace_scope trace("parallel_for", "parallel_for", end - begin);
+  xparallel_for(begin, end, f);
+}
+
+/**
+ * splits [begin, end) into at most parallel_concurrency() blocks of at least
+ * grainsize elements and runs them concurrently. The calling thread runs the
+ * first block itself, the others run on the loop_scheduler of the thread if
+ * any, on std::async threads otherwise.
+ */
+template <typename Func>
+void parallel_for(size_t begin, size_t end, const Func &f, size_t grainsize) {
+  if (end <= begin) return;
+  grainsize      = std::max<size_t>(grainsize, 1);
+  size_t count   = end - begin;
+  size_t nblocks = std::min(parallel_concurrency(),
+                            (count + grainsize - 1) / grainsize);
+  if (nblocks <= 1) {
+    xparallel_for(begin, end, f);
+    return;
+  }
+  size_t block_size = (count + nblocks - 1) / nblocks;
+
+  if (loop_scheduler *scheduler = detail::thread_loop_scheduler()) {
+    scheduler->run_blocks(
+      (count + block_size - 1) / block_size, [&](size_t block) {
+        const size_t b = begin + block * block_size;
+        parallel_block(b, std::min(end, b + block_size), f);
+      });
+    return;
+  }
+
+  std::vector<std::future<void>> futures;
+  futures.reserve(nblocks - 1);
+  for (size_t b = begin + block_size; b < end; b += block_size) {
+    size_t e = std::min(end, b + block_size);
+    futures.push_back(std::async(std::launch::async,
+                                 [&f, b, e]() { parallel_block(b, e, f); }));
+  }
+  parallel_block(begin, std::min(end, begin + block_size), f);
+
+  for (auto &future : futures) future.wait();
+  for (auto &future : futures) future.get();  // rethrows worker exceptions
+}
+
+template <typename T, typename U>
+bool value_representation(U const &value) {
+  return static_cast<U>(static_cast<T>(value)) == value;
+}
+
+template <typename T, typename Func>
+inline void for_(bool parallelize,
+                 size_t begin,
+                 T end,
+                 Func f,
+                 size_t grainsize = 100) {
+  static_assert(std::is_integral<T>::value, "end must be integral type");
+  parallelize = parallelize && value_representation<size_t>(end);
+  parallelize ? parallel_for(begin, static_cast<size_t>(end), f, grainsize)
+              : xparallel_for(begin, static_cast<size_t>(end), f);
+}
+
+template <typename T, typename Func>
+inline void for_i(bool parallelize, T size, Func f, size_t grainsize = 100) {
+  for_(parallelize, 0, size,
+       [&](const blocked_range &r) {
+         for (size_t i = r.begin(); i < r.end(); i++) {
+           f(i);
+         }
+       },
+       grainsize);
+}
+
+template <typename T, typename Func>
+inline void for_i(T size, Func f, size_t grainsize = 100) {
+  for_i(true, size, f, grainsize);
+}
+
+}  // namespace litchi
@@ -0,0 +1,237 @@
+#pragma once
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "litchi/util/macro.h"
+
+namespace litchi {
+
+/**
+ * hardware events counted around a kernel
+ */
+enum class perf_event {
+  cycles,
+  instructions,
+  l1d_misses,   // L1 data cache read misses
+  llc_misses,   // last level cache misses
+  dtlb_misses,  // data TLB read misses
+};
+
+constexpr size_t perf_event_count = 5;
+
+/**
+ * bytes moved from memory by a last level cache miss
+ */
+constexpr uint64_t cache_line_size = 64;
+
+/**
+ * counts of one measurement, or a sum of measurements
+ */
+struct perf_sample {
+  std::array<uint64_t, perf_event_count> values = {};
+  unsigned valid = 0;  // bit i set when values[i] was counted
+  uint64_t ns    = 0;  // wall time
+  uint64_t count = 0;  // measurements summed
+
+  bool has(perf_event e) const {
+    return (valid >> static_cast<unsigned>(e)) & 1u;
+  }
+
+  uint64_t operator[](perf_event e) const {
+    return values[static_cast<size_t>(e)];
+  }
+
+  /** accumulates a measurement, an event stays valid if counted by both */
+  perf_sample &operator+=(const perf_sample &rhs) {
+    for (size_t i = 0; i < perf_event_count; i++) values[i] += rhs.values[i];
+    valid = count == 0 ? rhs.valid : valid & rhs.valid;
+    ns += rhs.ns;
+    count += rhs.count;
+    return *this;
+  }
+};
+
+/**
+ * @brief Metrics derived from a perf_sample, NaN when an input is missing.
+ *
+ * The DRAM traffic is estimated as one cache line per LLC miss, giving the
+ * x axis (arithmetic_intensity) and the memory side of a roofline plot.
+ */
+struct perf_metrics {
+  double ipc                  = std::numeric_limits<double>::quiet_NaN();
+  double gflops               = std::numeric_limits<double>::quiet_NaN();
+  double dram_gbps            = std::numeric_limits<double>::quiet_NaN();
+  double arithmetic_intensity = std::numeric_limits<double>::quiet_NaN();
+  double tensor_gbps = std::numeric_limits<double>::quiet_NaN();  // touched
+  double l1d_mpki    = std::numeric_limits<double>::quiet_NaN();
+  double llc_mpki    = std::numeric_limits<double>::quiet_NaN();
+  double dtlb_mpki   = std::numeric_limits<double>::quiet_NaN();
+};
+
+/**
+ * @param flops floating point operations performed during the sample
+ * @param bytes bytes of the tensors the kernel read and wrote
+ */
+inline perf_metrics derive_metrics(const perf_sample &s,
+                                   uint64_t flops,
+                                   uint64_t bytes) {
+  perf_metrics m;
+  const double ns = static_cast<double>(s.ns);
+  if (s.ns > 0 && flops > 0) m.gflops = flops / ns;
+  if (s.ns > 0 && bytes > 0) m.tensor_gbps = bytes / ns;
+  if (s.has(perf_event::cycles) && s.has(perf_event::instructions) &&
+      s[perf_event::cycles] > 0) {
+    m.ipc = double(s[perf_event::instructions]) / s[perf_event::cycles];
+  }
+  if (s.has(perf_event::llc_misses)) {
+    const double dram = double(s[perf_event::llc_misses]) * cache_line_size;
+    if (s.ns > 0) m.dram_gbps = dram / ns;
+    if (flops > 0 && dram > 0) m.arithmetic_intensity = flops / dram;
+  }
+  if (s.has(perf_event::instructions) && s[perf_event::instructions] > 0) {
+    const double kilo = s[perf_event::instructions] / 1000.0;
+    if (s.has(perf_event::l1d_misses)) {
+      m.l1d_mpki = s[perf_event::l1d_misses] / kilo;
+    }
+    if (s.has(perf_event::llc_misses)) {
+      m.llc_mpki = s[perf_event::llc_misses] / kilo;
+    }
+    if (s.has(perf_event::dtlb_misses)) {
+      m.dtlb_mpki = s[perf_event::dtlb_misses] / kilo;
+    }
+  }
+  return m;
+}
+
+/**
+ * @brief Hardware counters of the calling thread through perf_event_open.
+ *
+ * Each event is opened on its own, so a machine lacking one (e.g. a VM
+ * without dTLB events) still counts the others. Threads started while
+ * counting (the parallel loops) are included once they exit. Where the
+ * counters cannot be opened (not Linux, containers denying the syscall,
+ * perf_event_paranoid) available() is false and stop() only measures the
+ * wall time. Counts are scaled when the kernel multiplexed the events.
+ */
+class perf_counters {
+ public:
+  perf_counters() {
+    fds_.fill(-1);
+#ifdef __linux__
+    const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const std::array<std::pair<uint32_t, uint64_t>, perf_event_count> events =
+      {{{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | read_miss},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | read_miss}}};
+    for (size_t i = 0; i < perf_event_count; i++) {
+      perf_event_attr attr = {};
+      attr.size            = sizeof(attr);
+      attr.type            = events[i].first;
+      attr.config          = events[i].second;
+      attr.inherit         = 1;
+      attr.exclude_kernel  = 1;
+      attr.exclude_hv      = 1;
+      attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds_[i] = static_cast<int>(
+        syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+  }
+
+  ~perf_counters() {
+#ifdef __linux__
+    for (int fd : fds_) {
+      if (fd >= 0) close(fd);
+    }
+#endif
+  }
+
+  perf_counters(const perf_counters &) = delete;
+  perf_counters &operator=(const perf_counters &) = delete;
+
+  /** whether at least one event is counted */
+  bool available() const {
+    for (int fd : fds_) {
+      if (fd >= 0) return true;
+    }
+    return false;
+  }
+
+  bool available(perf_event e) const {
+    return fds_[static_cast<size_t>(e)] >= 0;
+  }
+
+  void start() {
+    for (size_t i = 0; i < perf_event_count; i++) read_event(i, start_[i]);
+    start_time_ = std::chrono::steady_clock::now();
+  }
+
+  perf_sample stop() {
+    perf_sample s;
+    s.count = 1;
+    s.ns    = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_time_)
+        .count());
+    for (size_t i = 0; i < perf_event_count; i++) {
+      reading end;
+      if (!read_event(i, end) || !start_[i].ok) continue;
+      const uint64_t count   = end.count - start_[i].count;
+      const uint64_t enabled = end.enabled - start_[i].enabled;
+      const uint64_t running = end.running - start_[i].running;
+      if (running == 0) continue;  // never scheduled on the pmu
+      s.values[i] = running < enabled ? static_cast<uint64_t>(
+                                          double(count) * enabled / running)
+                                      : count;
+      s.valid |= 1u << i;
+    }
+    return s;
+  }
+
+ private:
+  // the counters run from their creation: a measurement is the difference
+  // of two readings, as resetting would not clear the counts of exited
+  // child threads
+  struct reading {
+    bool ok          = false;
+    uint64_t count   = 0;
+    uint64_t enabled = 0;  // ns the event was enabled
+    uint64_t running = 0;  // ns the event was on the pmu
+  };
+
+  bool read_event(size_t i, reading &r) const {
+    r.ok = false;
+#ifdef __linux__
+    if (fds_[i] < 0) return false;
+    uint64_t value[3] = {};
+    if (read(fds_[i], value, sizeof(value)) != sizeof(value)) return false;
+    r.count   = value[0];
+    r.enabled = value[1];
+    r.running = value[2];
+    r.ok      = true;
+#else
+    CNN_UNREFERENCED_PARAMETER(i);
+#endif
+    return r.ok;
+  }
+
+  std::array<int, perf_event_count> fds_;
+  std::array<reading, perf_event_count> start_;
+  std::chrono::steady_clock::time_point start_time_;
+};
+
+}  // namespace litchi
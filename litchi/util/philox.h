@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "litchi/util/product.h"
+
+namespace litchi {
+
+/**
+ * @brief Philox4x32-10 counter-based generator (Salmon et al., "Parallel
+ * random numbers: as easy as 1, 2, 3", SC 2011).
+ *
+ * Block c of the stream of a key is a pure function of (key, c): 128 random
+ * bits from ten rounds of multiplications, with no state carried between
+ * blocks. Threads draw disjoint ranges of counters without coordination,
+ * and the same counters reproduce the same bits whatever the split.
+ */
+class philox4x32 {
+ public:
+  explicit philox4x32(uint64_t key)
+    : key_{uint32_t(key), uint32_t(key >> 32)} {}
+
+  /**
+   * the block of a full 128-bit counter
+   */
+  void operator()(const uint32_t counter[4], uint32_t out[4]) const {
+    uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+    uint32_t k0   = key_[0], k1 = key_[1];
+    for (int r = 0; r < rounds; r++) {
+      if (r > 0) {
+        k0 += w0;
+        k1 += w1;
+      }
+      const uint64_t p0 = uint64_t(m0) * c[0];
+      const uint64_t p1 = uint64_t(m1) * c[2];
+      c[0]              = uint32_t(p1 >> 32) ^ c[1] ^ k0;
+      c[1]              = uint32_t(p1);
+      c[2]              = uint32_t(p0 >> 32) ^ c[3] ^ k1;
+      c[3]              = uint32_t(p0);
+    }
+    std::memcpy(out, c, sizeof(c));
+  }
+
+  /**
+   * blocks [counter, counter + blocks) one after the other in out, four
+   * words per block, the counter filling the low 64 bits of the 128
+   */
+  void generate(uint64_t counter, size_t blocks, uint32_t *out) const {
+    size_t b = 0;
+#if defined(CNN_VECTORIZE_AVX2) || defined(CNN_VECTORIZE_SSE)
+    for (; b < blocks / 4 * 4; b += 4) generate4(counter + b, out + 4 * b);
+#endif
+    for (; b < blocks; b++) {
+      const uint64_t n    = counter + b;
+      const uint32_t c[4] = {uint32_t(n), uint32_t(n >> 32), 0, 0};
+      (*this)(c, out + 4 * b);
+    }
+  }
+
+ private:
+  static constexpr int rounds  = 10;
+  static constexpr uint32_t m0 = 0xD2511F53u;
+  static constexpr uint32_t m1 = 0xCD9E8D57u;
+  static constexpr uint32_t w0 = 0x9E3779B9u;
+  static constexpr uint32_t w1 = 0xBB67AE85u;
+
+#if defined(CNN_VECTORIZE_AVX2) || defined(CNN_VECTORIZE_SSE)
+  // high and low halves of the 32 x 32 bit products of the four lanes;
+  // SSE2 multiplies the even lanes only, the odd ones are shifted down
+  static CNN_MUST_INLINE void mulhilo(__m128i a,
+                                      __m128i m,
+                                      __m128i *hi,
+                                      __m128i *lo) {
+    const __m128i even = _mm_mul_epu32(a, m);
+    const __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+    const __m128i t0   = _mm_unpacklo_epi32(even, odd);
+    const __m128i t1   = _mm_unpackhi_epi32(even, odd);
+    *lo                = _mm_unpacklo_epi64(t0, t1);
+    *hi                = _mm_unpackhi_epi64(t0, t1);
+  }
+
+  // four consecutive blocks, word i of every block in lane i of c[i]
+  void generate4(uint64_t counter, uint32_t *out) const {
+    uint32_t lo[4], hi[4];
+    for (int l = 0; l < 4; l++) {
+      lo[l] = uint32_t(counter + l);
+      hi[l] = uint32_t((counter + l) >> 32);
+    }
+    __m128i c0        = _mm_loadu_si128((const __m128i *)lo);
+    __m128i c1        = _mm_loadu_si128((const __m128i *)hi);
+    __m128i c2        = _mm_setzero_si128();
+    __m128i c3        = _mm_setzero_si128();
+    __m128i k0        = _mm_set1_epi32(int(key_[0]));
+    __m128i k1        = _mm_set1_epi32(int(key_[1]));
+    const __m128i vm0 = _mm_set1_epi32(int(m0));
+    const __m128i vm1 = _mm_set1_epi32(int(m1));
+    for (int r = 0; r < rounds; r++) {
+      if (r > 0) {
+        k0 = _mm_add_epi32(k0, _mm_set1_epi32(int(w0)));
+        k1 = _mm_add_epi32(k1, _mm_set1_epi32(int(w1)));
+      }
+      __m128i hi0, lo0, hi1, lo1;
+      mulhilo(c0, vm0, &hi0, &lo0);
+      mulhilo(c2, vm1, &hi1, &lo1);
+      c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), k0);
+      c1 = lo1;
+      c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), k1);
+      c3 = lo0;
+    }
+
+    // transpose the lanes back into blocks
+    const __m128i a = _mm_unpacklo_epi32(c0, c1);
+    const __m128i b = _mm_unpacklo_epi32(c2, c3);
+    const __m128i c = _mm_unpackhi_epi32(c0, c1);
+    const __m128i d = _mm_unpackhi_epi32(c2, c3);
+    _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi64(a, b));
+    _mm_storeu_si128((__m128i *)(out + 4), _mm_unpackhi_epi64(a, b));
+    _mm_storeu_si128((__m128i *)(out + 8), _mm_unpacklo_epi64(c, d));
+    _mm_storeu_si128((__m128i *)(out + 12), _mm_unpackhi_epi64(c, d));
+  }
+#endif
+
+  uint32_t key_[2];
+};
+
+/**
+ * number of philox4x32 blocks drawn per 64 bits of a bernoulli_mask(): one
+ * 16-bit uniform per bit
+ */
+constexpr size_t bernoulli_mask_blocks = 8;
+
+/**
+ * @brief Packed Bernoulli mask: bit i of mask is set with probability
+ * threshold / 2^16.
+ *
+ * Each bit compares a 16-bit uniform with the threshold, so that a block
+ * of the generator yields eight bits; bits [64w, 64w + 64) come from the
+ * blocks counter + 8w onwards. The bits past size in the last word are
+ * drawn like the others.
+ *
+ * @param threshold [in] in [0, 2^16], 2^16 setting every bit
+ */
+inline void bernoulli_mask(const philox4x32 &generator,
+                           uint64_t counter,
+                           size_t size,
+                           uint32_t threshold,
+                           uint64_t *mask) {
+  const size_t words = (size + 63) / 64;
+  if (threshold >= (1u << 16)) {
+    for (size_t w = 0; w < words; w++) mask[w] = ~uint64_t{0};
+    return;
+  }
+
+  uint32_t random[4 * bernoulli_mask_blocks];
+  uint16_t uniform[64];
+  for (size_t w = 0; w < words; w++) {
+    generator.generate(counter + w * bernoulli_mask_blocks,
+                       bernoulli_mask_blocks, random);
+    std::memcpy(uniform, random, sizeof(uniform));
+    uint64_t bits = 0;
+#if defined(CNN_VECTORIZE_AVX2) || defined(CNN_VECTORIZE_SSE)
+    // 16 compares at a time, unsigned through a flip of the sign bits,
+    // narrowed to bytes and gathered by movemask
+    const __m128i flip  = _mm_set1_epi16(short(0x8000));
+    const __m128i limit = _mm_set1_epi16(short(threshold ^ 0x8000));
+    for (size_t i = 0; i < 64; i += 16) {
+      const __m128i a = _mm_xor_si128(
+        _mm_loadu_si128((const __m128i *)(uniform + i)), flip);
+      const __m128i b = _mm_xor_si128(
+        _mm_loadu_si128((const __m128i *)(uniform + i + 8)), flip);
+      const __m128i lt = _mm_packs_epi16(_mm_cmplt_epi16(a, limit),
+                                         _mm_cmplt_epi16(b, limit));
+      bits |= uint64_t(uint16_t(_mm_movemask_epi8(lt))) << i;
+    }
+#else
+    for (size_t i = 0; i < 64; i++) {
+      bits |= uint64_t(uniform[i] < threshold) << i;
+    }
+#endif
+    mask[w] = bits;
+  }
+}
+
+}  // namespace litchi
@@ -1,6 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <limits>
+
+#if defined(CNN_USE_AVX2) && defined(__AVX2__) && defined(__FMA__)
+#define CNN_VECTORIZE_AVX2
+#include <immintrin.h>
+#elif defined(CNN_USE_SSE) && defined(__SSE2__)
+#define CNN_VECTORIZE_SSE
+#include <emmintrin.h>
+#endif
 
 #include "litchi/util/macro.h"
 
@@ -13,6 +24,399 @@ void fill(T *dst, size_t size, T value) {
   std::fill(dst, dst + size, value);
 }
 
+// sum(x[i] * y[i])
+template <typename T>
+T dot(const T *x, const T *y, size_t size) {
+  T sum{0};
+  for (size_t i = 0; i < size; i++) sum += x[i] * y[i];
+  return sum;
+}
+
+// dst[i] += src[i] * c
+template <typename T>
+void muladd(const T *src, T c, size_t size, T *dst) {
+  for (size_t i = 0; i < size; i++) dst[i] += src[i] * c;
+}
+
+// dst[i] += src[i]
+template <typename T>
+void reduce(const T *src, size_t size, T *dst) {
+  for (size_t i = 0; i < size; i++) dst[i] += src[i];
+}
+
+// max(x[i])
+template <typename T>
+T max_value(const T *x, size_t size) {
+  T m = -std::numeric_limits<T>::infinity();
+  for (size_t i = 0; i < size; i++) m = std::max(m, x[i]);
+  return m;
+}
+
+// sum(exp(x[i] - shift))
+template <typename T>
+T exp_sum(const T *x, size_t size, T shift) {
+  T sum{0};
+  for (size_t i = 0; i < size; i++) sum += std::exp(x[i] - shift);
+  return sum;
+}
+
+// dst[i] = scale * exp(x[i] - shift)
+template <typename T>
+void exp_scale(const T *x, size_t size, T shift, T scale, T *dst) {
+  for (size_t i = 0; i < size; i++) dst[i] = scale * std::exp(x[i] - shift);
+}
+
+// if (x[i] > best[i]) { best[i] = x[i]; index[i] = k; }
+template <typename T>
+void max_index(const T *x, size_t size, int32_t k, T *best, int32_t *index) {
+  for (size_t i = 0; i < size; i++) {
+    if (x[i] > best[i]) {
+      best[i]  = x[i];
+      index[i] = k;
+    }
+  }
+}
+
+// dst[i] = src[i] * scale where bit i of mask is set, 0 elsewhere
+template <typename T>
+void mask_scale(
+  const T *src, const uint64_t *mask, size_t size, T scale, T *dst) {
+  for (size_t i = 0; i < size; i++) {
+    dst[i] = (mask[i / 64] >> (i % 64)) & 1 ? src[i] * scale : T{0};
+  }
+}
+
+// dst[i] = 1 / (1 + exp(-x[i])), dst may be x
+template <typename T>
+void sigmoid(const T *x, size_t size, T *dst) {
+  for (size_t i = 0; i < size; i++) dst[i] = T(1) / (T(1) + std::exp(-x[i]));
+}
+
+// dst[i] = tanh(x[i]), dst may be x
+template <typename T>
+void tanh(const T *x, size_t size, T *dst) {
+  for (size_t i = 0; i < size; i++) dst[i] = std::tanh(x[i]);
+}
+
+#if defined(CNN_VECTORIZE_AVX2)
+
+// Cephes-style exp, 8 floats at a time. Inputs are clamped to the range
+// where the result is a normal float or flushed to zero.
+CNN_MUST_INLINE __m256 exp_ps(__m256 x) {
+  x = _mm256_min_ps(x, _mm256_set1_ps(88.0f));
+  x = _mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f));
+
+  // exp(x) = 2^n * exp(r), n = round(x / ln2), r = x - n * ln2
+  __m256 n = _mm256_floor_ps(
+    _mm256_fmadd_ps(x, _mm256_set1_ps(1.44269504088896341f),
+                    _mm256_set1_ps(0.5f)));
+  x = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+  x = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), x);
+
+  __m256 y = _mm256_set1_ps(1.9875691500e-4f);
+  y        = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507e-3f));
+  y        = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073e-3f));
+  y        = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894e-2f));
+  y        = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459e-1f));
+  y        = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201e-1f));
+  y        = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), x);
+  y        = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+
+  __m256i e =
+    _mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127));
+  return _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(e, 23)));
+}
+
+CNN_MUST_INLINE float hmax(__m256 v) {
+  __m128 m =
+    _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  m        = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m        = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+
+CNN_MUST_INLINE float hsum(__m256 v) {
+  __m128 s =
+    _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  s        = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s        = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+inline float max_value(const float *x, size_t size) {
+  float m  = -std::numeric_limits<float>::infinity();
+  size_t i = 0;
+  if (size >= 8) {
+    __m256 vm = _mm256_loadu_ps(x);
+    for (i = 8; i + 8 <= size; i += 8) {
+      vm = _mm256_max_ps(vm, _mm256_loadu_ps(x + i));
+    }
+    m = hmax(vm);
+  }
+  for (; i < size; i++) m = std::max(m, x[i]);
+  return m;
+}
+
+inline float exp_sum(const float *x, size_t size, float shift) {
+  const __m256 vshift = _mm256_set1_ps(shift);
+  __m256 vsum         = _mm256_setzero_ps();
+  size_t i            = 0;
+  for (; i + 8 <= size; i += 8) {
+    vsum = _mm256_add_ps(
+      vsum, exp_ps(_mm256_sub_ps(_mm256_loadu_ps(x + i), vshift)));
+  }
+  float sum = hsum(vsum);
+  for (; i < size; i++) sum += std::exp(x[i] - shift);
+  return sum;
+}
+
+inline void exp_scale(const float *x,
+                      size_t size,
+                      float shift,
+                      float scale,
+                      float *dst) {
+  const __m256 vshift = _mm256_set1_ps(shift);
+  const __m256 vscale = _mm256_set1_ps(scale);
+  size_t i            = 0;
+  for (; i + 8 <= size; i += 8) {
+    __m256 e = exp_ps(_mm256_sub_ps(_mm256_loadu_ps(x + i), vshift));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(vscale, e));
+  }
+  for (; i < size; i++) dst[i] = scale * std::exp(x[i] - shift);
+}
+
+inline void max_index(
+  const float *x, size_t size, int32_t k, float *best, int32_t *index) {
+  const __m256i vk = _mm256_set1_epi32(k);
+  size_t i         = 0;
+  for (; i + 8 <= size; i += 8) {
+    const __m256 v    = _mm256_loadu_ps(x + i);
+    const __m256 b    = _mm256_loadu_ps(best + i);
+    const __m256 gt   = _mm256_cmp_ps(v, b, _CMP_GT_OQ);
+    const __m256i idx = _mm256_loadu_si256((const __m256i *)(index + i));
+    _mm256_storeu_ps(best + i, _mm256_blendv_ps(b, v, gt));
+    _mm256_storeu_si256(
+      (__m256i *)(index + i),
+      _mm256_blendv_epi8(idx, vk, _mm256_castps_si256(gt)));
+  }
+  for (; i < size; i++) {
+    if (x[i] > best[i]) {
+      best[i]  = x[i];
+      index[i] = k;
+    }
+  }
+}
+
+inline void mask_scale(const float *src,
+                       const uint64_t *mask,
+                       size_t size,
+                       float scale,
+                       float *dst) {
+  // lane j keeps its element when bit j of the byte of the mask is set
+  const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  const __m256 vscale = _mm256_set1_ps(scale);
+  size_t i            = 0;
+  for (; i + 8 <= size; i += 8) {
+    const __m256i bits =
+      _mm256_set1_epi32(int((mask[i / 64] >> (i % 64)) & 0xff));
+    const __m256i keep =
+      _mm256_cmpeq_epi32(_mm256_and_si256(bits, lanes), lanes);
+    _mm256_storeu_ps(dst + i,
+                     _mm256_and_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i),
+                                                 vscale),
+                                   _mm256_castsi256_ps(keep)));
+  }
+  for (; i < size; i++) {
+    dst[i] = (mask[i / 64] >> (i % 64)) & 1 ? src[i] * scale : 0.0f;
+  }
+}
+
+inline void sigmoid(const float *x, size_t size, float *dst) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  size_t i         = 0;
+  for (; i + 8 <= size; i += 8) {
+    const __m256 e =
+      exp_ps(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(x + i)));
+    _mm256_storeu_ps(dst + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+  }
+  for (; i < size; i++) dst[i] = 1.0f / (1.0f + std::exp(-x[i]));
+}
+
+// tanh(x) = 2 / (1 + exp(-2x)) - 1, the clamping of exp_ps saturating it
+// to -1 and 1
+inline void tanh(const float *x, size_t size, float *dst) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  size_t i         = 0;
+  for (; i + 8 <= size; i += 8) {
+    const __m256 e =
+      exp_ps(_mm256_mul_ps(_mm256_set1_ps(-2.0f), _mm256_loadu_ps(x + i)));
+    _mm256_storeu_ps(
+      dst + i, _mm256_sub_ps(_mm256_div_ps(two, _mm256_add_ps(one, e)), one));
+  }
+  for (; i < size; i++) dst[i] = std::tanh(x[i]);
+}
+
+#elif defined(CNN_VECTORIZE_SSE)
+
+// Cephes-style exp, 4 floats at a time. Inputs are clamped to the range
+// where the result is a normal float or flushed to zero.
+CNN_MUST_INLINE __m128 exp_ps(__m128 x) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  x                = _mm_min_ps(x, _mm_set1_ps(88.0f));
+  x                = _mm_max_ps(x, _mm_set1_ps(-88.3762626647949f));
+
+  // exp(x) = 2^n * exp(r), n = round(x / ln2), r = x - n * ln2
+  __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)),
+                         _mm_set1_ps(0.5f));
+  // floor without SSE4.1: truncate, then step down for negative values
+  __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+  __m128 n = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, fx), one));
+  x        = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375f)));
+  x        = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(-2.12194440e-4f)));
+
+  __m128 y = _mm_set1_ps(1.9875691500e-4f);
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507e-3f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+  y = _mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), x);
+  y = _mm_add_ps(y, one);
+
+  __m128i e = _mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127));
+  return _mm_mul_ps(y, _mm_castsi128_ps(_mm_slli_epi32(e, 23)));
+}
+
+CNN_MUST_INLINE float hmax(__m128 m) {
+  m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+
+CNN_MUST_INLINE float hsum(__m128 s) {
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+inline float max_value(const float *x, size_t size) {
+  float m  = -std::numeric_limits<float>::infinity();
+  size_t i = 0;
+  if (size >= 4) {
+    __m128 vm = _mm_loadu_ps(x);
+    for (i = 4; i + 4 <= size; i += 4) {
+      vm = _mm_max_ps(vm, _mm_loadu_ps(x + i));
+    }
+    m = hmax(vm);
+  }
+  for (; i < size; i++) m = std::max(m, x[i]);
+  return m;
+}
+
+inline float exp_sum(const float *x, size_t size, float shift) {
+  const __m128 vshift = _mm_set1_ps(shift);
+  __m128 vsum         = _mm_setzero_ps();
+  size_t i            = 0;
+  for (; i + 4 <= size; i += 4) {
+    vsum =
+      _mm_add_ps(vsum, exp_ps(_mm_sub_ps(_mm_loadu_ps(x + i), vshift)));
+  }
+  float sum = hsum(vsum);
+  for (; i < size; i++) sum += std::exp(x[i] - shift);
+  return sum;
+}
+
+inline void exp_scale(const float *x,
+                      size_t size,
+                      float shift,
+                      float scale,
+                      float *dst) {
+  const __m128 vshift = _mm_set1_ps(shift);
+  const __m128 vscale = _mm_set1_ps(scale);
+  size_t i            = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m128 e = exp_ps(_mm_sub_ps(_mm_loadu_ps(x + i), vshift));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(vscale, e));
+  }
+  for (; i < size; i++) dst[i] = scale * std::exp(x[i] - shift);
+}
+
+inline void max_index(
+  const float *x, size_t size, int32_t k, float *best, int32_t *index) {
+  const __m128i vk = _mm_set1_epi32(k);
+  size_t i         = 0;
+  for (; i + 4 <= size; i += 4) {
+    const __m128 v    = _mm_loadu_ps(x + i);
+    const __m128 b    = _mm_loadu_ps(best + i);
+    const __m128 gt   = _mm_cmpgt_ps(v, b);
+    const __m128i m   = _mm_castps_si128(gt);
+    const __m128i idx = _mm_loadu_si128((const __m128i *)(index + i));
+    // SSE2 has no blend: select with and/andnot/or
+    _mm_storeu_ps(best + i,
+                  _mm_or_ps(_mm_and_ps(gt, v), _mm_andnot_ps(gt, b)));
+    _mm_storeu_si128(
+      (__m128i *)(index + i),
+      _mm_or_si128(_mm_and_si128(m, vk), _mm_andnot_si128(m, idx)));
+  }
+  for (; i < size; i++) {
+    if (x[i] > best[i]) {
+      best[i]  = x[i];
+      index[i] = k;
+    }
+  }
+}
+
+inline void mask_scale(const float *src,
+                       const uint64_t *mask,
+                       size_t size,
+                       float scale,
+                       float *dst) {
+  // lane j keeps its element when bit j of the nibble of the mask is set
+  const __m128i lanes = _mm_setr_epi32(1, 2, 4, 8);
+  const __m128 vscale = _mm_set1_ps(scale);
+  size_t i            = 0;
+  for (; i + 4 <= size; i += 4) {
+    const __m128i bits =
+      _mm_set1_epi32(int((mask[i / 64] >> (i % 64)) & 0xf));
+    const __m128i keep = _mm_cmpeq_epi32(_mm_and_si128(bits, lanes), lanes);
+    _mm_storeu_ps(dst + i,
+                  _mm_and_ps(_mm_mul_ps(_mm_loadu_ps(src + i), vscale),
+                             _mm_castsi128_ps(keep)));
+  }
+  for (; i < size; i++) {
+    dst[i] = (mask[i / 64] >> (i % 64)) & 1 ? src[i] * scale : 0.0f;
+  }
+}
+
+inline void sigmoid(const float *x, size_t size, float *dst) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  size_t i         = 0;
+  for (; i + 4 <= size; i += 4) {
+    const __m128 e =
+      exp_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(x + i)));
+    _mm_storeu_ps(dst + i, _mm_div_ps(one, _mm_add_ps(one, e)));
+  }
+  for (; i < size; i++) dst[i] = 1.0f / (1.0f + std::exp(-x[i]));
+}
+
+// tanh(x) = 2 / (1 + exp(-2x)) - 1, the clamping of exp_ps saturating it
+// to -1 and 1
+inline void tanh(const float *x, size_t size, float *dst) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  size_t i         = 0;
+  for (; i + 4 <= size; i += 4) {
+    const __m128 e =
+      exp_ps(_mm_mul_ps(_mm_set1_ps(-2.0f), _mm_loadu_ps(x + i)));
+    _mm_storeu_ps(dst + i,
+                  _mm_sub_ps(_mm_div_ps(two, _mm_add_ps(one, e)), one));
+  }
+  for (; i < size; i++) dst[i] = std::tanh(x[i]);
+}
+
+#endif
+
 } // namespace detail
 
 template <typename T>
@@ -20,4 +424,57 @@ CNN_MUST_INLINE void fill(T *dst, std::size_t size, T value) {
   detail::fill(dst, size, value);
 }
 
-} // namespace vectorize
\ No newline at end of file
+template <typename T>
+CNN_MUST_INLINE T dot(const T *x, const T *y, std::size_t size) {
+  return detail::dot(x, y, size);
+}
+
+template <typename T>
+CNN_MUST_INLINE void muladd(const T *src, T c, std::size_t size, T *dst) {
+  detail::muladd(src, c, size, dst);
+}
+
+template <typename T>
+CNN_MUST_INLINE void reduce(const T *src, std::size_t size, T *dst) {
+  detail::reduce(src, size, dst);
+}
+
+template <typename T>
+CNN_MUST_INLINE T max_value(const T *x, std::size_t size) {
+  return detail::max_value(x, size);
+}
+
+template <typename T>
+CNN_MUST_INLINE T exp_sum(const T *x, std::size_t size, T shift) {
+  return detail::exp_sum(x, size, shift);
+}
+
+template <typename T>
+CNN_MUST_INLINE void exp_scale(
+  const T *x, std::size_t size, T shift, T scale, T *dst) {
+  detail::exp_scale(x, size, shift, scale, dst);
+}
+
+template <typename T>
+CNN_MUST_INLINE void mask_scale(
+  const T *src, const uint64_t *mask, std::size_t size, T scale, T *dst) {
+  detail::mask_scale(src, mask, size, scale, dst);
+}
+
+template <typename T>
+CNN_MUST_INLINE void sigmoid(const T *x, std::size_t size, T *dst) {
+  detail::sigmoid(x, size, dst);
+}
+
+template <typename T>
+CNN_MUST_INLINE void tanh(const T *x, std::size_t size, T *dst) {
+  detail::tanh(x, size, dst);
+}
+
+template <typename T>
+CNN_MUST_INLINE void max_index(
+  const T *x, std::size_t size, int32_t k, T *best, int32_t *index) {
+  detail::max_index(x, size, k, best, index);
+}
+
+} // namespace vectorize
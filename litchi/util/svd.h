@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "litchi/util/parallel_for.h"
+
+namespace litchi {
+
+namespace detail {
+
+/**
+ * Eigen decomposition of the symmetric n x n matrix a (row-major), by
+ * Householder tridiagonalization and implicit QL iterations (the EISPACK
+ * tred2/tql2 pair).
+ *
+ * @param a       [in]  symmetric matrix, overwritten
+ * @param values  [out] eigenvalues, in descending order
+ * @param vectors [out] n x n, row j is the eigenvector of values[j]
+ */
+inline void symmetric_eigen(std::vector<double> &a,
+                            size_t n,
+                            std::vector<double> &values,
+                            std::vector<double> &vectors) {
+  // a is symmetric, so it is also its column-major storage: the inner loops
+  // below then walk contiguous columns and the eigenvectors end up
+  // contiguous
+  std::vector<double> &V = a;
+  std::vector<double> d(n), e(n);
+  auto v = [&](size_t r, size_t c) -> double & { return V[c * n + r]; };
+
+  // tridiagonalization, V accumulates the transformations
+  for (size_t j = 0; j < n; j++) d[j] = v(n - 1, j);
+  for (size_t i = n - 1; i > 0; i--) {
+    double scale = 0, h = 0;
+    for (size_t k = 0; k < i; k++) scale += std::abs(d[k]);
+    if (scale == 0) {
+      e[i] = d[i - 1];
+      for (size_t j = 0; j < i; j++) {
+        d[j]    = v(i - 1, j);
+        v(i, j) = 0;
+        v(j, i) = 0;
+      }
+    } else {
+      for (size_t k = 0; k < i; k++) {
+        d[k] /= scale;
+        h += d[k] * d[k];
+      }
+      double f = d[i - 1];
+      double g = std::sqrt(h);
+      if (f > 0) g = -g;
+      e[i]     = scale * g;
+      h        = h - f * g;
+      d[i - 1] = f - g;
+      for (size_t j = 0; j < i; j++) e[j] = 0;
+      for (size_t j = 0; j < i; j++) {
+        f       = d[j];
+        v(j, i) = f;
+        g       = e[j] + v(j, j) * f;
+        for (size_t k = j + 1; k < i; k++) {
+          g += v(k, j) * d[k];
+          e[k] += v(k, j) * f;
+        }
+        e[j] = g;
+      }
+      f = 0;
+      for (size_t j = 0; j < i; j++) {
+        e[j] /= h;
+        f += e[j] * d[j];
+      }
+      const double hh = f / (h + h);
+      for (size_t j = 0; j < i; j++) e[j] -= hh * d[j];
+      for (size_t j = 0; j < i; j++) {
+        f = d[j];
+        g = e[j];
+        for (size_t k = j; k < i; k++) v(k, j) -= f * e[k] + g * d[k];
+        d[j]    = v(i - 1, j);
+        v(i, j) = 0;
+      }
+    }
+    d[i] = h;
+  }
+  for (size_t i = 0; i + 1 < n; i++) {
+    v(n - 1, i)    = v(i, i);
+    v(i, i)        = 1;
+    const double h = d[i + 1];
+    if (h != 0) {
+      for (size_t k = 0; k <= i; k++) d[k] = v(k, i + 1) / h;
+      for (size_t j = 0; j <= i; j++) {
+        double g = 0;
+        for (size_t k = 0; k <= i; k++) g += v(k, i + 1) * v(k, j);
+        for (size_t k = 0; k <= i; k++) v(k, j) -= g * d[k];
+      }
+    }
+    for (size_t k = 0; k <= i; k++) v(k, i + 1) = 0;
+  }
+  for (size_t j = 0; j < n; j++) {
+    d[j]        = v(n - 1, j);
+    v(n - 1, j) = 0;
+  }
+  v(n - 1, n - 1) = 1;
+  e[0]            = 0;
+
+  // column j of V, i.e. Vt[j * n...], is the eigenvector of d[j]
+  std::vector<double> &Vt = V;
+
+  for (size_t i = 1; i < n; i++) e[i - 1] = e[i];
+  e[n - 1]         = 0;
+  double f         = 0;
+  double tst1      = 0;
+  const double eps = std::ldexp(1.0, -52);
+  for (size_t l = 0; l < n; l++) {
+    tst1     = std::max(tst1, std::abs(d[l]) + std::abs(e[l]));
+    size_t m = l;
+    while (m < n - 1 && std::abs(e[m]) > eps * tst1) m++;
+    if (m > l) {
+      do {
+        double g = d[l];
+        double p = (d[l + 1] - g) / (2 * e[l]);
+        double r = std::hypot(p, 1.0);
+        if (p < 0) r = -r;
+        d[l]             = e[l] / (p + r);
+        d[l + 1]         = e[l] * (p + r);
+        const double dl1 = d[l + 1];
+        double h         = g - d[l];
+        for (size_t i = l + 2; i < n; i++) d[i] -= h;
+        f += h;
+
+        p                = d[m];
+        double c         = 1, c2 = 1, c3 = 1;
+        const double el1 = e[l + 1];
+        double s = 0, s2 = 0;
+        for (size_t i = m; i-- > l;) {
+          c3       = c2;
+          c2       = c;
+          s2       = s;
+          g        = c * e[i];
+          h        = c * p;
+          r        = std::hypot(p, e[i]);
+          e[i + 1] = s * r;
+          s        = e[i] / r;
+          c        = p / r;
+          p        = c * d[i] - s * g;
+          d[i + 1] = h + s * (c * g + s * d[i]);
+          double *vi  = &Vt[i * n];
+          double *vi1 = &Vt[(i + 1) * n];
+          for (size_t k = 0; k < n; k++) {
+            h      = vi1[k];
+            vi1[k] = s * vi[k] + c * h;
+            vi[k]  = c * vi[k] - s * h;
+          }
+        }
+        p    = -s * s2 * c3 * el1 * e[l] / dl1;
+        e[l] = s * p;
+        d[l] = c * p;
+      } while (std::abs(e[l]) > eps * tst1);
+    }
+    d[l] = d[l] + f;
+    e[l] = 0;
+  }
+
+  std::vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), size_t{0});
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t x, size_t y) { return d[x] > d[y]; });
+  values.resize(n);
+  vectors.resize(n * n);
+  for (size_t j = 0; j < n; j++) {
+    values[j] = d[order[j]];
+    std::copy(&Vt[order[j] * n], &Vt[order[j] * n] + n, &vectors[j * n]);
+  }
+}
+
+}  // namespace detail
+
+/**
+ * singular value decomposition A = U * diag(s) * V of a rows x cols matrix
+ */
+struct svd_result {
+  size_t rows = 0;
+  size_t cols = 0;
+  std::vector<double> s;  // descending
+  std::vector<double> u;  // rows x s.size(), singular vectors as columns
+  std::vector<double> v;  // s.size() x cols, singular vectors as rows
+};
+
+/**
+ * @brief Thin SVD of a row-major matrix.
+ *
+ * Computed from the eigen decomposition of the Gram matrix of the smaller
+ * side, in double precision: singular values below about 1e-8 of the
+ * largest are not resolved, which is plenty to truncate float weights.
+ * Costs O(rows * cols * min(rows, cols)), a few seconds for 1024 x 1024;
+ * meant for offline compression.
+ */
+inline svd_result svd(const float_t *a, size_t rows, size_t cols) {
+  svd_result r;
+  r.rows          = rows;
+  r.cols          = cols;
+  const bool tall = rows >= cols;
+  const size_t n  = std::min(rows, cols);
+  const size_t m  = std::max(rows, cols);
+  if (n == 0) return r;
+  // element (i, j) of the matrix seen with its long side first
+  auto at = [&](size_t i, size_t j) -> double {
+    return tall ? a[i * cols + j] : a[j * cols + i];
+  };
+
+  // G = A^T A (tall) or A A^T (wide), n x n
+  std::vector<double> G(n * n, 0.0);
+  for_i(true, n, [&](size_t p) {
+    for (size_t i = 0; i < m; i++) {
+      const double x = at(i, p);
+      if (x == 0) continue;
+      for (size_t q = 0; q <= p; q++) G[p * n + q] += x * at(i, q);
+    }
+  }, 1);
+  for (size_t p = 0; p < n; p++) {
+    for (size_t q = 0; q < p; q++) G[q * n + p] = G[p * n + q];
+  }
+
+  std::vector<double> values, vectors;
+  detail::symmetric_eigen(G, n, values, vectors);
+
+  r.s.resize(n);
+  for (size_t k = 0; k < n; k++) r.s[k] = std::sqrt(std::max(values[k], 0.0));
+
+  // the other side: A v_k / s_k (tall) or A^T u_k / s_k (wide)
+  std::vector<double> other(n * m, 0.0);
+  for_i(true, n, [&](size_t k) {
+    if (r.s[k] == 0) return;
+    const double *e = &vectors[k * n];
+    for (size_t i = 0; i < m; i++) {
+      double sum = 0;
+      for (size_t p = 0; p < n; p++) sum += at(i, p) * e[p];
+      other[k * m + i] = sum / r.s[k];
+    }
+  }, 1);
+
+  r.u.resize(rows * n);
+  r.v.resize(n * cols);
+  const std::vector<double> &left  = tall ? other : vectors;  // n x rows
+  const std::vector<double> &right = tall ? vectors : other;  // n x cols
+  for (size_t k = 0; k < n; k++) {
+    for (size_t i = 0; i < rows; i++) r.u[i * n + k] = left[k * rows + i];
+  }
+  r.v = right;
+  return r;
+}
+
+}  // namespace litchi
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "litchi/util/parallel_for.h"
+#include "litchi/util/tracer.h"
+
+namespace litchi {
+
+/**
+ * @brief Fixed set of worker threads with one task deque each.
+ *
+ * A worker pops the newest task of its own deque first (tasks submitted by
+ * a task stay on the worker that produced their inputs) and, once it is
+ * empty, steals the oldest task of another worker. Tasks submitted from
+ * outside the pool are spread round-robin over the deques. Idle workers
+ * sleep until a task is submitted.
+ *
+ * The parallel loops started by a task run their blocks on the workers of
+ * the pool as well (see loop_scheduler): a task never starts threads, and
+ * the pool never runs more than size() threads however its tasks nest
+ * their loops.
+ */
+class work_stealing_pool : public loop_scheduler {
+ public:
+  typedef std::function<void()> task;
+
+  /**
+   * @param threads  [in] number of workers
+   * @param on_start [in] run by every worker with its index before its
+   *                      first task, e.g. to pin it to cpus
+   */
+  explicit work_stealing_pool(
+    size_t threads                       = parallel_concurrency(),
+    std::function<void(size_t)> on_start = nullptr) {
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; i++) {
+      queues_.emplace_back(new queue());
+    }
+    for (size_t i = 0; i < threads; i++) {
+      workers_.emplace_back([this, i, on_start]() {
+        if (on_start) on_start(i);
+        run(i);
+      });
+    }
+  }
+
+  /**
+   * runs the tasks still queued, then joins the workers
+   */
+  ~work_stealing_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    ready_.notify_all();
+    for (auto &worker : workers_) worker.join();
+  }
+
+  work_stealing_pool(const work_stealing_pool &) = delete;
+  work_stealing_pool &operator=(const work_stealing_pool &) = delete;
+
+  size_t size() const { return workers_.size(); }
+
+  void submit(task t) {
+    const size_t self = current_worker();
+    const size_t q =
+      self < queues_.size() ? self : next_queue_++ % queues_.size();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_++;
+    }
+    {
+      std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+      queues_[q]->tasks.push_back(std::move(t));
+    }
+    ready_.notify_one();
+  }
+
+  /** number of tasks taken from another worker's deque so far */
+  size_t steals() const { return steals_; }
+
+  size_t concurrency() const override { return size(); }
+
+  /**
+   * submits a task per block beyond the first; the calling worker runs the
+   * blocks nobody took yet, then runs other tasks of the pool until the
+   * blocks taken by the other workers are done
+   */
+  void run_blocks(size_t n,
+                  const std::function<void(size_t)> &body) override {
+    // outlives the call: a task may find every block taken after it
+    // returned
+    struct loop {
+      std::atomic<size_t> next{0};
+      std::atomic<size_t> done{0};
+      std::mutex mutex;
+      std::exception_ptr error;
+    };
+    std::shared_ptr<loop> state = std::make_shared<loop>();
+    const std::function<void(size_t)> *f = &body;
+    auto work = [state, f, n]() {
+      for (size_t i; (i = state->next++) < n;) {
+        try {
+          (*f)(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          if (!state->error) state->error = std::current_exception();
+        }
+        state->done++;
+      }
+    };
+    for (size_t i = 1; i < n; i++) submit(work);
+    work();
+
+    const size_t self = current_worker();
+    while (state->done < n) {
+      if (self >= queues_.size() || !run_one(self)) std::this_thread::yield();
+    }
+    if (state->error) std::rethrow_exception(state->error);
+  }
+
+ private:
+  struct queue {
+    std::mutex mutex;
+    std::deque<task> tasks;
+  };
+
+  // index of the calling worker in this pool, size() outside of it
+  size_t current_worker() const {
+    const worker_id &id = this_worker();
+    return id.pool == this ? id.index : queues_.size();
+  }
+
+  struct worker_id {
+    const work_stealing_pool *pool = nullptr;
+    size_t index                   = 0;
+  };
+
+  static worker_id &this_worker() {
+    thread_local worker_id id;
+    return id;
+  }
+
+  bool pop(size_t self, task &t) {
+    {
+      queue &own = *queues_[self];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty()) {
+        t = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        return true;
+      }
+    }
+    for (size_t i = 1; i < queues_.size(); i++) {
+      queue &victim = *queues_[(self + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        t = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        steals_++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // runs a task of the pool if there is one
+  bool run_one(size_t self) {
+    task t;
+    if (!pop(self, t)) return false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_--;
+    }
+    trace_scope trace("task", "pool.task");
+    t();
+    return true;
+  }
+
+  void run(size_t self) {
+    this_worker().pool  = this;
+    this_worker().index = self;
+    run_loops_on(this);
+    for (;;) {
+      if (run_one(self)) continue;
+      // pending_ counts a task before it is pushed, so a worker may spin
+      // here briefly until the push completes
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [this]() { return stop_ || pending_ > 0; });
+      if (stop_ && pending_ == 0) return;
+    }
+  }
+
+  std::vector<std::unique_ptr<queue>> queues_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  size_t pending_ = 0;  // tasks submitted and not popped yet
+  bool stop_      = false;
+
+  std::atomic<size_t> next_queue_{0};
+  std::atomic<size_t> steals_{0};
+};
+
+}  // namespace litchi
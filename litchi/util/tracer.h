@@ -0,0 +1,319 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "litchi/util/util.h"
+
+namespace litchi {
+
+/**
+ * a timed scope recorded by the tracer, exported as a Chrome trace
+ * "complete" event
+ */
+struct trace_event {
+  char name[48]        = {};
+  const char *category = "";  // string literal
+  uint64_t begin_ns    = 0;   // since the tracer epoch
+  uint64_t duration_ns = 0;
+  uint32_t thread      = 0;  // small id of the recording thread
+  uint64_t batch       = 0;  // samples processed, 0 when not relevant
+  uint64_t bytes       = 0;  // bytes of the tensors touched
+};
+
+namespace detail {
+
+/**
+ * Ring of the last events of one thread. Only the owning thread writes;
+ * readers validate every slot with its sequence number (a seqlock), so
+ * neither side ever blocks and a slot overwritten during a read is
+ * skipped instead of torn.
+ */
+class trace_buffer {
+ public:
+  trace_buffer(size_t capacity, uint32_t thread)
+    : slots_(new slot[std::max<size_t>(capacity, 1)]),
+      capacity_(std::max<size_t>(capacity, 1)),
+      thread_(thread) {}
+
+  uint32_t thread() const { return thread_; }
+
+  void push(const trace_event &e) {
+    const uint64_t i = head_.load(std::memory_order_relaxed);
+    slot &s          = slots_[i % capacity_];
+    s.seq.store(2 * i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.event = e;
+    s.seq.store(2 * i + 2, std::memory_order_release);
+    head_.store(i + 1, std::memory_order_release);
+  }
+
+  void read(std::vector<trace_event> &out) const {
+    const uint64_t head  = head_.load(std::memory_order_acquire);
+    const uint64_t first = head > capacity_ ? head - capacity_ : 0;
+    for (uint64_t i = first; i < head; i++) {
+      const slot &s       = slots_[i % capacity_];
+      const uint64_t seq  = s.seq.load(std::memory_order_acquire);
+      trace_event e       = s.event;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint64_t seq2 = s.seq.load(std::memory_order_relaxed);
+      if (seq == 2 * i + 2 && seq2 == seq) out.push_back(e);
+    }
+  }
+
+  void clear() { head_.store(0, std::memory_order_release); }
+
+ private:
+  struct slot {
+    std::atomic<uint64_t> seq{0};
+    trace_event event;
+  };
+
+  std::unique_ptr<slot[]> slots_;
+  size_t capacity_;
+  uint32_t thread_;
+  std::atomic<uint64_t> head_{0};
+};
+
+}  // namespace detail
+
+/**
+ * @brief Process-wide timeline of layers, kernels and tasks.
+ *
+ * Disabled by default; while disabled an instrumented scope costs one
+ * relaxed atomic load. Every thread records into its own ring buffer of
+ * the last capacity events, so recording takes no lock. Buffers of exited
+ * threads are kept for the dump and reused by new threads, which bounds the
+ * memory by the peak number of threads.
+ *
+ * Typical use:
+ *
+ *     tracer::enable();
+ *     net.forward(batch);
+ *     tracer::disable();
+ *     tracer::save_chrome_trace("forward.json");  // chrome://tracing
+ */
+class tracer {
+ public:
+  static void enable(size_t capacity = 8192) {
+    state &s = get_state();
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.capacity = capacity;
+    }
+    s.enabled.store(true, std::memory_order_release);
+  }
+
+  static void disable() {
+    get_state().enabled.store(false, std::memory_order_release);
+  }
+
+  static bool enabled() {
+    return get_state().enabled.load(std::memory_order_relaxed);
+  }
+
+  /** nanoseconds since the tracer epoch */
+  static uint64_t now() {
+    return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - get_state().epoch)
+        .count());
+  }
+
+  static void record(trace_event e) {
+    detail::trace_buffer &buffer = local_buffer();
+    e.thread                     = buffer.thread();
+    buffer.push(e);
+  }
+
+  /**
+   * events of every thread, oldest first. Exact once the traced threads
+   * are idle; events recorded meanwhile may be missing.
+   */
+  static std::vector<trace_event> events() {
+    state &s = get_state();
+    std::vector<trace_event> out;
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      for (const auto &buffer : s.buffers) buffer->read(out);
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const trace_event &a, const trace_event &b) {
+                       return a.begin_ns < b.begin_ns;
+                     });
+    return out;
+  }
+
+  /**
+   * drops the recorded events, the traced threads must be idle
+   */
+  static void clear() {
+    state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (const auto &buffer : s.buffers) buffer->clear();
+  }
+
+  /**
+   * writes the events in the Chrome trace event format (JSON object form)
+   * understood by chrome://tracing and Perfetto
+   */
+  static void write_chrome_trace(std::ostream &os) {
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const trace_event &e : events()) {
+      os << (first ? "\n" : ",\n");
+      first = false;
+      os << "{\"name\":\"" << escape(e.name) << "\",\"cat\":\""
+         << escape(e.category) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+         << e.thread << ",\"ts\":" << microseconds(e.begin_ns)
+         << ",\"dur\":" << microseconds(e.duration_ns)
+         << ",\"args\":{\"batch\":" << e.batch << ",\"bytes\":" << e.bytes
+         << "}}";
+    }
+    os << "\n]}\n";
+  }
+
+  static void save_chrome_trace(const std::string &path) {
+    std::ofstream os(path);
+    if (!os) throw "Failed to open trace file";
+    write_chrome_trace(os);
+  }
+
+ private:
+  struct state {
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+    std::mutex mutex;
+    size_t capacity = 8192;
+    std::vector<std::shared_ptr<detail::trace_buffer>> buffers;
+    std::vector<detail::trace_buffer *> retired;
+  };
+
+  static state &get_state() {
+    static state s;
+    return s;
+  }
+
+  // hands the buffer back to the pool when its thread exits
+  struct buffer_lease {
+    detail::trace_buffer *buffer = nullptr;
+
+    ~buffer_lease() {
+      if (!buffer) return;
+      state &s = get_state();
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.retired.push_back(buffer);
+    }
+  };
+
+  static detail::trace_buffer &local_buffer() {
+    thread_local buffer_lease lease;
+    if (lease.buffer) return *lease.buffer;
+
+    state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.retired.empty()) {
+      lease.buffer = s.retired.back();
+      s.retired.pop_back();
+    } else {
+      s.buffers.push_back(std::make_shared<detail::trace_buffer>(
+        s.capacity, static_cast<uint32_t>(s.buffers.size() + 1)));
+      lease.buffer = s.buffers.back().get();
+    }
+    return *lease.buffer;
+  }
+
+  static std::string microseconds(uint64_t ns) {
+    std::string us = std::to_string(ns / 1000) + ".";
+    const std::string frac = std::to_string(ns % 1000);
+    return us + std::string(3 - frac.size(), '0') + frac;
+  }
+
+  static std::string escape(const char *s) {
+    std::string out;
+    for (; *s; s++) {
+      if (*s == '"' || *s == '\\') out += '\\';
+      if (static_cast<unsigned char>(*s) >= 0x20) out += *s;
+    }
+    return out;
+  }
+};
+
+/**
+ * bytes held by the samples of a list of tensors, reported by the traces
+ */
+inline uint64_t trace_bytes(const std::vector<tensor_t *> &tensors) {
+  uint64_t bytes = 0;
+  for (const tensor_t *t : tensors) {
+    if (!t) continue;
+    for (const vec_t &v : *t) bytes += v.size() * sizeof(float_t);
+  }
+  return bytes;
+}
+
+/**
+ * @brief Records the lifetime of a scope as a trace_event, when the tracer
+ * is enabled at construction.
+ *
+ * The name is only built when tracing, e.g.:
+ *
+ *     trace_scope trace("layer");
+ *     if (trace) trace.set_name(layer_type(), ".forward");
+ */
+class trace_scope {
+ public:
+  explicit trace_scope(const char *category,
+                       const char *name = nullptr,
+                       uint64_t batch   = 0,
+                       uint64_t bytes   = 0)
+    : active_(tracer::enabled()) {
+    if (!active_) return;
+    event_.category = category;
+    event_.batch    = batch;
+    event_.bytes    = bytes;
+    if (name) set_name(name);
+    event_.begin_ns = tracer::now();
+  }
+
+  ~trace_scope() {
+    if (!active_) return;
+    event_.duration_ns = tracer::now() - event_.begin_ns;
+    tracer::record(event_);
+  }
+
+  trace_scope(const trace_scope &) = delete;
+  trace_scope &operator=(const trace_scope &) = delete;
+
+  explicit operator bool() const { return active_; }
+
+  /** name of the event, prefix and suffix concatenated and truncated */
+  void set_name(const std::string &prefix, const char *suffix = "") {
+    const size_t size = sizeof(event_.name) - 1;
+    const size_t n    = std::min(prefix.size(), size);
+    std::memcpy(event_.name, prefix.data(), n);
+    const size_t m = std::min(std::strlen(suffix), size - n);
+    std::memcpy(event_.name + n, suffix, m);
+    event_.name[n + m] = '\0';
+  }
+
+  void set_args(uint64_t batch, uint64_t bytes) {
+    event_.batch = batch;
+    event_.bytes = bytes;
+  }
+
+ private:
+  bool active_;
+  trace_event event_;
+};
+
+}  // namespace litchi
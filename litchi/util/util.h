@@ -9,17 +9,40 @@
 #include "litchi/util/product.h"
 #include "litchi/util/random.h"
 
+#ifdef CNN_USE_HUGE_PAGES
+#include "litchi/util/huge_pages.h"
+#endif
+
 namespace litchi {
 
+#ifdef CNN_USE_HUGE_PAGES
+// large buffers may be mapped on huge pages, see set_huge_page_mode()
+typedef std::vector<float_t, huge_page_allocator<float_t>> vec_t;
+#else
 typedef std::vector<float_t> vec_t;
+#endif
 
 typedef std::vector<vec_t> tensor_t;
 
+/**
+ * order of the elements of a width x height x depth shape: channel-major
+ * (depth planes of height x width, the default) or channel-last (the depth
+ * values of a position contiguous)
+ */
+enum class data_layout { nchw, nhwc };
+
 template <typename T>
 struct index3d {
-  index3d(T width, T height, T depth) { reshape(width, height, depth); }
+  index3d(T width,
+          T height,
+          T depth,
+          data_layout layout = data_layout::nchw)
+    : layout_(layout) {
+    reshape(width, height, depth);
+  }
 
-  index3d() : width_(0), height_(0), depth_(0) {}
+  index3d()
+    : width_(0), height_(0), depth_(0), layout_(data_layout::nchw) {}
 
   void reshape(T width, T height, T depth) {
     width_  = width;
@@ -34,6 +57,9 @@ struct index3d {
     assert(x >= 0 && x < width_);
     assert(y >= 0 && y < height_);
     assert(channel >= 0 && channel < depth_);
+    if (layout_ == data_layout::nhwc) {
+      return (y * width_ + x) * depth_ + channel;
+    }
     return (height_ * channel + y) * width_ + x;
   }
 
@@ -41,11 +67,49 @@ struct index3d {
 
   T size() const { return width_ * height_ * depth_; }
 
+  /**
+   * whether both layouts order the elements alike: a single position or a
+   * single channel
+   */
+  bool layout_invariant() const { return area() == 1 || depth_ == 1; }
+
+  /**
+   * the same shape with its elements in another order
+   */
+  index3d with_layout(data_layout layout) const {
+    return index3d(width_, height_, depth_, layout);
+  }
+
   T width_;
   T height_;
   T depth_;
+  data_layout layout_;
 };
 
+template <typename T>
+bool operator==(const index3d<T> &lhs, const index3d<T> &rhs) {
+  return (lhs.width_ == rhs.width_) && (lhs.height_ == rhs.height_) &&
+         (lhs.depth_ == rhs.depth_);
+}
+
+template <typename T>
+bool operator!=(const index3d<T> &lhs, const index3d<T> &rhs) {
+  return !(lhs == rhs);
+}
+
+/**
+ * whether data written in shape a reads the same in shape b: both have the
+ * same layout, or both are channel-major, data of a single position or
+ * channel being channel-major whatever its layout
+ */
+template <typename T>
+bool same_memory_order(const index3d<T> &a, const index3d<T> &b) {
+  auto channel_major = [](const index3d<T> &s) {
+    return s.layout_ == data_layout::nchw || s.layout_invariant();
+  };
+  return a.layout_ == b.layout_ || (channel_major(a) && channel_major(b));
+}
+
 typedef index3d<size_t> shape3d;
 
 enum class vector_type : int32_t {
@@ -60,6 +124,8 @@ enum class vector_type : int32_t {
   aux   = 0x0010000  // layer-specific storage
 };
 
+enum class net_phase { train, test };
+
 inline vector_type operator&(vector_type lhs, vector_type rhs) {
   return (vector_type)(static_cast<int32_t>(lhs) & static_cast<int32_t>(rhs));
 }
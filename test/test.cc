@@ -6,5 +6,29 @@
 using namespace litchi::activation;
 
 #include "test_activation_layer.h"
+#include "test_async_network.h"
+#include "test_average_pooling_layer.h"
+#include "test_batch_normalization_layer.h"
+#include "test_checkpoint.h"
+#include "test_convolutional_layer.h"
+#include "test_data_loader.h"
+#include "test_execution_plan.h"
+#include "test_dropout_layer.h"
+#include "test_embedding_layer.h"
 #include "test_fully_connected_layer.h"
-#include "test_node.h"
\ No newline at end of file
+#include "test_gemm_tuner.h"
+#include "test_graph_executor.h"
+#include "test_graph_optimizer.h"
+#include "test_huge_pages.h"
+#include "test_layout.h"
+#include "test_low_rank.h"
+#include "test_max_pooling_layer.h"
+#include "test_memory_report.h"
+#include "test_node.h"
+#include "test_numa.h"
+#include "test_perf_counters.h"
+#include "test_recurrent_layer.h"
+#include "test_softmax_cross_entropy_layer.h"
+#include "test_streaming.h"
+#include "test_tracer.h"
+#include "test_workspace.h"
\ No newline at end of file
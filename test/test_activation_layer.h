@@ -34,4 +34,20 @@ TEST(relu, gradient_check) {
   }
 }
 
+TEST(sigmoid, gradient_check_full_coverage) {
+  const size_t width    = 4;
+  const size_t height   = 4;
+  const size_t channels = 8;
+  sigmoid sgm(width, height, channels);
+  std::vector<tensor_t> input_data =
+    generate_test_data({1}, {width * height * channels});
+
+  gradient_checker checker(sgm, input_data, 32);
+  std::vector<gradient_check_report> reports = checker.check();
+  ASSERT_EQ(reports.size(), 1u);
+  EXPECT_EQ(reports[0].probes, width * height * channels);
+  EXPECT_LT(reports[0].max_relative_error, epsilon<float_t>());
+  EXPECT_LE(reports[0].mean_relative_error, reports[0].max_relative_error);
+}
+
 }  // namespace litchi
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace litchi {
+
+#ifdef CNN_HAS_COROUTINES
+
+namespace {
+
+// coroutine running eagerly to its first suspension, nothing to join
+struct detached_task {
+  struct promise_type {
+    detached_task get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+struct awaited {
+  tensor_t output;
+  std::string error;
+  std::thread::id resumed_on;
+  std::promise<void> done;
+};
+
+detached_task await_inference(inference_handle handle, awaited &result) {
+  try {
+    result.output = co_await handle;
+  } catch (const char *e) {
+    result.error = e;
+  }
+  result.resumed_on = std::this_thread::get_id();
+  result.done.set_value();
+}
+
+}  // namespace
+
+TEST(async_network, co_await_resumes_on_worker) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(6, 3)
+      << std::make_shared<sigmoid>(3);
+  const tensor_t batch    = generate_test_data({4}, {6})[0];
+  const tensor_t expected = net.forward(batch);
+
+  // the callback holds the worker until the coroutine is suspended
+  std::promise<void> gate;
+  std::shared_future<void> opened = gate.get_future().share();
+  async_network async(net, 1);
+  inference_handle handle = async.submit(
+    batch, [opened](const tensor_t *, std::exception_ptr) { opened.wait(); });
+
+  awaited result;
+  std::future<void> done = result.done.get_future();
+  await_inference(handle, result);
+  EXPECT_EQ(done.wait_for(std::chrono::seconds(0)),
+            std::future_status::timeout);
+  gate.set_value();
+  done.wait();
+  EXPECT_EQ(result.output, expected);
+  EXPECT_TRUE(result.error.empty());
+  EXPECT_NE(result.resumed_on, std::this_thread::get_id());
+
+  // a finished inference does not suspend
+  awaited ready;
+  await_inference(handle, ready);
+  EXPECT_EQ(ready.output, expected);
+  EXPECT_EQ(ready.resumed_on, std::this_thread::get_id());
+}
+
+TEST(async_network, co_await_cancelled) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(4, 2);
+  const tensor_t batch = generate_test_data({3}, {4})[0];
+
+  std::promise<void> gate;
+  std::shared_future<void> opened = gate.get_future().share();
+  async_network async(net, 1);
+  async.submit(
+    batch, [opened](const tensor_t *, std::exception_ptr) { opened.wait(); });
+  inference_handle queued = async.submit(batch);
+
+  awaited result;
+  await_inference(queued, result);
+  EXPECT_TRUE(queued.cancel());
+  // resumed by cancel(), on this thread
+  EXPECT_EQ(result.error, "Inference cancelled");
+  EXPECT_TRUE(result.output.empty());
+  EXPECT_EQ(result.resumed_on, std::this_thread::get_id());
+  gate.set_value();
+}
+
+#endif  // CNN_HAS_COROUTINES
+
+}  // namespace litchi
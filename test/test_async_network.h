@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace litchi {
+
+TEST(async_network, futures_and_callbacks) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(8, 6)
+      << std::make_shared<sigmoid>(6)
+      << std::make_shared<fully_connected_layer>(6, 2);
+
+  std::vector<tensor_t> batches, expected;
+  for (size_t i = 1; i <= 4; i++) {
+    batches.push_back(generate_test_data({i}, {8})[0]);
+    expected.push_back(net.forward(batches.back()));
+  }
+
+  std::atomic<size_t> callbacks{0};
+  async_network async(net);
+  std::vector<inference_handle> handles;
+  for (const tensor_t &batch : batches) {
+    handles.push_back(
+      async.submit(batch, [&](const tensor_t *output, std::exception_ptr e) {
+        EXPECT_NE(output, nullptr);
+        EXPECT_FALSE(e);
+        callbacks++;
+      }));
+  }
+  for (size_t i = 0; i < handles.size(); i++) {
+    EXPECT_EQ(handles[i].get(), expected[i]);
+    EXPECT_EQ(handles[i].status(), inference_status::done);
+    EXPECT_FALSE(handles[i].cancel());
+  }
+  EXPECT_EQ(callbacks, handles.size());
+}
+
+TEST(async_network, shared_pool) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(8, 4)
+      << std::make_shared<relu>(4);
+  const tensor_t batch    = generate_test_data({5}, {8})[0];
+  const tensor_t expected = net.forward(batch);
+
+  std::atomic<size_t> other{0};
+  {
+    work_stealing_pool pool(2);
+    {
+      async_network async(net, pool);
+      std::vector<inference_handle> handles;
+      const std::thread::id caller = std::this_thread::get_id();
+      for (size_t i = 0; i < 8; i++) {
+        pool.submit([&]() { other++; });
+        handles.push_back(async.submit(
+          batch, [caller](const tensor_t *, std::exception_ptr) {
+            EXPECT_NE(std::this_thread::get_id(), caller);
+          }));
+      }
+      for (const inference_handle &h : handles) EXPECT_EQ(h.get(), expected);
+    }
+    // the pool outlives the network, still serving other work
+    std::promise<void> done;
+    pool.submit([&]() { done.set_value(); });
+    done.get_future().wait();
+  }
+  EXPECT_EQ(other, 8u);
+}
+
+TEST(async_network, cancellation) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(4, 2);
+  const tensor_t batch = generate_test_data({3}, {4})[0];
+
+  // the first callback holds the worker until the others are queued
+  std::promise<void> gate;
+  std::shared_future<void> opened = gate.get_future().share();
+  std::atomic<int> cancelled{0};
+  auto on_cancel = [&](const tensor_t *output, std::exception_ptr e) {
+    if (!output && !e) cancelled++;
+  };
+
+  async_network async(net);
+  inference_handle first = async.submit(
+    batch, [opened](const tensor_t *, std::exception_ptr) { opened.wait(); });
+  inference_handle second = async.submit(batch, on_cancel);
+  inference_handle third  = async.submit(batch);
+  inference_handle fourth = async.submit(batch, on_cancel);
+
+  EXPECT_TRUE(second.cancel());
+  EXPECT_FALSE(second.cancel());
+  EXPECT_EQ(second.status(), inference_status::cancelled);
+  EXPECT_ANY_THROW(second.get());
+  EXPECT_EQ(cancelled, 1);
+
+  gate.set_value();
+  EXPECT_EQ(third.get().size(), 3u);
+  EXPECT_EQ(first.status(), inference_status::done);
+
+  // cancelled through the network this time
+  EXPECT_EQ(fourth.get().size(), 3u);
+  std::promise<void> block;
+  std::shared_future<void> blocked = block.get_future().share();
+  async.submit(batch, [blocked](const tensor_t *output, std::exception_ptr) {
+    if (output) blocked.wait();  // not when cancelled on this thread
+  });
+  inference_handle queued = async.submit(batch, on_cancel);
+  // the blocking request may still be queued too
+  EXPECT_GE(async.cancel_all(), 1u);
+  EXPECT_EQ(queued.status(), inference_status::cancelled);
+  EXPECT_EQ(async.queued(), 0u);
+  block.set_value();
+}
+
+}  // namespace litchi
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+namespace litchi {
+
+TEST(average_pooling, forward) {
+  average_pooling_layer l(4, 4, 1, 2);
+  EXPECT_EQ(l.out_shape()[0], shape3d(2, 2, 1));
+
+  // clang-format off
+  vec_t in = {0, 1, 2, 3,
+              8, 7, 5, 6,
+              4, 3, 1, 2,
+              0,-1,-2,-3};
+  vec_t out_expected = {4, 4,
+                        1.5, -0.5};
+  // clang-format on
+  std::vector<const tensor_t *> o;
+  l.forward({{in}}, o);
+  for (size_t i = 0; i < out_expected.size(); i++) {
+    EXPECT_FLOAT_EQ(out_expected[i], (*o[0])[0][i]);
+  }
+}
+
+TEST(average_pooling, gradient_check) {
+  // overlapping strided windows
+  average_pooling_layer l(9, 7, 3, 3, 3, 2, 2);
+  EXPECT_EQ(l.out_shape()[0], shape3d(4, 3, 3));
+  std::vector<tensor_t> input_data = generate_test_data({2}, {9 * 7 * 3});
+
+  gradient_checker checker(l, input_data);
+  gradient_check_report report = checker.check_edge(0);
+  EXPECT_EQ(report.probes, 9u * 7 * 3);
+  EXPECT_LT(report.max_relative_error, epsilon<float_t>());
+}
+
+}  // namespace litchi
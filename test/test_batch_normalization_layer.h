@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+// runs forward_propagation of a batch normalization on x
+tensor_t batch_norm_forward(batch_normalization_layer &bn,
+                            tensor_t x,
+                            const vec_t &gamma,
+                            const vec_t &beta) {
+  tensor_t g{gamma}, b{beta}, y(x.size(), vec_t(x[0].size()));
+  std::vector<tensor_t *> in = {&x, &g, &b}, out = {&y};
+  bn.forward_propagation(in, out);
+  return y;
+}
+
+}  // namespace
+
+TEST(batch_normalization, statistics) {
+  // large offset: a two-moment (sum, sum of squares) variance would lose
+  // most of its digits
+  const size_t spatial = 5, channels = 3, batch = 16;
+  batch_normalization_layer bn(spatial, channels);
+  tensor_t x = generate_test_data({batch}, {spatial * channels})[0];
+  for (auto &v : x) {
+    for (size_t i = 0; i < v.size(); i++) v[i] += 1000.0f * (i / spatial + 1);
+  }
+
+  const vec_t gamma(channels, float_t{1}), beta(channels, float_t{0});
+  const tensor_t y = batch_norm_forward(bn, x, gamma, beta);
+
+  for (size_t c = 0; c < channels; c++) {
+    double mean = 0.0, out_mean = 0.0, out_var = 0.0;
+    for (size_t s = 0; s < batch; s++) {
+      for (size_t j = 0; j < spatial; j++) {
+        mean += x[s][c * spatial + j];
+        out_mean += y[s][c * spatial + j];
+      }
+    }
+    const double n = double(batch * spatial);
+    mean /= n;
+    out_mean /= n;
+    double var = 0.0;
+    for (size_t s = 0; s < batch; s++) {
+      for (size_t j = 0; j < spatial; j++) {
+        const double d = x[s][c * spatial + j] - mean;
+        const double o = y[s][c * spatial + j] - out_mean;
+        var += d * d;
+        out_var += o * o;
+      }
+    }
+    EXPECT_NEAR(bn.running_mean()[c], mean, 1e-3);
+    EXPECT_NEAR(bn.running_variance()[c], var / (n - 1), 1e-2 * var / n);
+    EXPECT_NEAR(out_mean, 0.0, 1e-3);
+    EXPECT_NEAR(out_var / n, 1.0, 1e-2);
+  }
+}
+
+TEST(batch_normalization, train_gradient) {
+  // the batch statistics couple the samples, so the whole batch is
+  // perturbed at once
+  const size_t spatial = 4, channels = 3, batch = 5, size = spatial * channels;
+  batch_normalization_layer bn(spatial, channels);
+  tensor_t x    = generate_test_data({batch}, {size})[0];
+  tensor_t r    = generate_test_data({batch}, {size})[0];
+  vec_t gamma   = generate_test_data({1}, {channels})[0][0];
+  vec_t beta    = generate_test_data({1}, {channels})[0][0];
+  auto loss     = [&](const tensor_t &in, const vec_t &g) {
+    const tensor_t y = batch_norm_forward(bn, in, g, beta);
+    double sum       = 0.0;
+    for (size_t s = 0; s < batch; s++) {
+      for (size_t i = 0; i < size; i++) sum += double(r[s][i]) * y[s][i];
+    }
+    return sum;
+  };
+
+  tensor_t g{gamma}, b{beta}, y(batch, vec_t(size));
+  tensor_t dx(batch, vec_t(size)), dgamma(batch, vec_t(channels));
+  tensor_t dbeta(batch, vec_t(channels));
+  std::vector<tensor_t *> in = {&x, &g, &b}, out = {&y};
+  std::vector<tensor_t *> in_grad = {&dx, &dgamma, &dbeta}, out_grad = {&r};
+  bn.forward_propagation(in, out);
+  bn.back_propagation(in, out, out_grad, in_grad);
+
+  const float_t h = 1e-2f;
+  for (size_t s = 0; s < batch; s++) {
+    for (size_t i = 0; i < size; i++) {
+      tensor_t xp = x, xm = x;
+      xp[s][i] += h;
+      xm[s][i] -= h;
+      const double numeric = (loss(xp, gamma) - loss(xm, gamma)) / (2 * h);
+      EXPECT_NEAR(dx[s][i], numeric, 1e-2);
+    }
+  }
+  for (size_t c = 0; c < channels; c++) {
+    vec_t gp = gamma, gm = gamma;
+    gp[c] += h;
+    gm[c] -= h;
+    const double numeric = (loss(x, gp) - loss(x, gm)) / (2 * h);
+    double analytic      = 0.0;
+    for (size_t s = 0; s < batch; s++) analytic += dgamma[s][c];
+    EXPECT_NEAR(analytic, numeric, 1e-2);
+  }
+}
+
+TEST(batch_normalization, inference_gradient_check) {
+  const size_t channels = 6;
+  batch_normalization_layer bn(1, channels);
+  bn.set_context(net_phase::test);
+  vec_t mean = generate_test_data({1}, {channels})[0][0];
+  vec_t var(channels);
+  for (size_t c = 0; c < channels; c++) var[c] = 0.5f + 0.1f * c;
+  bn.set_running_statistics(mean, var);
+
+  std::vector<tensor_t> input_data =
+    generate_test_data({1, 1, 1}, {channels, channels, channels});
+  gradient_checker checker(bn, input_data);
+  for (const auto &report : checker.check()) {
+    EXPECT_LT(report.max_relative_error, epsilon<float_t>());
+  }
+}
+
+TEST(graph_optimizer, fold_batch_norm) {
+  auto trained_bn = [](size_t spatial, size_t channels) {
+    auto bn = std::make_shared<batch_normalization_layer>(spatial, channels);
+    bn->setup(false);
+    uniform_rand(bn->weights()[0]->begin(), bn->weights()[0]->end(), 0.5f,
+                 2.0f);
+    uniform_rand(bn->weights()[1]->begin(), bn->weights()[1]->end(), -1.0f,
+                 1.0f);
+    vec_t mean = generate_test_data({1}, {channels})[0][0];
+    vec_t var(channels);
+    uniform_rand(var.begin(), var.end(), 0.1f, 2.0f);
+    bn->set_running_statistics(mean, var);
+    return bn;
+  };
+
+  sequential net;
+  net << std::make_shared<convolutional_layer>(6, 6, 3, 3, 2, 4, 1, 1, 1, 1)
+      << trained_bn(36, 4) << std::make_shared<relu>(144)
+      << std::make_shared<fully_connected_layer>(144, 10, false)
+      << trained_bn(1, 10);
+  net.set_context(net_phase::test);
+
+  tensor_t batch    = generate_test_data({3}, {6 * 6 * 2})[0];
+  tensor_t expected = net.forward(batch);
+
+  graph_optimizer_options options;
+  options.validation               = &batch;
+  graph_optimization_report report = optimize_graph(net, options);
+  EXPECT_TRUE(report.applied);
+  EXPECT_EQ(report.folded_norms, 2u);
+  ASSERT_EQ(net.size(), 3u);
+  EXPECT_EQ(net[0].layer_type(), "conv");
+  EXPECT_EQ(net[2].layer_type(), "fully-connected");
+  EXPECT_LT(report.flops_after, report.flops_before);
+  EXPECT_LT(report.max_abs_error, 1e-4f);
+
+  const tensor_t &out = net.forward(batch);
+  for (size_t s = 0; s < batch.size(); s++) {
+    for (size_t i = 0; i < 10; i++) {
+      EXPECT_NEAR(expected[s][i], out[s][i], 1e-4f);
+    }
+  }
+}
+
+}  // namespace litchi
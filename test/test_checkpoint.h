@@ -0,0 +1,105 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+// gradients of the input and of every weight after one training step
+std::vector<tensor_t> checkpoint_step(sequential &net, const tensor_t &in) {
+  net.clear_grads();
+  net.forward(in);
+  net.backward(tensor_t(in.size(), vec_t(net.output()[0].size(), 1.0f)));
+
+  std::vector<tensor_t> grads = {*net[0].prev()[0]->get_gradient()};
+  for (size_t i = 0; i < net.size(); i++) {
+    for (const edgeptr_t &e : net[i].prev()) {
+      if (is_trainable_weight(e->vtype())) grads.push_back(*e->get_gradient());
+    }
+  }
+  return grads;
+}
+
+}  // namespace
+
+TEST(checkpoint, sqrt_policy) {
+  EXPECT_EQ(sqrt_checkpoints(2), std::vector<bool>(2, false));
+  // segments of 3 layers, the last output is always kept
+  const std::vector<bool> nine = {false, false, true, false, false,
+                                  true,  false, false, false};
+  EXPECT_EQ(sqrt_checkpoints(9), nine);
+  const std::vector<bool> ten = {false, false, false, true,  false,
+                                 false, false, true,  false, false};
+  EXPECT_EQ(sqrt_checkpoints(10), ten);
+}
+
+TEST(checkpoint, same_gradients) {
+  sequential net;
+  for (size_t i = 0; i < 4; i++) {
+    net << std::make_shared<fully_connected_layer>(12, 12)
+        << std::make_shared<sigmoid>(12);
+  }
+  net << std::make_shared<fully_connected_layer>(12, 3);
+
+  const tensor_t in                    = generate_test_data({5}, {12})[0];
+  const std::vector<tensor_t> expected = checkpoint_step(net, in);
+  const tensor_t out                   = net.output();
+
+  net.set_sqrt_checkpoints();
+  for (int step = 0; step < 2; step++) {
+    const std::vector<tensor_t> grads = checkpoint_step(net, in);
+    ASSERT_EQ(grads.size(), expected.size());
+    for (size_t g = 0; g < grads.size(); g++) {
+      for (size_t s = 0; s < grads[g].size(); s++) {
+        for (size_t i = 0; i < grads[g][s].size(); i++) {
+          EXPECT_FLOAT_EQ(grads[g][s][i], expected[g][s][i]);
+        }
+      }
+    }
+    EXPECT_EQ(net.output(), out);
+  }
+
+  // back to keeping every output
+  net.clear_checkpoints();
+  EXPECT_EQ(checkpoint_step(net, in), expected);
+}
+
+TEST(checkpoint, lower_peak_memory) {
+  sequential net;
+  for (size_t i = 0; i < 8; i++) net << std::make_shared<relu>(256);
+  net << std::make_shared<fully_connected_layer>(256, 2);
+  const tensor_t in = generate_test_data({16}, {256})[0];
+
+  memory_tracker tracker;
+  net.set_memory_tracker(&tracker);
+  checkpoint_step(net, in);
+  const uint64_t full_peak     = tracker.peak();
+  const checkpoint_report full = net.checkpoint_cost(16);
+  EXPECT_EQ(full.checkpoints, 8u);
+  EXPECT_EQ(full.recompute_flops, 0u);
+  EXPECT_EQ(full.activation_bytes_peak, full.activation_bytes);
+
+  // the first step releases the outputs left by the previous one
+  net.set_sqrt_checkpoints();
+  checkpoint_step(net, in);
+  tracker.reset();
+  checkpoint_step(net, in);
+  EXPECT_LT(tracker.peak(), full_peak);
+  EXPECT_EQ(tracker.current(), memory_in_use(net.layers()));
+
+  const checkpoint_report plan = net.checkpoint_cost(16);
+  EXPECT_EQ(plan.layers, 9u);
+  EXPECT_EQ(plan.checkpoints, 2u);
+  EXPECT_EQ(plan.longest_segment, 2u);
+  EXPECT_GT(plan.recompute_flops, 0u);
+  EXPECT_LT(plan.recompute_flops, plan.forward_flops);
+  // checkpoints 2 and 5, the output and a segment of two layers
+  const uint64_t out_bytes = 16 * 256 * sizeof(float_t);
+  EXPECT_EQ(plan.activation_bytes, 8 * out_bytes + 16 * 2 * sizeof(float_t));
+  EXPECT_EQ(plan.activation_bytes_peak,
+            4 * out_bytes + 16 * 2 * sizeof(float_t));
+}
+
+}  // namespace litchi
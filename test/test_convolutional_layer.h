@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+
+namespace litchi {
+
+// direct convolution used as a reference for the implicit GEMM kernel
+inline vec_t naive_conv2d(const vec_t &x,
+                          const vec_t &W,
+                          const vec_t *bias,
+                          const core::conv_params &p) {
+  const size_t cin_g  = p.in_channels_per_group();
+  const size_t cout_g = p.out_channels_per_group();
+  vec_t y(p.out.size());
+  for (size_t o = 0; o < p.out.depth_; o++) {
+    const size_t g = o / cout_g;
+    for (size_t oy = 0; oy < p.out.height_; oy++) {
+      for (size_t ox = 0; ox < p.out.width_; ox++) {
+        float_t sum = bias ? (*bias)[o] : float_t{0};
+        for (size_t c = 0; c < cin_g; c++) {
+          for (size_t ky = 0; ky < p.weight.height_; ky++) {
+            for (size_t kx = 0; kx < p.weight.width_; kx++) {
+              const long iy = long(oy * p.h_stride + ky * p.h_dilation) -
+                              long(p.h_padding);
+              const long ix = long(ox * p.w_stride + kx * p.w_dilation) -
+                              long(p.w_padding);
+              if (iy < 0 || ix < 0 || iy >= long(p.in.height_) ||
+                  ix >= long(p.in.width_)) {
+                continue;
+              }
+              const size_t ci = g * cin_g + c;
+              sum += W[((o * cin_g + c) * p.weight.height_ + ky) *
+                         p.weight.width_ +
+                       kx] *
+                     x[(ci * p.in.height_ + size_t(iy)) * p.in.width_ +
+                       size_t(ix)];
+            }
+          }
+        }
+        y[(o * p.out.height_ + oy) * p.out.width_ + ox] = sum;
+      }
+    }
+  }
+  return y;
+}
+
+TEST(convolutional, output_shape) {
+  convolutional_layer l(7, 9, 3, 3, 4, 6, 2, 2, 1, 1, 2, 2, 2);
+  EXPECT_EQ(l.out_shape()[0], shape3d(3, 4, 6));
+  EXPECT_EQ(l.in_shape()[1], shape3d(3, 3, 2 * 6));
+  EXPECT_EQ(l.in_shape()[2], shape3d(1, 1, 6));
+  EXPECT_EQ(l.flops(), 2u * 3 * 4 * 6 * (2 * 3 * 3) + 3 * 4 * 6);
+
+  EXPECT_ANY_THROW(convolutional_layer(5, 5, 3, 3, 3, 4, 1, 1, 0, 0, 1, 1, 2));
+  EXPECT_ANY_THROW(convolutional_layer(2, 2, 3, 3, 1, 1));
+}
+
+TEST(convolutional, forward_matches_direct) {
+  // stride, padding, dilation and groups all differ from their defaults
+  convolutional_layer l(11, 10, 3, 2, 4, 6, 2, 1, 1, 2, 2, 1, 2);
+  l.setup(false);
+  std::vector<vec_t *> w = l.weights();
+  uniform_rand(w[0]->begin(), w[0]->end(), -1.0f, 1.0f);
+  uniform_rand(w[1]->begin(), w[1]->end(), -1.0f, 1.0f);
+
+  const size_t in_size = 11 * 10 * 4;
+  tensor_t batch       = generate_test_data({3}, {in_size})[0];
+  std::vector<const tensor_t *> o;
+  l.forward({batch}, o);
+
+  for (size_t s = 0; s < batch.size(); s++) {
+    const vec_t expected = naive_conv2d(batch[s], *w[0], w[1], l.params());
+    ASSERT_EQ((*o[0])[s].size(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_NEAR(expected[i], (*o[0])[s][i], 1e-4f);
+    }
+  }
+}
+
+TEST(convolutional, gradient_check) {
+  convolutional_layer l(6, 5, 3, 3, 4, 4, 2, 1, 1, 1, 1, 2, 2);
+  const shape3d in = l.in_shape()[0];
+  const shape3d w  = l.in_shape()[1];
+  std::vector<tensor_t> input_data =
+    generate_test_data({2, 1, 1}, {in.size(), w.size(), 4});
+
+  gradient_checker checker(l, input_data);
+  std::vector<gradient_check_report> reports = checker.check();
+  ASSERT_EQ(reports.size(), 3u);  // in, W and b
+  for (const auto &report : reports) {
+    EXPECT_LT(report.max_relative_error, epsilon<float_t>());
+  }
+}
+
+}  // namespace litchi
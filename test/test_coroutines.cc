@@ -0,0 +1,8 @@
+#include "gtest/gtest.h"
+
+#include "litchi/litchi.h"
+#include "test/testhelper.h"
+
+using namespace litchi::activation;
+
+#include "test_async_coroutines.h"
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace litchi {
+
+inline std::string write_test_dataset(size_t samples,
+                                      size_t sample_size,
+                                      size_t label_size) {
+  std::string path = temp_path("dataset.bin");
+  dataset_writer writer(path, sample_size, label_size);
+  for (size_t i = 0; i < samples; i++) {
+    // every value encodes the index of its sample
+    writer.write(vec_t(sample_size, float_t(i)),
+                 vec_t(label_size, -float_t(i)));
+  }
+  writer.close();
+  return path;
+}
+
+TEST(dataset, mmap_roundtrip) {
+  std::string path = write_test_dataset(10, 4, 1);
+  mmap_dataset dataset(path);
+  EXPECT_EQ(dataset.size(), 10u);
+  EXPECT_EQ(dataset.sample_size(), 4u);
+  EXPECT_EQ(dataset.label_size(), 1u);
+  for (size_t i = 0; i < dataset.size(); i++) {
+    EXPECT_FLOAT_EQ(dataset.sample(i)[3], float_t(i));
+    EXPECT_FLOAT_EQ(dataset.label(i)[0], -float_t(i));
+  }
+}
+
+TEST(index_stream, permutation) {
+  const size_t count = 1000;
+  index_stream stream(count, true, 42);
+  std::set<size_t> epoch0, epoch1;
+  std::vector<size_t> order0;
+  for (size_t i = 0; i < count; i++) {
+    order0.push_back(stream[i]);
+    epoch0.insert(stream[i]);
+  }
+  stream.reset(1);
+  bool same_order = true;
+  for (size_t i = 0; i < count; i++) {
+    epoch1.insert(stream[i]);
+    same_order = same_order && stream[i] == order0[i];
+  }
+  EXPECT_EQ(epoch0.size(), count);
+  EXPECT_EQ(epoch1.size(), count);
+  EXPECT_LT(*epoch0.rbegin(), count);
+  EXPECT_FALSE(same_order);
+}
+
+TEST(data_loader, epochs) {
+  const size_t samples = 103;
+  std::string path     = write_test_dataset(samples, 8, 1);
+  mmap_dataset dataset(path);
+  data_loader loader(dataset, 10, true, 3);
+  EXPECT_EQ(loader.batches_per_epoch(), 11u);
+
+  tensor_t data, labels;
+  for (size_t epoch = 0; epoch < 2; epoch++) {
+    std::set<size_t> seen;
+    size_t batches = 0;
+    while (loader.next(data, labels)) {
+      ASSERT_EQ(data.size(), labels.size());
+      for (size_t i = 0; i < data.size(); i++) {
+        ASSERT_EQ(data[i].size(), 8u);
+        EXPECT_FLOAT_EQ(labels[i][0], -data[i][0]);
+        seen.insert(static_cast<size_t>(data[i][0]));
+      }
+      batches++;
+    }
+    EXPECT_EQ(batches, 11u);
+    EXPECT_EQ(seen.size(), samples);
+  }
+}
+
+TEST(data_loader, feeds_layer) {
+  std::string path = write_test_dataset(6, 4, 0);
+  mmap_dataset dataset(path);
+  data_loader loader(dataset, 4, false);
+
+  fully_connected_layer l(4, 2);
+  l.weight_init(weight_init::constant(1.0));
+  l.bias_init(weight_init::constant(0.5));
+  l.setup(false);
+
+  ASSERT_TRUE(loader.next(*l.input_tensor(0)));
+  l.forward();
+  std::vector<const tensor_t *> out;
+  l.output(out);
+  ASSERT_EQ(out[0]->size(), 4u);
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_FLOAT_EQ((*out[0])[i][0], 4 * float_t(i) + 0.5f);
+  }
+
+  ASSERT_TRUE(loader.next(*l.input_tensor(0)));
+  EXPECT_EQ(l.input_tensor(0)->size(), 2u);
+  EXPECT_FALSE(loader.next(*l.input_tensor(0)));
+}
+
+}  // namespace litchi
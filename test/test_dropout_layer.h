@@ -0,0 +1,163 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+TEST(dropout, philox_known_answers) {
+  // test vectors of the Random123 reference implementation
+  const uint32_t zero[4] = {0, 0, 0, 0};
+  const uint32_t pi[4]   = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+  uint32_t out[4];
+
+  philox4x32(0)(zero, out);
+  EXPECT_EQ(out[0], 0x6627e8d5u);
+  EXPECT_EQ(out[1], 0xe169c58du);
+  EXPECT_EQ(out[2], 0xbc57ac4cu);
+  EXPECT_EQ(out[3], 0x9b00dbd8u);
+
+  philox4x32(0x299f31d0a4093822ull)(pi, out);
+  EXPECT_EQ(out[0], 0xd16cfe09u);
+  EXPECT_EQ(out[1], 0x94fdccebu);
+  EXPECT_EQ(out[2], 0x5001e420u);
+  EXPECT_EQ(out[3], 0x24126ea1u);
+}
+
+TEST(dropout, philox_generate) {
+  // the vectorized blocks match the scalar ones, across the 2^32 carry
+  const philox4x32 gen(0x0123456789abcdefull);
+  const uint64_t first = (uint64_t(1) << 32) - 5;
+  std::vector<uint32_t> blocks(4 * 11);
+  gen.generate(first, 11, &blocks[0]);
+  for (uint64_t b = 0; b < 11; b++) {
+    const uint64_t n    = first + b;
+    const uint32_t c[4] = {uint32_t(n), uint32_t(n >> 32), 0, 0};
+    uint32_t out[4];
+    gen(c, out);
+    for (size_t i = 0; i < 4; i++) EXPECT_EQ(blocks[4 * b + i], out[i]);
+  }
+}
+
+TEST(dropout, bernoulli_mask) {
+  const philox4x32 gen(42);
+  const size_t size = 64 * 1000;
+  std::vector<uint64_t> mask(size / 64);
+  bernoulli_mask(gen, 0, size, 3 << 14, &mask[0]);  // p = 0.75
+
+  size_t kept = 0;
+  for (uint64_t w : mask) {
+    for (size_t i = 0; i < 64; i++) kept += (w >> i) & 1;
+  }
+  EXPECT_NEAR(float_t(kept) / size, 0.75, 0.01);
+
+  // the bits of a word are the comparisons of its 16-bit uniforms
+  uint32_t random[4 * bernoulli_mask_blocks];
+  gen.generate(7 * bernoulli_mask_blocks, bernoulli_mask_blocks, random);
+  for (size_t i = 0; i < 64; i++) {
+    const uint32_t u = (random[i / 2] >> (16 * (i % 2))) & 0xffff;
+    EXPECT_EQ((mask[7] >> i) & 1, uint64_t(u < (3u << 14)));
+  }
+}
+
+TEST(dropout, mask_scale) {
+  const size_t size = 77;
+  vec_t x = generate_test_data({1}, {size})[0][0], y(size), expected(size);
+  const uint64_t mask[2] = {0xf0f0a5a5deadbeefull, 0x1234ull};
+  vectorize::mask_scale(&x[0], mask, size, float_t(2), &y[0]);
+  for (size_t i = 0; i < size; i++) {
+    const bool keep = (mask[i / 64] >> (i % 64)) & 1;
+    EXPECT_EQ(y[i], keep ? x[i] * 2 : float_t{0});
+  }
+}
+
+TEST(dropout, forward_backward) {
+  const size_t in = 300, batch = 5;
+  dropout_layer dropout(in, float_t(0.3));
+  tensor_t x  = generate_test_data({batch}, {in})[0];
+  tensor_t dy = generate_test_data({batch}, {in})[0];
+  tensor_t y(batch, vec_t(in)), dx(batch, vec_t(in));
+  std::vector<tensor_t *> in_data = {&x}, out_data = {&y};
+  std::vector<tensor_t *> out_grad = {&dy}, in_grad = {&dx};
+  dropout.forward_propagation(in_data, out_data);
+  dropout.back_propagation(in_data, out_data, out_grad, in_grad);
+
+  const float_t scale = float_t(1) / float_t(0.7);
+  size_t kept         = 0;
+  for (size_t s = 0; s < batch; s++) {
+    const uint64_t *mask = dropout.mask(s);
+    for (size_t i = 0; i < in; i++) {
+      const bool keep = (mask[i / 64] >> (i % 64)) & 1;
+      kept += keep;
+      EXPECT_FLOAT_EQ(y[s][i], keep ? x[s][i] * scale : float_t{0});
+      EXPECT_FLOAT_EQ(dx[s][i], keep ? dy[s][i] * scale : float_t{0});
+    }
+  }
+  EXPECT_NEAR(float_t(kept) / (batch * in), 0.7, 0.05);
+
+  // the next pass draws another mask
+  const tensor_t first = y;
+  dropout.forward_propagation(in_data, out_data);
+  EXPECT_NE(first, y);
+}
+
+TEST(dropout, inference_pass_through) {
+  dropout_layer dropout(10, float_t(0.5));
+  dropout.set_context(net_phase::test);
+  tensor_t x = generate_test_data({3}, {10})[0], y(3, vec_t(10));
+  tensor_t dx(3, vec_t(10));
+  std::vector<tensor_t *> in_data = {&x}, out_data = {&y};
+  std::vector<tensor_t *> out_grad = {&x}, in_grad = {&dx};
+  dropout.forward_propagation(in_data, out_data);
+  dropout.back_propagation(in_data, out_data, out_grad, in_grad);
+  EXPECT_EQ(y, x);
+  EXPECT_EQ(dx, x);
+}
+
+TEST(dropout, reproducible) {
+  // a seed of the global generator fixes the masks
+  tensor_t x = tensor_t(2, vec_t(100, float_t{1}));
+  auto run   = [&]() {
+    set_random_seed(7);
+    dropout_layer dropout(100, float_t(0.5));
+    tensor_t y(2, vec_t(100));
+    std::vector<tensor_t *> in_data = {&x}, out_data = {&y};
+    dropout.forward_propagation(in_data, out_data);
+    return y;
+  };
+  EXPECT_EQ(run(), run());
+}
+
+TEST(dropout, recomputed_under_checkpoints) {
+  // the output of the dropout is dropped after the forward pass and
+  // recomputed by backward(): it must draw the same mask again
+  auto step = [](bool checkpoint, std::vector<uint64_t> *masks) {
+    set_random_seed(11);
+    auto dropout = std::make_shared<dropout_layer>(16, float_t(0.5));
+    sequential net;
+    net << std::make_shared<fully_connected_layer>(8, 16) << dropout
+        << std::make_shared<fully_connected_layer>(16, 16)
+        << std::make_shared<fully_connected_layer>(16, 4);
+    if (checkpoint) net.set_checkpoint(2);
+    const tensor_t x = tensor_t(3, vec_t(8, float_t{1}));
+    net.forward(x);
+    const std::vector<uint64_t> before(dropout->mask(0),
+                                       dropout->mask(0) + 3);
+    net.backward(tensor_t(3, vec_t(4, float_t{1})));
+    masks->assign(dropout->mask(0), dropout->mask(0) + 3);
+    EXPECT_EQ(*masks, before);
+    return *net[0].prev()[0]->get_gradient();
+  };
+  std::vector<uint64_t> plain_masks, checkpoint_masks;
+  const tensor_t expected = step(false, &plain_masks);
+  const tensor_t dx       = step(true, &checkpoint_masks);
+  EXPECT_EQ(checkpoint_masks, plain_masks);
+  ASSERT_EQ(dx.size(), expected.size());
+  for (size_t s = 0; s < dx.size(); s++) {
+    for (size_t i = 0; i < dx[s].size(); i++) {
+      EXPECT_FLOAT_EQ(dx[s][i], expected[s][i]);
+    }
+  }
+}
+
+}  // namespace litchi
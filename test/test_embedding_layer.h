@@ -0,0 +1,153 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+// bag of indices of a sample, padded to bag_size
+vec_t embedding_bag(const std::vector<uint32_t> &rows, size_t bag_size) {
+  vec_t bag(bag_size, embedding_layer::index(embedding_layer::no_index));
+  for (size_t k = 0; k < rows.size(); k++) {
+    bag[k] = embedding_layer::index(rows[k]);
+  }
+  return bag;
+}
+
+}  // namespace
+
+TEST(embedding, index_roundtrip) {
+  // indices beyond 2^24 are not exact as float values
+  const uint32_t large = (1u << 24) + 1;
+  EXPECT_EQ(embedding_layer::row_of(embedding_layer::index(large)), large);
+  EXPECT_EQ(embedding_layer::row_of(embedding_layer::index(0)), 0u);
+}
+
+TEST(embedding, forward_pooling) {
+  const size_t rows = 10, dim = 5, bag = 3;
+  tensor_t table = generate_test_data({1}, {rows * dim})[0];
+  tensor_t x     = {embedding_bag({1, 4, 1}, bag), embedding_bag({7}, bag),
+                    embedding_bag({}, bag)};
+
+  for (auto pooling : {embedding_pooling::sum, embedding_pooling::mean}) {
+    embedding_layer emb(rows, dim, bag, pooling);
+    tensor_t y(x.size(), vec_t(dim));
+    std::vector<tensor_t *> in_data  = {&x, &table};
+    std::vector<tensor_t *> out_data = {&y};
+    emb.forward_propagation(in_data, out_data);
+
+    const std::vector<std::vector<uint32_t>> bags = {{1, 4, 1}, {7}, {}};
+    for (size_t s = 0; s < x.size(); s++) {
+      for (size_t j = 0; j < dim; j++) {
+        float_t expected = float_t{0};
+        for (uint32_t r : bags[s]) expected += table[0][r * dim + j];
+        if (pooling == embedding_pooling::mean && !bags[s].empty()) {
+          expected /= float_t(bags[s].size());
+        }
+        EXPECT_NEAR(y[s][j], expected, 1e-6);
+      }
+    }
+  }
+}
+
+TEST(embedding, out_of_range) {
+  embedding_layer emb(4, 2);
+  tensor_t table(1, vec_t(8)), x = {embedding_bag({4}, 1)}, y(1, vec_t(2));
+  std::vector<tensor_t *> in_data  = {&x, &table};
+  std::vector<tensor_t *> out_data = {&y};
+  EXPECT_THROW(emb.forward_propagation(in_data, out_data), const char *);
+}
+
+TEST(embedding, sparse_gradient) {
+  const size_t rows = 50, dim = 4, bag = 3;
+  embedding_layer emb(rows, dim, bag, embedding_pooling::mean);
+  tensor_t table = generate_test_data({1}, {rows * dim})[0];
+  const std::vector<std::vector<uint32_t>> bags = {{3, 17}, {17, 17, 42}};
+  tensor_t x = {embedding_bag(bags[0], bag), embedding_bag(bags[1], bag)};
+  tensor_t y(2, vec_t(dim)), dy = generate_test_data({2}, {dim})[0];
+  tensor_t dx(2, vec_t(bag)), dtable;
+  std::vector<tensor_t *> in_data  = {&x, &table};
+  std::vector<tensor_t *> out_data = {&y}, out_grad = {&dy};
+  std::vector<tensor_t *> in_grad  = {&dx, &dtable};
+  emb.forward_propagation(in_data, out_data);
+  emb.back_propagation(in_data, out_data, out_grad, in_grad);
+
+  // the dense gradient of the table, row by row
+  vec_t dense(rows * dim, float_t{0});
+  for (size_t s = 0; s < bags.size(); s++) {
+    for (uint32_t r : bags[s]) {
+      for (size_t j = 0; j < dim; j++) {
+        dense[r * dim + j] += dy[s][j] / float_t(bags[s].size());
+      }
+    }
+  }
+
+  const embedding_gradient &g = emb.sparse_gradient();
+  ASSERT_EQ(g.rows, std::vector<uint32_t>({3, 17, 42}));
+  ASSERT_EQ(g.values.size(), 3 * dim);
+  for (size_t u = 0; u < g.rows.size(); u++) {
+    for (size_t j = 0; j < dim; j++) {
+      EXPECT_NEAR(g.values[u * dim + j], dense[g.rows[u] * dim + j], 1e-6);
+    }
+  }
+  EXPECT_TRUE(dtable.empty());
+}
+
+TEST(embedding, update_touched_rows) {
+  const size_t rows = 20, dim = 3, bag = 2;
+  const std::vector<std::vector<uint32_t>> bags = {{2, 5}, {5}, {11, 2}};
+
+  for (bool hogwild : {false, true}) {
+    embedding_layer emb(rows, dim, bag);
+    emb.set_parallelize(false);
+    emb.set_hogwild(hogwild);
+    vec_t &W = *emb.weights()[0];
+    W        = generate_test_data({1}, {rows * dim})[0][0];
+    const vec_t before = W;
+
+    tensor_t table = {W}, y(bags.size(), vec_t(dim)), dx(bags.size());
+    tensor_t x, dy(bags.size(), vec_t(dim, float_t{1})), dtable;
+    for (const auto &b : bags) x.push_back(embedding_bag(b, bag));
+    std::vector<tensor_t *> in_data  = {&x, &table};
+    std::vector<tensor_t *> out_data = {&y}, out_grad = {&dy};
+    std::vector<tensor_t *> in_grad  = {&dx, &dtable};
+    emb.forward_propagation(in_data, out_data);
+    emb.back_propagation(in_data, out_data, out_grad, in_grad);
+    emb.update(float_t(0.5));
+
+    // a row moves by 0.5 per lookup
+    for (size_t r = 0; r < rows; r++) {
+      const float_t lookups = r == 2 || r == 5 ? 2 : r == 11 ? 1 : 0;
+      for (size_t j = 0; j < dim; j++) {
+        EXPECT_NEAR(W[r * dim + j], before[r * dim + j] - lookups / 2, 1e-6);
+      }
+    }
+    EXPECT_EQ(emb.sparse_gradient().rows.empty(), hogwild);
+  }
+}
+
+TEST(embedding, network) {
+  const size_t rows = 1000, dim = 8, bag = 4, batch = 6;
+  sequential net;
+  auto emb = std::make_shared<embedding_layer>(rows, dim, bag);
+  net << emb << std::make_shared<fully_connected_layer>(dim, 2);
+
+  tensor_t x;
+  for (uint32_t s = 0; s < batch; s++) {
+    x.push_back(embedding_bag({s, 100 + s, 999}, bag));
+  }
+  net.forward(x);
+  net.backward(tensor_t(batch, vec_t(2, float_t{1})));
+
+  // the table gradient edge holds nothing; the sparse one the touched rows
+  EXPECT_TRUE(emb->prev()[1]->get_gradient()->empty());
+  EXPECT_EQ(emb->sparse_gradient().rows.size(), 2 * batch + 1);
+  const vec_t before = *emb->weights()[0];
+  emb->update(float_t(0.1));
+  EXPECT_EQ((*emb->weights()[0])[500 * dim], before[500 * dim]);
+  EXPECT_NE((*emb->weights()[0])[999 * dim], before[999 * dim]);
+}
+
+}  // namespace litchi
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+void build_plan_net(sequential &net) {
+  net << std::make_shared<convolutional_layer>(8, 8, 3, 3, 2, 4)
+      << std::make_shared<relu>(6, 6, 4)
+      << std::make_shared<max_pooling_layer>(6, 6, 4, 2)
+      << std::make_shared<fully_connected_layer>(3 * 3 * 4, 5);
+}
+
+}  // namespace
+
+TEST(execution_plan, matches_forward) {
+  sequential net;
+  build_plan_net(net);
+  execution_plan plan = compile_network(net, 3);
+  EXPECT_EQ(plan.batch_size(), 3u);
+  ASSERT_EQ(plan.instructions().size(), net.size());
+  EXPECT_EQ(plan.instructions()[1].target, &net[1]);
+
+  for (int pass = 0; pass < 2; pass++) {
+    const tensor_t x        = generate_test_data({3}, {8 * 8 * 2})[0];
+    const tensor_t expected = net.forward(x);
+    const tensor_t &y       = plan.run(x);
+    ASSERT_EQ(y.size(), 3u);
+    for (size_t s = 0; s < 3; s++) {
+      for (size_t i = 0; i < 5; i++) EXPECT_FLOAT_EQ(y[s][i], expected[s][i]);
+    }
+  }
+}
+
+TEST(execution_plan, input_in_place) {
+  sequential net;
+  build_plan_net(net);
+  execution_plan plan = compile_network(net, 2);
+  const tensor_t x    = generate_test_data({2}, {8 * 8 * 2})[0];
+  const tensor_t expected = net.forward(x);
+
+  // the buffers resolved at compile time are the ones run() uses
+  const float_t *in  = &plan.input()[0][0];
+  const float_t *out = &plan.output()[0][0];
+  for (size_t s = 0; s < 2; s++) {
+    std::copy(x[s].begin(), x[s].end(), plan.input()[s].begin());
+  }
+  const tensor_t &y = plan.run();
+  EXPECT_EQ(&plan.input()[0][0], in);
+  EXPECT_EQ(&y[0][0], out);
+  for (size_t s = 0; s < 2; s++) {
+    for (size_t i = 0; i < 5; i++) EXPECT_FLOAT_EQ(y[s][i], expected[s][i]);
+  }
+}
+
+TEST(execution_plan, no_allocation) {
+  sequential net;
+  build_plan_net(net);
+  for (size_t i = 0; i < net.size(); i++) net[i].set_parallelize(false);
+  execution_plan plan = compile_network(net, 8);
+  const tensor_t x    = generate_test_data({8}, {8 * 8 * 2})[0];
+  plan.run(x);
+
+  const size_t before = heap_allocations;
+  for (int pass = 0; pass < 3; pass++) plan.run();
+  EXPECT_EQ(heap_allocations - before, 0u);
+}
+
+TEST(execution_plan, network_ran_on_another_batch) {
+  sequential net;
+  build_plan_net(net);
+  execution_plan plan = compile_network(net, 4);
+  const tensor_t x    = generate_test_data({4}, {8 * 8 * 2})[0];
+  plan.run(x);
+
+  // the network shrank the buffers the plan borrows
+  net.forward(generate_test_data({2}, {8 * 8 * 2})[0]);
+  EXPECT_THROW(plan.run(x), const char *);
+  EXPECT_THROW(plan.run(), const char *);
+
+  // back on the compiled batch size the plan runs again
+  const tensor_t expected = net.forward(x);
+  const tensor_t &y       = plan.run(x);
+  for (size_t s = 0; s < 4; s++) {
+    for (size_t i = 0; i < 5; i++) EXPECT_FLOAT_EQ(y[s][i], expected[s][i]);
+  }
+}
+
+TEST(execution_plan, errors) {
+  sequential empty;
+  EXPECT_THROW(compile_network(empty, 1), const char *);
+
+  sequential net;
+  build_plan_net(net);
+  EXPECT_THROW(compile_network(net, 0), const char *);
+  execution_plan plan = compile_network(net, 4);
+  EXPECT_THROW(plan.run(generate_test_data({3}, {8 * 8 * 2})[0]),
+               const char *);
+  EXPECT_THROW(plan.run(generate_test_data({4}, {10})[0]), const char *);
+
+  net.set_sqrt_checkpoints();
+  EXPECT_THROW(compile_network(net, 4), const char *);
+}
+
+}  // namespace litchi
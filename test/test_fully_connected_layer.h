@@ -22,4 +22,83 @@ TEST(fully_connected, forward) {
   }
 }
 
+TEST(fully_connected, small_batch) {
+  // large enough for gemv() to split the columns over threads
+  const size_t in_size = 700, out_size = 600, batch = 9;
+  fully_connected_layer fc(in_size, out_size);
+  std::vector<tensor_t> data = generate_test_data(
+    {batch, 1, 1}, {in_size, in_size * out_size, out_size});
+
+  // the batch goes through gemm(), single samples through gemv()
+  tensor_t expected(batch, vec_t(out_size));
+  std::vector<tensor_t *> in_data  = {&data[0], &data[1], &data[2]};
+  std::vector<tensor_t *> out_data = {&expected};
+  fc.forward_propagation(in_data, out_data);
+
+  for (size_t sample = 0; sample < batch; sample++) {
+    tensor_t x(1, data[0][sample]), y(1, vec_t(out_size));
+    in_data  = {&x, &data[1], &data[2]};
+    out_data = {&y};
+    fc.forward_propagation(in_data, out_data);
+    for (size_t i = 0; i < out_size; i++) {
+      EXPECT_NEAR(y[0][i], expected[sample][i], 1e-4);
+    }
+  }
+
+  // a few samples share one pass over W
+  for (size_t count = 2; count <= kernels::fully_connected_gemv_batch;
+       count++) {
+    tensor_t x(data[0].begin(), data[0].begin() + count);
+    tensor_t y(count, vec_t(out_size));
+    in_data  = {&x, &data[1], &data[2]};
+    out_data = {&y};
+    fc.forward_propagation(in_data, out_data);
+    for (size_t sample = 0; sample < count; sample++) {
+      for (size_t i = 0; i < out_size; i++) {
+        EXPECT_NEAR(y[sample][i], expected[sample][i], 1e-4);
+      }
+    }
+  }
+}
+
+TEST(fully_connected, gradient_check) {
+  const size_t in_size  = 30;
+  const size_t out_size = 20;
+  fully_connected_layer fc(in_size, out_size);
+  std::vector<tensor_t> input_data = generate_test_data(
+    {1, 1, 1}, {in_size, in_size * out_size, out_size});
+
+  gradient_checker checker(fc, input_data);
+  std::vector<gradient_check_report> reports = checker.check();
+  ASSERT_EQ(reports.size(), 3u);  // in, W and b
+  EXPECT_EQ(reports[0].probes, in_size);
+  EXPECT_EQ(reports[1].probes, in_size * out_size);
+  EXPECT_EQ(reports[2].probes, out_size);
+  for (const auto &report : reports) {
+    EXPECT_LT(report.max_relative_error, epsilon<float_t>());
+  }
+}
+
+TEST(fully_connected, gradient_check_large) {
+  fully_connected_layer fc(256, 128, false);
+  std::vector<tensor_t> input_data =
+    generate_test_data({1, 1}, {256, 256 * 128});
+
+  // on the workers of a pool, so that the weight probes spread over four
+  // copies of the layer whatever the machine
+  gradient_check_report data_report, weight_report;
+  {
+    work_stealing_pool pool(4);
+    pool.submit([&]() {
+      gradient_checker checker(fc, input_data);
+      data_report   = checker.check_edge(0);
+      weight_report = checker.check_edge(1);
+    });
+  }
+  EXPECT_EQ(data_report.probes, 256u);
+  EXPECT_LT(data_report.max_relative_error, epsilon<float_t>());
+  EXPECT_EQ(weight_report.probes, 256u * 128u);
+  EXPECT_LT(weight_report.max_relative_error, epsilon<float_t>());
+}
+
 }  // namespace litchi
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace litchi {
+
+TEST(gemm_tuner, configurations_agree) {
+  const size_t M = 13, N = 37, K = 300;
+  const vec_t A = generate_test_data({1}, {M * K})[0][0];
+  const vec_t B = generate_test_data({1}, {K * N})[0][0];
+
+  vec_t expected(M * N, float_t{0});
+  for (size_t i = 0; i < M; i++) {
+    for (size_t k = 0; k < K; k++) {
+      for (size_t j = 0; j < N; j++) {
+        expected[i * N + j] += A[i * K + k] * B[k * N + j];
+      }
+    }
+  }
+
+  std::vector<kernels::gemm_config> configs =
+    kernels::gemm_tuner::candidates(4);
+  kernels::gemm_config tiny;
+  tiny.mc = 4;
+  tiny.kc = 7;
+  tiny.nc = 16;
+  configs.push_back(tiny);
+  for (const kernels::gemm_config &config : configs) {
+    vec_t C(M * N, float_t{0});
+    kernels::gemm(
+      M, N, K,
+      [&](size_t i0, size_t k0, size_t mc, size_t kc, float_t *dst) {
+        kernels::gemm_pack_a_rows([&](size_t i) { return &A[i * K]; }, i0,
+                                  k0, mc, kc, dst);
+      },
+      [&](size_t k0, size_t j0, size_t kc, size_t nc, float_t *dst) {
+        kernels::gemm_pack_b_rows([&](size_t k) { return &B[k * N]; }, k0,
+                                  j0, kc, nc, dst);
+      },
+      [&](size_t i, size_t j, const float_t *values, size_t n) {
+        for (size_t x = 0; x < n; x++) C[i * N + j + x] += values[x];
+      },
+      true, config);
+    for (size_t i = 0; i < M * N; i++) {
+      EXPECT_NEAR(C[i], expected[i], 1e-4);
+    }
+  }
+}
+
+TEST(gemm_tuner, persistent_cache) {
+  using kernels::gemm_tuner;
+  const std::string path = temp_path("tuning.tsv");
+  std::remove(path.c_str());
+  gemm_tuner::clear();
+
+  fully_connected_layer fc(40, 24);
+  const tensor_t batch = generate_test_data({8}, {40})[0];
+  std::vector<const tensor_t *> out;
+  fc.forward({batch}, out);
+  const tensor_t reference = *out[0];
+
+  gemm_tuner::enable(path);
+  const size_t tunings = gemm_tuner::tunings();
+  fc.forward({batch}, out);
+  EXPECT_EQ(gemm_tuner::tunings(), tunings + 1);
+  for (size_t s = 0; s < batch.size(); s++) {
+    for (size_t i = 0; i < 24; i++) {
+      EXPECT_NEAR((*out[0])[s][i], reference[s][i], 1e-5);
+    }
+  }
+
+  // the shape is tuned once
+  fc.forward({batch}, out);
+  EXPECT_EQ(gemm_tuner::tunings(), tunings + 1);
+  const std::string key = gemm_tuner::key(
+    "fully_connected.forward", 8, 24, 40,
+    fc.parallelize() ? parallel_concurrency() : 1);
+  kernels::gemm_config tuned;
+  ASSERT_TRUE(gemm_tuner::find(key, tuned));
+
+  // another process: the choice comes from the file, with the entries of
+  // other CPUs kept aside
+  {
+    std::ofstream os(path, std::ios::app);
+    os << "Other CPU/2/generic\t" << key << "\t8 8 16 1 rows\n"
+       << "malformed line\n";
+  }
+  gemm_tuner::disable();
+  gemm_tuner::clear();
+  gemm_tuner::enable(path);
+  EXPECT_EQ(gemm_tuner::size(), 2u);
+  kernels::gemm_config loaded;
+  ASSERT_TRUE(gemm_tuner::find(key, loaded));
+  EXPECT_TRUE(loaded == tuned);
+  fc.forward({batch}, out);
+  EXPECT_EQ(gemm_tuner::tunings(), tunings + 1);
+
+  // the choices remembered by the thread go with the entries
+  gemm_tuner::clear();
+  fc.forward({batch}, out);
+  EXPECT_EQ(gemm_tuner::tunings(), tunings + 2);
+  fc.forward({batch}, out);
+  EXPECT_EQ(gemm_tuner::tunings(), tunings + 2);
+
+  gemm_tuner::disable();
+  gemm_tuner::clear();
+  std::remove(path.c_str());
+}
+
+}  // namespace litchi
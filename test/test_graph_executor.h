@@ -0,0 +1,195 @@
+#pragma once
+
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+// threads of the process, 0 where they cannot be counted
+size_t live_threads() {
+  size_t count = 0;
+#ifdef __linux__
+  if (DIR *dir = opendir("/proc/self/task")) {
+    while (const dirent *entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') count++;
+    }
+    closedir(dir);
+  }
+#endif
+  return count;
+}
+
+// identity running a parallel loop whose blocks record the threads of the
+// process and how many blocks run at once
+class loop_probe : public identity_layer {
+ public:
+  loop_probe(size_t n, std::atomic<size_t> &active, size_t &peak_active,
+             size_t &peak_threads, std::mutex &mutex)
+    : identity_layer(n),
+      active_(active),
+      peak_active_(peak_active),
+      peak_threads_(peak_threads),
+      mutex_(mutex) {}
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    for_i(true, 32,
+          [&](size_t) {
+            const size_t running = ++active_;
+            const size_t threads = live_threads();
+            {
+              std::lock_guard<std::mutex> lock(mutex_);
+              peak_active_  = std::max(peak_active_, running);
+              peak_threads_ = std::max(peak_threads_, threads);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            --active_;
+          },
+          1);
+    identity_layer::forward_propagation(in_data, out_data);
+  }
+
+ private:
+  std::atomic<size_t> &active_;
+  size_t &peak_active_;
+  size_t &peak_threads_;
+  std::mutex &mutex_;
+};
+
+}  // namespace
+
+TEST(concat, forward) {
+  concat_layer concat(std::vector<size_t>{2, 3});
+  EXPECT_EQ(concat.out_shape()[0].size(), 5u);
+
+  std::vector<const tensor_t *> out;
+  concat.forward({{{1, 2}}, {{3, 4, 5}}}, out);
+  EXPECT_EQ((*out[0])[0], vec_t({1, 2, 3, 4, 5}));
+}
+
+TEST(concat, gradient_check) {
+  concat_layer concat(std::vector<size_t>{4, 7, 1});
+  std::vector<tensor_t> input_data = generate_test_data({1, 1, 1}, {4, 7, 1});
+  gradient_checker checker(concat, input_data);
+  for (const auto &report : checker.check()) {
+    EXPECT_LT(report.max_relative_error, epsilon<float_t>());
+  }
+}
+
+TEST(work_stealing_pool, nested_tasks) {
+  std::atomic<size_t> done{0};
+  {
+    work_stealing_pool pool(4);
+    EXPECT_EQ(pool.size(), 4u);
+    for (size_t i = 0; i < 64; i++) {
+      pool.submit([&]() {
+        for (size_t j = 0; j < 8; j++) pool.submit([&]() { done++; });
+        done++;
+      });
+    }
+  }  // runs the queued tasks before joining
+  EXPECT_EQ(done, 64u * 9u);
+}
+
+TEST(graph_executor, towers) {
+  auto input  = std::make_shared<identity>(16);
+  auto fc_a   = std::make_shared<fully_connected_layer>(16, 8);
+  auto act_a  = std::make_shared<sigmoid>(8);
+  auto fc_b   = std::make_shared<fully_connected_layer>(16, 8);
+  auto act_b  = std::make_shared<relu>(8);
+  auto fc_c   = std::make_shared<fully_connected_layer>(16, 4);
+  auto concat = std::make_shared<concat_layer>(std::vector<size_t>{8, 8, 4});
+  auto head   = std::make_shared<fully_connected_layer>(20, 3);
+
+  connect(input.get(), fc_a.get());
+  connect(input.get(), fc_b.get());
+  connect(input.get(), fc_c.get());
+  connect(fc_a.get(), act_a.get());
+  connect(fc_b.get(), act_b.get());
+  connect(act_a.get(), concat.get(), 0, 0);
+  connect(act_b.get(), concat.get(), 0, 1);
+  connect(fc_c.get(), concat.get(), 0, 2);
+  connect(concat.get(), head.get());
+
+  // shuffled on purpose
+  graph_executor executor({head, concat, act_b, fc_c, input, fc_a, act_a,
+                           fc_b},
+                          4);
+  EXPECT_EQ(executor.width(), 3u);
+  ASSERT_EQ(executor.sources().size(), 1u);
+  EXPECT_EQ(executor.sources()[0], input.get());
+  ASSERT_EQ(executor.sinks().size(), 1u);
+  EXPECT_EQ(executor.sinks()[0], head.get());
+  EXPECT_EQ(executor.layers().front(), input);
+  EXPECT_EQ(executor.layers().back(), head);
+
+  const tensor_t batch = generate_test_data({5}, {16})[0];
+  const tensor_t out   = *executor.forward({batch})[0];
+
+  // same layers, one at a time
+  *input->input_tensor(0) = batch;
+  for (layer *l : std::vector<layer *>{input.get(), fc_a.get(), act_a.get(),
+                                      fc_b.get(), act_b.get(), fc_c.get(),
+                                      concat.get(), head.get()}) {
+    l->forward();
+  }
+  EXPECT_EQ(*head->next()[0]->get_data(), out);
+
+  for (int run = 0; run < 10; run++) {
+    EXPECT_EQ(*executor.forward({batch})[0], out);
+  }
+}
+
+TEST(graph_executor, thread_budget) {
+  std::atomic<size_t> active{0};
+  size_t peak_active = 0, peak_threads = 0;
+  std::mutex mutex;
+  auto probe = [&](size_t n) {
+    return std::make_shared<loop_probe>(n, active, peak_active, peak_threads,
+                                        mutex);
+  };
+  auto input  = probe(8);
+  auto tower1 = probe(8);
+  auto tower2 = probe(8);
+  auto tower3 = probe(8);
+  auto concat = std::make_shared<concat_layer>(std::vector<size_t>{8, 8, 8});
+  auto head   = probe(24);
+  for (auto tower : {tower1, tower2, tower3}) {
+    connect(input.get(), tower.get());
+  }
+  connect(tower1.get(), concat.get(), 0, 0);
+  connect(tower2.get(), concat.get(), 0, 1);
+  connect(tower3.get(), concat.get(), 0, 2);
+  connect(concat.get(), head.get());
+
+  const size_t before = live_threads();
+  graph_executor executor({input, tower1, tower2, tower3, concat, head}, 3);
+  const tensor_t batch = generate_test_data({2}, {8})[0];
+  for (int run = 0; run < 5; run++) executor.forward({batch});
+
+  // the loops of the layers ran on the 3 workers of the executor, none
+  // started a thread of its own
+  EXPECT_LE(peak_active, 3u);
+  EXPECT_GE(peak_active, 2u);
+#ifdef __linux__
+  EXPECT_EQ(peak_threads, before + 3);
+#endif
+}
+
+TEST(graph_executor, rejects_cycles) {
+  auto a = std::make_shared<identity>(4);
+  auto b = std::make_shared<identity>(4);
+  connect(a.get(), b.get());
+  connect(b.get(), a.get());
+  EXPECT_ANY_THROW(graph_executor({a, b}));
+}
+
+}  // namespace litchi
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+TEST(graph_optimizer, fold_linear_chain) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(8, 16)
+      << std::make_shared<fully_connected_layer>(16, 16)
+      << std::make_shared<fully_connected_layer>(16, 4);
+  net.setup(false);
+  for (size_t i = 0; i < net.size(); i++) {
+    // non-zero biases so that the bias chain is exercised
+    uniform_rand(net[i].weights()[1]->begin(), net[i].weights()[1]->end(),
+                 -1.0f, 1.0f);
+  }
+
+  tensor_t batch = generate_test_data({1}, {8})[0];
+  batch.push_back(generate_test_data({1}, {8})[0][0]);
+  tensor_t expected = net.forward(batch);
+
+  graph_optimizer_options options;
+  options.validation               = &batch;
+  graph_optimization_report report = optimize_graph(net, options);
+  EXPECT_TRUE(report.applied);
+  EXPECT_EQ(report.layers_before, 3u);
+  EXPECT_EQ(report.layers_after, 1u);
+  EXPECT_EQ(report.folded, 2u);
+  EXPECT_EQ(report.flops_before, (2u * 8 * 16 + 16) + (2u * 16 * 16 + 16) +
+                                   (2u * 16 * 4 + 4));
+  EXPECT_EQ(report.flops_after, 2u * 8 * 4 + 4);
+  EXPECT_LT(report.weight_bytes_after, report.weight_bytes_before);
+  EXPECT_LT(report.activation_bytes_after, report.activation_bytes_before);
+  EXPECT_LT(report.max_abs_error, 1e-4f);
+
+  const tensor_t &out = net.forward(batch);
+  for (size_t s = 0; s < batch.size(); s++) {
+    for (size_t i = 0; i < 4; i++) {
+      EXPECT_NEAR(expected[s][i], out[s][i], 1e-4f);
+    }
+  }
+}
+
+TEST(graph_optimizer, keep_bottleneck_and_nonlinearity) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(64, 4)
+      << std::make_shared<fully_connected_layer>(4, 64)
+      << std::make_shared<relu>(64)
+      << std::make_shared<fully_connected_layer>(64, 2);
+  graph_optimization_report report = optimize_graph(net);
+  EXPECT_EQ(report.layers_after, 4u);
+  EXPECT_EQ(report.folded, 0u);
+  EXPECT_EQ(report.flops_before, report.flops_after);
+}
+
+TEST(graph_optimizer, drop_identity) {
+  auto fc = std::make_shared<fully_connected_layer>(3, 3, false);
+  fc->weight_init(weight_init::constant(0.0));
+  fc->setup(false);
+  vec_t &W = *fc->weights()[0];
+  for (size_t i = 0; i < 3; i++) W[i * 3 + i] = float_t{1};
+
+  sequential net;
+  net << std::make_shared<identity>(3) << std::make_shared<relu>(3) << fc
+      << std::make_shared<identity>(3);
+  tensor_t batch    = {{-1, 2, 3}};
+  tensor_t expected = net.forward(batch);
+
+  graph_optimizer_options options;
+  options.validation               = &batch;
+  graph_optimization_report report = optimize_graph(net, options);
+  EXPECT_EQ(report.dropped, 3u);
+  ASSERT_EQ(net.size(), 1u);
+  EXPECT_EQ(net[0].layer_type(), "relu-activation");
+  EXPECT_FLOAT_EQ(report.max_abs_error, 0.0f);
+  EXPECT_EQ(net.forward(batch), expected);
+}
+
+TEST(graph_optimizer, frozen_only) {
+  sequential net;
+  auto a = std::make_shared<fully_connected_layer>(8, 8);
+  auto b = std::make_shared<fully_connected_layer>(8, 2);
+  net << a << b;
+
+  graph_optimizer_options options;
+  options.frozen_only = true;
+  EXPECT_EQ(optimize_graph(net, options).folded, 0u);
+
+  a->set_trainable(false);
+  b->set_trainable(false);
+  EXPECT_EQ(optimize_graph(net, options).folded, 1u);
+  EXPECT_FALSE(net[0].trainable());
+}
+
+}  // namespace litchi
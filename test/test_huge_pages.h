@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+namespace litchi {
+
+#ifdef CNN_USE_HUGE_PAGES
+
+namespace {
+
+// restores the heap for the following tests
+struct huge_page_scope {
+  huge_page_scope(huge_page_mode mode, size_t threshold) {
+    set_huge_page_mode(mode, threshold);
+  }
+  ~huge_page_scope() { set_huge_page_mode(huge_page_mode::off); }
+};
+
+}  // namespace
+
+TEST(huge_pages, threshold) {
+  const huge_page_report before = huge_page_usage();
+  {
+    huge_page_scope scope(huge_page_mode::transparent, 1 << 20);
+    vec_t small(1000), large((1 << 20) / sizeof(float_t));
+    EXPECT_FALSE(is_huge_block(small.data()));
+#ifdef __linux__
+    ASSERT_TRUE(is_huge_block(large.data()));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(large.data()) % huge_page_size,
+              0u);
+    const huge_page_report report = huge_page_usage();
+    EXPECT_EQ(report.blocks, before.blocks + 1);
+    EXPECT_EQ(report.mapped_bytes, before.mapped_bytes + huge_page_size);
+    EXPECT_LE(report.huge_bytes, report.mapped_bytes);
+#endif
+    // zeroed like any vector, and usable
+    EXPECT_EQ(large.front(), float_t{0});
+    EXPECT_EQ(large.back(), float_t{0});
+    large.back() = float_t{1};
+    EXPECT_EQ(large.back(), float_t{1});
+  }
+  EXPECT_EQ(huge_page_usage().blocks, before.blocks);
+}
+
+TEST(huge_pages, off_and_fallback) {
+  vec_t heap(huge_page_size);
+  EXPECT_FALSE(is_huge_block(heap.data()));
+
+  // without pages reserved in hugetlbfs the transparent ones take over
+  huge_page_scope scope(huge_page_mode::hugetlbfs, huge_page_size);
+  vec_t large(huge_page_size);
+#ifdef __linux__
+  EXPECT_TRUE(is_huge_block(large.data()));
+  const huge_page_report report = huge_page_usage();
+  EXPECT_GE(report.mapped_bytes, 4 * huge_page_size);
+#endif
+  std::fill(large.begin(), large.end(), float_t{2});
+  EXPECT_EQ(large[huge_page_size / 2], float_t{2});
+
+  // a mapping that fails leaves the buffer on the heap, released there
+  const size_t blocks          = huge_page_usage().blocks;
+  detail::huge_pages().refused = 1;
+  {
+    vec_t refused(huge_page_size, float_t{3});
+    EXPECT_EQ(detail::huge_pages().refused, 0u);
+    EXPECT_FALSE(is_huge_block(refused.data()));
+    EXPECT_EQ(huge_page_usage().blocks, blocks);
+    EXPECT_EQ(refused.back(), float_t{3});
+  }
+  vec_t mapped(huge_page_size);
+#ifdef __linux__
+  EXPECT_TRUE(is_huge_block(mapped.data()));
+#endif
+}
+
+TEST(huge_pages, reallocate_weights) {
+  fully_connected_layer fc(1024, 1024);
+  fc.setup(true);
+  vec_t &W           = *fc.weights()[0];
+  const vec_t before = W;
+  EXPECT_FALSE(is_huge_block(W.data()));
+
+  huge_page_scope scope(huge_page_mode::transparent, huge_page_size);
+#ifdef __linux__
+  EXPECT_TRUE(reallocate_huge(W));
+#endif
+  EXPECT_EQ(W, before);
+}
+
+TEST(huge_pages, smaps_coverage) {
+#ifdef __linux__
+  huge_page_scope scope(huge_page_mode::transparent, huge_page_size);
+  vec_t a(huge_page_size / sizeof(float_t));
+  ASSERT_TRUE(is_huge_block(a.data()));
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(a.data());
+
+  // a mapping spanning the block and the page after it, half of it huge:
+  // only the bytes of the block are credited
+  const std::string path = temp_path("smaps");
+  FILE *file             = std::fopen(path.c_str(), "w");
+  ASSERT_NE(file, nullptr);
+  std::fprintf(file,
+               "%llx-%llx rw-p 00000000 00:00 0\n"
+               "Size:               6144 kB\n"
+               "AnonHugePages:      4096 kB\n"
+               "7f0000000000-7f0000200000 rw-p 00000000 00:00 0\n"
+               "AnonHugePages:      2048 kB\n",
+               static_cast<unsigned long long>(begin),
+               static_cast<unsigned long long>(begin + 3 * huge_page_size));
+  std::fclose(file);
+  const huge_page_report report = huge_page_usage(path);
+  std::remove(path.c_str());
+  EXPECT_EQ(report.huge_bytes, huge_page_size);
+#endif
+}
+
+#endif  // CNN_USE_HUGE_PAGES
+
+}  // namespace litchi
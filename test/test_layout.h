@@ -0,0 +1,233 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+// a tensor of spatial samples converted to another layout
+tensor_t to_layout(const tensor_t &x, const shape3d &shape, data_layout to) {
+  tensor_t y(x.size(), vec_t(shape.size()));
+  for (size_t s = 0; s < x.size(); s++) {
+    kernels::convert_layout(&x[s][0], shape, to, &y[s][0]);
+  }
+  return y;
+}
+
+// forward and backward passes of a standalone layer; returns the output
+// followed by the gradients of every input
+std::vector<tensor_t> run_layer(layer &l,
+                                std::vector<tensor_t> in,
+                                tensor_t dy) {
+  const size_t batch = in[0].size();
+  tensor_t y(batch, vec_t(l.out_shape()[0].size()));
+  std::vector<tensor_t> dx;
+  for (const tensor_t &t : in) {
+    dx.emplace_back(batch, vec_t(t[0].size(), float_t{0}));
+  }
+  std::vector<tensor_t *> in_data, in_grad;
+  for (size_t i = 0; i < in.size(); i++) {
+    in_data.push_back(&in[i]);
+    in_grad.push_back(&dx[i]);
+  }
+  std::vector<tensor_t *> out_data = {&y}, out_grad = {&dy};
+  l.forward_propagation(in_data, out_data);
+  l.back_propagation(in_data, out_data, out_grad, in_grad);
+  dx.insert(dx.begin(), y);
+  return dx;
+}
+
+void expect_tensor_near(const tensor_t &a, const tensor_t &b, float_t eps) {
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t s = 0; s < a.size(); s++) {
+    ASSERT_EQ(a[s].size(), b[s].size());
+    for (size_t i = 0; i < a[s].size(); i++) {
+      EXPECT_NEAR(a[s][i], b[s][i], eps);
+    }
+  }
+}
+
+// the layer gives the same results on channel-last data as on channel-major
+// data, the weights and biases keeping their layout
+void expect_layouts_agree(layer &l, const std::vector<tensor_t> &in) {
+  const shape3d in_shape  = l.in_shape()[0];
+  const shape3d out_shape = l.out_shape()[0];
+  const tensor_t dy =
+    generate_test_data({in[0].size()}, {out_shape.size()})[0];
+  const std::vector<tensor_t> nchw = run_layer(l, in, dy);
+
+  l.set_layout(data_layout::nhwc);
+  EXPECT_EQ(l.layout(), data_layout::nhwc);
+  std::vector<tensor_t> nhwc_in = in;
+  nhwc_in[0] = to_layout(in[0], in_shape, data_layout::nhwc);
+  std::vector<tensor_t> nhwc = run_layer(
+    l, nhwc_in, to_layout(dy, out_shape, data_layout::nhwc));
+  nhwc[0] = to_layout(nhwc[0], l.out_shape()[0], data_layout::nchw);
+  nhwc[1] = to_layout(nhwc[1], l.in_shape()[0], data_layout::nchw);
+
+  for (size_t i = 0; i < nchw.size(); i++) {
+    expect_tensor_near(nchw[i], nhwc[i], 1e-4f);
+  }
+}
+
+}  // namespace
+
+TEST(layout, nhwc_index) {
+  const shape3d nchw(4, 3, 5);
+  const shape3d nhwc(4, 3, 5, data_layout::nhwc);
+  EXPECT_EQ(nchw.get_index(1, 2, 3), (3 * 3 + 2) * 4 + 1);
+  EXPECT_EQ(nhwc.get_index(1, 2, 3), (2 * 4 + 1) * 5 + 3);
+  EXPECT_EQ(nchw, nhwc);
+
+  // data of a single position or a single channel is read the same way
+  EXPECT_FALSE(same_memory_order(nchw, nhwc));
+  EXPECT_TRUE(same_memory_order(shape3d(1, 1, 8),
+                                shape3d(1, 1, 8, data_layout::nhwc)));
+  EXPECT_TRUE(same_memory_order(shape3d(6, 6, 1),
+                                shape3d(6, 6, 1, data_layout::nhwc)));
+}
+
+TEST(layout, transpose_roundtrip) {
+  const shape3d shape(7, 5, 19);
+  const vec_t x = generate_test_data({1}, {shape.size()})[0][0];
+  vec_t t(shape.size()), back(shape.size());
+  kernels::convert_layout(&x[0], shape, data_layout::nhwc, &t[0]);
+  const shape3d nhwc = shape.with_layout(data_layout::nhwc);
+  for (size_t c = 0; c < 19; c++) {
+    for (size_t y = 0; y < 5; y++) {
+      for (size_t w = 0; w < 7; w++) {
+        EXPECT_EQ(t[nhwc.get_index(w, y, c)], x[shape.get_index(w, y, c)]);
+      }
+    }
+  }
+  kernels::convert_layout(&t[0], nhwc, data_layout::nchw, &back[0]);
+  EXPECT_EQ(back, x);
+}
+
+TEST(layout, convolution) {
+  convolutional_layer l(7, 6, 3, 3, 3, 5, 2, 1, 1, 1);
+  const shape3d in = l.in_shape()[0];
+  const shape3d w  = l.in_shape()[1];
+  expect_layouts_agree(
+    l, generate_test_data({3, 1, 1}, {in.size(), w.size(), 5}));
+}
+
+TEST(layout, grouped_convolution) {
+  convolutional_layer l(6, 5, 3, 3, 4, 4, 2, 1, 1, 1, 1, 2, 2);
+  const shape3d in = l.in_shape()[0];
+  const shape3d w  = l.in_shape()[1];
+  expect_layouts_agree(
+    l, generate_test_data({2, 1, 1}, {in.size(), w.size(), 4}));
+}
+
+TEST(layout, pooling) {
+  max_pooling_layer max_pool(9, 8, 6, 2);
+  expect_layouts_agree(max_pool,
+                       generate_test_data({3}, {9 * 8 * 6}));
+
+  average_pooling_layer ave_pool(13, 9, 3, 3, 2, 2, 1);
+  expect_layouts_agree(ave_pool,
+                       generate_test_data({3}, {13 * 9 * 3}));
+}
+
+TEST(layout, mismatch) {
+  auto conv = std::make_shared<convolutional_layer>(6, 6, 3, 3, 2, 4);
+  conv->set_layout(data_layout::nhwc);
+  sequential net;
+  net << conv;
+  EXPECT_THROW(net << std::make_shared<fully_connected_layer>(4 * 4 * 4, 2),
+               const char *);
+  EXPECT_THROW(std::make_shared<fully_connected_layer>(4, 2)->set_layout(
+                 data_layout::nhwc),
+               const char *);
+}
+
+TEST(layout, optimize_layouts) {
+  sequential net;
+  net << std::make_shared<convolutional_layer>(10, 10, 3, 3, 3, 6, 1, 1, 1, 1)
+      << std::make_shared<relu>(10, 10, 6)
+      << std::make_shared<max_pooling_layer>(10, 10, 6, 2)
+      << std::make_shared<convolutional_layer>(5, 5, 3, 3, 6, 8)
+      << std::make_shared<relu>(3, 3, 8)
+      << std::make_shared<fully_connected_layer>(3 * 3 * 8, 4);
+  const tensor_t x  = generate_test_data({4}, {10 * 10 * 3})[0];
+  const tensor_t dy = generate_test_data({4}, {4})[0];
+  const tensor_t expected = net.forward(x);
+  net.backward(dy);
+  const tensor_t expected_dx = *net[0].prev()[0]->get_gradient();
+
+  const layout_report report = optimize_layouts(net);
+  // both convolutions and the pooling switch; the activations follow them,
+  // so only the input and the flattening need a transpose
+  EXPECT_EQ(report.converted, 3u);
+  EXPECT_EQ(report.transposes, 2u);
+  EXPECT_EQ(report.transposed_elements, 10u * 10 * 3 + 3 * 3 * 8);
+  ASSERT_EQ(net.size(), 8u);
+  EXPECT_EQ(net[0].layer_type(), "transpose");
+  EXPECT_EQ(net[2].layout(), data_layout::nhwc);
+  EXPECT_EQ(net[6].layer_type(), "transpose");
+
+  expect_tensor_near(net.forward(x), expected, 1e-4f);
+  net.backward(dy);
+  expect_tensor_near(*net[0].prev()[0]->get_gradient(), expected_dx, 1e-4f);
+
+  // a second pass finds the graph already optimal
+  EXPECT_EQ(optimize_layouts(net).transposes, 2u);
+  EXPECT_EQ(net.size(), 8u);
+
+  // back to channel-major, without any transpose
+  EXPECT_EQ(optimize_layouts(net, data_layout::nchw).transposes, 0u);
+  EXPECT_EQ(net.size(), 6u);
+  expect_tensor_near(net.forward(x), expected, 1e-4f);
+}
+
+TEST(layout, flattened_dropout) {
+  // a flat dropout cannot read channel-last data: the transpose goes before
+  sequential net;
+  net << std::make_shared<convolutional_layer>(6, 6, 3, 3, 2, 4)
+      << std::make_shared<dropout_layer>(4 * 4 * 4, float_t(0.5),
+                                         net_phase::test)
+      << std::make_shared<fully_connected_layer>(4 * 4 * 4, 3);
+  const tensor_t x        = generate_test_data({2}, {6 * 6 * 2})[0];
+  const tensor_t expected = net.forward(x);
+  const layout_report report = optimize_layouts(net);
+  EXPECT_EQ(report.transposes, 2u);
+  ASSERT_EQ(net.size(), 5u);
+  EXPECT_EQ(net[2].layer_type(), "transpose");
+  EXPECT_EQ(net[3].layout(), data_layout::nchw);
+  expect_tensor_near(net.forward(x), expected, 1e-4f);
+}
+
+TEST(layout, invariant_output) {
+  // the pooling writes a single position: its channel-last output reads as
+  // the flat input of the fully connected layer without a transpose
+  sequential net;
+  net << std::make_shared<convolutional_layer>(4, 4, 3, 3, 2, 4)
+      << std::make_shared<max_pooling_layer>(2, 2, 4, 2)
+      << std::make_shared<fully_connected_layer>(4, 3);
+  const tensor_t x        = generate_test_data({3}, {4 * 4 * 2})[0];
+  const tensor_t expected = net.forward(x);
+
+  const shape3d pooled = net[1].out_shape()[0].with_layout(data_layout::nhwc);
+  EXPECT_TRUE(same_memory_order(pooled, net[2].in_shape()[0]));
+  EXPECT_TRUE(same_memory_order(net[2].in_shape()[0], pooled));
+  EXPECT_EQ(detail::transpose_cost(pooled, net[2].in_shape()[0]), 0u);
+
+  const layout_report report = optimize_layouts(net);
+  EXPECT_EQ(report.converted, 2u);
+  EXPECT_EQ(report.transposes, 1u);
+  ASSERT_EQ(net.size(), 4u);
+  EXPECT_EQ(net[2].layout(), data_layout::nhwc);
+  expect_tensor_near(net.forward(x), expected, 1e-4f);
+}
+
+TEST(layout, rejects_graphs) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(8, 4)
+      << std::make_shared<concat_layer>(std::vector<size_t>{4, 4});
+  EXPECT_THROW(optimize_layouts(net), const char *);
+}
+
+}  // namespace litchi
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+// in x out weights of rank k: sum of k outer products
+vec_t low_rank_weights(size_t in, size_t out, size_t k) {
+  std::vector<tensor_t> f = generate_test_data({1, 1}, {in * k, k * out});
+  vec_t W(in * out, float_t{0});
+  for (size_t c = 0; c < in; c++) {
+    for (size_t r = 0; r < k; r++) {
+      for (size_t i = 0; i < out; i++) {
+        W[c * out + i] += f[0][0][c * k + r] * f[1][0][r * out + i];
+      }
+    }
+  }
+  return W;
+}
+
+}  // namespace
+
+TEST(low_rank, svd) {
+  for (const auto &shape : {std::make_pair(7, 4), std::make_pair(3, 9)}) {
+    const size_t rows = shape.first, cols = shape.second;
+    const vec_t a     = generate_test_data({1}, {rows * cols})[0][0];
+    const svd_result r = svd(&a[0], rows, cols);
+    const size_t k     = std::min(rows, cols);
+    ASSERT_EQ(r.s.size(), k);
+    for (size_t i = 1; i < k; i++) EXPECT_GE(r.s[i - 1], r.s[i]);
+
+    // reconstruction and orthonormal singular vectors
+    for (size_t i = 0; i < rows; i++) {
+      for (size_t j = 0; j < cols; j++) {
+        double x = 0;
+        for (size_t p = 0; p < k; p++) {
+          x += r.u[i * k + p] * r.s[p] * r.v[p * cols + j];
+        }
+        EXPECT_NEAR(x, a[i * cols + j], 1e-5);
+      }
+    }
+    for (size_t p = 0; p < k; p++) {
+      for (size_t q = 0; q < k; q++) {
+        double uu = 0, vv = 0;
+        for (size_t i = 0; i < rows; i++) {
+          uu += r.u[i * k + p] * r.u[i * k + q];
+        }
+        for (size_t j = 0; j < cols; j++) {
+          vv += r.v[p * cols + j] * r.v[q * cols + j];
+        }
+        EXPECT_NEAR(uu, p == q ? 1.0 : 0.0, 1e-6);
+        EXPECT_NEAR(vv, p == q ? 1.0 : 0.0, 1e-6);
+      }
+    }
+  }
+}
+
+TEST(low_rank, select_rank) {
+  const std::vector<double> s = {4, 2, 1, 1};  // energies 16, 4, 1, 1
+  low_rank_options options;
+  options.energy = 0.7;
+  EXPECT_EQ(select_rank(s, options), 1u);
+  options.energy = 0.9;
+  EXPECT_EQ(select_rank(s, options), 2u);
+  options.energy = 1.0;
+  EXPECT_EQ(select_rank(s, options), 4u);
+  options.max_rank = 3;
+  EXPECT_EQ(select_rank(s, options), 3u);
+
+  // relative error sqrt(2 / 22) ~ 0.30 at rank 2
+  options.max_rank           = 0;
+  options.max_relative_error = 0.31;
+  EXPECT_EQ(select_rank(s, options), 2u);
+}
+
+TEST(low_rank, gradient_check) {
+  const size_t in_size = 12, out_size = 9, rank = 3;
+  low_rank_fully_connected_layer l(in_size, out_size, rank);
+  EXPECT_EQ(l.in_channels(), 4u);  // in, U, V and b
+  EXPECT_EQ(l.flops(), 2u * rank * (in_size + out_size) + out_size);
+
+  std::vector<tensor_t> input_data = generate_test_data(
+    {1, 1, 1, 1}, {in_size, in_size * rank, rank * out_size, out_size});
+  gradient_checker checker(l, input_data);
+  std::vector<gradient_check_report> reports = checker.check();
+  ASSERT_EQ(reports.size(), 4u);
+  for (const auto &report : reports) {
+    EXPECT_LT(report.max_relative_error, epsilon<float_t>());
+  }
+}
+
+TEST(low_rank, compress) {
+  const size_t in = 64, out = 48;
+  sequential net;
+  auto wide  = std::make_shared<fully_connected_layer>(in, out);
+  auto small = std::make_shared<fully_connected_layer>(out, 4);
+  net << wide << std::make_shared<relu>(out) << small;
+  net.setup(false);
+  *wide->weights()[0] = low_rank_weights(in, out, 5);
+
+  const tensor_t batch = generate_test_data({16}, {in})[0];
+  low_rank_options options;
+  options.energy     = 0.999999;
+  options.validation = &batch;
+  const low_rank_report report = compress_low_rank(net, options);
+
+  ASSERT_EQ(report.layers.size(), 2u);
+  EXPECT_TRUE(report.applied);
+  EXPECT_TRUE(report.layers[0].factorized);
+  EXPECT_EQ(report.layers[0].rank, 5u);
+  EXPECT_LT(report.layers[0].relative_error, 1e-3);
+  // 48 -> 4 has no rank below 4 * 48 / 52 retaining the energy
+  EXPECT_FALSE(report.layers[1].factorized);
+
+  EXPECT_EQ(net[0].layer_type(), "low-rank-fully-connected");
+  EXPECT_EQ(net[2].layer_type(), "fully-connected");
+  EXPECT_EQ(report.flops_before - report.flops_after,
+            2u * in * out - 2u * 5 * (in + out));
+  EXPECT_EQ(report.params_before - report.params_after,
+            in * out - 5u * (in + out));
+  EXPECT_LT(report.max_abs_error, 1e-3);
+
+  // a strict tolerance on a lossy compression restores the network
+  sequential lossy;
+  lossy << std::make_shared<fully_connected_layer>(in, out);
+  low_rank_options strict;
+  strict.energy     = 0.5;
+  strict.validation = &batch;
+  strict.tolerance  = 1e-6;
+  const low_rank_report rejected = compress_low_rank(lossy, strict);
+  EXPECT_FALSE(rejected.applied);
+  EXPECT_GT(rejected.max_abs_error, 1e-6);
+  EXPECT_EQ(lossy[0].layer_type(), "fully-connected");
+  EXPECT_EQ(rejected.flops_after, rejected.flops_before);
+}
+
+}  // namespace litchi
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+
+namespace litchi {
+
+// direct max pooling used as a reference, returning the input index of
+// every maximum
+inline vec_t naive_max_pool(const vec_t &x,
+                            const core::pooling_params &p,
+                            std::vector<size_t> *argmax = nullptr) {
+  vec_t y(p.out.size());
+  if (argmax) argmax->resize(p.out.size());
+  for (size_t c = 0; c < p.out.depth_; c++) {
+    for (size_t oy = 0; oy < p.out.height_; oy++) {
+      for (size_t ox = 0; ox < p.out.width_; ox++) {
+        size_t best = p.in.get_index(ox * p.stride_x, oy * p.stride_y, c);
+        for (size_t dy = 0; dy < p.pool_size_y; dy++) {
+          for (size_t dx = 0; dx < p.pool_size_x; dx++) {
+            const size_t i = p.in.get_index(ox * p.stride_x + dx,
+                                            oy * p.stride_y + dy, c);
+            if (x[i] > x[best]) best = i;
+          }
+        }
+        y[p.out.get_index(ox, oy, c)] = x[best];
+        if (argmax) (*argmax)[p.out.get_index(ox, oy, c)] = best;
+      }
+    }
+  }
+  return y;
+}
+
+TEST(max_pooling, forward) {
+  max_pooling_layer l(4, 4, 1, 2);
+  EXPECT_EQ(l.out_shape()[0], shape3d(2, 2, 1));
+
+  // clang-format off
+  vec_t in = {0, 1, 2, 3,
+              8, 7, 5, 6,
+              4, 3, 1, 2,
+              0,-1,-2,-3};
+  vec_t out_expected = {8, 6,
+                        4, 2};
+  // clang-format on
+  std::vector<const tensor_t *> o;
+  l.forward({{in}}, o);
+  for (size_t i = 0; i < out_expected.size(); i++) {
+    EXPECT_FLOAT_EQ(out_expected[i], (*o[0])[0][i]);
+  }
+  EXPECT_EQ(l.params().argmax8[0], (std::vector<uint8_t>{2, 3, 0, 1}));
+}
+
+TEST(max_pooling, overlapping_windows) {
+  max_pooling_layer l(13, 9, 3, 3, 2, 2, 1);
+  EXPECT_EQ(l.out_shape()[0], shape3d(6, 8, 3));
+
+  tensor_t batch = generate_test_data({4}, {13 * 9 * 3})[0];
+  std::vector<const tensor_t *> o;
+  l.forward({batch}, o);
+  for (size_t s = 0; s < batch.size(); s++) {
+    const vec_t expected = naive_max_pool(batch[s], l.params());
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_FLOAT_EQ(expected[i], (*o[0])[s][i]);
+    }
+  }
+}
+
+TEST(max_pooling, wide_window_backward) {
+  // 20x20 windows do not fit one byte per offset
+  max_pooling_layer l(24, 20, 2, 20, 20, 2, 1);
+  const core::pooling_params &p = l.params();
+  EXPECT_FALSE(p.compact_argmax());
+
+  vec_t x = generate_test_data({1}, {p.in.size()})[0][0];
+  std::vector<size_t> argmax;
+  const vec_t expected = naive_max_pool(x, p, &argmax);
+
+  tensor_t in_data{x}, out_data(1, vec_t(p.out.size()));
+  tensor_t dx(1, vec_t(p.in.size())), dy(1, vec_t(p.out.size()));
+  for (size_t i = 0; i < p.out.size(); i++) dy[0][i] = float_t(i + 1);
+  std::vector<tensor_t *> in = {&in_data}, out = {&out_data};
+  std::vector<tensor_t *> in_grad = {&dx}, out_grad = {&dy};
+
+  l.forward_propagation(in, out);
+  l.back_propagation(in, out, out_grad, in_grad);
+
+  EXPECT_TRUE(p.argmax8.empty());
+  ASSERT_EQ(p.argmax16.size(), 1u);
+  vec_t dx_expected(p.in.size());
+  for (size_t i = 0; i < p.out.size(); i++) {
+    EXPECT_FLOAT_EQ(expected[i], out_data[0][i]);
+    dx_expected[argmax[i]] += dy[0][i];
+  }
+  for (size_t i = 0; i < p.in.size(); i++) {
+    EXPECT_FLOAT_EQ(dx_expected[i], dx[0][i]);
+  }
+}
+
+TEST(max_pooling, gradient_check) {
+  max_pooling_layer l(6, 6, 2, 2);
+  // distinct, well separated values so that the finite differences never
+  // move the maximum of a window
+  vec_t x(6 * 6 * 2);
+  for (size_t i = 0; i < x.size(); i++) x[i] = float_t((i * 29) % 72) * 0.05f;
+  std::vector<tensor_t> input_data = {tensor_t{x}};
+
+  gradient_checker checker(l, input_data);
+  gradient_check_report report = checker.check_edge(0);
+  EXPECT_LT(report.max_relative_error, epsilon<float_t>());
+}
+
+TEST(vectorize, max_index) {
+  vec_t x(37), best(37, float_t{0});
+  std::vector<int32_t> index(37, -1);
+  for (size_t i = 0; i < x.size(); i++) x[i] = (i % 3 == 0) ? 1.0f : -1.0f;
+  vectorize::max_index(&x[0], x.size(), 5, &best[0], &index[0]);
+  for (size_t i = 0; i < x.size(); i++) {
+    EXPECT_FLOAT_EQ(best[i], i % 3 == 0 ? 1.0f : 0.0f);
+    EXPECT_EQ(index[i], i % 3 == 0 ? 5 : -1);
+  }
+}
+
+}  // namespace litchi
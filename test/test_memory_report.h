@@ -0,0 +1,115 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+TEST(memory_report, prediction_matches_allocation) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(32, 64)
+      << std::make_shared<relu>(64)
+      << std::make_shared<fully_connected_layer>(64, 10, false);
+
+  const size_t batch_size  = 7;
+  const memory_report pred = net.predict_memory(batch_size);
+
+  tensor_t batch = generate_test_data({batch_size}, {32})[0];
+  net.forward(batch);
+  net.backward(tensor_t(batch_size, vec_t(10, float_t{1})));
+  const memory_report used = net.memory();
+
+  ASSERT_EQ(pred.layers.size(), 3u);
+  ASSERT_EQ(used.layers.size(), 3u);
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_EQ(pred.layers[i].layer_type, used.layers[i].layer_type);
+    EXPECT_EQ(pred.layers[i].edges.size(), used.layers[i].edges.size());
+    EXPECT_EQ(pred.layers[i].usage.total(), used.layers[i].usage.total());
+  }
+  // input, W, b, then the three outputs
+  EXPECT_EQ(pred.layers[0].edges.size(), 4u);
+
+  const uint64_t f = sizeof(float_t);
+  EXPECT_EQ(used.total.weights, (32 * 64 + 64 + 64 * 10) * f);
+  EXPECT_EQ(used.total.weight_gradients,
+            batch_size * (32 * 64 + 64 + 64 * 10) * f);
+  EXPECT_EQ(used.total.data, batch_size * (32 + 64 + 64 + 10) * f);
+  EXPECT_EQ(used.total.gradients, used.total.data);
+  EXPECT_GT(used.total.overhead, 0u);
+  EXPECT_EQ(memory_in_use(net.layers()), used.total.total());
+}
+
+TEST(memory_report, embedding_table_gradient) {
+  const size_t rows = 100000, dim = 8, bag = 2, batch_size = 16;
+  sequential net;
+  net << std::make_shared<embedding_layer>(rows, dim, bag)
+      << std::make_shared<fully_connected_layer>(dim, 4);
+
+  // the table keeps no dense gradient, whatever the batch
+  const memory_report pred = net.predict_memory(batch_size);
+  ASSERT_EQ(pred.layers[0].edges.size(), 3u);
+  EXPECT_EQ(pred.layers[0].edges[1].grad_samples, 0u);
+  EXPECT_EQ(pred.layers[0].edges[1].usage.weight_gradients, 0u);
+  EXPECT_EQ(pred.layers[0].edges[1].usage.weights,
+            rows * dim * sizeof(float_t));
+
+  tensor_t x(batch_size, vec_t(bag));
+  for (size_t s = 0; s < batch_size; s++) {
+    x[s] = {embedding_layer::index(uint32_t(s * 7)),
+            embedding_layer::index(uint32_t(rows - 1 - s))};
+  }
+  net.forward(x);
+  net.backward(tensor_t(batch_size, vec_t(4, float_t{1})));
+  const memory_report used = net.memory();
+  for (size_t i = 0; i < 2; i++) {
+    EXPECT_EQ(pred.layers[i].usage.total(), used.layers[i].usage.total());
+  }
+  EXPECT_EQ(pred.total.total(), used.total.total());
+}
+
+TEST(memory_report, peak_tracking) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(16, 16)
+      << std::make_shared<sigmoid>(16)
+      << std::make_shared<fully_connected_layer>(16, 4);
+  memory_tracker tracker;
+  net.set_memory_tracker(&tracker);
+
+  tensor_t small = generate_test_data({2}, {16})[0];
+  tensor_t large = generate_test_data({9}, {16})[0];
+  net.forward(large);
+  net.backward(tensor_t(9, vec_t(4)));
+  EXPECT_EQ(tracker.records(), 6u);
+  const uint64_t peak = tracker.peak();
+  EXPECT_EQ(peak, net.predict_memory(9).total.total());
+
+  // a smaller batch shrinks the tensors but keeps the peak
+  net.forward(small);
+  EXPECT_EQ(tracker.peak(), peak);
+  EXPECT_LE(tracker.current(), peak);
+  EXPECT_EQ(tracker.current(), memory_in_use(net.layers()));
+  net.backward(tensor_t(2, vec_t(4)));
+  EXPECT_EQ(tracker.current(), memory_in_use(net.layers()));
+
+  tracker.reset();
+  net.set_memory_tracker(nullptr);
+  net.forward(large);
+  EXPECT_EQ(tracker.records(), 0u);
+}
+
+TEST(memory_report, prediction_grows_with_batch) {
+  sequential net;
+  net << std::make_shared<convolutional_layer>(8, 8, 3, 3, 3, 4)
+      << std::make_shared<max_pooling_layer>(6, 6, 4, 2);
+
+  const uint64_t before  = net.memory().total.total();
+  const memory_usage one = net.predict_memory(1).total;
+  const memory_usage big = net.predict_memory(100).total;
+  EXPECT_EQ(one.weights, big.weights);
+  EXPECT_EQ(big.data, 100 * one.data);
+  EXPECT_EQ(big.weight_gradients, 100 * one.weight_gradients);
+  // nothing was allocated by the predictions
+  EXPECT_EQ(net.memory().total.total(), before);
+}
+
+}  // namespace litchi
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <sys/stat.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+// a topology whose nodes all run on cpu 0, which every machine has
+numa_topology fake_numa_topology(size_t nodes) {
+  numa_topology topology;
+  for (size_t i = 0; i < nodes; i++) {
+    numa_node node;
+    node.id   = i;
+    node.cpus = {0};
+    topology.nodes.push_back(node);
+  }
+  return topology;
+}
+
+}  // namespace
+
+TEST(numa, sysfs_topology) {
+  const std::string root = temp_path("sysfs");
+  mkdir(root.c_str(), 0755);
+  for (const char *node : {"/node0", "/node1", "/node2"}) {
+    mkdir((root + node).c_str(), 0755);
+  }
+  std::ofstream(root + "/online") << "0-2\n";
+  std::ofstream(root + "/node0/cpulist") << "0-1,4\n";
+  std::ofstream(root + "/node1/cpulist") << "2-3\n";
+  std::ofstream(root + "/node2/cpulist") << "\n";  // memory only
+
+  const numa_topology topology = detect_numa_topology(root);
+  ASSERT_EQ(topology.size(), 2u);
+  EXPECT_TRUE(topology.is_numa());
+  EXPECT_EQ(topology.nodes[0].cpus, std::vector<size_t>({0, 1, 4}));
+  EXPECT_EQ(topology.nodes[1].id, 1u);
+  EXPECT_EQ(topology.nodes[1].cpus, std::vector<size_t>({2, 3}));
+  EXPECT_EQ(topology.cpus(), 5u);
+
+  // nodes split a batch by their share of the cpus
+  EXPECT_EQ(numa_partition(topology, 10), std::vector<size_t>({0, 6, 10}));
+
+  const numa_topology fallback = detect_numa_topology(root + "/missing");
+  ASSERT_EQ(fallback.size(), 1u);
+  EXPECT_FALSE(fallback.is_numa());
+  EXPECT_EQ(fallback.cpus(), parallel_concurrency());
+}
+
+TEST(numa, numa_for_covers_range) {
+  const numa_topology topology = fake_numa_topology(3);
+  std::vector<int> visits(50, 0);
+  std::vector<size_t> owner(50);
+  numa_for(topology, visits.size(), [&](size_t node, size_t begin,
+                                        size_t end) {
+    // limited to the single cpu of the node
+    EXPECT_EQ(parallel_concurrency(), 1u);
+    for (size_t i = begin; i < end; i++) {
+      visits[i]++;
+      owner[i] = node;
+    }
+  });
+  EXPECT_EQ(visits, std::vector<int>(50, 1));
+  EXPECT_EQ(owner[0], 0u);
+  EXPECT_EQ(owner[49], 2u);
+}
+
+TEST(numa, replicated_fully_connected) {
+  fully_connected_layer fc(40, 24);
+  fc.setup(false);
+  uniform_rand(fc.weights()[0]->begin(), fc.weights()[0]->end(), -1.0f,
+               1.0f);
+  uniform_rand(fc.weights()[1]->begin(), fc.weights()[1]->end(), -1.0f,
+               1.0f);
+  tensor_t in = generate_test_data({9}, {40})[0];
+
+  auto forward = [&]() {
+    tensor_t out(in.size(), vec_t(24));
+    tensor_t W{*fc.weights()[0]}, b{*fc.weights()[1]};
+    std::vector<tensor_t *> in_data = {&in, &W, &b}, out_data = {&out};
+    fc.forward_propagation(in_data, out_data);
+    return out;
+  };
+  const tensor_t expected = forward();
+
+  fc.set_numa_policy(numa_policy::replicate, fake_numa_topology(2));
+  EXPECT_EQ(forward(), expected);
+  EXPECT_EQ(fc.numa_replica_bytes(), 2 * 40 * 24 * sizeof(float_t));
+
+  // a single node needs no copy
+  fc.set_numa_policy(numa_policy::replicate, fake_numa_topology(1));
+  EXPECT_EQ(forward(), expected);
+  EXPECT_EQ(fc.numa_replica_bytes(), 0u);
+
+  fc.set_numa_policy(numa_policy::interleave, fake_numa_topology(1));
+  EXPECT_EQ(forward(), expected);
+
+  // a backward pass, then a training step: the copies follow the weights
+  fc.set_numa_policy(numa_policy::replicate, fake_numa_topology(2));
+  EXPECT_EQ(forward(), expected);
+  tensor_t out(in.size(), vec_t(24)), dy = generate_test_data({9}, {24})[0];
+  tensor_t dx(in.size(), vec_t(40)), dW(in.size(), vec_t(40 * 24));
+  tensor_t db(in.size(), vec_t(24)), W{*fc.weights()[0]}, b{*fc.weights()[1]};
+  std::vector<tensor_t *> in_data = {&in, &W, &b}, out_data = {&out};
+  std::vector<tensor_t *> out_grad = {&dy}, in_grad = {&dx, &dW, &db};
+  fc.back_propagation(in_data, out_data, out_grad, in_grad);
+  for (float_t &w : *fc.weights()[0]) w *= float_t(0.5);
+  const tensor_t trained = forward();
+  EXPECT_NE(trained, expected);
+  fc.set_numa_policy(numa_policy::none);
+  EXPECT_EQ(forward(), trained);
+}
+
+TEST(numa, persistent_workers) {
+  const numa_topology topology = fake_numa_topology(2);
+  std::vector<std::thread::id> first(2), second(2);
+  for_each_numa_node(topology, [&](size_t node) {
+    first[node] = std::this_thread::get_id();
+    // the loops of a node stay on its single worker
+    EXPECT_EQ(parallel_concurrency(), 1u);
+  });
+  for_each_numa_node(topology, [&](size_t node) {
+    second[node] = std::this_thread::get_id();
+    // nested: runs on the calling worker
+    for_each_numa_node(topology, [&](size_t) {
+      EXPECT_EQ(std::this_thread::get_id(), second[node]);
+    });
+  });
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first[0], first[1]);
+  EXPECT_NE(first[0], std::this_thread::get_id());
+
+  EXPECT_THROW(for_each_numa_node(topology,
+                                  [](size_t node) {
+                                    if (node == 1) throw "node failed";
+                                  }),
+               const char *);
+}
+
+}  // namespace litchi
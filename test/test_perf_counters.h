@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+TEST(perf_counters, derive_metrics) {
+  perf_sample s;
+  s.values = {{1000, 2000, 40, 10, 2}};
+  s.valid  = 0x1f;
+  s.ns     = 500;
+  s.count  = 1;
+
+  const perf_metrics m = derive_metrics(s, 4000, 1000);
+  EXPECT_DOUBLE_EQ(m.ipc, 2.0);
+  EXPECT_DOUBLE_EQ(m.gflops, 8.0);
+  EXPECT_DOUBLE_EQ(m.tensor_gbps, 2.0);
+  EXPECT_DOUBLE_EQ(m.dram_gbps, 10.0 * 64 / 500);
+  EXPECT_DOUBLE_EQ(m.arithmetic_intensity, 4000.0 / (10 * 64));
+  EXPECT_DOUBLE_EQ(m.l1d_mpki, 20.0);
+  EXPECT_DOUBLE_EQ(m.llc_mpki, 5.0);
+  EXPECT_DOUBLE_EQ(m.dtlb_mpki, 1.0);
+
+  // without the cycles only the counted events give metrics
+  s.valid = 0x1e;
+  const perf_metrics partial = derive_metrics(s, 4000, 1000);
+  EXPECT_TRUE(std::isnan(partial.ipc));
+  EXPECT_DOUBLE_EQ(partial.llc_mpki, 5.0);
+
+  // an event stays valid in a sum only if every measurement counted it
+  perf_sample sum;
+  sum += s;
+  perf_sample other = s;
+  other.valid       = 0x0f;
+  sum += other;
+  EXPECT_EQ(sum.count, 2u);
+  EXPECT_EQ(sum[perf_event::instructions], 4000u);
+  EXPECT_TRUE(sum.has(perf_event::llc_misses));
+  EXPECT_FALSE(sum.has(perf_event::dtlb_misses));
+}
+
+TEST(perf_counters, measure) {
+  perf_counters counters;
+  counters.start();
+  volatile float_t x = 0;
+  for (int i = 0; i < 100000; i++) x = x + float_t(i);
+  const perf_sample s = counters.stop();
+
+  EXPECT_EQ(s.count, 1u);
+  EXPECT_GT(s.ns, 0u);
+  if (!counters.available()) {
+    // denied in this environment: wall time only
+    EXPECT_EQ(s.valid, 0u);
+  } else if (s.has(perf_event::instructions)) {
+    EXPECT_GT(s[perf_event::instructions], 100000u);
+  }
+}
+
+TEST(perf_counters, kernel_profiler) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(10, 4)
+      << std::make_shared<relu>(4);
+  const tensor_t batch = generate_test_data({3}, {10})[0];
+
+  kernel_profiler::reset();
+  net.forward(batch);  // disabled: nothing recorded
+  EXPECT_TRUE(kernel_profiler::report().empty());
+
+  kernel_profiler::enable();
+  net.forward(batch);
+  net.forward(batch);
+  net.backward(tensor_t(3, vec_t(4, 1.0f)));
+  kernel_profiler::disable();
+
+  const std::vector<kernel_profile> report = kernel_profiler::report();
+  const kernel_profile *fwd = nullptr, *grad = nullptr;
+  for (const kernel_profile &p : report) {
+    if (p.name == "FullyConnectedOp") fwd = &p;
+    if (p.name == "FullyConnectedGradOp") grad = &p;
+  }
+  ASSERT_NE(fwd, nullptr);
+  ASSERT_NE(grad, nullptr);
+  EXPECT_EQ(fwd->calls, 2u);
+  EXPECT_EQ(fwd->flops, 2u * 2 * 3 * 10 * 4);
+  EXPECT_EQ(grad->calls, 1u);
+  EXPECT_EQ(grad->flops, 4u * 3 * 10 * 4);
+  EXPECT_GT(fwd->bytes, 0u);
+  EXPECT_EQ(fwd->counters.count, 2u);
+  EXPECT_FALSE(std::isnan(fwd->metrics().gflops));
+  kernel_profiler::reset();
+}
+
+}  // namespace litchi
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+float_t reference_sigmoid(float_t x) { return 1 / (1 + std::exp(-x)); }
+
+// gate k of unit j at step t, x_t W_x + h W_h + b, computed naively
+float_t reference_gate(const std::vector<tensor_t> &data,
+                       const float_t *x,
+                       const float_t *h,
+                       size_t in,
+                       size_t hidden,
+                       size_t k,
+                       size_t j) {
+  const size_t G = data[3][0].size();
+  float_t a      = data[3][0][k * hidden + j];
+  for (size_t c = 0; c < in; c++) {
+    a += x[c] * data[1][0][c * G + k * hidden + j];
+  }
+  for (size_t c = 0; h && c < hidden; c++) {
+    a += h[c] * data[2][0][c * G + k * hidden + j];
+  }
+  return a;
+}
+
+}  // namespace
+
+TEST(recurrent, lstm_forward) {
+  const size_t in = 3, hidden = 5, steps = 4, batch = 2;
+  lstm_layer lstm(in, hidden, steps);
+  std::vector<tensor_t> data = generate_test_data(
+    {batch, 1, 1, 1},
+    {in * steps, in * 4 * hidden, hidden * 4 * hidden, 4 * hidden});
+  tensor_t y(batch, vec_t(hidden * steps));
+  std::vector<tensor_t *> in_data  = {&data[0], &data[1], &data[2], &data[3]};
+  std::vector<tensor_t *> out_data = {&y};
+  lstm.forward_propagation(in_data, out_data);
+
+  for (size_t s = 0; s < batch; s++) {
+    vec_t h(hidden, float_t{0}), c(hidden, float_t{0});
+    for (size_t t = 0; t < steps; t++) {
+      const float_t *x = &data[0][s][t * in];
+      vec_t next_h(hidden);
+      for (size_t j = 0; j < hidden; j++) {
+        auto gate = [&](size_t k) {
+          return reference_gate(data, x, t > 0 ? &h[0] : nullptr, in, hidden,
+                                k, j);
+        };
+        const float_t i = reference_sigmoid(gate(0));
+        const float_t f = reference_sigmoid(gate(1));
+        const float_t g = std::tanh(gate(2));
+        const float_t o = reference_sigmoid(gate(3));
+        c[j]            = f * c[j] + i * g;
+        next_h[j]       = o * std::tanh(c[j]);
+        EXPECT_NEAR(y[s][t * hidden + j], next_h[j], 1e-5);
+      }
+      h = next_h;
+    }
+  }
+}
+
+TEST(recurrent, gru_forward) {
+  const size_t in = 3, hidden = 5, steps = 4, batch = 2;
+  gru_layer gru(in, hidden, steps);
+  std::vector<tensor_t> data = generate_test_data(
+    {batch, 1, 1, 1},
+    {in * steps, in * 3 * hidden, hidden * 3 * hidden, 3 * hidden});
+  tensor_t y(batch, vec_t(hidden * steps));
+  std::vector<tensor_t *> in_data  = {&data[0], &data[1], &data[2], &data[3]};
+  std::vector<tensor_t *> out_data = {&y};
+  gru.forward_propagation(in_data, out_data);
+
+  for (size_t s = 0; s < batch; s++) {
+    vec_t h(hidden, float_t{0});
+    for (size_t t = 0; t < steps; t++) {
+      const float_t *x = &data[0][s][t * in];
+      vec_t next_h(hidden);
+      for (size_t j = 0; j < hidden; j++) {
+        const float_t *hp = t > 0 ? &h[0] : nullptr;
+        // h W_hn alone, without the input projection and the bias
+        float_t hn = float_t{0};
+        for (size_t c = 0; hp && c < hidden; c++) {
+          hn += hp[c] * data[2][0][c * 3 * hidden + 2 * hidden + j];
+        }
+        const float_t r =
+          reference_sigmoid(reference_gate(data, x, hp, in, hidden, 0, j));
+        const float_t z =
+          reference_sigmoid(reference_gate(data, x, hp, in, hidden, 1, j));
+        const float_t n = std::tanh(
+          reference_gate(data, x, nullptr, in, hidden, 2, j) + r * hn);
+        next_h[j] = (1 - z) * n + z * h[j];
+        EXPECT_NEAR(y[s][t * hidden + j], next_h[j], 1e-5);
+      }
+      h = next_h;
+    }
+  }
+}
+
+TEST(recurrent, lstm_gradient_check) {
+  const size_t in = 3, hidden = 4, steps = 5;
+  lstm_layer lstm(in, hidden, steps);
+  std::vector<tensor_t> input_data = generate_test_data(
+    {1, 1, 1, 1},
+    {in * steps, in * 4 * hidden, hidden * 4 * hidden, 4 * hidden});
+
+  gradient_checker checker(lstm, input_data);
+  std::vector<gradient_check_report> reports = checker.check();
+  ASSERT_EQ(reports.size(), 4u);  // in, W_x, W_h and b
+  for (const auto &report : reports) {
+    EXPECT_LT(report.max_relative_error, epsilon<float_t>());
+  }
+}
+
+TEST(recurrent, gru_gradient_check) {
+  const size_t in = 3, hidden = 4, steps = 5;
+  gru_layer gru(in, hidden, steps);
+  std::vector<tensor_t> input_data = generate_test_data(
+    {1, 1, 1, 1},
+    {in * steps, in * 3 * hidden, hidden * 3 * hidden, 3 * hidden});
+
+  gradient_checker checker(gru, input_data);
+  std::vector<gradient_check_report> reports = checker.check();
+  ASSERT_EQ(reports.size(), 4u);  // in, W_x, W_h and b
+  for (const auto &report : reports) {
+    EXPECT_LT(report.max_relative_error, epsilon<float_t>());
+  }
+}
+
+TEST(recurrent, batch_gradients) {
+  // the weight gradients of a batch are the sums of those of its samples
+  const size_t in = 6, hidden = 8, steps = 7, batch = 3;
+  lstm_layer lstm(in, hidden, steps);
+  std::vector<tensor_t> data = generate_test_data(
+    {batch, 1, 1, 1},
+    {in * steps, in * 4 * hidden, hidden * 4 * hidden, 4 * hidden});
+  tensor_t dy = generate_test_data({batch}, {hidden * steps})[0];
+
+  auto gradients = [&](const tensor_t &x, const tensor_t &d) {
+    std::vector<tensor_t> in_data = {x, data[1], data[2], data[3]};
+    std::vector<tensor_t> in_grad = in_data;
+    for (auto &g : in_grad) fill_tensor(g, float_t{0});
+    tensor_t y(x.size(), vec_t(hidden * steps)), out_grad = d;
+    std::vector<tensor_t *> in_ptr   = tensor2ptr(in_data);
+    std::vector<tensor_t *> grad_ptr = tensor2ptr(in_grad);
+    std::vector<tensor_t *> out_ptr  = {&y}, out_grad_ptr = {&out_grad};
+    lstm.forward_propagation(in_ptr, out_ptr);
+    lstm.back_propagation(in_ptr, out_ptr, out_grad_ptr, grad_ptr);
+    return in_grad;
+  };
+
+  const std::vector<tensor_t> total = gradients(data[0], dy);
+  std::vector<vec_t> sum = {vec_t(total[1][0].size(), float_t{0}),
+                            vec_t(total[2][0].size(), float_t{0}),
+                            vec_t(total[3][0].size(), float_t{0})};
+  for (size_t s = 0; s < batch; s++) {
+    const std::vector<tensor_t> one =
+      gradients(tensor_t(1, data[0][s]), tensor_t(1, dy[s]));
+    for (size_t i = 0; i < total[0][s].size(); i++) {
+      EXPECT_NEAR(total[0][s][i], one[0][0][i], 1e-5);
+    }
+    for (size_t e = 1; e < 4; e++) {
+      for (size_t i = 0; i < sum[e - 1].size(); i++) {
+        sum[e - 1][i] += one[e][0][i];
+      }
+    }
+  }
+  for (size_t e = 1; e < 4; e++) {
+    for (size_t i = 0; i < sum[e - 1].size(); i++) {
+      EXPECT_NEAR(total[e][0][i], sum[e - 1][i], 1e-4);
+    }
+  }
+}
+
+TEST(vectorize, gate_activations) {
+  // covers the saturated ends, zero and a tail shorter than a register
+  vec_t x(1003), y(1003), z(1003);
+  for (size_t i = 0; i < x.size(); i++) x[i] = -100.0f + 0.2f * i;
+  x[500] = float_t{0};
+  vectorize::sigmoid(&x[0], x.size(), &y[0]);
+  vectorize::tanh(&x[0], x.size(), &z[0]);
+  for (size_t i = 0; i < x.size(); i++) {
+    EXPECT_NEAR(y[i], reference_sigmoid(x[i]), 1e-6) << "x = " << x[i];
+    EXPECT_NEAR(z[i], std::tanh(x[i]), 1e-6) << "x = " << x[i];
+  }
+
+  // in place, as the layers use them
+  vectorize::sigmoid(&x[0], x.size(), &x[0]);
+  EXPECT_EQ(x, y);
+}
+
+}  // namespace litchi
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace litchi {
+
+inline double reference_cross_entropy(const vec_t &x, size_t label) {
+  double m = x[0];
+  for (float_t v : x) m = std::max(m, double(v));
+  double sum = 0.0;
+  for (float_t v : x) sum += std::exp(double(v) - m);
+  return m + std::log(sum) - x[label];
+}
+
+TEST(softmax_cross_entropy, forward) {
+  const size_t classes = 37;  // not a multiple of the SIMD width
+  softmax_cross_entropy_layer l(classes);
+  tensor_t logits = generate_test_data({3}, {classes})[0];
+  logits[1][5]    = 50.0f;  // a dominating logit must not overflow
+  tensor_t labels = {{0}, {5}, {36}};
+
+  std::vector<const tensor_t *> out;
+  l.forward({logits, labels}, out);
+  for (size_t s = 0; s < logits.size(); s++) {
+    const size_t label = static_cast<size_t>(labels[s][0]);
+    EXPECT_NEAR((*out[0])[s][0], reference_cross_entropy(logits[s], label),
+                1e-5);
+  }
+}
+
+TEST(softmax_cross_entropy, label_out_of_range) {
+  EXPECT_THROW(softmax_cross_entropy_layer(0), const char *);
+
+  softmax_cross_entropy_layer l(4);
+  const tensor_t logits = generate_test_data({2}, {4})[0];
+  std::vector<const tensor_t *> out;
+  for (float_t bad : {float_t(-1), float_t(4), float_t(1e9),
+                      std::numeric_limits<float_t>::quiet_NaN()}) {
+    EXPECT_THROW(l.forward({logits, {{0}, {bad}}}, out), const char *);
+  }
+  l.forward({logits, {{0}, {3}}}, out);
+  EXPECT_EQ(out[0]->size(), 2u);
+}
+
+TEST(softmax_cross_entropy, gradient_check) {
+  const size_t classes = 21;
+  softmax_cross_entropy_layer l(classes);
+  std::vector<tensor_t> input = generate_test_data({1}, {classes});
+  input.push_back({{7}});
+
+  gradient_checker checker(l, input);
+  std::vector<gradient_check_report> reports = checker.check();
+  ASSERT_EQ(reports.size(), 1u);  // labels are not checked
+  EXPECT_EQ(reports[0].probes, classes);
+  EXPECT_LT(reports[0].max_relative_error, epsilon<float_t>());
+}
+
+TEST(softmax_cross_entropy, large_output) {
+  const size_t classes = 10007;
+  softmax_cross_entropy_layer l(classes);
+  std::vector<tensor_t *> in_data, out_data, in_grad, out_grad;
+  tensor_t x = generate_test_data({2}, {classes})[0];
+  for (auto &v : x[0]) v *= 20.0f;
+  tensor_t label = {{123}, {10006}};
+  tensor_t loss(2, vec_t(1)), dy(2, vec_t(1, 1.0f));
+  tensor_t dx(2, vec_t(classes)), dlabel(2, vec_t(1));
+  in_data  = {&x, &label};
+  out_data = {&loss};
+  in_grad  = {&dx, &dlabel};
+  out_grad = {&dy};
+
+  l.forward_propagation(in_data, out_data);
+  l.back_propagation(in_data, out_data, out_grad, in_grad);
+
+  for (size_t s = 0; s < 2; s++) {
+    const size_t t = static_cast<size_t>(label[s][0]);
+    EXPECT_NEAR(loss[s][0], reference_cross_entropy(x[s], t), 1e-3);
+
+    // softmax sums to one, so the gradient sums to zero
+    double sum = 0.0;
+    for (float_t g : dx[s]) sum += g;
+    EXPECT_NEAR(sum, 0.0, 1e-4);
+    EXPECT_NEAR(dx[s][t], std::exp(-double(loss[s][0])) - 1.0, 1e-5);
+  }
+}
+
+TEST(vectorize, exp_scale) {
+  vec_t x(1001), y(1001);
+  for (size_t i = 0; i < x.size(); i++) x[i] = -80.0f + 0.08f * i;
+  vectorize::exp_scale(&x[0], x.size(), float_t{0}, float_t{2}, &y[0]);
+  for (size_t i = 0; i < x.size(); i++) {
+    const double expected = 2.0 * std::exp(double(x[i]));
+    EXPECT_NEAR(y[i] / expected, 1.0, 1e-6) << "x = " << x[i];
+  }
+  EXPECT_FLOAT_EQ(vectorize::max_value(&x[0], x.size()), x.back());
+}
+
+}  // namespace litchi
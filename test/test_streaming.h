@@ -0,0 +1,143 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+void build_streaming_net(sequential &net) {
+  net << std::make_shared<fully_connected_layer>(12, 32)
+      << std::make_shared<relu>(32)
+      << std::make_shared<fully_connected_layer>(32, 5);
+  net.setup(false);
+}
+
+// outputs of a stream gathered in order
+struct gathered_outputs {
+  tensor_t outputs;
+
+  sample_sink sink() {
+    return [this](size_t first, const tensor_t &chunk) {
+      EXPECT_EQ(first, outputs.size());
+      outputs.insert(outputs.end(), chunk.begin(), chunk.end());
+    };
+  }
+};
+
+}  // namespace
+
+TEST(streaming, matches_batch_forward) {
+  sequential net;
+  build_streaming_net(net);
+  const tensor_t x        = generate_test_data({1000}, {12})[0];
+  const tensor_t expected = net.forward(x);
+
+  for (bool pipelined : {false, true}) {
+    streaming_options options;
+    options.chunk_size = 64;
+    options.pipelined  = pipelined;
+    gathered_outputs result;
+    const streaming_report report =
+      stream_forward(net, x.begin(), x.end(), result.sink(), options);
+    EXPECT_EQ(report.samples, 1000u);
+    EXPECT_EQ(report.chunks, 16u);
+    EXPECT_EQ(report.chunk_size, 64u);
+    ASSERT_EQ(result.outputs.size(), expected.size());
+    for (size_t s = 0; s < expected.size(); s++) {
+      for (size_t i = 0; i < 5; i++) {
+        EXPECT_FLOAT_EQ(result.outputs[s][i], expected[s][i]);
+      }
+    }
+  }
+}
+
+TEST(streaming, memory_independent_of_length) {
+  sequential net;
+  build_streaming_net(net);
+  const vec_t sample = generate_test_data({1}, {12})[0][0];
+
+  // a source generating count samples without holding them
+  auto run = [&](size_t count) {
+    size_t produced      = 0;
+    sample_source source = [&](tensor_t &chunk, size_t max_samples) {
+      const size_t n = std::min(max_samples, count - produced);
+      for (size_t s = 0; s < n; s++) chunk[s] = sample;
+      produced += n;
+      return n;
+    };
+    streaming_options options;
+    options.chunk_size = 32;
+    size_t delivered   = 0;
+    const streaming_report report = stream_forward(
+      net, source,
+      [&](size_t, const tensor_t &out) { delivered += out.size(); },
+      options);
+    EXPECT_EQ(delivered, count);
+    return report;
+  };
+
+  const streaming_report short_stream = run(320);
+  const streaming_report long_stream  = run(32000);
+  EXPECT_EQ(long_stream.chunks, 1000u);
+  EXPECT_EQ(short_stream.peak_graph_bytes, long_stream.peak_graph_bytes);
+  EXPECT_EQ(short_stream.buffer_bytes, long_stream.buffer_bytes);
+  EXPECT_LT(long_stream.peak_graph_bytes,
+            net.predict_memory(32000).total.total() / 100);
+}
+
+TEST(streaming, chunk_size_from_cache) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(256, 1024)
+      << std::make_shared<fully_connected_layer>(1024, 8);
+  EXPECT_EQ(streaming_chunk_size(net.layers(), size_t(1) << 20),
+            (size_t(1) << 20) / ((256 + 1024) * sizeof(float_t)));
+  EXPECT_EQ(streaming_chunk_size(net.layers(), 16), 1u);
+
+  const tensor_t x = generate_test_data({7}, {256})[0];
+  const streaming_report report = stream_forward(
+    net, x.begin(), x.end(), [](size_t, const tensor_t &) {});
+  EXPECT_EQ(report.chunks, 1u);
+  EXPECT_EQ(report.samples, 7u);
+}
+
+TEST(streaming, errors) {
+  sequential net;
+  build_streaming_net(net);
+  const tensor_t x = generate_test_data({100}, {12})[0];
+  streaming_options options;
+  options.chunk_size = 10;
+
+  for (bool pipelined : {false, true}) {
+    options.pipelined     = pipelined;
+    size_t calls          = 0;
+    sample_source failing = [&](tensor_t &chunk, size_t max_samples) {
+      if (++calls == 3) throw "source failed";
+      for (size_t s = 0; s < max_samples; s++) chunk[s] = x[s];
+      return max_samples;
+    };
+    size_t delivered = 0;
+    EXPECT_THROW(stream_forward(net, failing,
+                                [&](size_t, const tensor_t &out) {
+                                  delivered += out.size();
+                                },
+                                options),
+                 const char *);
+    EXPECT_LE(delivered, 20u);
+
+    EXPECT_THROW(stream_forward(net, x.begin(), x.end(),
+                                [](size_t first, const tensor_t &) {
+                                  if (first == 50) throw "sink failed";
+                                },
+                                options),
+                 const char *);
+
+    const tensor_t wrong = generate_test_data({5}, {11})[0];
+    EXPECT_THROW(stream_forward(net, wrong.begin(), wrong.end(),
+                                [](size_t, const tensor_t &) {}, options),
+                 const char *);
+  }
+}
+
+}  // namespace litchi
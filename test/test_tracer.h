@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace litchi {
+
+namespace {
+
+const trace_event *find_event(const std::vector<trace_event> &events,
+                              const std::string &name) {
+  for (const trace_event &e : events) {
+    if (name == e.name) return &e;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+TEST(tracer, layers_and_kernels) {
+  sequential net;
+  net << std::make_shared<fully_connected_layer>(10, 4)
+      << std::make_shared<relu>(4);
+  const tensor_t batch = generate_test_data({3}, {10})[0];
+
+  tracer::clear();
+  net.forward(batch);  // disabled: nothing recorded
+  EXPECT_TRUE(tracer::events().empty());
+
+  tracer::enable();
+  net.forward(batch);
+  net.backward(tensor_t(3, vec_t(4, 1.0f)));
+  {
+    work_stealing_pool pool(2);
+    pool.submit([]() {});
+  }
+  tracer::disable();
+
+  const std::vector<trace_event> events = tracer::events();
+  const trace_event *fc   = find_event(events, "fully-connected.forward");
+  const trace_event *op   = find_event(events, "FullyConnectedOp");
+  const trace_event *grad = find_event(events, "FullyConnectedGradOp");
+  const trace_event *back = find_event(events, "relu-activation.backward");
+  const trace_event *task = find_event(events, "pool.task");
+  ASSERT_NE(fc, nullptr);
+  ASSERT_NE(op, nullptr);
+  EXPECT_NE(grad, nullptr);
+  EXPECT_NE(back, nullptr);
+  EXPECT_NE(task, nullptr);
+
+  EXPECT_STREQ(fc->category, "layer");
+  EXPECT_STREQ(op->category, "kernel");
+  EXPECT_EQ(fc->batch, 3u);
+  // input, W, b and output
+  EXPECT_EQ(fc->bytes, (3 * 10 + 40 + 4 + 3 * 4) * sizeof(float_t));
+  // the kernel runs within its layer, on the same thread
+  EXPECT_EQ(op->thread, fc->thread);
+  EXPECT_GE(op->begin_ns, fc->begin_ns);
+  EXPECT_LE(op->begin_ns + op->duration_ns,
+            fc->begin_ns + fc->duration_ns);
+  EXPECT_TRUE(std::is_sorted(events.begin(), events.end(),
+                             [](const trace_event &a, const trace_event &b) {
+                               return a.begin_ns < b.begin_ns;
+                             }));
+
+  std::ostringstream os;
+  tracer::write_chrome_trace(os);
+  const std::string json = os.str();
+  EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+  EXPECT_NE(json.find("\"name\":\"fully-connected.forward\",\"cat\":\"layer\","
+                      "\"ph\":\"X\""),
+            std::string::npos);
+  EXPECT_NE(json.find("\"args\":{\"batch\":3,"), std::string::npos);
+
+  tracer::clear();
+  EXPECT_TRUE(tracer::events().empty());
+}
+
+TEST(tracer, ring_keeps_latest_events) {
+  tracer::clear();
+  tracer::enable();
+  std::thread([]() {
+    for (int i = 0; i < 20000; i++) trace_scope trace("test", "spin");
+    trace_scope trace("test", "last");
+  }).join();
+  tracer::disable();
+
+  // the exited thread's buffer is kept, holding its latest events
+  const std::vector<trace_event> events = tracer::events();
+  EXPECT_LE(events.size(), 8192u);
+  EXPECT_GT(events.size(), 0u);
+  EXPECT_STREQ(events.back().name, "last");
+  tracer::clear();
+}
+
+}  // namespace litchi
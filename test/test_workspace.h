@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace litchi {
+
+TEST(workspace, lease_reuse) {
+  core::workspace ws;
+  ws.reserve(1000, 2);
+  EXPECT_EQ(ws.allocations(), 2u);
+  {
+    core::workspace::lease a = ws.acquire(1000);
+    core::workspace::lease b = ws.acquire(600);
+    EXPECT_NE(a.data(), b.data());
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a.data()) %
+                core::workspace::alignment,
+              0u);
+    EXPECT_GE(b.bytes(), 600u);
+    EXPECT_EQ(ws.allocations(), 2u);
+  }
+  // returned buffers are leased again, a larger request grows one of them
+  {
+    core::workspace::lease a = ws.acquire(800);
+    core::workspace::lease b = ws.acquire(4000);
+    EXPECT_EQ(b.bytes(), 4000u);
+    EXPECT_EQ(ws.allocations(), 3u);
+  }
+  core::workspace::lease a = ws.acquire(4000);
+  core::workspace::lease b = ws.acquire(10);
+  EXPECT_EQ(ws.allocations(), 3u);
+  EXPECT_EQ(ws.bytes(), 5000u);
+}
+
+TEST(workspace, steady_state) {
+  core::fully_params params;
+  params.in_size_  = 300;
+  params.out_size_ = 40;
+  params.has_bias_ = true;
+  core::OpKernelConstruction construction(&params);
+  FullyConnectedOp op(construction);
+  EXPECT_EQ(op.workspace_size(),
+            kernels::fully_connected_workspace_size(params));
+
+  tensor_t in = generate_test_data({8}, {300})[0];
+  tensor_t W  = generate_test_data({1}, {300 * 40})[0];
+  tensor_t b  = generate_test_data({1}, {40})[0];
+  tensor_t out(8, vec_t(40));
+  std::vector<tensor_t *> inputs  = {&in, &W, &b};
+  std::vector<tensor_t *> outputs = {&out};
+  core::OpKernelContext context;
+  context.set_in_out(inputs, outputs);
+  context.setEngine(core::backend_t::internal);
+
+  EXPECT_GT(heap_allocations, 0u);  // counting works
+  for (bool parallelize : {false, true}) {
+    context.setParallelize(parallelize);
+    op.run(context);
+    const tensor_t expected  = out;
+    const size_t allocations = context.scratch().allocations();
+    for (int i = 0; i < 3; i++) {
+      const size_t heap = heap_allocations;
+      op.run(context);
+      EXPECT_EQ(context.scratch().allocations(), allocations);
+      if (!parallelize) {
+        EXPECT_EQ(heap_allocations - heap, 0u);
+      }
+    }
+    EXPECT_EQ(out, expected);
+  }
+
+  // a copy shares the settings, not the buffers
+  core::OpKernelContext copy = context;
+  EXPECT_EQ(copy.engine(), core::backend_t::internal);
+  EXPECT_TRUE(copy.parallelize());
+  EXPECT_EQ(copy.scratch().allocations(), 0u);
+}
+
+}  // namespace litchi
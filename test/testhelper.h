@@ -1,5 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
 #include <utility>
 
 #include "litchi/litchi.h"
@@ -7,6 +11,39 @@
 
 namespace litchi {
 
+// calls of the global operator new so far, by every thread
+std::atomic<size_t> heap_allocations{0};
+
+}  // namespace litchi
+
+// counted for the tests asserting that a steady state allocates nothing;
+// kept out of line so that the compiler does not pair malloc with delete
+__attribute__((noinline)) void *operator new(std::size_t size) {
+  litchi::heap_allocations++;
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p,
+                                               std::size_t) noexcept {
+  std::free(p);
+}
+
+namespace litchi {
+
+// a file name of the temporary directory owned by the running test, so
+// that tests run in parallel by ctest do not share files
+inline std::string temp_path(const std::string &name) {
+  const ::testing::TestInfo *test =
+    ::testing::UnitTest::GetInstance()->current_test_info();
+  return ::testing::TempDir() + "litchi_" + test->test_suite_name() + "_" +
+         test->name() + "_" + name;
+}
+
 template <typename T> inline T epsilon() { return 0; }
 
 template <> inline float epsilon() { return 1e-2f; }